@@ -0,0 +1,1207 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/*
+ * intel-gen4analyse: static summary of compiled EU kernels.
+ *
+ * Every input file is one kernel, either as the hex dwords (or bytes with -b)
+ * of a C array as read by intel-gen4disasm, or as the raw binary. Kernels are
+ * decoded with the tables of the disassembler, compacted instructions are
+ * expanded through brw_eu_compact.c, and for each one a JSON object with the
+ * instruction mix, SEND messages per shared function, register footprint,
+ * control flow graph and a rough cycle estimate is printed. Directories are
+ * walked for kernels and the files are analysed in parallel.
+ */
+
+#include <ctype.h>
+#include <errno.h>
+#include <ftw.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "brw_context.h"
+#include "brw_defines.h"
+#include "brw_eu.h"
+
+#ifndef ARRAY_SIZE
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+#endif
+
+#define MAX_GRF 128
+#define MAX_MRF 16
+
+enum insn_class {
+	CLASS_MOVE,
+	CLASS_LOGIC,
+	CLASS_COMPARE,
+	CLASS_ARITH,
+	CLASS_MATH,
+	CLASS_CONTROL,
+	CLASS_SEND,
+	CLASS_NOP,
+	CLASS_OTHER,
+	NUM_CLASSES
+};
+
+static const char *class_names[NUM_CLASSES] = {
+	[CLASS_MOVE] = "move",
+	[CLASS_LOGIC] = "logic",
+	[CLASS_COMPARE] = "compare",
+	[CLASS_ARITH] = "arith",
+	[CLASS_MATH] = "math",
+	[CLASS_CONTROL] = "control",
+	[CLASS_SEND] = "send",
+	[CLASS_NOP] = "nop",
+	[CLASS_OTHER] = "other",
+};
+
+/* Opcodes the disassembler's opcode_descs does not name. */
+static const char *extra_opcode_names[128] = {
+	[BRW_OPCODE_RSR] = "rsr",
+	[BRW_OPCODE_RSL] = "rsl",
+	[BRW_OPCODE_F32TO16] = "f32to16",
+	[BRW_OPCODE_F16TO32] = "f16to32",
+	[BRW_OPCODE_BFREV] = "bfrev",
+	[BRW_OPCODE_BFE] = "bfe",
+	[BRW_OPCODE_BFI1] = "bfi1",
+	[BRW_OPCODE_BFI2] = "bfi2",
+	[BRW_OPCODE_BRD] = "brd",
+	[BRW_OPCODE_FBH] = "fbh",
+	[BRW_OPCODE_FBL] = "fbl",
+	[BRW_OPCODE_CBIT] = "cbit",
+	[BRW_OPCODE_ADDC] = "addc",
+	[BRW_OPCODE_SUBB] = "subb",
+	[BRW_OPCODE_DPA2] = "dpa2",
+	[BRW_OPCODE_LRP] = "lrp",
+};
+
+#define NUM_SFIDS 16
+
+/* Rough cost of a message until its response can be used. */
+static const unsigned int sfid_latency[NUM_SFIDS] = {
+	[BRW_SFID_NULL] = 1,
+	[BRW_SFID_MATH] = 22,
+	[BRW_SFID_SAMPLER] = 300,
+	[BRW_SFID_MESSAGE_GATEWAY] = 30,
+	[BRW_SFID_DATAPORT_READ] = 150,
+	[BRW_SFID_DATAPORT_WRITE] = 150,
+	[BRW_SFID_URB] = 60,
+	[BRW_SFID_THREAD_SPAWNER] = 10,
+	[GEN6_SFID_VME] = 300,
+	[GEN6_SFID_DATAPORT_CONSTANT_CACHE] = 150,
+	[GEN7_SFID_DATAPORT_DATA_CACHE] = 150,
+	[11] = 50, /* pixel interpolator */
+	[HSW_SFID_DATAPORT_DATA_CACHE1] = 150,
+	[HSW_SFID_CRE] = 300,
+};
+
+static const char *sfid_name(int gen, unsigned int sfid)
+{
+	static const char *gen4_names[NUM_SFIDS] = {
+		[BRW_SFID_NULL] = "null",
+		[BRW_SFID_MATH] = "math",
+		[BRW_SFID_SAMPLER] = "sampler",
+		[BRW_SFID_MESSAGE_GATEWAY] = "gateway",
+		[BRW_SFID_DATAPORT_READ] = "dataport-read",
+		[BRW_SFID_DATAPORT_WRITE] = "dataport-write",
+		[BRW_SFID_URB] = "urb",
+		[BRW_SFID_THREAD_SPAWNER] = "thread-spawner",
+	};
+	static const char *gen6_names[NUM_SFIDS] = {
+		[BRW_SFID_NULL] = "null",
+		[BRW_SFID_SAMPLER] = "sampler",
+		[BRW_SFID_MESSAGE_GATEWAY] = "gateway",
+		[GEN6_SFID_DATAPORT_SAMPLER_CACHE] = "dataport-sampler-cache",
+		[GEN6_SFID_DATAPORT_RENDER_CACHE] = "dataport-render-cache",
+		[BRW_SFID_URB] = "urb",
+		[BRW_SFID_THREAD_SPAWNER] = "thread-spawner",
+		[GEN6_SFID_VME] = "vme",
+		[GEN6_SFID_DATAPORT_CONSTANT_CACHE] = "dataport-constant-cache",
+		[GEN7_SFID_DATAPORT_DATA_CACHE] = "dataport-data-cache",
+		[11] = "pixel-interpolator",
+		[HSW_SFID_DATAPORT_DATA_CACHE1] = "dataport-data-cache1",
+		[HSW_SFID_CRE] = "cre",
+	};
+	const char *name = (gen >= 6 ? gen6_names : gen4_names)[sfid];
+
+	return name ?: "unknown";
+}
+
+struct insn {
+	uint32_t dw[4];
+	unsigned int offset;
+	bool compacted;
+	/* Compacted on a gen without compaction tables, only counted. */
+	bool undecoded;
+};
+
+struct block {
+	unsigned int start, end;
+	int succ[3];
+	unsigned int num_succ;
+};
+
+struct kernel {
+	const char *path;
+	char *json;
+	bool failed;
+};
+
+static int gen;
+static bool byte_input;
+static struct intel_context intel;
+
+static struct kernel *kernels;
+static unsigned int num_kernels, max_kernels;
+static unsigned int next_kernel;
+static pthread_mutex_t next_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint32_t bits(const struct insn *insn, unsigned int high,
+		     unsigned int low)
+{
+	uint32_t v = insn->dw[low / 32] >> (low % 32);
+	unsigned int width = high - low + 1;
+
+	return width == 32 ? v : v & ((1u << width) - 1);
+}
+
+static int32_t sbits(const struct insn *insn, unsigned int high,
+		     unsigned int low)
+{
+	unsigned int width = high - low + 1;
+	uint32_t v = bits(insn, high, low);
+
+	if (width < 32 && v & (1u << (width - 1)))
+		v |= ~0u << width;
+
+	return (int32_t)v;
+}
+
+static unsigned int insn_opcode(const struct insn *insn)
+{
+	return bits(insn, 6, 0);
+}
+
+static const char *opcode_name(unsigned int opcode)
+{
+	if (gen >= 6 && opcode == BRW_OPCODE_CALL)
+		return "call";
+	if (gen >= 6 && opcode == BRW_OPCODE_RET)
+		return "ret";
+	if (gen >= 7 && opcode == BRW_OPCODE_IFF)
+		return "brc";
+
+	return opcode_descs[opcode].name ?: extra_opcode_names[opcode];
+}
+
+static enum insn_class opcode_class(unsigned int opcode)
+{
+	switch (opcode) {
+	case BRW_OPCODE_MOV:
+	case BRW_OPCODE_SEL:
+		return CLASS_MOVE;
+	case BRW_OPCODE_NOT:
+	case BRW_OPCODE_AND:
+	case BRW_OPCODE_OR:
+	case BRW_OPCODE_XOR:
+	case BRW_OPCODE_SHR:
+	case BRW_OPCODE_SHL:
+	case BRW_OPCODE_RSR:
+	case BRW_OPCODE_RSL:
+	case BRW_OPCODE_ASR:
+	case BRW_OPCODE_BFREV:
+	case BRW_OPCODE_BFE:
+	case BRW_OPCODE_BFI1:
+	case BRW_OPCODE_BFI2:
+	case BRW_OPCODE_LZD:
+	case BRW_OPCODE_FBH:
+	case BRW_OPCODE_FBL:
+	case BRW_OPCODE_CBIT:
+		return CLASS_LOGIC;
+	case BRW_OPCODE_CMP:
+	case BRW_OPCODE_CMPN:
+		return CLASS_COMPARE;
+	case BRW_OPCODE_F32TO16:
+	case BRW_OPCODE_F16TO32:
+	case BRW_OPCODE_ADD:
+	case BRW_OPCODE_MUL:
+	case BRW_OPCODE_AVG:
+	case BRW_OPCODE_FRC:
+	case BRW_OPCODE_RNDU:
+	case BRW_OPCODE_RNDD:
+	case BRW_OPCODE_RNDE:
+	case BRW_OPCODE_RNDZ:
+	case BRW_OPCODE_MAC:
+	case BRW_OPCODE_MACH:
+	case BRW_OPCODE_ADDC:
+	case BRW_OPCODE_SUBB:
+	case BRW_OPCODE_SAD2:
+	case BRW_OPCODE_SADA2:
+	case BRW_OPCODE_DP4:
+	case BRW_OPCODE_DPH:
+	case BRW_OPCODE_DP3:
+	case BRW_OPCODE_DP2:
+	case BRW_OPCODE_DPA2:
+	case BRW_OPCODE_LINE:
+	case BRW_OPCODE_PLN:
+	case BRW_OPCODE_MAD:
+	case BRW_OPCODE_LRP:
+		return CLASS_ARITH;
+	case BRW_OPCODE_MATH:
+		return CLASS_MATH;
+	case BRW_OPCODE_JMPI:
+	case BRW_OPCODE_BRD:
+	case BRW_OPCODE_IF:
+	case BRW_OPCODE_IFF:
+	case BRW_OPCODE_ELSE:
+	case BRW_OPCODE_ENDIF:
+	case BRW_OPCODE_DO:
+	case BRW_OPCODE_WHILE:
+	case BRW_OPCODE_BREAK:
+	case BRW_OPCODE_CONTINUE:
+	case BRW_OPCODE_HALT:
+	case BRW_OPCODE_CALL:
+	case BRW_OPCODE_RET:
+	case BRW_OPCODE_PUSH:
+	case BRW_OPCODE_POP:
+	case BRW_OPCODE_WAIT:
+		return CLASS_CONTROL;
+	case BRW_OPCODE_SEND:
+	case BRW_OPCODE_SENDC:
+		return CLASS_SEND;
+	case BRW_OPCODE_NOP:
+		return CLASS_NOP;
+	default:
+		return CLASS_OTHER;
+	}
+}
+
+static bool is_3src(unsigned int opcode)
+{
+	if (gen < 6)
+		return false;
+
+	switch (opcode) {
+	case BRW_OPCODE_MAD:
+	case BRW_OPCODE_LRP:
+	case BRW_OPCODE_BFE:
+	case BRW_OPCODE_BFI2:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool is_send(unsigned int opcode)
+{
+	return opcode == BRW_OPCODE_SEND || opcode == BRW_OPCODE_SENDC;
+}
+
+/* Register file and type of dst (0), src0 (1) and src1 (2). */
+static unsigned int operand_file(const struct insn *insn, int i)
+{
+	static const unsigned int gen4_low[] = { 32, 37, 42 };
+	static const unsigned int gen8_low[] = { 35, 41, 89 };
+	unsigned int low = gen >= 8 ? gen8_low[i] : gen4_low[i];
+
+	return bits(insn, low + 1, low);
+}
+
+static unsigned int operand_type_size(const struct insn *insn, int i)
+{
+	static const unsigned int gen4_low[] = { 34, 39, 44 };
+	static const unsigned int gen8_low[] = { 37, 43, 91 };
+	static const unsigned int sizes[16] = {
+		4, 4, 2, 2, 1, 1, 8, 4, 8, 8, 2, 4, 4, 4, 4, 4,
+	};
+	unsigned int type;
+
+	if (gen >= 8)
+		type = bits(insn, gen8_low[i] + 3, gen8_low[i]);
+	else
+		type = bits(insn, gen4_low[i] + 2, gen4_low[i]);
+
+	/* Type 6 is HF before DF was added on gen7. */
+	if (gen < 7 && type == 6)
+		return 2;
+
+	return sizes[type];
+}
+
+static unsigned int exec_size(const struct insn *insn)
+{
+	return 1u << bits(insn, 23, 21);
+}
+
+struct send_desc {
+	unsigned int sfid;
+	unsigned int mlen, rlen;
+	bool eot;
+	bool known;
+};
+
+static struct send_desc send_desc(const struct insn *insn)
+{
+	struct send_desc desc = {};
+
+	if (gen >= 6)
+		desc.sfid = bits(insn, 27, 24);
+	else if (gen == 5)
+		desc.sfid = bits(insn, 95, 92);
+	else
+		desc.sfid = bits(insn, 123, 120);
+
+	desc.eot = bits(insn, 127, 127);
+
+	/* The lengths are only known for an immediate descriptor. */
+	if (operand_file(insn, 2) != BRW_IMMEDIATE_VALUE)
+		return desc;
+
+	desc.known = true;
+	if (gen >= 5) {
+		desc.rlen = bits(insn, 120, 116);
+		desc.mlen = bits(insn, 124, 121);
+	} else {
+		desc.rlen = bits(insn, 115, 112);
+		desc.mlen = bits(insn, 119, 116);
+	}
+
+	return desc;
+}
+
+struct footprint {
+	uint64_t grf[MAX_GRF / 64];
+	uint32_t mrf;
+	int grf_max;
+};
+
+static void mark_grf(struct footprint *fp, unsigned int reg, unsigned int n)
+{
+	while (n-- && reg < MAX_GRF) {
+		fp->grf[reg / 64] |= 1ull << (reg % 64);
+		if ((int)reg > fp->grf_max)
+			fp->grf_max = reg;
+		reg++;
+	}
+}
+
+static unsigned int regs_spanned(unsigned int subreg, unsigned int bytes)
+{
+	return (subreg + bytes + 31) / 32 ?: 1;
+}
+
+static void operand_footprint(const struct insn *insn, int i,
+			      struct footprint *fp)
+{
+	/* dst, src0, src1: reg_nr, subreg_nr and address mode */
+	static const unsigned int reg_low[] = { 53, 69, 101 };
+	static const unsigned int subreg_low[] = { 48, 64, 96 };
+	static const unsigned int addr_bit[] = { 63, 79, 111 };
+	unsigned int file = operand_file(insn, i);
+	unsigned int reg, subreg, bytes;
+
+	/* Indirect accesses can't be resolved statically. */
+	if (bits(insn, addr_bit[i], addr_bit[i]))
+		return;
+
+	reg = bits(insn, reg_low[i] + 7, reg_low[i]);
+
+	if (file == BRW_MESSAGE_REGISTER_FILE && i == 0) {
+		fp->mrf |= 1u << (reg & (MAX_MRF - 1));
+		return;
+	}
+	if (file != BRW_GENERAL_REGISTER_FILE)
+		return;
+
+	subreg = bits(insn, subreg_low[i] + 4, subreg_low[i]);
+	bytes = exec_size(insn) * operand_type_size(insn, i);
+
+	if (i == 0) {
+		unsigned int hstride = bits(insn, 62, 61);
+
+		if (hstride > 1)
+			bytes <<= hstride - 1;
+	} else if (!bits(insn, reg_low[i] + 19, reg_low[i] + 16)) {
+		/* Scalar region, <0;1,0> */
+		bytes = operand_type_size(insn, i);
+	}
+
+	mark_grf(fp, reg, regs_spanned(subreg, bytes));
+}
+
+static void insn_footprint(const struct insn *insn, struct footprint *fp)
+{
+	unsigned int opcode = insn_opcode(insn);
+	unsigned int n = exec_size(insn) * 4;
+
+	if (is_3src(opcode)) {
+		/* Always GRF, assume 32 bit channels. */
+		mark_grf(fp, bits(insn, 63, 56), regs_spanned(0, n));
+		mark_grf(fp, bits(insn, 83, 76), regs_spanned(0, n));
+		mark_grf(fp, bits(insn, 104, 97), regs_spanned(0, n));
+		mark_grf(fp, bits(insn, 125, 118), regs_spanned(0, n));
+		return;
+	}
+
+	if (is_send(opcode)) {
+		struct send_desc desc = send_desc(insn);
+		unsigned int dst = bits(insn, 60, 53);
+		unsigned int src = bits(insn, 76, 69);
+
+		if (!desc.known) {
+			operand_footprint(insn, 0, fp);
+			operand_footprint(insn, 1, fp);
+			return;
+		}
+
+		if (desc.rlen && operand_file(insn, 0) == BRW_GENERAL_REGISTER_FILE)
+			mark_grf(fp, dst, desc.rlen);
+
+		/* Before gen7 the payload is in MRFs, src0 is an implied move. */
+		if (operand_file(insn, 1) == BRW_GENERAL_REGISTER_FILE)
+			mark_grf(fp, src, gen >= 7 ? desc.mlen : 1);
+		else if (operand_file(insn, 1) == BRW_MESSAGE_REGISTER_FILE)
+			fp->mrf |= ((1u << desc.mlen) - 1) << (src & (MAX_MRF - 1));
+
+		/* Gen4-6 SEND writes its payload from the MRF in the header. */
+		if (gen < 6)
+			fp->mrf |= ((1u << desc.mlen) - 1) <<
+				   (bits(insn, 27, 24) & (MAX_MRF - 1));
+		return;
+	}
+
+	if (opcode_class(opcode) == CLASS_CONTROL)
+		return;
+
+	operand_footprint(insn, 0, fp);
+	operand_footprint(insn, 1, fp);
+	if (opcode_descs[opcode].nsrc > 1 &&
+	    operand_file(insn, 2) != BRW_IMMEDIATE_VALUE)
+		operand_footprint(insn, 2, fp);
+}
+
+/*
+ * Issue cycles on the FPU, which handles 16 bytes of channels per cycle,
+ * the shared math unit being about four times slower, plus the latency of
+ * each message. Loops are counted once, so this is a per-pass figure for
+ * comparing builds of a kernel rather than a prediction.
+ */
+static unsigned int insn_cycles(const struct insn *insn)
+{
+	unsigned int opcode = insn_opcode(insn);
+	unsigned int bytes, cycles;
+
+	switch (opcode_class(opcode)) {
+	case CLASS_SEND: {
+		struct send_desc desc = send_desc(insn);
+
+		return 1 + (sfid_latency[desc.sfid] ?: 100);
+	}
+	case CLASS_CONTROL:
+	case CLASS_NOP:
+		return 1;
+	default:
+		break;
+	}
+
+	bytes = exec_size(insn) * (is_3src(opcode) ? 4 :
+				   operand_type_size(insn, 0));
+	cycles = (bytes + 15) / 16 ?: 1;
+
+	if (opcode == BRW_OPCODE_MATH)
+		cycles *= 4;
+
+	return cycles;
+}
+
+/* Bytes the jump fields count in. */
+static int jump_scale(void)
+{
+	if (gen >= 8)
+		return 1;
+	if (gen >= 5)
+		return 8;
+	return 16;
+}
+
+/*
+ * Jump targets as byte offsets, returns how many. JIP/UIP style offsets are
+ * relative to the instruction, JMPI ones to the next instruction.
+ */
+static unsigned int branch_targets(const struct insn *insn,
+				   unsigned int next_offset, int64_t *targets)
+{
+	unsigned int opcode = insn_opcode(insn);
+	int scale = jump_scale();
+	unsigned int n = 0;
+	int32_t jip, uip;
+	bool has_uip;
+
+	if (opcode == BRW_OPCODE_JMPI) {
+		targets[n++] = next_offset + (int64_t)sbits(insn, 127, 96) * scale;
+		return n;
+	}
+
+	/* ENDIF only joins, the jumps are all taken by IF and ELSE. */
+	switch (opcode) {
+	case BRW_OPCODE_IF:
+	case BRW_OPCODE_ELSE:
+	case BRW_OPCODE_WHILE:
+		has_uip = false;
+		break;
+	case BRW_OPCODE_BREAK:
+	case BRW_OPCODE_CONTINUE:
+	case BRW_OPCODE_HALT:
+		has_uip = gen >= 6;
+		break;
+	default:
+		return 0;
+	}
+
+	if (gen >= 8) {
+		jip = sbits(insn, 127, 96);
+		uip = sbits(insn, 95, 64);
+	} else if (gen == 6 && !has_uip) {
+		jip = sbits(insn, 63, 48);
+		uip = 0;
+	} else if (gen >= 6) {
+		jip = sbits(insn, 111, 96);
+		uip = sbits(insn, 127, 112);
+	} else {
+		jip = sbits(insn, 111, 96);
+		uip = 0;
+	}
+
+	targets[n++] = insn->offset + (int64_t)jip * scale;
+	if (has_uip && uip != jip)
+		targets[n++] = insn->offset + (int64_t)uip * scale;
+
+	return n;
+}
+
+static int find_insn(const struct insn *insns, unsigned int n, int64_t offset)
+{
+	unsigned int lo = 0, hi = n;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+
+		if (insns[mid].offset == offset)
+			return mid;
+		if (insns[mid].offset < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return -1;
+}
+
+/* Whether execution can continue with the next instruction. */
+static bool falls_through(const struct insn *insn)
+{
+	unsigned int opcode = insn_opcode(insn);
+
+	if (is_send(opcode))
+		return !send_desc(insn).eot;
+
+	switch (opcode) {
+	case BRW_OPCODE_ELSE:
+	case BRW_OPCODE_RET:
+		return false;
+	case BRW_OPCODE_JMPI:
+		/* Unpredicated, it always jumps. */
+		return bits(insn, 19, 16) != 0;
+	default:
+		return true;
+	}
+}
+
+static bool ends_block(const struct insn *insn)
+{
+	unsigned int opcode = insn_opcode(insn);
+
+	if (is_send(opcode))
+		return send_desc(insn).eot;
+
+	switch (opcode) {
+	case BRW_OPCODE_JMPI:
+	case BRW_OPCODE_IF:
+	case BRW_OPCODE_IFF:
+	case BRW_OPCODE_ELSE:
+	case BRW_OPCODE_WHILE:
+	case BRW_OPCODE_BREAK:
+	case BRW_OPCODE_CONTINUE:
+	case BRW_OPCODE_HALT:
+	case BRW_OPCODE_CALL:
+	case BRW_OPCODE_RET:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static struct block *build_cfg(const struct insn *insns, unsigned int n,
+			       unsigned int *num_blocks, unsigned int *loops)
+{
+	bool *leader = calloc(n + 1, sizeof(*leader));
+	int *block_of = calloc(n + 1, sizeof(*block_of));
+	struct block *blocks;
+	unsigned int i, nb = 0;
+
+	*loops = 0;
+	leader[0] = true;
+
+	for (i = 0; i < n; i++) {
+		unsigned int next = i + 1 < n ? insns[i + 1].offset :
+				    insns[i].offset + (insns[i].compacted ? 8 : 16);
+		int64_t targets[2];
+		unsigned int t, nt;
+
+		if (insns[i].undecoded)
+			continue;
+
+		nt = branch_targets(&insns[i], next, targets);
+		for (t = 0; t < nt; t++) {
+			int idx = find_insn(insns, n, targets[t]);
+
+			if (idx >= 0)
+				leader[idx] = true;
+			if (idx >= 0 && idx <= (int)i)
+				(*loops)++;
+		}
+
+		if (ends_block(&insns[i]))
+			leader[i + 1] = true;
+	}
+
+	for (i = 0; i < n; i++)
+		if (leader[i])
+			nb++;
+
+	blocks = calloc(nb ?: 1, sizeof(*blocks));
+	nb = 0;
+	for (i = 0; i < n; i++) {
+		if (leader[i]) {
+			if (nb)
+				blocks[nb - 1].end = i - 1;
+			blocks[nb].start = i;
+			nb++;
+		}
+		block_of[i] = nb - 1;
+	}
+	if (nb)
+		blocks[nb - 1].end = n - 1;
+
+	for (i = 0; i < nb; i++) {
+		struct block *b = &blocks[i];
+		const struct insn *last = &insns[b->end];
+		unsigned int next = b->end + 1 < n ? insns[b->end + 1].offset :
+				    last->offset + (last->compacted ? 8 : 16);
+		int64_t targets[2];
+		unsigned int t, nt;
+
+		nt = last->undecoded ? 0 : branch_targets(last, next, targets);
+		for (t = 0; t < nt; t++) {
+			int idx = find_insn(insns, n, targets[t]);
+			unsigned int s;
+
+			if (idx < 0)
+				continue;
+
+			for (s = 0; s < b->num_succ; s++)
+				if (b->succ[s] == block_of[idx])
+					break;
+			if (s == b->num_succ)
+				b->succ[b->num_succ++] = block_of[idx];
+		}
+
+		if (b->end + 1 < n && falls_through(last)) {
+			unsigned int s;
+
+			for (s = 0; s < b->num_succ; s++)
+				if (b->succ[s] == (int)i + 1)
+					break;
+			if (s == b->num_succ)
+				b->succ[b->num_succ++] = i + 1;
+		}
+	}
+
+	free(leader);
+	free(block_of);
+
+	*num_blocks = nb;
+	return blocks;
+}
+
+static int parse_text(const char *buf, size_t len, uint32_t **out,
+		      size_t *num)
+{
+	size_t max = 0, n = 0, bytes = 0;
+	uint32_t *dw = NULL;
+	const char *p = buf;
+
+	while ((p = memmem(p, len - (p - buf), "0x", 2))) {
+		unsigned long v;
+		char *end;
+
+		v = strtoul(p, &end, 16);
+		p = end > p ? end : p + 2;
+
+		if (n + 1 > max) {
+			max = max ? 2 * max : 256;
+			dw = realloc(dw, max * sizeof(*dw));
+			if (!dw)
+				return -ENOMEM;
+		}
+
+		if (byte_input) {
+			if (bytes % 4 == 0)
+				dw[n++] = 0;
+			dw[n - 1] |= (uint32_t)(v & 0xff) << (8 * (bytes % 4));
+			bytes++;
+		} else {
+			dw[n++] = v;
+		}
+	}
+
+	*out = dw;
+	*num = n;
+	return 0;
+}
+
+static bool is_text(const char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len && i < 4096; i++)
+		if (!isprint((unsigned char)buf[i]) &&
+		    !isspace((unsigned char)buf[i]))
+			return false;
+
+	return true;
+}
+
+static int load_kernel(const char *path, uint32_t **dw, size_t *num)
+{
+	struct stat st;
+	char *buf;
+	FILE *f;
+	int ret;
+
+	f = fopen(path, "rb");
+	if (!f)
+		return -errno;
+
+	if (fstat(fileno(f), &st)) {
+		ret = -errno;
+		fclose(f);
+		return ret;
+	}
+
+	buf = malloc(st.st_size + 1);
+	if (!buf || fread(buf, 1, st.st_size, f) != (size_t)st.st_size) {
+		free(buf);
+		fclose(f);
+		return -EIO;
+	}
+	fclose(f);
+
+	if (is_text(buf, st.st_size)) {
+		ret = parse_text(buf, st.st_size, dw, num);
+		free(buf);
+		return ret;
+	}
+
+	if (st.st_size % 8) {
+		free(buf);
+		return -EINVAL;
+	}
+
+	*dw = (uint32_t *)buf;
+	*num = st.st_size / 4;
+	return 0;
+}
+
+static int decode(const uint32_t *dw, size_t num, struct insn **out,
+		  unsigned int *count)
+{
+	struct insn *insns = calloc(num / 2 + 1, sizeof(*insns));
+	unsigned int n = 0;
+	size_t i = 0;
+
+	if (!insns)
+		return -ENOMEM;
+
+	while (i < num) {
+		struct insn *insn = &insns[n++];
+
+		insn->offset = i * 4;
+
+		/* Compaction was introduced with the cmpt bit on gen6. */
+		if (gen >= 6 && dw[i] & (1u << 29)) {
+			if (i + 2 > num)
+				goto err;
+
+			insn->compacted = true;
+			if (gen <= 7)
+				brw_uncompact_instruction(&intel,
+							  (struct brw_instruction *)insn->dw,
+							  (struct brw_compact_instruction *)&dw[i]);
+			else
+				insn->undecoded = true;
+			i += 2;
+			continue;
+		}
+
+		if (i + 4 > num)
+			goto err;
+
+		memcpy(insn->dw, &dw[i], sizeof(insn->dw));
+		i += 4;
+	}
+
+	*out = insns;
+	*count = n;
+	return 0;
+
+err:
+	free(insns);
+	return -EINVAL;
+}
+
+static void json_string(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++) {
+		if (*s == '"' || *s == '\\')
+			fprintf(f, "\\%c", *s);
+		else if ((unsigned char)*s < 0x20)
+			fprintf(f, "\\u%04x", *s);
+		else
+			fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+static void analyse(struct kernel *k)
+{
+	unsigned int classes[NUM_CLASSES] = {}, opcodes[128] = {};
+	unsigned int sends[NUM_SFIDS] = {};
+	unsigned int n, i, compacted = 0, undecoded = 0;
+	unsigned int num_blocks, loops;
+	struct footprint fp = { .grf_max = -1 };
+	unsigned long long cycles = 0;
+	struct block *blocks;
+	struct insn *insns;
+	uint32_t *dw;
+	size_t num, size;
+	bool first;
+	FILE *f;
+	int ret;
+
+	f = open_memstream(&k->json, &size);
+	if (!f) {
+		k->failed = true;
+		return;
+	}
+
+	fprintf(f, "  {\n    \"file\": ");
+	json_string(f, k->path);
+
+	ret = load_kernel(k->path, &dw, &num);
+	if (!ret) {
+		ret = decode(dw, num, &insns, &n);
+		free(dw);
+	}
+	if (ret) {
+		fprintf(f, ",\n    \"error\": ");
+		json_string(f, strerror(-ret));
+		fprintf(f, "\n  }");
+		fclose(f);
+		k->failed = true;
+		return;
+	}
+
+	for (i = 0; i < n; i++) {
+		const struct insn *insn = &insns[i];
+		unsigned int opcode;
+
+		compacted += insn->compacted;
+		if (insn->undecoded) {
+			undecoded++;
+			continue;
+		}
+
+		opcode = insn_opcode(insn);
+		opcodes[opcode]++;
+		classes[opcode_class(opcode)]++;
+		if (is_send(opcode))
+			sends[send_desc(insn).sfid]++;
+
+		insn_footprint(insn, &fp);
+		cycles += insn_cycles(insn);
+	}
+
+	blocks = build_cfg(insns, n, &num_blocks, &loops);
+
+	fprintf(f, ",\n    \"gen\": %d", gen);
+	fprintf(f, ",\n    \"instructions\": %u", n);
+	fprintf(f, ",\n    \"compacted\": %u", compacted);
+	fprintf(f, ",\n    \"undecoded\": %u", undecoded);
+	fprintf(f, ",\n    \"bytes\": %zu", num * 4);
+
+	fprintf(f, ",\n    \"classes\": {");
+	for (i = 0; i < NUM_CLASSES; i++)
+		fprintf(f, "%s\n      \"%s\": %u", i ? "," : "",
+			class_names[i], classes[i]);
+	fprintf(f, "\n    }");
+
+	fprintf(f, ",\n    \"opcodes\": {");
+	first = true;
+	for (i = 0; i < ARRAY_SIZE(opcodes); i++) {
+		const char *name = opcode_name(i);
+
+		if (!opcodes[i])
+			continue;
+
+		if (name)
+			fprintf(f, "%s\n      \"%s\": %u", first ? "" : ",",
+				name, opcodes[i]);
+		else
+			fprintf(f, "%s\n      \"op%u\": %u", first ? "" : ",",
+				i, opcodes[i]);
+		first = false;
+	}
+	fprintf(f, "%s}", first ? "" : "\n    ");
+
+	fprintf(f, ",\n    \"sends\": {");
+	first = true;
+	for (i = 0; i < NUM_SFIDS; i++) {
+		if (!sends[i])
+			continue;
+
+		fprintf(f, "%s\n      \"%s\": %u", first ? "" : ",",
+			sfid_name(gen, i), sends[i]);
+		first = false;
+	}
+	fprintf(f, "%s}", first ? "" : "\n    ");
+
+	fprintf(f, ",\n    \"registers\": {\n      \"grf-max\": %d,\n"
+		"      \"grf-used\": %d,\n      \"mrf-used\": %d\n    }",
+		fp.grf_max,
+		__builtin_popcountll(fp.grf[0]) + __builtin_popcountll(fp.grf[1]),
+		__builtin_popcount(fp.mrf));
+
+	fprintf(f, ",\n    \"cfg\": {\n      \"loops\": %u,\n      \"blocks\": [",
+		loops);
+	for (i = 0; i < num_blocks; i++) {
+		unsigned int s;
+
+		fprintf(f, "%s\n        { \"start\": %u, \"end\": %u, \"successors\": [",
+			i ? "," : "", blocks[i].start, blocks[i].end);
+		for (s = 0; s < blocks[i].num_succ; s++)
+			fprintf(f, "%s%d", s ? ", " : "", blocks[i].succ[s]);
+		fprintf(f, "] }");
+	}
+	fprintf(f, "%s]\n    }", num_blocks ? "\n      " : "");
+
+	fprintf(f, ",\n    \"cycles\": %llu\n  }", cycles);
+
+	fclose(f);
+	free(blocks);
+	free(insns);
+}
+
+static void *worker(void *arg)
+{
+	for (;;) {
+		unsigned int i;
+
+		pthread_mutex_lock(&next_lock);
+		i = next_kernel++;
+		pthread_mutex_unlock(&next_lock);
+
+		if (i >= num_kernels)
+			break;
+
+		analyse(&kernels[i]);
+	}
+
+	return NULL;
+}
+
+static void add_kernel(const char *path)
+{
+	if (num_kernels == max_kernels) {
+		max_kernels = max_kernels ? 2 * max_kernels : 64;
+		kernels = realloc(kernels, max_kernels * sizeof(*kernels));
+		if (!kernels) {
+			fprintf(stderr, "Out of memory\n");
+			exit(1);
+		}
+	}
+
+	memset(&kernels[num_kernels], 0, sizeof(*kernels));
+	kernels[num_kernels++].path = strdup(path);
+}
+
+static int add_file(const char *path, const struct stat *st, int type,
+		    struct FTW *ftw)
+{
+	if (type == FTW_F)
+		add_kernel(path);
+
+	return 0;
+}
+
+static int kernel_cmp(const void *a, const void *b)
+{
+	return strcmp(((const struct kernel *)a)->path,
+		      ((const struct kernel *)b)->path);
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: intel-gen4analyse [options] {file|directory}...\n");
+	fprintf(stderr, "\t-b, --binary                         C style binary input\n");
+	fprintf(stderr, "\t-o, --output {outputfile}            Specify output file\n");
+	fprintf(stderr, "\t-g, --gen <4|5|6|7|8|9|10|11>        Specify GPU generation\n");
+	fprintf(stderr, "\t-j, --jobs <n>                       Kernels analysed in parallel\n");
+}
+
+static const struct option longopts[] = {
+	{ "binary", no_argument, NULL, 'b' },
+	{ "output", required_argument, NULL, 'o' },
+	{ "gen", required_argument, NULL, 'g' },
+	{ "jobs", required_argument, NULL, 'j' },
+	{ NULL, 0, NULL, 0 }
+};
+
+int main(int argc, char **argv)
+{
+	long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	FILE *output = stdout;
+	char *output_file = NULL;
+	pthread_t *threads;
+	struct brw_context brw;
+	bool failed = false;
+	unsigned int i;
+	int o;
+
+	while ((o = getopt_long(argc, argv, "o:bg:j:", longopts, NULL)) != -1) {
+		switch (o) {
+		case 'o':
+			if (strcmp(optarg, "-") != 0)
+				output_file = optarg;
+			break;
+		case 'b':
+			byte_input = true;
+			break;
+		case 'g':
+			gen = strtol(optarg, NULL, 10);
+			if (gen < 4 || gen > 11) {
+				usage();
+				exit(1);
+			}
+			break;
+		case 'j':
+			jobs = strtol(optarg, NULL, 10);
+			break;
+		default:
+			usage();
+			exit(1);
+		}
+	}
+	argc -= optind;
+	argv += optind;
+
+	if (!gen || argc < 1) {
+		usage();
+		exit(1);
+	}
+
+	brw_init_context(&brw, gen * 10);
+	intel = brw.intel;
+	brw_init_compaction_tables(&intel);
+
+	for (i = 0; i < (unsigned int)argc; i++) {
+		struct stat st;
+		unsigned int first = num_kernels;
+
+		if (stat(argv[i], &st)) {
+			fprintf(stderr, "Couldn't open %s: %s\n",
+				argv[i], strerror(errno));
+			exit(1);
+		}
+
+		if (!S_ISDIR(st.st_mode)) {
+			add_kernel(argv[i]);
+			continue;
+		}
+
+		nftw(argv[i], add_file, 16, FTW_PHYS);
+		qsort(kernels + first, num_kernels - first, sizeof(*kernels),
+		      kernel_cmp);
+	}
+
+	if (output_file) {
+		output = fopen(output_file, "w");
+		if (output == NULL) {
+			perror("Couldn't open output file");
+			exit(1);
+		}
+	}
+
+	if (jobs < 1)
+		jobs = 1;
+	if (jobs > num_kernels)
+		jobs = num_kernels ?: 1;
+
+	threads = calloc(jobs, sizeof(*threads));
+	for (i = 0; i < jobs; i++)
+		pthread_create(&threads[i], NULL, worker, NULL);
+	for (i = 0; i < jobs; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+
+	fprintf(output, "[");
+	for (i = 0; i < num_kernels; i++) {
+		fprintf(output, "%s\n%s", i ? "," : "",
+			kernels[i].json ?: "  {}");
+		failed |= kernels[i].failed;
+	}
+	fprintf(output, "\n]\n");
+
+	if (output != stdout)
+		fclose(output);
+
+	exit(failed ? 1 : 0);
+}
@@ -0,0 +1,24 @@
+#!/bin/sh
+
+SRCDIR="${srcdir-`pwd`}"
+BUILDDIR="${top_builddir-`pwd`}"
+
+test="TEST"
+gen="7"
+
+if [ -n "$1" ] ; then
+	test="$1"
+fi
+
+if [ -n "$2" ] ; then
+	gen="$2"
+fi
+
+test -d "${BUILDDIR}/test" || mkdir "${BUILDDIR}/test/"
+
+(cd "$SRCDIR" && "${BUILDDIR}/intel-gen4analyse" -g "$gen" -o "${BUILDDIR}/${test}.json" "${test}.hex")
+if cmp "${BUILDDIR}/${test}.json" "${SRCDIR}/${test}.json" 2> /dev/null; then : ; else
+  echo "Output comparison for ${test}"
+  diff -u "${SRCDIR}/${test}.json" "${BUILDDIR}/${test}.json"
+  exit 1;
+fi
@@ -0,0 +1,207 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Cost of the DRM fdinfo memory parsing and of the per process collector,
+ * against a fake procfs with thousands of clients.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_drm_fdinfo.h"
+
+static const char fdinfo_fmt[] =
+	"pos:\t0\n"
+	"flags:\t02100002\n"
+	"mnt_id:\t25\n"
+	"ino:\t%d\n"
+	"drm-driver:\ti915\n"
+	"drm-pdev:\t0000:00:02.0\n"
+	"drm-client-id:\t%d\n"
+	"drm-engine-render:\t%d ns\n"
+	"drm-engine-copy:\t0 ns\n"
+	"drm-engine-video:\t0 ns\n"
+	"drm-engine-capacity-video:\t2\n"
+	"drm-engine-video-enhance:\t0 ns\n"
+	"drm-total-system0:\t%d KiB\n"
+	"drm-shared-system0:\t0\n"
+	"drm-active-system0:\t0\n"
+	"drm-resident-system0:\t%d KiB\n"
+	"drm-purgeable-system0:\t0\n"
+	"drm-total-stolen-system0:\t0\n"
+	"drm-shared-stolen-system0:\t0\n"
+	"drm-active-stolen-system0:\t0\n"
+	"drm-resident-stolen-system0:\t0\n"
+	"drm-purgeable-stolen-system0:\t0\n";
+
+static double elapsed_us(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) * 1e6 +
+	       (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+static void make_dir(const char *fmt, int a, int b)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), fmt, a, b);
+	if (mkdir(path, 0755) && errno != EEXIST) {
+		perror(path);
+		exit(1);
+	}
+}
+
+/* @clients processes, each with one DRM fd and @others other fds. */
+static void make_tree(const char *root, int clients, int others)
+{
+	char path[PATH_MAX], buf[2048];
+	int pid, fd, len;
+
+	snprintf(path, sizeof(path), "%s/proc", root);
+	mkdir(path, 0755);
+
+	for (pid = 1; pid <= clients; pid++) {
+		snprintf(path, sizeof(path), "%s/proc/%%d", root);
+		make_dir(path, pid, 0);
+		snprintf(path, sizeof(path), "%s/proc/%%d/fd", root);
+		make_dir(path, pid, 0);
+		snprintf(path, sizeof(path), "%s/proc/%%d/fdinfo", root);
+		make_dir(path, pid, 0);
+
+		for (fd = 0; fd <= others; fd++) {
+			int out;
+
+			snprintf(path, sizeof(path), "%s/proc/%d/fd/%d",
+				 root, pid, fd);
+			if (symlink(fd == others ? "/dev/dri/renderD128" :
+				    "/dev/null", path)) {
+				perror(path);
+				exit(1);
+			}
+
+			if (fd == others)
+				len = snprintf(buf, sizeof(buf), fdinfo_fmt,
+					       pid, pid, pid * 1000,
+					       pid * 4, pid * 2);
+			else
+				len = snprintf(buf, sizeof(buf),
+					       "pos:\t0\nflags:\t0100002\n");
+
+			snprintf(path, sizeof(path), "%s/proc/%d/fdinfo/%d",
+				 root, pid, fd);
+			out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (out < 0 || write(out, buf, len) != len) {
+				perror(path);
+				exit(1);
+			}
+			close(out);
+		}
+	}
+}
+
+int main(int argc, char **argv)
+{
+	char root[] = "/tmp/drm_fdinfo.XXXXXX";
+	struct drm_client_fdinfo info;
+	struct igt_drm_mem mem;
+	struct timespec start;
+	int clients = 4096;
+	int others = 8;
+	int reps = 10;
+	char buf[2048];
+	double us;
+	int c, n;
+
+	while ((c = getopt(argc, argv, "c:f:r:")) != -1) {
+		switch (c) {
+		case 'c':
+			clients = atoi(optarg);
+			if (clients < 1)
+				clients = 1;
+			break;
+
+		case 'f':
+			others = atoi(optarg);
+			if (others < 0)
+				others = 0;
+			break;
+
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+				reps = 1;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	if (!mkdtemp(root)) {
+		perror(root);
+		return 1;
+	}
+	make_tree(root, clients, others);
+
+	/* Parsing alone, out of memory. */
+	snprintf(buf, sizeof(buf), fdinfo_fmt, 1, 1, 1000, 4, 2);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < reps * clients; n++)
+		__igt_parse_drm_fdinfo(buf, &info);
+	us = elapsed_us(&start);
+	printf("parse: %.3fus per fdinfo\n", us / (reps * clients));
+
+	igt_drm_mem_init(&mem, root, NULL);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_drm_mem_update(&mem);
+	us = elapsed_us(&start);
+	printf("first update: %.3fms, %d clients, %lu fds resolved, %lu fdinfo reads\n",
+	       us / 1e3, mem.num_processes, mem.fds_resolved,
+	       mem.fdinfo_reads);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (n = 0; n < reps; n++)
+		igt_drm_mem_update(&mem);
+	us = elapsed_us(&start) / reps;
+	printf("incremental update: %.3fms, %lu fds resolved, %lu fdinfo reads\n",
+	       us / 1e3, mem.fds_resolved, mem.fdinfo_reads);
+
+	igt_drm_mem_fini(&mem);
+
+	snprintf(buf, sizeof(buf), "rm -rf %s", root);
+	return system(buf);
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_dummyload.h"
+#include "igt_rand.h"
+#include "igt_stats.h"
+
+static uint64_t ts_to_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static int count_threads(void)
+{
+	char buf[4096], *s;
+	int fd, len;
+
+	fd = open("/proc/self/status", O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return -1;
+	buf[len] = '\0';
+
+	s = strstr(buf, "Threads:");
+	if (!s)
+		return -1;
+
+	return atoi(s + strlen("Threads:"));
+}
+
+static void loop(int fd, int nspin, int timeout_ms, uint32_t seed)
+{
+	uint64_t *deadline, max_deadline = 0, late = 0;
+	igt_spin_t **spin;
+	igt_stats_t stats;
+	struct timespec ts;
+	int threads, n;
+
+	spin = calloc(nspin, sizeof(*spin));
+	deadline = calloc(nspin, sizeof(*deadline));
+	igt_assert(spin && deadline);
+
+	for (n = 0; n < nspin; n++)
+		spin[n] = igt_spin_new(fd);
+
+	/* Deadlines spread over the second half of the timeout window. */
+	for (n = 0; n < nspin; n++) {
+		int64_t ns = (int64_t)timeout_ms * 1000 * 1000;
+
+		ns = ns / 2 + hars_petruska_f54_1_random(&seed) % (ns / 2);
+
+		igt_gettime(&ts);
+		igt_spin_set_timeout(spin[n], ns);
+		deadline[n] = ts_to_ns(&ts) + ns;
+		if (deadline[n] > max_deadline)
+			max_deadline = deadline[n];
+	}
+
+	threads = count_threads();
+
+	igt_gettime(&ts);
+	if (max_deadline > ts_to_ns(&ts))
+		usleep((max_deadline - ts_to_ns(&ts)) / 1000 + 10000);
+
+	/* igt_spin_end() stamps last_signal on the same clock. */
+	igt_stats_init_with_size(&stats, nspin);
+	for (n = 0; n < nspin; n++) {
+		uint64_t end = ts_to_ns(&spin[n]->last_signal);
+
+		if (!end) {
+			late++;
+			continue;
+		}
+
+		igt_stats_push(&stats, end > deadline[n] ? end - deadline[n] : 0);
+	}
+
+	printf("%d spinners, %d threads: timer latency avg/median/max %.1f/%.1f/%.1fus",
+	       nspin, threads,
+	       igt_stats_get_mean(&stats) / 1e3,
+	       igt_stats_get_median(&stats) / 1e3,
+	       igt_stats_get_max(&stats) / 1e3);
+	if (late)
+		printf(", %"PRIu64" not ended", late);
+	putchar('\n');
+
+	igt_stats_fini(&stats);
+
+	for (n = 0; n < nspin; n++)
+		igt_spin_free(fd, spin[n]);
+	free(deadline);
+	free(spin);
+}
+
+int main(int argc, char **argv)
+{
+	int timeout_ms = 100;
+	int nspin = 256;
+	int reps = 1;
+	uint32_t seed = 0;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "n:t:r:s:")) != -1) {
+		switch (c) {
+		case 'n':
+			nspin = atoi(optarg);
+			if (nspin < 1)
+				nspin = 1;
+			break;
+
+		case 't':
+			timeout_ms = atoi(optarg);
+			if (timeout_ms < 2)
+				timeout_ms = 2;
+			break;
+
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+				reps = 1;
+			break;
+
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	fd = drm_open_driver(DRIVER_INTEL);
+
+	while (reps--)
+		loop(fd, nspin, timeout_ms, seed++);
+
+	close(fd);
+
+	return 0;
+}
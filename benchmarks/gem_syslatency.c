@@ -40,7 +40,10 @@
 #include <sys/time.h>
 #include <time.h>
 #include <limits.h>
+#include <ctype.h>
+#include <math.h>
 #include "drm.h"
+#include "igt_vgem.h"
 
 #include <linux/unistd.h>
 
@@ -48,17 +51,60 @@
 
 static volatile int done;
 
-struct gem_busyspin {
+/*
+ * Latencies are kept in buckets of 1/8th of a power of two nanoseconds,
+ * within 12.5% up to the longest stall.
+ */
+#define HIST_SUB_BITS 3
+#define HIST_SUB (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS ((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+/* Wakeups later than outlier_ns, for the interrupt sampler */
+#define OUTLIER_RING 256
+
+static uint64_t outlier_ns;
+
+struct load;
+
+struct load_thread {
 	pthread_t thread;
-	unsigned long sz;
+	const struct load *load;
+	int cpu;
 	unsigned long count;
+
+	/* gem */
+	unsigned long sz;
 	bool leak;
 	bool interrupts;
 };
 
+/**
+ * struct load:
+ * @name: the name given to -l
+ * @help: what the load does, for -L
+ * @per_cpu: whether to run a thread bound to each CPU, or a single one
+ * @warmup: seconds for the load to get going before measuring
+ * @available: whether the load can run on this system, NULL if always
+ * @fn: the thread, counting its work in load_thread.count until done
+ */
+struct load {
+	const char *name;
+	const char *help;
+	bool per_cpu;
+	unsigned int warmup;
+	bool (*available)(void);
+	void *(*fn)(void *arg);
+};
+
 struct sys_wait {
 	pthread_t thread;
 	struct igt_mean mean;
+	uint64_t hist[HIST_BUCKETS];
+
+	/* Written by the waiter, read by the interrupt sampler */
+	uint64_t outliers[OUTLIER_RING];
+	unsigned int outlier_head, outlier_tail;
+	unsigned long outliers_dropped;
 };
 
 static void force_low_latency(void)
@@ -76,7 +122,7 @@ static void force_low_latency(void)
 static void *gem_busyspin(void *arg)
 {
 	const uint32_t bbe = MI_BATCH_BUFFER_END;
-	struct gem_busyspin *bs = arg;
+	struct load_thread *bs = arg;
 	struct drm_i915_gem_execbuffer2 execbuf;
 	struct drm_i915_gem_exec_object2 obj[2];
 	const unsigned sz =
@@ -136,11 +182,93 @@ static void *gem_busyspin(void *arg)
 	return NULL;
 }
 
+static bool gem_available(void)
+{
+	int fd = __drm_open_driver(DRIVER_INTEL);
+
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
 static double elapsed(const struct timespec *a, const struct timespec *b)
 {
 	return 1e9*(b->tv_sec - a->tv_sec) + (b->tv_nsec - a ->tv_nsec);
 }
 
+static uint64_t ns(const struct timespec *ts)
+{
+	return ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+static unsigned int hist_bucket(uint64_t v)
+{
+	unsigned int e;
+
+	if (v < HIST_SUB)
+		return v;
+
+	e = 63 - __builtin_clzll(v);
+	return (e - HIST_SUB_BITS + 1) * HIST_SUB +
+		((v >> (e - HIST_SUB_BITS)) & (HIST_SUB - 1));
+}
+
+/* The smallest latency in the bucket */
+static uint64_t hist_value(unsigned int bucket)
+{
+	unsigned int e;
+
+	if (bucket < HIST_SUB)
+		return bucket;
+
+	e = bucket / HIST_SUB + HIST_SUB_BITS - 1;
+	return (uint64_t)(HIST_SUB + bucket % HIST_SUB) << (e - HIST_SUB_BITS);
+}
+
+static uint64_t hist_percentile(const uint64_t *hist, double pct)
+{
+	uint64_t total = 0, sum = 0;
+	unsigned int n;
+
+	for (n = 0; n < HIST_BUCKETS; n++)
+		total += hist[n];
+	if (!total)
+		return 0;
+
+	for (n = 0; n < HIST_BUCKETS; n++) {
+		sum += hist[n];
+		if (sum >= total * pct / 100)
+			break;
+	}
+
+	/* The upper bound of the bucket */
+	return n + 1 < HIST_BUCKETS ? hist_value(n + 1) - 1 : UINT64_MAX;
+}
+
+static void record(struct sys_wait *w, double latency,
+		   const struct timespec *now)
+{
+	uint64_t v = latency > 0 ? latency : 0;
+
+	igt_mean_add(&w->mean, latency);
+	w->hist[hist_bucket(v)]++;
+
+	if (outlier_ns && v > outlier_ns) {
+		unsigned int head = w->outlier_head;
+
+		if (head - __atomic_load_n(&w->outlier_tail, __ATOMIC_ACQUIRE) <
+		    OUTLIER_RING) {
+			w->outliers[head % OUTLIER_RING] = ns(now);
+			__atomic_store_n(&w->outlier_head, head + 1,
+					 __ATOMIC_RELEASE);
+		} else {
+			w->outliers_dropped++;
+		}
+	}
+}
+
 static void *sys_wait(void *arg)
 {
 	struct sys_wait *w = arg;
@@ -176,7 +304,7 @@ static void *sys_wait(void *arg)
 
 		sigwait(&mask, &sigs);
 		clock_gettime(CLOCK_MONOTONIC, &now);
-		igt_mean_add(&w->mean, elapsed(&its.it_value, &now));
+		record(w, elapsed(&its.it_value, &now), &now);
 	}
 
 	sigprocmask(SIG_UNBLOCK, &mask, NULL);
@@ -207,7 +335,7 @@ static void *sys_thp_alloc(void *arg)
 		munmap(ptr, sz);
 
 		clock_gettime(CLOCK_MONOTONIC, &now);
-		igt_mean_add(&w->mean, elapsed(&start, &now));
+		record(w, elapsed(&start, &now), &now);
 	}
 
 	return NULL;
@@ -260,6 +388,96 @@ static double min_measurement_error(void)
 	return elapsed(&start, &end) / n;
 }
 
+static void *cpu_spin(void *arg)
+{
+	struct load_thread *t = arg;
+	volatile uint32_t x = 1;
+
+	while (!done) {
+		for (int n = 0; n < 1024; n++)
+			x = x * 1664525 + 1013904223;
+		t->count++;
+	}
+
+	return NULL;
+}
+
+#define MEMBW_SIZE (16 << 20)
+static void *memory_bandwidth(void *arg)
+{
+	struct load_thread *t = arg;
+	char *src, *dst;
+
+	/* Larger than the cache, to keep the memory controller busy */
+	src = malloc(MEMBW_SIZE);
+	dst = malloc(MEMBW_SIZE);
+	igt_assert(src && dst);
+	memset(src, 0x5a, MEMBW_SIZE);
+
+	while (!done) {
+		memcpy(dst, src, MEMBW_SIZE);
+		igt_swap(src, dst);
+		t->count += MEMBW_SIZE >> 20;
+	}
+
+	free(src);
+	free(dst);
+	return NULL;
+}
+
+static bool vgem_available(void)
+{
+	int fd = __drm_open_driver(DRIVER_VGEM);
+
+	if (fd < 0)
+		return false;
+
+	close(fd);
+	return true;
+}
+
+/* dma-buf export, mmap, CPU access and fencing, without a GPU */
+static void *vgem_dmabuf(void *arg)
+{
+	struct load_thread *t = arg;
+	bool fences;
+	int fd;
+
+	fd = drm_open_driver(DRIVER_VGEM);
+	fences = vgem_has_fences(fd);
+
+	while (!done) {
+		struct vgem_bo bo = {
+			.width = 512,
+			.height = 512,
+			.bpp = 32,
+		};
+		void *ptr;
+		int dmabuf;
+
+		vgem_create(fd, &bo);
+		dmabuf = prime_handle_to_fd(fd, bo.handle);
+
+		ptr = mmap(NULL, bo.size, PROT_WRITE, MAP_SHARED, dmabuf, 0);
+		igt_assert(ptr != MAP_FAILED);
+		prime_sync_start(dmabuf, true);
+		memset(ptr, t->count, bo.size);
+		prime_sync_end(dmabuf, true);
+		munmap(ptr, bo.size);
+
+		if (fences)
+			vgem_fence_signal(fd, vgem_fence_attach(fd, &bo,
+								VGEM_FENCE_WRITE));
+
+		close(dmabuf);
+		gem_close(fd, bo.handle);
+		t->count++;
+	}
+
+	close(fd);
+	return NULL;
+}
+
 static int print_entry(const char *filepath, const struct stat *info,
 		       const int typeflag, struct FTW *pathinfo)
 {
@@ -278,16 +496,414 @@ static int print_entry(const char *filepath, const struct stat *info,
 		close(fd);
 	}
 
-	return 0;
+	return done;
+}
+
+static void *background_fs(void *arg)
+{
+	struct load_thread *t = arg;
+
+	while (!done) {
+		nftw("/", print_entry, 20, FTW_PHYS | FTW_MOUNT);
+		t->count++;
+	}
+
+	return NULL;
 }
 
-static void *background_fs(void *path)
+static const struct load loads[] = {
+	{ "gem", "execbuf on every engine, from each CPU",
+	  true, 0, gem_available, gem_busyspin },
+	{ "cpu", "integer arithmetic on each CPU",
+	  true, 0, NULL, cpu_spin },
+	{ "membw", "memcpy between 16MiB buffers on each CPU",
+	  true, 0, NULL, memory_bandwidth },
+	{ "vgem", "vgem dma-buf export, mmap and fences, from each CPU",
+	  true, 0, vgem_available, vgem_dmabuf },
+	{ "fs", "read all the files of /, from a single thread",
+	  false, 5, NULL, background_fs },
+};
+
+static const struct load *find_load(const char *name)
 {
-	while (1)
-		nftw(path, print_entry, 20, FTW_PHYS | FTW_MOUNT);
+	for (int n = 0; n < ARRAY_SIZE(loads); n++)
+		if (!strcmp(loads[n].name, name))
+			return &loads[n];
+
 	return NULL;
 }
 
+/*
+ * Interrupts and softirqs per CPU, sampled from /proc every SAMPLE_MS
+ * while measuring. The activity in the samples where a CPU woke up late
+ * is compared with its activity over the whole run, to point at the
+ * sources the outliers coincide with.
+ */
+#define SAMPLE_MS 10
+
+struct irq_source {
+	char name[64];
+	bool primed;
+	uint64_t *last, *delta, *total, *spike;
+};
+
+struct irq_sampler {
+	pthread_t thread;
+	int ncpus;
+	struct sys_wait *wait;
+
+	int nsources;
+	struct irq_source *sources;
+	int *columns;
+
+	uint64_t last_ns;
+	unsigned long samples;
+	unsigned long *spike_samples, *last_spike, *outliers, *missed;
+};
+
+static struct irq_source *irq_source(struct irq_sampler *s, int idx,
+				     const char *name)
+{
+	struct irq_source *src;
+
+	/* The sources come in the same order every time */
+	if (idx < s->nsources && !strcmp(s->sources[idx].name, name))
+		return &s->sources[idx];
+
+	for (int n = 0; n < s->nsources; n++)
+		if (!strcmp(s->sources[n].name, name))
+			return &s->sources[n];
+
+	s->sources = realloc(s->sources,
+			     (s->nsources + 1) * sizeof(*s->sources));
+	igt_assert(s->sources);
+
+	src = memset(&s->sources[s->nsources++], 0, sizeof(*src));
+	snprintf(src->name, sizeof(src->name), "%s", name);
+	src->last = calloc(4 * s->ncpus, sizeof(uint64_t));
+	igt_assert(src->last);
+	src->delta = src->last + s->ncpus;
+	src->total = src->delta + s->ncpus;
+	src->spike = src->total + s->ncpus;
+
+	return src;
+}
+
+/* Maps the CPUn columns of the header line to CPUs */
+static int irq_columns(struct irq_sampler *s, char *line)
+{
+	char *tok, *save;
+	int ncols = 0;
+
+	for (tok = strtok_r(line, " \t\n", &save); tok;
+	     tok = strtok_r(NULL, " \t\n", &save)) {
+		int cpu;
+
+		if (sscanf(tok, "CPU%d", &cpu) != 1)
+			break;
+
+		s->columns = realloc(s->columns, (ncols + 1) * sizeof(int));
+		igt_assert(s->columns);
+		s->columns[ncols++] = cpu < s->ncpus ? cpu : -1;
+	}
+
+	return ncols;
+}
+
+static void irq_line(struct irq_sampler *s, int idx, char *line,
+		     int ncols, const char *prefix)
+{
+	uint64_t counts[ncols];
+	char name[64], *label, *p, *end;
+	struct irq_source *src;
+	int n;
+
+	p = strchr(line, ':');
+	if (!p)
+		return;
+	*p++ = '\0';
+
+	label = line + strspn(line, " ");
+	for (n = 0; n < ncols; n++) {
+		counts[n] = strtoull(p, &end, 10);
+		if (end == p)
+			break;
+		p = end;
+	}
+	for (; n < ncols; n++)
+		counts[n] = 0;
+
+	/* Numbered interrupts by the name of their handler */
+	end = p + strlen(p);
+	while (end > p && strchr(" \t\n", end[-1]))
+		*--end = '\0';
+	while (end > p && !strchr(" \t", end[-1]))
+		end--;
+	if (isdigit(*label) && *end)
+		snprintf(name, sizeof(name), "%s%s (%s)", prefix, label, end);
+	else
+		snprintf(name, sizeof(name), "%s%s", prefix, label);
+
+	/* Nothing to compare with until the next sample of a new source */
+	src = irq_source(s, idx, name);
+	for (n = 0; n < ncols; n++) {
+		int cpu = s->columns[n];
+
+		if (cpu < 0)
+			continue;
+
+		src->delta[cpu] = !src->primed || counts[n] < src->last[cpu] ?
+			0 : counts[n] - src->last[cpu];
+		src->total[cpu] += src->delta[cpu];
+		src->last[cpu] = counts[n];
+	}
+	src->primed = true;
+}
+
+static int irq_read(struct irq_sampler *s, const char *path,
+		    const char *prefix, int idx)
+{
+	char *line = NULL;
+	size_t len = 0;
+	int ncols;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f)
+		return idx;
+
+	if (getline(&line, &len, f) > 0 &&
+	    (ncols = irq_columns(s, line)) > 0) {
+		while (getline(&line, &len, f) > 0)
+			irq_line(s, idx++, line, ncols, prefix);
+	}
+
+	free(line);
+	fclose(f);
+	return idx;
+}
+
+/* Counts the samples a CPU woke up late in, with what happened in them */
+static void irq_attribute(struct irq_sampler *s, uint64_t now)
+{
+	for (int cpu = 0; cpu < s->ncpus; cpu++) {
+		struct sys_wait *w = &s->wait[cpu];
+		unsigned int head, tail;
+
+		head = __atomic_load_n(&w->outlier_head, __ATOMIC_ACQUIRE);
+		for (tail = w->outlier_tail; tail != head; tail++) {
+			uint64_t t = w->outliers[tail % OUTLIER_RING];
+
+			if (t > now)
+				break;
+
+			if (t <= s->last_ns) {
+				s->missed[cpu]++;
+				continue;
+			}
+
+			s->outliers[cpu]++;
+			if (s->last_spike[cpu] == s->samples)
+				continue;
+
+			s->last_spike[cpu] = s->samples;
+			s->spike_samples[cpu]++;
+			for (int n = 0; n < s->nsources; n++)
+				s->sources[n].spike[cpu] +=
+					s->sources[n].delta[cpu];
+		}
+		__atomic_store_n(&w->outlier_tail, tail, __ATOMIC_RELEASE);
+	}
+}
+
+static void irq_sample(struct irq_sampler *s)
+{
+	struct timespec now;
+	int idx;
+
+	for (int n = 0; n < s->nsources; n++)
+		memset(s->sources[n].delta, 0, s->ncpus * sizeof(uint64_t));
+
+	idx = irq_read(s, "/proc/interrupts", "", 0);
+	irq_read(s, "/proc/softirqs", "softirq ", idx);
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	s->samples++;
+	if (s->last_ns)
+		irq_attribute(s, ns(&now));
+	s->last_ns = ns(&now);
+}
+
+static void *irq_sampler(void *arg)
+{
+	struct irq_sampler *s = arg;
+	const struct timespec period = { .tv_nsec = SAMPLE_MS * 1000 * 1000 };
+
+	while (!done) {
+		irq_sample(s);
+		nanosleep(&period, NULL);
+	}
+	irq_sample(s);
+
+	return NULL;
+}
+
+static void irq_sampler_init(struct irq_sampler *s, struct sys_wait *wait,
+			     int ncpus)
+{
+	memset(s, 0, sizeof(*s));
+	s->ncpus = ncpus;
+	s->wait = wait;
+	s->spike_samples = calloc(4 * ncpus, sizeof(unsigned long));
+	igt_assert(s->spike_samples);
+	s->last_spike = s->spike_samples + ncpus;
+	s->outliers = s->last_spike + ncpus;
+	s->missed = s->outliers + ncpus;
+	for (int cpu = 0; cpu < ncpus; cpu++)
+		s->last_spike[cpu] = ULONG_MAX;
+}
+
+static void irq_sampler_fini(struct irq_sampler *s)
+{
+	for (int n = 0; n < s->nsources; n++)
+		free(s->sources[n].last);
+	free(s->sources);
+	free(s->columns);
+	free(s->spike_samples);
+}
+
+struct irq_excess {
+	const char *name;
+	double spike, base;
+};
+
+static int cmp_excess(const void *A, const void *B)
+{
+	const struct irq_excess *a = A, *b = B;
+	double x = a->spike - a->base, y = b->spike - b->base;
+
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+static void irq_report(const struct irq_sampler *s)
+{
+	struct irq_excess *excess = calloc(s->nsources, sizeof(*excess));
+
+	printf("Wakeups later than %.0fus, against the interrupts and softirqs every %dms:\n",
+	       outlier_ns / 1e3, SAMPLE_MS);
+	for (int cpu = 0; cpu < s->ncpus; cpu++) {
+		unsigned long dropped = s->wait[cpu].outliers_dropped;
+		int n, shown;
+
+		if (!s->outliers[cpu] && !s->missed[cpu] && !dropped)
+			continue;
+
+		printf("  cpu%d: %lu late wakeups in %lu of %lu samples",
+		       cpu, s->outliers[cpu], s->spike_samples[cpu],
+		       s->samples);
+		if (s->missed[cpu] + dropped)
+			printf(", %lu not sampled", s->missed[cpu] + dropped);
+		printf("\n");
+
+		if (!s->spike_samples[cpu])
+			continue;
+
+		for (n = 0; n < s->nsources; n++) {
+			excess[n].name = s->sources[n].name;
+			excess[n].spike = (double)s->sources[n].spike[cpu] /
+				s->spike_samples[cpu];
+			excess[n].base = (double)s->sources[n].total[cpu] /
+				s->samples;
+		}
+		qsort(excess, s->nsources, sizeof(*excess), cmp_excess);
+
+		for (n = shown = 0; n < s->nsources && shown < 5; n++) {
+			if (excess[n].spike <= excess[n].base)
+				break;
+
+			printf("    %-32s %8.2f per sample, %8.2f usually\n",
+			       excess[n].name, excess[n].spike, excess[n].base);
+			shown++;
+		}
+		if (!shown)
+			printf("    no more interrupts or softirqs than usual\n");
+	}
+
+	free(excess);
+}
+
+static void print_histograms(const struct sys_wait *wait, int ncpus)
+{
+	for (int cpu = 0; cpu < ncpus; cpu++) {
+		const struct sys_wait *w = &wait[cpu];
+
+		printf("cpu%d: %lu wakeups, mean %.3fus, p50 %.1fus, p90 %.1fus, p99 %.1fus, p99.9 %.1fus, max %.1fus\n",
+		       cpu, w->mean.count, w->mean.mean / 1000,
+		       hist_percentile(w->hist, 50) / 1e3,
+		       hist_percentile(w->hist, 90) / 1e3,
+		       hist_percentile(w->hist, 99) / 1e3,
+		       hist_percentile(w->hist, 99.9) / 1e3,
+		       w->mean.max / 1000);
+
+		for (int n = 0; n < HIST_BUCKETS; n++) {
+			if (!w->hist[n])
+				continue;
+
+			printf("  %10.3f - %10.3fus: %" PRIu64 "\n",
+			       hist_value(n) / 1e3,
+			       n + 1 < HIST_BUCKETS ? hist_value(n + 1) / 1e3 : INFINITY,
+			       w->hist[n]);
+		}
+	}
+}
+
+static void list_loads(void)
+{
+	for (int n = 0; n < ARRAY_SIZE(loads); n++)
+		printf("%-8s %s%s\n", loads[n].name, loads[n].help,
+		       !loads[n].available || loads[n].available() ?
+		       "" : " (unavailable)");
+}
+
+static int start_loads(const struct load **selected, int nselected,
+		       struct load_thread **threads, int ncpus,
+		       const struct load_thread *opts)
+{
+	unsigned int warmup = 0;
+	pthread_attr_t attr;
+	int count = 0;
+
+	for (int l = 0; l < nselected; l++)
+		count += selected[l]->per_cpu ? ncpus : 1;
+
+	*threads = calloc(count, sizeof(**threads));
+	igt_assert(*threads || !count);
+
+	count = 0;
+	for (int l = 0; l < nselected; l++) {
+		const struct load *load = selected[l];
+
+		for (int n = 0; n < (load->per_cpu ? ncpus : 1); n++) {
+			struct load_thread *t = &(*threads)[count++];
+
+			*t = *opts;
+			t->load = load;
+			t->cpu = load->per_cpu ? n : -1;
+
+			pthread_attr_init(&attr);
+			bind_cpu(&attr, t->cpu);
+			pthread_create(&t->thread, &attr, load->fn, t);
+			pthread_attr_destroy(&attr);
+		}
+
+		if (load->warmup > warmup)
+			warmup = load->warmup;
+	}
+
+	sleep(warmup);
+	return count;
+}
+
 static unsigned long calibrate_nop(unsigned int target_us,
 				   unsigned int tolerance_pct)
 {
@@ -332,34 +948,89 @@ static unsigned long calibrate_nop(unsigned int target_us,
 	return sz;
 }
 
+static void usage(const char *name)
+{
+	printf("Usage: %s [options]\n"
+	       "  -t <seconds>   How long to measure for, default 10\n"
+	       "  -l <loads>     Comma separated load generators, default gem, or cpu\n"
+	       "                 without an i915\n"
+	       "  -L             List the load generators\n"
+	       "  -n             No load, to measure the baseline\n"
+	       "  -b             Add the fs load\n"
+	       "  -1             Only the first CPU\n"
+	       "  -r <us>        gem: duration of each batch\n"
+	       "  -i             gem: interrupt after each batch\n"
+	       "  -m             Time huge page allocations instead of wakeups,\n"
+	       "                 gem: leak the batches\n"
+	       "  -H             Print the latency histogram of each CPU\n"
+	       "  -o <us>        Attribute wakeups later than this to interrupts\n"
+	       "  -f <field>     Only print cycles (0), mean (1), max (2) or p99 (3)\n",
+	       name);
+}
+
+static int select_loads(const char *list, const struct load **selected)
+{
+	char *names = strdup(list), *name, *save;
+	int count = 0, n;
+
+	for (name = strtok_r(names, ",", &save); name;
+	     name = strtok_r(NULL, ",", &save)) {
+		const struct load *load = find_load(name);
+
+		if (!load) {
+			fprintf(stderr, "Unknown load %s, see -L\n", name);
+			exit(1);
+		}
+
+		if (load->available && !load->available()) {
+			fprintf(stderr, "Load %s is not available\n", name);
+			exit(1);
+		}
+
+		/* Each load runs once, however often it is listed */
+		for (n = 0; n < count; n++)
+			if (selected[n] == load)
+				break;
+		if (n == count)
+			selected[count++] = load;
+	}
+
+	free(names);
+	return count;
+}
+
 int main(int argc, char **argv)
 {
-	struct gem_busyspin *busy;
+	const struct load *selected[ARRAY_SIZE(loads)];
+	struct load_thread opts = {}, *busy;
+	struct irq_sampler sampler;
 	struct sys_wait *wait;
 	void *sys_fn = sys_wait;
 	pthread_attr_t attr;
-	pthread_t bg_fs = 0;
 	int ncpus = sysconf(_SC_NPROCESSORS_ONLN);
 	igt_stats_t cycles, mean, max;
+	uint64_t *hist;
 	double min;
 	int time = 10;
 	int field = -1;
-	int enable_gem_sysbusy = 1;
-	bool leak = false;
-	bool interrupts = false;
+	int nselected = 0, nthreads;
+	const char *list = NULL;
+	bool enable_load = true;
+	bool fs = false;
+	bool histograms = false;
 	long batch = 0;
 	int n, c;
 
-	while ((c = getopt(argc, argv, "r:t:f:bmni1")) != -1) {
+	while ((c = getopt(argc, argv, "r:t:f:l:o:bmni1LHh")) != -1) {
 		switch (c) {
 		case '1':
 			ncpus = 1;
 			break;
 		case 'n': /* dry run, measure baseline system latency */
-			enable_gem_sysbusy = 0;
+			enable_load = false;
 			break;
 		case 'i': /* interrupts ahoy! */
-			interrupts = true;
+			opts.interrupts = true;
 			break;
 		case 't':
 			/* How long to run the benchmark for (seconds) */
@@ -375,41 +1046,63 @@ int main(int argc, char **argv)
 			/* Select an output field */
 			field = atoi(optarg);
 			break;
+		case 'l':
+			list = optarg;
+			break;
+		case 'o':
+			outlier_ns = strtoull(optarg, NULL, 0) * 1000;
+			break;
 		case 'b':
-			pthread_create(&bg_fs, NULL,
-				       background_fs, (void *)"/");
-			sleep(5);
+			fs = true;
 			break;
 		case 'm':
 			sys_fn = sys_thp_alloc;
-			leak = true;
+			opts.leak = true;
 			break;
+		case 'H':
+			histograms = true;
+			break;
+		case 'L':
+			list_loads();
+			return 0;
+		case 'h':
+			usage(argv[0]);
+			return 0;
 		default:
 			break;
 		}
 	}
 
+	if (enable_load) {
+		if (list)
+			nselected = select_loads(list, selected);
+		else if (gem_available())
+			selected[nselected++] = find_load("gem");
+		else
+			selected[nselected++] = find_load("cpu");
+	}
+	if (fs) {
+		for (n = 0; n < nselected; n++)
+			if (!strcmp(selected[n]->name, "fs"))
+				break;
+		if (n == nselected && nselected < ARRAY_SIZE(selected))
+			selected[nselected++] = find_load("fs");
+	}
+
 	/* Prevent CPU sleeps so that busy and idle loads are consistent. */
 	force_low_latency();
 	min = min_measurement_error();
 
-	if (batch > 0)
+	for (n = 0; n < nselected; n++)
+		if (selected[n]->fn == gem_busyspin)
+			break;
+	if (n < nselected && batch > 0)
 		batch = calibrate_nop(batch, 2);
 	else
-		batch = -batch;
+		batch = labs(batch);
+	opts.sz = batch;
 
-	busy = calloc(ncpus, sizeof(*busy));
-	pthread_attr_init(&attr);
-	if (enable_gem_sysbusy) {
-		for (n = 0; n < ncpus; n++) {
-			bind_cpu(&attr, n);
-			busy[n].sz = batch;
-			busy[n].leak = leak;
-			busy[n].interrupts = interrupts;
-			pthread_create(&busy[n].thread, &attr,
-				       gem_busyspin, &busy[n]);
-		}
-	}
+	nthreads = start_loads(selected, nselected, &busy, ncpus, &opts);
 
 	wait = calloc(ncpus, sizeof(*wait));
 	pthread_attr_init(&attr);
@@ -420,35 +1113,46 @@ int main(int argc, char **argv)
 		pthread_create(&wait[n].thread, &attr, sys_fn, &wait[n]);
 	}
 
+	if (outlier_ns) {
+		irq_sampler_init(&sampler, wait, ncpus);
+		pthread_create(&sampler.thread, NULL, irq_sampler, &sampler);
+	}
+
 	sleep(time);
 	done = 1;
 
+	/* The cycles of the first load, as each counts its own work */
 	igt_stats_init_with_size(&cycles, ncpus);
-	if (enable_gem_sysbusy) {
-		for (n = 0; n < ncpus; n++) {
-			pthread_join(busy[n].thread, NULL);
+	for (n = 0; n < nthreads; n++) {
+		pthread_join(busy[n].thread, NULL);
+		if (busy[n].load == selected[0])
 			igt_stats_push(&cycles, busy[n].count);
-		}
 	}
 
+	hist = calloc(HIST_BUCKETS, sizeof(*hist));
 	igt_stats_init_with_size(&mean, ncpus);
 	igt_stats_init_with_size(&max, ncpus);
 	for (n = 0; n < ncpus; n++) {
 		pthread_join(wait[n].thread, NULL);
 		igt_stats_push_float(&mean, wait[n].mean.mean);
 		igt_stats_push_float(&max, wait[n].mean.max);
-	}
-	if (bg_fs) {
-		pthread_cancel(bg_fs);
-		pthread_join(bg_fs, NULL);
+		for (c = 0; c < HIST_BUCKETS; c++)
+			hist[c] += wait[n].hist[c];
 	}
 
+	if (outlier_ns)
+		pthread_join(sampler.thread, NULL);
+
 	switch (field) {
 	default:
 		printf("gem_syslatency: cycles=%.0f, latency mean=%.3fus max=%.0fus\n",
 		       igt_stats_get_mean(&cycles),
 		       (igt_stats_get_mean(&mean) - min)/ 1000,
 		       (l_estimate(&max) - min) / 1000);
+		if (histograms)
+			print_histograms(wait, ncpus);
+		if (outlier_ns)
+			irq_report(&sampler);
 		break;
 	case 0:
 		printf("%.0f\n", igt_stats_get_mean(&cycles));
@@ -459,8 +1163,17 @@ int main(int argc, char **argv)
 	case 2:
 		printf("%.0f\n", (l_estimate(&max) - min) / 1000);
 		break;
+	case 3:
+		printf("%.1f\n", (hist_percentile(hist, 99) - min) / 1000);
+		break;
 	}
 
+	if (outlier_ns)
+		irq_sampler_fini(&sampler);
+	free(hist);
+	free(wait);
+	free(busy);
+
 	return 0;
 
 }
@@ -54,6 +54,7 @@
 #include "igt_aux.h"
 #include "igt_rand.h"
 #include "igt_perf.h"
+#include "igt_stats.h"
 #include "sw_sync.h"
 #include "i915/gem_mman.h"
 
@@ -135,6 +136,30 @@ struct working_set {
 
 struct workload;
 
+/* Submission record for a GPU timestamp results slot. */
+struct ts_sample {
+	uint64_t submit;
+	enum intel_engine_id engine;
+};
+
+struct ts_stats {
+	bool init;
+	igt_stats_t queued; /* submit -> start */
+	igt_stats_t exec; /* start -> end */
+};
+
+/*
+ * A copy of the step's batch buffer storing its timestamps into one fixed
+ * results slot, so the slot can be reused as soon as that copy is idle.
+ */
+struct ts_batch {
+	uint32_t handle;
+	uint32_t *duration;
+	uint64_t offset;
+	unsigned int nr_relocs;
+	struct drm_i915_gem_relocation_entry reloc[5];
+};
+
 struct w_step
 {
 	struct workload *wrk;
@@ -177,9 +202,19 @@ struct w_step
 
 	struct drm_i915_gem_execbuffer2 eb;
 	struct drm_i915_gem_exec_object2 *obj;
-	struct drm_i915_gem_relocation_entry reloc[3];
+	struct drm_i915_gem_relocation_entry reloc[5];
 	uint32_t bb_handle;
 	uint32_t *bb_duration;
+
+	/* GPU timestamps: per slot batches and results ring tracking. */
+	struct ts_batch *ts_batch; /* TS_RING slots plus one without results. */
+	unsigned int ts_bb;
+	unsigned int ts_submitted, ts_harvested;
+	struct ts_sample *ts_ring;
+	struct ts_stats *ts_stats; /* Indexed by engine. */
+
+	/* Simulated execution window (ns). */
+	uint64_t sim_start, sim_end;
 };
 
 struct ctx {
@@ -191,8 +226,12 @@ struct ctx {
 	struct bond *bonds;
 	bool load_balance;
 	uint64_t sseu;
+
+	enum intel_engine_id sticky_engine;
 };
 
+struct workload_balancer;
+
 struct workload
 {
 	unsigned int id;
@@ -212,7 +251,8 @@ struct workload
 	uint32_t bb_prng;
 	uint32_t bo_prng;
 
-	struct timespec repeat_start;
+	uint64_t repeat_start;
+	uint64_t elapsed;
 
 	unsigned int nr_ctxs;
 	struct ctx *ctx_list;
@@ -225,12 +265,38 @@ struct workload
 
 	struct igt_list_head requests[NUM_ENGINES];
 	unsigned int nrequest[NUM_ENGINES];
+
+	const struct workload_balancer *balancer;
+	unsigned int rr_next;
+	unsigned int nr_sticky[NUM_ENGINES];
+	unsigned long nr_balanced[NUM_ENGINES];
+	uint64_t balance_ns;
+	struct {
+		int fd;
+		uint64_t ts;
+		uint64_t busy[NUM_ENGINES];
+		unsigned int load[NUM_ENGINES];
+	} pmu;
+
+	/* Simulated engine state (ns). */
+	uint64_t sim_now;
+	uint64_t sim_busy_until[NUM_ENGINES];
+	uint64_t sim_busy_total[NUM_ENGINES];
+	uint64_t sim_latency_tot, sim_latency_max;
+	unsigned long sim_batches;
+
+	/* GPU timestamp results buffer and last CPU<->GPU correlation. */
+	uint32_t ts_handle;
+	uint32_t *ts_map;
+	uint64_t ts_cpu, ts_gpu;
+	unsigned long ts_dropped;
 };
 
 static unsigned int master_prng;
 
 static int verbose = 1;
 static int fd;
+static bool simulated;
 static struct drm_i915_gem_context_param_sseu device_sseu = {
 	.slice_mask = -1 /* Force read on first use. */
 };
@@ -238,6 +304,10 @@ static struct drm_i915_gem_context_param_sseu device_sseu = {
 #define SYNCEDCLIENTS	(1<<1)
 #define DEPSYNC		(1<<2)
 #define SSEU		(1<<3)
+#define GPU_TIMESTAMPS	(1<<4)
+
+/* Results slots per step, each holding the start and end RING_TIMESTAMP. */
+#define TS_RING		32
 
 static const char *ring_str_map[NUM_ENGINES] = {
 	[DEFAULT] = "DEFAULT",
@@ -249,6 +319,17 @@ static const char *ring_str_map[NUM_ENGINES] = {
 	[VECS] = "VECS",
 };
 
+/* Platform assumed when running without a GPU (-N). */
+#define SIM_GEN 12
+
+static int wsim_gen(void)
+{
+	if (simulated)
+		return SIM_GEN;
+
+	return intel_gen(intel_get_drm_devid(fd));
+}
+
 static int read_timestamp_frequency(int i915)
 {
 	int value = 0;
@@ -539,6 +620,20 @@ static void query_engines(void)
 
 	__engines_queried = true;
 
+	if (simulated) {
+		static struct i915_engine_class_instance sim_engines[] = {
+			{ I915_ENGINE_CLASS_RENDER, 0 },
+			{ I915_ENGINE_CLASS_COPY, 0 },
+			{ I915_ENGINE_CLASS_VIDEO, 0 },
+			{ I915_ENGINE_CLASS_VIDEO, 1 },
+			{ I915_ENGINE_CLASS_VIDEO_ENHANCE, 0 },
+		};
+
+		__engines = sim_engines;
+		__num_engines = ARRAY_SIZE(sim_engines);
+		return;
+	}
+
 	if (!has_engine_query(fd)) {
 		unsigned int num_bsd = gem_has_bsd(fd) + gem_has_bsd2(fd);
 		unsigned int i = 0;
@@ -1157,7 +1252,10 @@ parse_workload(struct w_arg *arg, unsigned int flags, double scale_dur,
 			fstart = NULL;
 
 			if (field[0] == '*') {
-				check_arg(intel_gen(intel_get_drm_devid(fd)) < 8,
+				check_arg(simulated,
+					  "Infinite batch at step %u cannot be simulated!\n",
+					  nr_steps);
+				check_arg(wsim_gen() < 8,
 					  "Infinite batch at step %u needs Gen8+!\n",
 					  nr_steps);
 				step.unbound_duration = true;
@@ -1363,8 +1461,10 @@ clone_workload(struct workload *_wrk)
 		       sizeof(*wrk->working_sets));
 	}
 
+	wrk->pmu.fd = -1;
+
 	/* Check if we need a sw sync timeline. */
-	for (i = 0; i < wrk->nr_steps; i++) {
+	for (i = 0; !simulated && i < wrk->nr_steps; i++) {
 		if (wrk->steps[i].type == SW_FENCE) {
 			wrk->sync_timeline = sw_sync_timeline_create();
 			igt_assert(wrk->sync_timeline >= 0);
@@ -1437,12 +1537,14 @@ static uint32_t mmio_base(int i915, enum intel_engine_id engine, int gen)
 	return gem_engine_mmio_base(i915, name);
 }
 
-static unsigned int create_bb(struct w_step *w, int self)
+static unsigned int
+create_bb(struct w_step *w, int self, int results, uint32_t results_offset)
 {
 	const int gen = intel_gen(intel_get_drm_devid(fd));
 	const uint32_t base = mmio_base(fd, w->engine, gen);
 #define CS_GPR(x) (base + 0x600 + 8 * (x))
 #define TIMESTAMP (base + 0x3a8)
+#define RING_TIMESTAMP (base + 0x358)
 	const int use_64b = gen >= 8;
 	enum { START_TS, NOW_TS };
 	uint32_t *ptr, *cs, *jmp;
@@ -1455,6 +1557,20 @@ static unsigned int create_bb(struct w_step *w, int self)
 
 	cs = ptr = gem_mmap__wc(fd, w->bb_handle, 0, 4096, PROT_WRITE);
 
+	/*
+	 * Record RING_TIMESTAMP into the results buffer as the batch starts
+	 * and on every loop iteration, so the last one written marks the end.
+	 */
+	if (results >= 0) {
+		*cs++ = MI_STORE_REGISTER_MEM | (1 + use_64b) | MI_CS_MMIO_DST;
+		*cs++ = RING_TIMESTAMP;
+		w->reloc[r].target_handle = results;
+		w->reloc[r].offset = offset_in_page(cs);
+		*cs++ = w->reloc[r].delta = results_offset;
+		*cs++ = 0;
+		r++;
+	}
+
 	/* Store initial 64b timestamp: start */
 	*cs++ = MI_LOAD_REGISTER_IMM | MI_CS_MMIO_DST;
 	*cs++ = CS_GPR(START_TS) + 4;
@@ -1494,6 +1610,16 @@ static unsigned int create_bb(struct w_step *w, int self)
 	*cs++ = 0;
 	r++;
 
+	if (results >= 0) {
+		*cs++ = MI_STORE_REGISTER_MEM | (1 + use_64b) | MI_CS_MMIO_DST;
+		*cs++ = RING_TIMESTAMP;
+		w->reloc[r].target_handle = results;
+		w->reloc[r].offset = offset_in_page(cs);
+		*cs++ = w->reloc[r].delta = results_offset + sizeof(uint32_t);
+		*cs++ = 0;
+		r++;
+	}
+
 	/* Delay between SRM and COND_BBE to post the writes */
 	for (int n = 0; n < 8; n++) {
 		*cs++ = MI_STORE_DWORD_INDEX;
@@ -1583,14 +1709,65 @@ static uint32_t alloc_bo(int i915, unsigned long size)
 	return gem_create(i915, size);
 }
 
+static uint32_t ts_offset(struct w_step *w, unsigned int slot)
+{
+	return (w->idx * TS_RING + slot) * 2 * sizeof(uint32_t);
+}
+
+/* Make one of the step's batch copies the one submitted next. */
+static void ts_select(struct w_step *w, unsigned int slot)
+{
+	struct drm_i915_gem_exec_object2 *obj =
+		&w->obj[w->eb.buffer_count - 1];
+	struct ts_batch *b = &w->ts_batch[slot];
+
+	w->ts_batch[w->ts_bb].offset = obj->offset;
+	w->ts_bb = slot;
+
+	w->bb_handle = obj->handle = b->handle;
+	w->bb_duration = b->duration;
+	obj->offset = b->offset;
+	obj->relocation_count = b->nr_relocs;
+	obj->relocs_ptr = to_user_pointer(b->reloc);
+}
+
+static void
+ts_alloc_batches(struct w_step *w, unsigned int self, int results)
+{
+	unsigned int i;
+
+	w->ts_batch = calloc(TS_RING + 1, sizeof(*w->ts_batch));
+	igt_assert(w->ts_batch);
+
+	for (i = 0; i <= TS_RING; i++) {
+		struct ts_batch *b = &w->ts_batch[i];
+
+		/* The last copy stores nothing, for when all slots are busy. */
+		w->bb_handle = b->handle = gem_create(fd, 4096);
+		b->nr_relocs = create_bb(w, self,
+					 i < TS_RING ? results : -1,
+					 ts_offset(w, i));
+		igt_assert(b->nr_relocs <= ARRAY_SIZE(b->reloc));
+		memcpy(b->reloc, w->reloc, sizeof(b->reloc));
+		b->duration = w->bb_duration;
+	}
+
+	w->ts_bb = TS_RING;
+	ts_select(w, TS_RING);
+}
+
 static void
 alloc_step_batch(struct workload *wrk, struct w_step *w)
 {
 	enum intel_engine_id engine = w->engine;
 	unsigned int j = 0;
 	unsigned int nr_obj = 2 + w->data_deps.nr;
+	int results = -1;
 	unsigned int i;
 
+	if (wrk->flags & GPU_TIMESTAMPS)
+		nr_obj++;
+
 	w->obj = calloc(nr_obj, sizeof(*w->obj));
 	igt_assert(w->obj);
 
@@ -1632,15 +1809,26 @@ alloc_step_batch(struct workload *wrk, struct w_step *w)
 		igt_assert(j < nr_obj);
 	}
 
-	w->bb_handle = w->obj[j].handle = gem_create(fd, 4096);
-	w->obj[j].relocation_count = create_bb(w, j);
-	igt_assert(w->obj[j].relocation_count <= ARRAY_SIZE(w->reloc));
-	w->obj[j].relocs_ptr = to_user_pointer(&w->reloc);
+	/* Not marked as written to avoid serialising all batches on it. */
+	if (wrk->flags & GPU_TIMESTAMPS) {
+		w->obj[j].handle = wrk->ts_handle;
+		results = j++;
+		igt_assert(j < nr_obj);
+	}
 
 	w->eb.buffers_ptr = to_user_pointer(w->obj);
 	w->eb.buffer_count = j + 1;
 	w->eb.rsvd1 = get_ctxid(wrk, w);
 
+	if (wrk->flags & GPU_TIMESTAMPS) {
+		ts_alloc_batches(w, j, results);
+	} else {
+		w->bb_handle = w->obj[j].handle = gem_create(fd, 4096);
+		w->obj[j].relocation_count = create_bb(w, j, -1, 0);
+		igt_assert(w->obj[j].relocation_count <= ARRAY_SIZE(w->reloc));
+		w->obj[j].relocs_ptr = to_user_pointer(&w->reloc);
+	}
+
 	eb_update_flags(wrk, w, engine);
 #ifdef DEBUG
 	printf("%u: %u:|", w->idx, w->eb.buffer_count);
@@ -1878,6 +2066,38 @@ static void measure_active_set(struct workload *wrk)
 
 #define alloca0(sz) ({ size_t sz__ = (sz); memset(alloca(sz__), 0, sz__); })
 
+static void ts_correlate(struct workload *wrk);
+
+static void ts_init(struct workload *wrk)
+{
+	const unsigned int sz = ALIGN(wrk->nr_steps * TS_RING *
+				      2 * sizeof(uint32_t), 4096);
+	struct w_step *w;
+	int i;
+
+	for (i = 0, w = wrk->steps; i < wrk->nr_steps; i++, w++) {
+		if (w->type != BATCH)
+			continue;
+
+		w->ts_stats = calloc(NUM_ENGINES, sizeof(*w->ts_stats));
+		igt_assert(w->ts_stats);
+		w->ts_submitted = w->ts_harvested = 0;
+
+		if (!simulated) {
+			w->ts_ring = calloc(TS_RING, sizeof(*w->ts_ring));
+			igt_assert(w->ts_ring);
+		}
+	}
+
+	if (simulated)
+		return;
+
+	wrk->ts_handle = alloc_bo(fd, sz);
+	wrk->ts_map = gem_mmap__wc(fd, wrk->ts_handle, 0, sz,
+				   PROT_READ | PROT_WRITE);
+	ts_correlate(wrk);
+}
+
 static int prepare_workload(unsigned int id, struct workload *wrk)
 {
 	struct working_set **sets;
@@ -1933,7 +2153,7 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 					wsim_err("Load balancing needs an engine map!\n");
 					return 1;
 				}
-				if (intel_gen(intel_get_drm_devid(fd)) < 11) {
+				if (wsim_gen() < 11) {
 					wsim_err("Load balancing needs relative mmio support, gen11+!\n");
 					return 1;
 				}
@@ -1956,6 +2176,20 @@ static int prepare_workload(unsigned int id, struct workload *wrk)
 		}
 	}
 
+	if (wrk->flags & GPU_TIMESTAMPS)
+		ts_init(wrk);
+
+	/*
+	 * Simulated workloads never touch the GPU so use fake context ids and
+	 * skip all buffer allocation.
+	 */
+	if (simulated) {
+		for (i = 0; i < wrk->nr_ctxs; i++)
+			wrk->ctx_list[i].id = i + 1;
+
+		return 0;
+	}
+
 	/*
 	 * Create and configure contexts.
 	 */
@@ -2190,9 +2424,194 @@ static double elapsed(const struct timespec *start, const struct timespec *end)
 	       (end->tv_nsec - start->tv_nsec) / 1e9;
 }
 
-static int elapsed_us(const struct timespec *start, const struct timespec *end)
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t wrk_now(struct workload *wrk)
+{
+	return simulated ? wrk->sim_now : now_ns();
+}
+
+static void wrk_sleep(struct workload *wrk, int us)
+{
+	if (simulated)
+		wrk->sim_now += (uint64_t)us * 1000;
+	else
+		usleep(us);
+}
+
+static void w_step_sync(struct workload *wrk, struct w_step *w)
+{
+	if (!simulated)
+		gem_sync(fd, w->obj[0].handle);
+	else if (w->sim_end > wrk->sim_now)
+		wrk->sim_now = w->sim_end;
+}
+
+static unsigned int ts_frequency(void)
+{
+	static unsigned int f;
+
+	if (!f)
+		f = read_timestamp_frequency(fd);
+
+	return f;
+}
+
+/*
+ * RING_TIMESTAMP is in the same GT clock domain on all engines so sample the
+ * render one from the CPU, halfway between two CLOCK_MONOTONIC reads.
+ */
+static void ts_correlate(struct workload *wrk)
 {
-	return elapsed(start, end) * 1e6;
+	struct drm_i915_reg_read reg = {
+		.offset = 0x2358 | I915_REG_READ_8B_WA,
+	};
+	uint64_t t0, t1;
+
+	t0 = now_ns();
+	if (igt_ioctl(fd, DRM_IOCTL_I915_REG_READ, &reg))
+		return;
+	t1 = now_ns();
+
+	wrk->ts_cpu = t0 + (t1 - t0) / 2;
+	wrk->ts_gpu = reg.val;
+}
+
+static void
+ts_record(struct w_step *w, enum intel_engine_id engine,
+	  uint64_t queued, uint64_t exec)
+{
+	struct ts_stats *stats = &w->ts_stats[engine];
+
+	if (!stats->init) {
+		igt_stats_init(&stats->queued);
+		igt_stats_init(&stats->exec);
+		stats->init = true;
+	}
+
+	igt_stats_push(&stats->queued, queued);
+	igt_stats_push(&stats->exec, exec);
+}
+
+static uint32_t *ts_slot(struct workload *wrk, struct w_step *w,
+			 unsigned int seq)
+{
+	return &wrk->ts_map[(w->idx * TS_RING + seq % TS_RING) * 2];
+}
+
+/*
+ * Convert the outstanding results of a step in submission order, stopping at
+ * the first one whose batch copy is still busy unless the step is known idle.
+ * Only the low 32 bits of RING_TIMESTAMP are stored so they are extended
+ * around the GPU time expected at the submission.
+ */
+static void ts_harvest(struct workload *wrk, struct w_step *w, bool idle)
+{
+	const double ns_per_tick = (double)NSEC_PER_SEC / ts_frequency();
+	bool correlated = false;
+
+	for (; w->ts_harvested != w->ts_submitted; w->ts_harvested++) {
+		const unsigned int slot = w->ts_harvested % TS_RING;
+		const uint32_t *ts = ts_slot(wrk, w, w->ts_harvested);
+		struct ts_sample *s = &w->ts_ring[slot];
+		uint64_t expect, start;
+		double queued;
+
+		if (!idle && gem_bo_busy(fd, w->ts_batch[slot].handle))
+			break;
+
+		if (!correlated) {
+			ts_correlate(wrk);
+			correlated = true;
+		}
+
+		if (!ts[0] && !ts[1]) {
+			wrk->ts_dropped++;
+			continue;
+		}
+
+		expect = wrk->ts_gpu -
+			 (int64_t)((int64_t)(wrk->ts_cpu - s->submit) /
+				   ns_per_tick);
+		start = (expect & ~0xffffffffull) | ts[0];
+		if (start + (1ull << 31) < expect)
+			start += 1ull << 32;
+		else if (start > expect + (1ull << 31))
+			start -= 1ull << 32;
+
+		queued = (int64_t)(wrk->ts_cpu - s->submit) -
+			 (int64_t)(wrk->ts_gpu - start) * ns_per_tick;
+
+		ts_record(w, s->engine, queued > 0 ? queued : 0,
+			  (uint32_t)(ts[1] - ts[0]) * ns_per_tick);
+	}
+}
+
+static void
+ts_prepare(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
+{
+	uint32_t *ts;
+
+	if (w->ts_submitted - w->ts_harvested >= TS_RING / 2)
+		ts_harvest(wrk, w, false);
+
+	/* Never wait for the GPU here, rather submit without a sample. */
+	if (w->ts_submitted - w->ts_harvested == TS_RING) {
+		ts_select(w, TS_RING);
+		wrk->ts_dropped++;
+		return;
+	}
+
+	ts = ts_slot(wrk, w, w->ts_submitted);
+	ts[0] = ts[1] = 0;
+	ts_select(w, w->ts_submitted % TS_RING);
+
+	w->ts_ring[w->ts_submitted % TS_RING] = (struct ts_sample) {
+		.submit = now_ns(),
+		.engine = engine,
+	};
+	w->ts_submitted++;
+}
+
+static void print_ts_stats(struct workload *wrk)
+{
+	struct w_step *w;
+	int i, e;
+
+	printf("%c%u: GPU timestamps, queued (submit to start) and executing (start to end) avg/median/max in us:\n",
+	       wrk->background ? ' ' : '*', wrk->id);
+
+	for (i = 0, w = wrk->steps; i < wrk->nr_steps; i++, w++) {
+		if (!w->ts_stats)
+			continue;
+
+		for (e = 0; e < NUM_ENGINES; e++) {
+			struct ts_stats *stats = &w->ts_stats[e];
+
+			if (!stats->init)
+				continue;
+
+			printf("  %3u %-5s %6u batches; queued %.1f/%.1f/%.1f; executing %.1f/%.1f/%.1f\n",
+			       w->idx, ring_str_map[e],
+			       stats->exec.n_values,
+			       igt_stats_get_mean(&stats->queued) / 1e3,
+			       igt_stats_get_median(&stats->queued) / 1e3,
+			       igt_stats_get_max(&stats->queued) / 1e3,
+			       igt_stats_get_mean(&stats->exec) / 1e3,
+			       igt_stats_get_median(&stats->exec) / 1e3,
+			       igt_stats_get_max(&stats->exec) / 1e3);
+		}
+	}
+
+	if (wrk->ts_dropped)
+		printf("  %lu samples dropped.\n", wrk->ts_dropped);
 }
 
 static void
@@ -2223,7 +2642,7 @@ static void w_sync_to(struct workload *wrk, struct w_step *w, int target)
 	igt_assert(target < wrk->nr_steps);
 	igt_assert(wrk->steps[target].type == BATCH);
 
-	gem_sync(fd, wrk->steps[target].obj[0].handle);
+	w_step_sync(wrk, &wrk->steps[target]);
 }
 
 static void
@@ -2232,6 +2651,11 @@ do_eb(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
 	unsigned int i;
 
 	eb_update_flags(wrk, w, engine);
+
+	/* Picks the batch copy, so before its duration is filled in. */
+	if (wrk->flags & GPU_TIMESTAMPS)
+		ts_prepare(wrk, w, engine);
+
 	update_bb_start(wrk, w);
 
 	for (i = 0; i < w->fence_deps.nr; i++) {
@@ -2282,28 +2706,402 @@ static void sync_deps(struct workload *wrk, struct w_step *w)
 		igt_assert(dep_idx >= 0 && dep_idx < w->idx);
 		igt_assert(wrk->steps[dep_idx].type == BATCH);
 
-		gem_sync(fd, wrk->steps[dep_idx].obj[0].handle);
+		w_step_sync(wrk, &wrk->steps[dep_idx]);
+	}
+}
+
+static void
+sim_submit(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
+{
+	uint64_t start = wrk->sim_now;
+	unsigned int i;
+
+	/*
+	 * Model each engine as a FIFO which executes batches back to back,
+	 * starting each one only once its data and fence dependencies have
+	 * completed (or started, for submit fences).
+	 */
+	for (i = 0; i < w->data_deps.nr; i++) {
+		struct dep_entry *entry = &w->data_deps.list[i];
+		struct w_step *dep;
+
+		if (entry->working_set != -1 || !entry->target)
+			continue;
+
+		dep = &wrk->steps[w->idx + entry->target];
+		start = max(start, dep->sim_end);
+	}
+
+	for (i = 0; i < w->fence_deps.nr; i++) {
+		struct w_step *dep =
+			&wrk->steps[w->idx + w->fence_deps.list[i].target];
+
+		if (dep->type != BATCH)
+			continue;
+
+		start = max(start, w->fence_deps.submit_fence ?
+				   dep->sim_start : dep->sim_end);
 	}
+
+	start = max(start, wrk->sim_busy_until[engine]);
+
+	w->sim_start = start;
+	w->sim_end = start + 1000ull * get_duration(wrk, w);
+
+	wrk->sim_busy_until[engine] = w->sim_end;
+	wrk->sim_busy_total[engine] += w->sim_end - w->sim_start;
+
+	if (wrk->flags & GPU_TIMESTAMPS)
+		ts_record(w, engine, w->sim_start - wrk->sim_now,
+			  w->sim_end - w->sim_start);
+
+	wrk->sim_latency_tot += w->sim_end - wrk->sim_now;
+	wrk->sim_latency_max = max(wrk->sim_latency_max,
+				   w->sim_end - wrk->sim_now);
+	wrk->sim_batches++;
+}
+
+static enum intel_engine_id
+sim_engine(struct workload *wrk, struct w_step *w, enum intel_engine_id engine)
+{
+	enum intel_engine_id best = VCS1;
+	unsigned int i;
+
+	/*
+	 * Steps left to the kernel (no engine map, or a load balanced one)
+	 * land on whichever engine of the class frees up first.
+	 */
+	if (engine == DEFAULT)
+		return RCS;
+	else if (engine != VCS)
+		return engine;
+
+	for (i = 1; i < num_engines_in_class(VCS); i++) {
+		if (wrk->sim_busy_until[VCS1 + i] <
+		    wrk->sim_busy_until[best])
+			best = VCS1 + i;
+	}
+
+	return best;
+}
+
+/*
+ * Userspace engine selection policies.
+ *
+ * When a balancer is selected with -b, every batch step which targets the VCS
+ * engine class is placed on a physical engine by the policy instead of by the
+ * kernel. Contexts with an engine map are then submitted to explicitly, by
+ * index, so the same workload files can be used to compare the policies
+ * against the kernel load balancing.
+ */
+struct workload_balancer {
+	const char *name;
+	const char *desc;
+
+	int (*init)(const struct workload_balancer *balancer,
+		    struct workload *wrk);
+	enum intel_engine_id (*balance)(const struct workload_balancer *balancer,
+					struct workload *wrk,
+					struct w_step *w,
+					const enum intel_engine_id *engines,
+					unsigned int count);
+};
+
+static bool step_busy(struct workload *wrk, struct w_step *w)
+{
+	if (simulated)
+		return w->sim_end > wrk->sim_now;
+
+	return gem_bo_busy(fd, w->obj[0].handle);
+}
+
+static void retire_requests(struct workload *wrk, enum intel_engine_id engine)
+{
+	struct w_step *w, *tmp;
+
+	igt_list_for_each_entry_safe(w, tmp, &wrk->requests[engine], rq_link) {
+		if (step_busy(wrk, w))
+			break;
+
+		w->request = -1;
+		igt_list_del(&w->rq_link);
+		wrk->nrequest[engine]--;
+	}
+}
+
+static enum intel_engine_id
+rr_balance(const struct workload_balancer *balancer,
+	   struct workload *wrk, struct w_step *w,
+	   const enum intel_engine_id *engines, unsigned int count)
+{
+	return engines[wrk->rr_next++ % count];
+}
+
+static enum intel_engine_id
+qd_balance(const struct workload_balancer *balancer,
+	   struct workload *wrk, struct w_step *w,
+	   const enum intel_engine_id *engines, unsigned int count)
+{
+	enum intel_engine_id best = engines[wrk->rr_next % count];
+	unsigned int i;
+
+	/* Rotate the starting point so ties do not favour the first engine. */
+	for (i = 0; i < count; i++) {
+		enum intel_engine_id engine =
+			engines[(wrk->rr_next + i) % count];
+
+		retire_requests(wrk, engine);
+		if (wrk->nrequest[engine] < wrk->nrequest[best])
+			best = engine;
+	}
+
+	wrk->rr_next++;
+
+	return best;
+}
+
+#define BUSY_SAMPLE_NS (100 * 1000)
+
+static int
+busy_init(const struct workload_balancer *balancer, struct workload *wrk)
+{
+	unsigned int i;
+
+	if (simulated)
+		return 0;
+
+	for (i = 0; i < num_engines_in_class(VCS); i++) {
+		struct i915_engine_class_instance ci = get_engine(VCS1 + i);
+		int pmu;
+
+		pmu = perf_i915_open_group(fd,
+					   I915_PMU_ENGINE_BUSY(ci.engine_class,
+								ci.engine_instance),
+					   wrk->pmu.fd);
+		if (pmu < 0) {
+			wsim_err("Failed to open busy stats for VCS%u! (%s)\n",
+				 i + 1, strerror(errno));
+			return 1;
+		}
+
+		if (wrk->pmu.fd < 0)
+			wrk->pmu.fd = pmu;
+	}
+
+	return 0;
+}
+
+static uint64_t
+busy_sample(struct workload *wrk, uint64_t *busy)
+{
+	const unsigned int count = num_engines_in_class(VCS);
+	uint64_t buf[2 + NUM_ENGINES];
+	unsigned int i;
+
+	if (simulated) {
+		for (i = 0; i < count; i++) {
+			enum intel_engine_id engine = VCS1 + i;
+			uint64_t pending = 0;
+			struct w_step *w;
+
+			igt_list_for_each_entry(w, &wrk->requests[engine],
+						rq_link) {
+				if (w->sim_end > wrk->sim_now)
+					pending += w->sim_end -
+						   max(w->sim_start,
+						       wrk->sim_now);
+			}
+
+			busy[engine] = wrk->sim_busy_total[engine] - pending;
+		}
+
+		return wrk->sim_now;
+	}
+
+	/* Group read: nr, time_enabled, then one value per engine. */
+	igt_assert(read(wrk->pmu.fd, buf, sizeof(buf)) > 0);
+	igt_assert_eq(buf[0], count);
+
+	for (i = 0; i < count; i++)
+		busy[VCS1 + i] = buf[2 + i];
+
+	return buf[1];
+}
+
+static enum intel_engine_id
+busy_balance(const struct workload_balancer *balancer,
+	     struct workload *wrk, struct w_step *w,
+	     const enum intel_engine_id *engines, unsigned int count)
+{
+	enum intel_engine_id best = engines[wrk->rr_next % count];
+	uint64_t busy[NUM_ENGINES], ts;
+	unsigned int i;
+
+	/*
+	 * Refresh the per-mille engine load once per sampling interval and
+	 * otherwise decide from the previous sample, breaking ties on the
+	 * number of requests in flight.
+	 */
+	ts = busy_sample(wrk, busy);
+	if (ts - wrk->pmu.ts >= BUSY_SAMPLE_NS) {
+		const uint64_t dt = ts - wrk->pmu.ts;
+
+		for (i = 0; i < num_engines_in_class(VCS); i++) {
+			enum intel_engine_id engine = VCS1 + i;
+
+			wrk->pmu.load[engine] =
+				(busy[engine] - wrk->pmu.busy[engine]) * 1000 /
+				dt;
+			wrk->pmu.busy[engine] = busy[engine];
+		}
+
+		wrk->pmu.ts = ts;
+	}
+
+	for (i = 0; i < count; i++) {
+		enum intel_engine_id engine =
+			engines[(wrk->rr_next + i) % count];
+
+		retire_requests(wrk, engine);
+		if (wrk->pmu.load[engine] < wrk->pmu.load[best] ||
+		    (wrk->pmu.load[engine] == wrk->pmu.load[best] &&
+		     wrk->nrequest[engine] < wrk->nrequest[best]))
+			best = engine;
+	}
+
+	wrk->rr_next++;
+
+	return best;
+}
+
+static enum intel_engine_id
+context_balance(const struct workload_balancer *balancer,
+		struct workload *wrk, struct w_step *w,
+		const enum intel_engine_id *engines, unsigned int count)
+{
+	struct ctx *ctx = __get_ctx(wrk, w);
+	enum intel_engine_id best;
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		if (ctx->sticky_engine == engines[i])
+			return ctx->sticky_engine;
+	}
+
+	/* First use - pin to the engine with the fewest pinned contexts. */
+	best = engines[wrk->rr_next++ % count];
+	for (i = 0; i < count; i++) {
+		if (wrk->nr_sticky[engines[i]] < wrk->nr_sticky[best])
+			best = engines[i];
+	}
+
+	if (ctx->sticky_engine != DEFAULT)
+		wrk->nr_sticky[ctx->sticky_engine]--;
+	wrk->nr_sticky[best]++;
+	ctx->sticky_engine = best;
+
+	return best;
+}
+
+static const struct workload_balancer all_balancers[] = {
+	{
+		.name = "rr",
+		.desc = "Simple round-robin between the engines of a class.",
+		.balance = rr_balance,
+	},
+	{
+		.name = "qd",
+		.desc = "Pick the engine with the fewest requests in flight.",
+		.balance = qd_balance,
+	},
+	{
+		.name = "busy",
+		.desc = "Pick the least loaded engine according to the i915 PMU\n"
+			"busy stats, with queue depth as the tie-breaker.",
+		.init = busy_init,
+		.balance = busy_balance,
+	},
+	{
+		.name = "context",
+		.desc = "Pin each context to an engine on first use.",
+		.balance = context_balance,
+	},
+};
+
+static enum intel_engine_id
+balance_step(struct workload *wrk, struct w_step *w)
+{
+	const struct workload_balancer *balancer = wrk->balancer;
+	struct ctx *ctx = __get_ctx(wrk, w);
+	enum intel_engine_id engines[NUM_ENGINES];
+	enum intel_engine_id engine;
+	unsigned int count = 0, i;
+	uint64_t t;
+
+	if (ctx->engine_map) {
+		for (i = 0; i < ctx->engine_map_count; i++) {
+			if (ctx->engine_map[i] == VCS1 ||
+			    ctx->engine_map[i] == VCS2)
+				engines[count++] = ctx->engine_map[i];
+		}
+	} else {
+		count = num_engines_in_class(VCS);
+		fill_engines_id_class(engines, VCS);
+	}
+
+	if (!count)
+		return w->engine;
+
+	/* Wall clock even when simulated to expose the policy CPU cost. */
+	t = now_ns();
+	engine = balancer->balance(balancer, wrk, w, engines, count);
+	wrk->balance_ns += now_ns() - t;
+
+	wrk->nr_balanced[engine]++;
+
+	return engine;
+}
+
+static void print_balancer_stats(struct workload *wrk)
+{
+	unsigned long total = 0;
+	unsigned int i;
+
+	for (i = 0; i < NUM_ENGINES; i++)
+		total += wrk->nr_balanced[i];
+
+	printf("%c%u: Balancer %s: %lu decisions",
+	       wrk->background ? ' ' : '*', wrk->id, wrk->balancer->name,
+	       total);
+	if (total)
+		printf(", %.1fns avg", (double)wrk->balance_ns / total);
+	for (i = 0; i < NUM_ENGINES; i++) {
+		if (wrk->nr_balanced[i])
+			printf(" %s=%lu", ring_str_map[i], wrk->nr_balanced[i]);
+	}
+	putchar('\n');
 }
 
 static void *run_workload(void *data)
 {
 	struct workload *wrk = (struct workload *)data;
-	struct timespec t_start, t_end;
+	uint64_t t_start, t_end;
 	struct w_step *w;
 	int throttle = -1;
 	int qd_throttle = -1;
 	int count, missed = 0;
 	unsigned long time_tot = 0, time_min = ULONG_MAX, time_max = 0;
+	uint64_t cycle_tot = 0, cycle_max = 0;
 	int i;
 
-	clock_gettime(CLOCK_MONOTONIC, &t_start);
+	t_start = wrk_now(wrk);
 
 	for (count = 0; wrk->run && (wrk->background || count < wrk->repeat);
 	     count++) {
 		unsigned int cur_seqno = wrk->sync_seqno;
+		uint64_t cycle;
 
-		clock_gettime(CLOCK_MONOTONIC, &wrk->repeat_start);
+		wrk->repeat_start = wrk_now(wrk);
 
 		for (i = 0, w = wrk->steps; wrk->run && (i < wrk->nr_steps);
 		     i++, w++) {
@@ -2313,11 +3111,9 @@ static void *run_workload(void *data)
 			if (w->type == DELAY) {
 				do_sleep = w->delay;
 			} else if (w->type == PERIOD) {
-				struct timespec now;
 				int elapsed;
 
-				clock_gettime(CLOCK_MONOTONIC, &now);
-				elapsed = elapsed_us(&wrk->repeat_start, &now);
+				elapsed = (wrk_now(wrk) - wrk->repeat_start) / 1000;
 				do_sleep = w->period - elapsed;
 				time_tot += elapsed;
 				if (elapsed < time_min)
@@ -2336,7 +3132,7 @@ static void *run_workload(void *data)
 
 				igt_assert(s_idx >= 0 && s_idx < i);
 				igt_assert(wrk->steps[s_idx].type == BATCH);
-				gem_sync(fd, wrk->steps[s_idx].obj[0].handle);
+				w_step_sync(wrk, &wrk->steps[s_idx]);
 				continue;
 			} else if (w->type == THROTTLE) {
 				throttle = w->throttle;
@@ -2344,6 +3140,12 @@ static void *run_workload(void *data)
 			} else if (w->type == QD_THROTTLE) {
 				qd_throttle = w->throttle;
 				continue;
+			} else if (simulated &&
+				   (w->type == SW_FENCE ||
+				    w->type == SW_FENCE_SIGNAL ||
+				    w->type == SSEU)) {
+				/* Needs the kernel, nothing to model. */
+				continue;
 			} else if (w->type == SW_FENCE) {
 				igt_assert(w->emit_fence < 0);
 				w->emit_fence =
@@ -2369,19 +3171,27 @@ static void *run_workload(void *data)
 						.value = w->priority,
 					};
 
-					gem_context_set_param(fd, &param);
+					if (!simulated)
+						gem_context_set_param(fd, &param);
 					wrk->ctx_list[w->context].priority =
 								    w->priority;
 				}
 				continue;
 			} else if (w->type == TERMINATE) {
 				unsigned int t_idx = i + w->target;
+				struct w_step *t = &wrk->steps[t_idx];
+				unsigned int n;
 
 				igt_assert(t_idx >= 0 && t_idx < i);
-				igt_assert(wrk->steps[t_idx].type == BATCH);
-				igt_assert(wrk->steps[t_idx].unbound_duration);
+				igt_assert(t->type == BATCH);
+				igt_assert(t->unbound_duration);
 
-				*wrk->steps[t_idx].bb_duration = 0xffffffff;
+				if (t->ts_batch) {
+					for (n = 0; n <= TS_RING; n++)
+						*t->ts_batch[n].duration = 0xffffffff;
+				} else {
+					*t->bb_duration = 0xffffffff;
+				}
 				__sync_synchronize();
 				continue;
 			} else if (w->type == SSEU) {
@@ -2401,7 +3211,7 @@ static void *run_workload(void *data)
 			}
 
 			if (do_sleep || w->type == PERIOD) {
-				usleep(do_sleep);
+				wrk_sleep(wrk, do_sleep);
 				continue;
 			}
 
@@ -2413,7 +3223,15 @@ static void *run_workload(void *data)
 			if (throttle > 0)
 				w_sync_to(wrk, w, i - throttle);
 
-			do_eb(wrk, w, engine);
+			if (engine == VCS && wrk->balancer)
+				engine = balance_step(wrk, w);
+
+			if (simulated) {
+				engine = sim_engine(wrk, w, engine);
+				sim_submit(wrk, w, engine);
+			} else {
+				do_eb(wrk, w, engine);
+			}
 
 			if (w->request != -1) {
 				igt_list_del(&w->rq_link);
@@ -2427,7 +3245,7 @@ static void *run_workload(void *data)
 				break;
 
 			if (w->sync)
-				gem_sync(fd, w->obj[0].handle);
+				w_step_sync(wrk, w);
 
 			if (qd_throttle > 0) {
 				while (wrk->nrequest[engine] > qd_throttle) {
@@ -2436,7 +3254,7 @@ static void *run_workload(void *data)
 					s = igt_list_first_entry(&wrk->requests[engine],
 								 s, rq_link);
 
-					gem_sync(fd, s->obj[0].handle);
+					w_step_sync(wrk, s);
 
 					s->request = -1;
 					igt_list_del(&s->rq_link);
@@ -2453,6 +3271,10 @@ static void *run_workload(void *data)
 			wrk->sync_seqno += wrk->nr_steps;
 		}
 
+		cycle = wrk_now(wrk) - wrk->repeat_start;
+		cycle_tot += cycle;
+		cycle_max = max(cycle_max, cycle);
+
 		/* Cleanup all fences instantiated in this iteration. */
 		for (i = 0, w = wrk->steps; wrk->run && (i < wrk->nr_steps);
 		     i++, w++) {
@@ -2468,13 +3290,25 @@ static void *run_workload(void *data)
 			continue;
 
 		w = igt_list_last_entry(&wrk->requests[i], w, rq_link);
-		gem_sync(fd, w->obj[0].handle);
+		w_step_sync(wrk, w);
 	}
 
-	clock_gettime(CLOCK_MONOTONIC, &t_end);
+	/* Outside of the timed loop it is fine to wait for the stragglers. */
+	for (i = 0, w = wrk->steps;
+	     !simulated && (wrk->flags & GPU_TIMESTAMPS) && i < wrk->nr_steps;
+	     i++, w++) {
+		if (w->type != BATCH)
+			continue;
+
+		w_step_sync(wrk, w);
+		ts_harvest(wrk, w, true);
+	}
+
+	t_end = wrk_now(wrk);
+	wrk->elapsed = t_end - t_start;
 
 	if (wrk->print_stats) {
-		double t = elapsed(&t_start, &t_end);
+		double t = wrk->elapsed / 1e9;
 
 		printf("%c%u: %.3fs elapsed (%d cycles, %.3f workloads/s).",
 		       wrk->background ? ' ' : '*', wrk->id,
@@ -2482,14 +3316,47 @@ static void *run_workload(void *data)
 		if (time_tot)
 			printf(" Time avg/min/max=%lu/%lu/%luus; %u missed.",
 			       time_tot / count, time_min, time_max, missed);
+		if (count)
+			printf(" Cycle avg/max=%"PRIu64"/%"PRIu64"us.",
+			       cycle_tot / count / 1000, cycle_max / 1000);
+		if (wrk->sim_batches)
+			printf(" Batch latency avg/max=%"PRIu64"/%"PRIu64"us.",
+			       wrk->sim_latency_tot / wrk->sim_batches / 1000,
+			       wrk->sim_latency_max / 1000);
 		putchar('\n');
+
+		if (wrk->balancer)
+			print_balancer_stats(wrk);
+		if (wrk->flags & GPU_TIMESTAMPS)
+			print_ts_stats(wrk);
 	}
 
 	return NULL;
 }
 
+static void ts_fini(struct workload *wrk)
+{
+	struct w_step *w;
+	int i, e;
+
+	for (i = 0, w = wrk->steps; i < wrk->nr_steps; i++, w++) {
+		for (e = 0; w->ts_stats && e < NUM_ENGINES; e++) {
+			if (!w->ts_stats[e].init)
+				continue;
+
+			igt_stats_fini(&w->ts_stats[e].queued);
+			igt_stats_fini(&w->ts_stats[e].exec);
+		}
+
+		free(w->ts_stats);
+		free(w->ts_ring);
+		free(w->ts_batch);
+	}
+}
+
 static void fini_workload(struct workload *wrk)
 {
+	ts_fini(wrk);
 	free(wrk->steps);
 	free(wrk);
 }
@@ -2524,9 +3391,48 @@ static void print_help(void)
 "  -F <scale>        Scale factor for delays.\n"
 "  -L                List GPUs.\n"
 "  -D <gpu>          One of the GPUs from -L.\n"
+"  -b <policy>       Place VCS class batches using a userspace engine selection\n"
+"                    policy instead of the kernel. Use 'list' to see them.\n"
+"  -N                Simulate execution without a GPU.\n"
+"  -g                Record GPU timestamps as each batch starts and ends and\n"
+"                    report queueing and execution times per step and engine.\n"
 	);
 }
 
+static void list_balancers(void)
+{
+	unsigned int i;
+
+	puts("Available engine selection policies:");
+
+	for (i = 0; i < ARRAY_SIZE(all_balancers); i++) {
+		const struct workload_balancer *balancer = &all_balancers[i];
+		const char *desc = balancer->desc;
+
+		printf("  %-10s", balancer->name);
+		while (*desc) {
+			const char *nl = strchrnul(desc, '\n');
+
+			printf("%.*s\n", (int)(nl - desc), desc);
+			desc = *nl ? nl + 1 : nl;
+			if (*desc)
+				printf("            ");
+		}
+	}
+}
+
+static const struct workload_balancer *find_balancer(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(all_balancers); i++) {
+		if (!strcasecmp(name, all_balancers[i].name))
+			return &all_balancers[i];
+	}
+
+	return NULL;
+}
+
 static char *load_workload_descriptor(char *filename)
 {
 	struct stat sbuf;
@@ -2574,6 +3480,7 @@ add_workload_arg(struct w_arg *w_args, unsigned int nr_args, char *w_arg,
 int main(int argc, char **argv)
 {
 	struct igt_device_card card = { };
+	const struct workload_balancer *balancer = NULL;
 	bool list_devices_arg = false;
 	unsigned int repeat = 1;
 	unsigned int clients = 1;
@@ -2597,8 +3504,24 @@ int main(int argc, char **argv)
 	master_prng = time(NULL);
 
 	while ((c = getopt(argc, argv,
-			   "LhqvsSdc:r:w:W:a:p:I:f:F:D:")) != -1) {
+			   "LhqvsSdNgc:r:w:W:a:p:I:f:F:D:b:")) != -1) {
 		switch (c) {
+		case 'b':
+			if (!strcmp(optarg, "list")) {
+				list_balancers();
+				goto out;
+			}
+
+			balancer = find_balancer(optarg);
+			if (!balancer) {
+				wsim_err("Unknown balancing mode '%s'!\n",
+					 optarg);
+				goto err;
+			}
+			break;
+		case 'N':
+			simulated = true;
+			break;
 		case 'L':
 			list_devices_arg = true;
 			break;
@@ -2648,6 +3571,9 @@ int main(int argc, char **argv)
 		case 'd':
 			flags |= DEPSYNC;
 			break;
+		case 'g':
+			flags |= GPU_TIMESTAMPS;
+			break;
 		case 'I':
 			master_prng = strtol(optarg, NULL, 0);
 			break;
@@ -2665,6 +3591,13 @@ int main(int argc, char **argv)
 		}
 	}
 
+	if (simulated) {
+		fd = -1;
+		if (verbose > 1)
+			printf("Simulating execution.\n");
+		goto skip_device;
+	}
+
 	igt_devices_scan(false);
 
 	if (list_devices_arg) {
@@ -2714,6 +3647,18 @@ int main(int argc, char **argv)
 	if (verbose > 1)
 		printf("Using device %s\n", drm_dev);
 
+skip_device:
+	/* Batches read engine registers relative to where they execute. */
+	if (balancer && wsim_gen() < 11) {
+		wsim_err("Engine selection policies need relative mmio support, gen11+!\n");
+		goto err;
+	}
+
+	if ((flags & GPU_TIMESTAMPS) && !simulated && !ts_frequency()) {
+		wsim_err("GPU timestamps need the CS timestamp frequency!\n");
+		goto err;
+	}
+
 	if (!nr_w_args) {
 		wsim_err("No workload descriptor(s)!\n");
 		goto err;
@@ -2786,11 +3731,19 @@ int main(int argc, char **argv)
 		w[i]->background = master_workload >= 0 && i != master_workload;
 		w[i]->print_stats = verbose > 1 ||
 				    (verbose > 0 && master_workload == i);
+		w[i]->balancer = balancer;
 
 		if (prepare_workload(i, w[i])) {
 			wsim_err("Failed to prepare workload %u!\n", i);
 			goto err;
 		}
+
+		if (balancer && balancer->init &&
+		    balancer->init(balancer, w[i])) {
+			wsim_err("Failed to initialize balancing for workload %u!\n",
+				 i);
+			goto err;
+		}
 	}
 
 	clock_gettime(CLOCK_MONOTONIC, &t_start);
@@ -2818,12 +3771,28 @@ int main(int argc, char **argv)
 	clock_gettime(CLOCK_MONOTONIC, &t_end);
 
 	t = elapsed(&t_start, &t_end);
-	if (verbose)
-		printf("%.3fs elapsed (%.3f workloads/s)\n",
-		       t, clients * repeat / t);
+	if (simulated) {
+		/* Report simulated time, clients run on their own engines. */
+		uint64_t sim = 0;
 
-	for (i = 0; i < clients; i++)
+		for (i = 0; i < clients; i++)
+			sim = max(sim, w[i]->elapsed);
+		t = sim / 1e9;
+	}
+	if (verbose) {
+		printf("%.3fs %s (%.3f workloads/s)",
+		       t, simulated ? "simulated" : "elapsed",
+		       clients * repeat / t);
+		if (balancer)
+			printf(" using %s balancing", balancer->name);
+		putchar('\n');
+	}
+
+	for (i = 0; i < clients; i++) {
+		if (w[i]->pmu.fd >= 0)
+			close(w[i]->pmu.fd);
 		fini_workload(w[i]);
+	}
 	free(w);
 	for (i = 0; i < nr_w_args; i++)
 		fini_workload(wrk[i]);
@@ -0,0 +1,102 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+/** @file kms_display_init.c
+ *
+ * Measures how long igt_display_require() takes to set up a display, first
+ * cold and then as repeated by every subtest of a KMS test binary.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_kms.h"
+#include "igt_stats.h"
+
+static uint64_t elapsed(const struct timespec *start,
+			const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * NSEC_PER_SEC +
+		end->tv_nsec - start->tv_nsec;
+}
+
+static uint64_t display_init(int fd, int *n_outputs)
+{
+	struct timespec start, end;
+	igt_display_t display;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	igt_display_require(&display, fd);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*n_outputs = display.n_outputs;
+	igt_display_fini(&display);
+
+	return elapsed(&start, &end);
+}
+
+int main(int argc, char **argv)
+{
+	int reps = 20, n_outputs;
+	igt_stats_t stats;
+	uint64_t cold;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "r:")) != -1) {
+		switch (c) {
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+				reps = 1;
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-r repetitions]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	fd = drm_open_driver_master(DRIVER_ANY);
+
+	cold = display_init(fd, &n_outputs);
+
+	igt_stats_init_with_size(&stats, reps);
+	for (int n = 0; n < reps; n++)
+		igt_stats_push(&stats, display_init(fd, &n_outputs));
+
+	printf("%d connectors: first init %.2fms, then avg/median/max %.2f/%.2f/%.2fms\n",
+	       n_outputs, cold / 1e6,
+	       igt_stats_get_mean(&stats) / 1e6,
+	       igt_stats_get_median(&stats) / 1e6,
+	       igt_stats_get_max(&stats) / 1e6);
+
+	igt_stats_fini(&stats);
+	close(fd);
+
+	return 0;
+}
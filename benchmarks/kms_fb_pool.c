@@ -0,0 +1,142 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+/** @file kms_fb_pool.c
+ *
+ * Measures framebuffer create/destroy churn with and without the igt_fb
+ * buffer object pool.
+ */
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "drmtest.h"
+#include "igt_aux.h"
+#include "igt_fb.h"
+#include "ioctl_wrappers.h"
+
+static uint64_t elapsed(const struct timespec *start,
+			const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) * NSEC_PER_SEC +
+		end->tv_nsec - start->tv_nsec;
+}
+
+static uint64_t churn(int fd, int width, int height, uint32_t format,
+		      uint64_t modifier, bool paint, int count)
+{
+	struct timespec start, end;
+	struct igt_fb fb[4];
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (int n = 0; n < count; n++) {
+		struct igt_fb *f = &fb[n % ARRAY_SIZE(fb)];
+
+		/* Keep a few in flight, as a page flipping test would */
+		if (n >= (int)ARRAY_SIZE(fb))
+			igt_remove_fb(fd, f);
+
+		if (paint)
+			igt_create_color_fb(fd, width, height, format,
+					    modifier, 0.5, 0.5, 0.5, f);
+		else
+			igt_create_fb(fd, width, height, format, modifier, f);
+	}
+	for (int n = 0; n < min(count, (int)ARRAY_SIZE(fb)); n++)
+		igt_remove_fb(fd, &fb[n]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return elapsed(&start, &end) / count;
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t format = DRM_FORMAT_XRGB8888;
+	uint64_t modifier = LOCAL_DRM_FORMAT_MOD_NONE;
+	int width = 1920, height = 1080;
+	unsigned int flags = 0;
+	bool paint = false;
+	int count = 1000;
+	struct igt_fb_pool_stats stats;
+	uint64_t base, pooled;
+	int fd, c;
+
+	while ((c = getopt(argc, argv, "w:h:n:m:cp")) != -1) {
+		switch (c) {
+		case 'w':
+			width = atoi(optarg);
+			break;
+		case 'h':
+			height = atoi(optarg);
+			break;
+		case 'n':
+			count = atoi(optarg);
+			if (count < 1)
+				count = 1;
+			break;
+		case 'm':
+			modifier = strtoull(optarg, NULL, 0);
+			break;
+		case 'c':
+			flags |= IGT_FB_POOL_CLEAR;
+			break;
+		case 'p':
+			paint = true;
+			break;
+		default:
+			fprintf(stderr,
+				"Usage: %s [-w width] [-h height] [-n count] [-m modifier] [-c] [-p]\n"
+				"  -c  clear recycled buffers\n"
+				"  -p  paint every framebuffer through a CPU mapping\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	fd = drm_open_driver_master(DRIVER_ANY);
+
+	base = churn(fd, width, height, format, modifier, paint, count);
+
+	igt_fb_pool_enable(fd, flags);
+	pooled = churn(fd, width, height, format, modifier, paint, count);
+	igt_assert(igt_fb_pool_get_stats(fd, &stats));
+	igt_fb_pool_disable(fd);
+
+	printf("%dx%d " IGT_FORMAT_FMT " modifier 0x%"PRIx64", %d framebuffers\n",
+	       width, height, IGT_FORMAT_ARGS(format), modifier, count);
+	printf("unpooled: %.1fus per framebuffer\n", base / 1e3);
+	printf("pooled:   %.1fus per framebuffer\n", pooled / 1e3);
+	printf("buffers created %"PRIu64", reused %"PRIu64"; mappings created %"PRIu64", reused %"PRIu64"\n",
+	       stats.created, stats.reused, stats.mapped, stats.map_reused);
+	printf("ioctls saved: %"PRIu64" (%.2f per framebuffer)\n",
+	       stats.ioctls_saved, (double)stats.ioctls_saved / count);
+
+	close(fd);
+	return 0;
+}
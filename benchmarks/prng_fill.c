@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Throughput of filling a buffer with random dwords, the per dword loop
+ * over hars_petruska_f54_1_random() the tests use against the counter based
+ * generator, one dword at a time and in bulk.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_rand.h"
+#include "igt_x86.h"
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static void fill_hars_petruska(uint32_t *buf, size_t n)
+{
+	uint32_t seed = 0x12345678;
+
+	for (size_t i = 0; i < n; i++)
+		buf[i] = hars_petruska_f54_1_random(&seed);
+}
+
+static void fill_philox(uint32_t *buf, size_t n)
+{
+	igt_philox_t rng;
+
+	igt_philox_init(&rng, 0x12345678);
+	for (size_t i = 0; i < n; i++)
+		buf[i] = igt_philox_random(&rng);
+}
+
+static void fill_philox_bulk(uint32_t *buf, size_t n)
+{
+	igt_philox_t rng;
+
+	igt_philox_init(&rng, 0x12345678);
+	igt_philox_fill(&rng, buf, n * sizeof(*buf));
+}
+
+static const struct {
+	const char *name;
+	void (*fill)(uint32_t *buf, size_t n);
+} generators[] = {
+	{ "hars-petruska", fill_hars_petruska },
+	{ "philox", fill_philox },
+	{ "philox-fill", fill_philox_bulk },
+};
+
+int main(int argc, char **argv)
+{
+	size_t size = 256 << 20;
+	char features[1024];
+	int reps = 5;
+	uint32_t *buf;
+	int c;
+
+	while ((c = getopt(argc, argv, "s:r:")) != -1) {
+		switch (c) {
+		case 's':
+			size = strtoull(optarg, NULL, 0) << 20;
+			if (!size)
+				size = 1 << 20;
+			break;
+
+		case 'r':
+			reps = atoi(optarg);
+			if (reps < 1)
+				reps = 1;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	buf = malloc(size);
+	if (!buf) {
+		fprintf(stderr, "Unable to allocate %zuMiB\n", size >> 20);
+		return 1;
+	}
+
+	printf("%zuMiB, cpu:%s\n", size >> 20,
+	       igt_x86_features_to_string(igt_x86_features(), features));
+
+	for (int g = 0; g < sizeof(generators) / sizeof(generators[0]); g++) {
+		struct timespec start;
+		double best = 0;
+
+		/* Fault in the buffer outside of the measurements */
+		generators[g].fill(buf, size / sizeof(*buf));
+
+		for (int r = 0; r < reps; r++) {
+			double t;
+
+			clock_gettime(CLOCK_MONOTONIC, &start);
+			generators[g].fill(buf, size / sizeof(*buf));
+			t = elapsed(&start);
+
+			if (!r || t < best)
+				best = t;
+		}
+
+		printf("%s: %.0fMiB/s\n", generators[g].name,
+		       (size >> 20) / best);
+	}
+
+	free(buf);
+	return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Cost of a PSR status sample: parsing a PSR2 status into a struct
+ * igt_psr_status against the strstr() lookups of psr_active_check() and
+ * psr2_read_last_num_su_blocks_val(), and with -f the pread() of a status
+ * file through a single fd on top.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_psr.h"
+
+static const char status_text[] =
+	"Sink support: yes [0x03]\n"
+	"PSR mode: PSR2 enabled\n"
+	"Source PSR ctl: enabled [0x40000c32]\n"
+	"Source PSR status: DEEP_SLEEP [0x80010000]\n"
+	"Busy frontbuffer bits: 0x00000000\n"
+	"Frame:\tPSR2 SU blocks:\n"
+	"0\t4\n"
+	"1\t4\n"
+	"2\t0\n"
+	"3\t0\n"
+	"4\t0\n"
+	"5\t0\n"
+	"6\t0\n"
+	"7\t0\n"
+	"PSR2 selective fetch: enabled\n";
+
+static double elapsed(const struct timespec *start)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - start->tv_sec) +
+	       (now.tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static volatile unsigned int sink;
+
+static void parse_strstr(const char *buf, size_t len)
+{
+	const char *s;
+
+	s = strstr(buf, "PSR2 SU blocks:\n0\t");
+	sink += !!strstr(buf, "DEEP_SLEEP") +
+		(s ? strtol(s + 18, NULL, 10) : 0);
+}
+
+static void parse_table(const char *buf, size_t len)
+{
+	struct igt_psr_status status;
+
+	igt_psr_status_parse(buf, len, &status);
+	sink += status.state + status.su_blocks[0];
+}
+
+static const struct {
+	const char *name;
+	void (*parse)(const char *buf, size_t len);
+} parsers[] = {
+	{ "strstr", parse_strstr },
+	{ "table", parse_table },
+};
+
+int main(int argc, char **argv)
+{
+	const char *file = NULL;
+	unsigned int loops = 1000000;
+	char buf[4096];
+	int fd = -1, c;
+
+	while ((c = getopt(argc, argv, "f:n:")) != -1) {
+		switch (c) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'n':
+			loops = strtoul(optarg, NULL, 0);
+			if (!loops)
+				loops = 1;
+			break;
+		default:
+			break;
+		}
+	}
+
+	if (file) {
+		fd = open(file, O_RDONLY);
+		if (fd < 0) {
+			fprintf(stderr, "Unable to open %s\n", file);
+			return 1;
+		}
+	}
+
+	for (int p = 0; p < sizeof(parsers) / sizeof(parsers[0]); p++) {
+		struct timespec start;
+		ssize_t len = sizeof(status_text) - 1;
+
+		memcpy(buf, status_text, sizeof(status_text));
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (unsigned int i = 0; i < loops; i++) {
+			if (fd >= 0) {
+				len = pread(fd, buf, sizeof(buf) - 1, 0);
+				if (len < 0) {
+					fprintf(stderr, "Unable to read %s\n",
+						file);
+					return 1;
+				}
+				buf[len] = '\0';
+			}
+
+			parsers[p].parse(buf, len);
+		}
+
+		printf("%s: %.0fns\n", parsers[p].name,
+		       elapsed(&start) * 1e9 / loops);
+	}
+
+	if (fd >= 0)
+		close(fd);
+
+	return 0;
+}
@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Copyright © 2021 Intel Corporation
+#
+# Permission is hereby granted, free of charge, to any person obtaining a
+# copy of this software and associated documentation files (the "Software"),
+# to deal in the Software without restriction, including without limitation
+# the rights to use, copy, modify, merge, publish, distribute, sublicense,
+# and/or sell copies of the Software, and to permit persons to whom the
+# Software is furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice (including the next
+# paragraph) shall be included in all copies or substantial portions of the
+# Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+# THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+# FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+# IN THE SOFTWARE.
+
+#
+# Runs a workload on simulated engines with one engine selection policy,
+# reports the batch latency it achieved and checks the engines it picked.
+#
+# Usage: check_balancer.sh <gem_wsim> <balancer> <workload> <decisions>
+#
+# where <decisions> is the expected per engine count, e.g. "VCS1=10 VCS2=30".
+# Simulated time makes the decisions reproducible.
+#
+
+if [ $# -ne 4 ]; then
+	echo "Usage: $0 <gem_wsim> <balancer> <workload> <decisions>" >&2
+	exit 1
+fi
+
+gem_wsim=$1
+balancer=$2
+workload=$3
+expected=$4
+
+out=$("$gem_wsim" -N -v -v -c 1 -r 10 -b "$balancer" -w "$workload") || exit 1
+
+latency=$(echo "$out" | sed -n 's/^\*0: .*Batch latency avg\/max=\([0-9/]*\)us\.$/\1/p')
+decisions=$(echo "$out" | sed -n "s/^\*0: Balancer $balancer: [0-9]* decisions, [0-9.]*ns avg //p")
+
+echo "$balancer: batch latency avg/max ${latency}us, decisions $decisions"
+
+if [ "$decisions" != "$expected" ]; then
+	echo "Expected decisions $expected!" >&2
+	exit 1
+fi
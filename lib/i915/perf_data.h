@@ -52,6 +52,15 @@ enum intel_perf_record_type {
 
 	/* intel_perf_record_timestamp_correlation */
 	INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+
+	/* intel_perf_record_pmu_config */
+	INTEL_PERF_RECORD_TYPE_PMU_CONFIG,
+
+	/* intel_perf_record_pmu_sample */
+	INTEL_PERF_RECORD_TYPE_PMU_SAMPLE,
+
+	/* intel_perf_record_request */
+	INTEL_PERF_RECORD_TYPE_REQUEST,
 };
 
 /* This structure cannot ever change. */
@@ -111,6 +120,69 @@ struct intel_perf_record_timestamp_correlation {
 	uint64_t gpu_timestamp;
 } __attribute__((packed));
 
+/* i915 PMU counters sampled by the recorder, in the order of the values in
+ * intel_perf_record_pmu_sample. */
+struct intel_perf_record_pmu_counter {
+	/* perf_event_attr.config */
+	uint64_t config;
+
+	/* Event name as listed in sysfs, e.g. "rcs0-busy" */
+	char name[48];
+} __attribute__((packed));
+
+struct intel_perf_record_pmu_config {
+	uint32_t n_counters;
+	uint32_t pad;
+
+	struct intel_perf_record_pmu_counter counters[];
+} __attribute__((packed));
+
+/* Periodic read of the PMU counter group. */
+struct intel_perf_record_pmu_sample {
+	/* In the clock of intel_perf_record_timestamp_correlation */
+	uint64_t cpu_timestamp;
+
+	/* PERF_FORMAT_TOTAL_TIME_ENABLED of the group */
+	uint64_t time_enabled;
+
+	uint32_t n_values;
+	uint32_t pad;
+
+	uint64_t values[];
+} __attribute__((packed));
+
+enum intel_perf_request_event {
+	INTEL_PERF_REQUEST_ADD,
+	INTEL_PERF_REQUEST_SUBMIT,
+	INTEL_PERF_REQUEST_EXECUTE,
+	INTEL_PERF_REQUEST_IN,
+	INTEL_PERF_REQUEST_OUT,
+	INTEL_PERF_REQUEST_RETIRE,
+	INTEL_PERF_REQUEST_WAIT_BEGIN,
+	INTEL_PERF_REQUEST_WAIT_END,
+};
+
+/* An i915 request tracepoint hit. */
+struct intel_perf_record_request {
+	/* In the clock of intel_perf_record_timestamp_correlation */
+	uint64_t cpu_timestamp;
+
+	/* Fence context and seqno identifying the request */
+	uint64_t ctx;
+	uint32_t seqno;
+
+	/* enum intel_perf_request_event */
+	uint16_t event;
+
+	uint16_t engine_class;
+	uint16_t engine_instance;
+
+	/* ELSP port for INTEL_PERF_REQUEST_IN, completion for _OUT */
+	uint16_t arg;
+
+	uint32_t cpu;
+} __attribute__((packed));
+
 #ifdef __cplusplus
 };
 #endif
@@ -104,6 +104,29 @@ append_timestamp_correlation(struct intel_perf_data_reader *reader,
 	reader->correlations[reader->n_correlations++] = corr;
 }
 
+static struct intel_perf_event *
+append_event(struct intel_perf_data_reader *reader,
+	     enum intel_perf_event_type type, uint64_t cpu_ts)
+{
+	struct intel_perf_event *event;
+
+	if (reader->n_events >= reader->n_allocated_events) {
+		reader->n_allocated_events = MAX(100, 2 * reader->n_allocated_events);
+		reader->events =
+			(struct intel_perf_event *)
+			realloc((void *) reader->events,
+				reader->n_allocated_events *
+				sizeof(*reader->events));
+		assert(reader->events);
+	}
+
+	event = &reader->events[reader->n_events++];
+	event->cpu_ts = cpu_ts;
+	event->type = type;
+
+	return event;
+}
+
 static struct intel_perf_metric_set *
 find_metric_set(struct intel_perf *perf, const char *symbol_name)
 {
@@ -180,6 +203,37 @@ parse_data(struct intel_perf_data_reader *reader)
 						     (const struct intel_perf_record_timestamp_correlation *) (header + 1));
 			break;
 		}
+
+		case INTEL_PERF_RECORD_TYPE_PMU_CONFIG: {
+			const struct intel_perf_record_pmu_config *config =
+				(const struct intel_perf_record_pmu_config *) (header + 1);
+
+			assert(header->size == (sizeof(*header) + sizeof(*config) +
+						config->n_counters * sizeof(config->counters[0])));
+			reader->pmu_config = config;
+			break;
+		}
+
+		case INTEL_PERF_RECORD_TYPE_PMU_SAMPLE: {
+			const struct intel_perf_record_pmu_sample *sample =
+				(const struct intel_perf_record_pmu_sample *) (header + 1);
+
+			assert(header->size == (sizeof(*header) + sizeof(*sample) +
+						sample->n_values * sizeof(sample->values[0])));
+			append_event(reader, INTEL_PERF_EVENT_PMU_SAMPLE,
+				     sample->cpu_timestamp)->pmu_sample = sample;
+			break;
+		}
+
+		case INTEL_PERF_RECORD_TYPE_REQUEST: {
+			const struct intel_perf_record_request *request =
+				(const struct intel_perf_record_request *) (header + 1);
+
+			assert(header->size == (sizeof(*header) + sizeof(*request)));
+			append_event(reader, INTEL_PERF_EVENT_REQUEST,
+				     request->cpu_timestamp)->request = request;
+			break;
+		}
 		}
 
 		iter += header->size;
@@ -259,10 +313,18 @@ correlate_gpu_timestamp(struct intel_perf_data_reader *reader,
 		}
 	}
 
-	/* This is a bit harsh, but the recording tool should ensure we have
-	 * sampling points on either side of the bag of OA reports.
+	/* Past the last timestamp correlation, the recording stopped before
+	 * the next sampling point. Extrapolate from the last two.
 	 */
-	assert(0);
+	{
+		uint32_t n = reader->n_correlations;
+
+		assert(gpu_ts >= (reader->correlations[n - 1]->gpu_timestamp & mask));
+		return reader->correlations[n - 1]->cpu_timestamp +
+			(gpu_ts - (reader->correlations[n - 1]->gpu_timestamp & mask)) *
+			(reader->correlations[n - 1]->cpu_timestamp - reader->correlations[n - 2]->cpu_timestamp) /
+			(reader->correlations[n - 1]->gpu_timestamp - reader->correlations[n - 2]->gpu_timestamp);
+	}
 }
 
 static void
@@ -340,6 +402,50 @@ compute_correlation_chunks(struct intel_perf_data_reader *reader)
 	}
 }
 
+static int
+event_cmp(const void *_a, const void *_b)
+{
+	const struct intel_perf_event *a = _a, *b = _b;
+
+	if (a->cpu_ts != b->cpu_ts)
+		return a->cpu_ts < b->cpu_ts ? -1 : 1;
+
+	if (a->type != b->type)
+		return a->type < b->type ? -1 : 1;
+
+	/* Keep the file order for events of a kind at the same time. */
+	switch (a->type) {
+	case INTEL_PERF_EVENT_OA_REPORT:
+		return a->record < b->record ? -1 : a->record > b->record;
+	case INTEL_PERF_EVENT_PMU_SAMPLE:
+		return a->pmu_sample < b->pmu_sample ? -1 : a->pmu_sample > b->pmu_sample;
+	case INTEL_PERF_EVENT_REQUEST:
+		return a->request < b->request ? -1 : a->request > b->request;
+	}
+
+	return 0;
+}
+
+static void
+generate_merged_events(struct intel_perf_data_reader *reader)
+{
+	/* Correlating OA timestamps needs a slope. */
+	if (reader->n_correlations >= 2) {
+		for (uint32_t i = 0; i < reader->n_records; i++) {
+			const uint8_t *report = (const uint8_t *) (reader->records[i] + 1);
+			uint64_t cpu_ts =
+				correlate_gpu_timestamp(reader,
+							oa_report_timestamp(report));
+
+			append_event(reader, INTEL_PERF_EVENT_OA_REPORT,
+				     cpu_ts)->record = i;
+		}
+	}
+
+	qsort(reader->events, reader->n_events, sizeof(*reader->events),
+	      event_cmp);
+}
+
 bool
 intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
 			    int perf_file_fd)
@@ -368,6 +474,7 @@ intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
 
 	compute_correlation_chunks(reader);
 	generate_cpu_events(reader);
+	generate_merged_events(reader);
 
 	return true;
 }
@@ -379,5 +486,290 @@ intel_perf_data_reader_fini(struct intel_perf_data_reader *reader)
 	free(reader->records);
 	free(reader->timelines);
 	free(reader->correlations);
+	free(reader->events);
 	munmap((void *)reader->mmap_data, reader->mmap_size);
 }
+
+static inline uint64_t
+timestamp_to_ns(const struct intel_perf_data_reader *reader, uint64_t ts)
+{
+	uint64_t freq = reader->devinfo.timestamp_frequency;
+
+	/* Split to avoid overflowing on long recordings. */
+	return (ts / freq) * 1000000000ull + (ts % freq) * 1000000000ull / freq;
+}
+
+static inline uint32_t
+context_hash(uint32_t hw_id, uint32_t hash_size)
+{
+	/* Fibonacci hashing, hash_size is a power of 2. */
+	return (hw_id * 2654435761u) & (hash_size - 1);
+}
+
+static void
+context_stats_rehash(struct intel_perf_context_stats *stats)
+{
+	free(stats->hash);
+
+	stats->hash_size = MAX(64, stats->hash_size * 2);
+	stats->hash = (uint32_t *) calloc(stats->hash_size, sizeof(*stats->hash));
+	assert(stats->hash);
+
+	for (uint32_t i = 0; i < stats->n_contexts; i++) {
+		uint32_t h = context_hash(stats->contexts[i].hw_id, stats->hash_size);
+
+		while (stats->hash[h])
+			h = (h + 1) & (stats->hash_size - 1);
+		stats->hash[h] = i + 1;
+	}
+}
+
+static struct intel_perf_context_totals *
+context_stats_get(struct intel_perf_context_stats *stats, uint32_t hw_id)
+{
+	struct intel_perf_context_totals *ctx;
+	uint32_t h;
+
+	if (stats->hash_size) {
+		h = context_hash(hw_id, stats->hash_size);
+		while (stats->hash[h]) {
+			ctx = &stats->contexts[stats->hash[h] - 1];
+			if (ctx->hw_id == hw_id)
+				return ctx;
+			h = (h + 1) & (stats->hash_size - 1);
+		}
+	}
+
+	/* Keep the load factor under 1/2. */
+	if (2 * (stats->n_contexts + 1) > stats->hash_size)
+		context_stats_rehash(stats);
+
+	if (stats->n_contexts >= stats->n_allocated_contexts) {
+		stats->n_allocated_contexts = MAX(16, 2 * stats->n_allocated_contexts);
+		stats->contexts =
+			(struct intel_perf_context_totals *)
+			realloc((void *) stats->contexts,
+				stats->n_allocated_contexts *
+				sizeof(*stats->contexts));
+		assert(stats->contexts);
+	}
+
+	ctx = &stats->contexts[stats->n_contexts++];
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->hw_id = hw_id;
+
+	h = context_hash(hw_id, stats->hash_size);
+	while (stats->hash[h])
+		h = (h + 1) & (stats->hash_size - 1);
+	stats->hash[h] = stats->n_contexts;
+
+	return ctx;
+}
+
+static struct intel_perf_accumulator *
+context_bucket(struct intel_perf_context_totals *ctx, uint32_t bucket)
+{
+	if (bucket >= ctx->n_buckets) {
+		uint32_t n_buckets = MAX(bucket + 1, 2 * ctx->n_buckets);
+
+		ctx->buckets =
+			(struct intel_perf_accumulator *)
+			realloc((void *) ctx->buckets,
+				n_buckets * sizeof(*ctx->buckets));
+		assert(ctx->buckets);
+		memset(&ctx->buckets[ctx->n_buckets], 0,
+		       (n_buckets - ctx->n_buckets) * sizeof(*ctx->buckets));
+		ctx->n_buckets = n_buckets;
+	}
+
+	return &ctx->buckets[bucket];
+}
+
+static inline void
+accumulator_add(struct intel_perf_accumulator *dst,
+		const struct intel_perf_accumulator *src)
+{
+	for (uint32_t i = 0; i < ARRAY_SIZE(dst->deltas); i++)
+		dst->deltas[i] += src->deltas[i];
+}
+
+/* Accumulate the deltas of consecutive OA reports into per context totals,
+ * and optionally into time buckets of bucket_ns.
+ *
+ * The delta between two reports is attributed to the context of the first
+ * one: when the context changes, the second report is the one the OA unit
+ * emits at the switch, so the interval belongs to the outgoing context.
+ * Reports without a valid context id end up under hw_id 0xffffffff.
+ *
+ * Single pass over the reports, only the hash lookup on context changes.
+ */
+bool
+intel_perf_data_reader_context_stats(struct intel_perf_data_reader *reader,
+				     uint64_t bucket_ns,
+				     struct intel_perf_context_stats *stats)
+{
+	struct intel_perf_context_totals *ctx = NULL;
+	uint64_t elapsed = 0;
+	uint32_t last_hw_id = 0;
+	int gpu_time_offset;
+
+	memset(stats, 0, sizeof(*stats));
+	stats->bucket_ns = bucket_ns;
+
+	if (!reader->metric_set) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unknown metric set '%s'", reader->metric_set_name);
+		return false;
+	}
+
+	if (reader->n_records && reader->n_correlations >= 2) {
+		stats->cpu_ts_start =
+			correlate_gpu_timestamp(reader,
+						oa_report_timestamp((const uint8_t *) (reader->records[0] + 1)));
+	}
+
+	gpu_time_offset = reader->metric_set->gpu_time_offset;
+
+	for (uint32_t i = 1; i < reader->n_records; i++) {
+		const uint8_t *report = (const uint8_t *) (reader->records[i - 1] + 1);
+		uint32_t hw_id = oa_report_ctx_id(&reader->devinfo, report);
+		struct intel_perf_accumulator accu;
+
+		intel_perf_accumulate_reports(&accu, reader->metric_set->perf_oa_format,
+					      reader->records[i - 1], reader->records[i]);
+
+		/* Consecutive reports mostly belong to the same context. */
+		if (!ctx || hw_id != last_hw_id) {
+			ctx = context_stats_get(stats, hw_id);
+			last_hw_id = hw_id;
+		}
+
+		accumulator_add(&ctx->totals, &accu);
+		ctx->n_deltas++;
+
+		if (bucket_ns) {
+			uint32_t bucket = timestamp_to_ns(reader, elapsed) / bucket_ns;
+
+			accumulator_add(context_bucket(ctx, bucket), &accu);
+			stats->n_buckets = MAX(stats->n_buckets, bucket + 1);
+		}
+
+		elapsed += accu.deltas[gpu_time_offset];
+	}
+
+	for (uint32_t i = 0; i < stats->n_contexts; i++) {
+		stats->contexts[i].gpu_time_ns =
+			timestamp_to_ns(reader, stats->contexts[i].totals.deltas[gpu_time_offset]);
+	}
+	stats->gpu_time_ns = timestamp_to_ns(reader, elapsed);
+
+	return true;
+}
+
+const struct intel_perf_context_totals *
+intel_perf_context_stats_find(const struct intel_perf_context_stats *stats,
+			      uint32_t hw_id)
+{
+	uint32_t h;
+
+	if (!stats->hash_size)
+		return NULL;
+
+	h = context_hash(hw_id, stats->hash_size);
+	while (stats->hash[h]) {
+		const struct intel_perf_context_totals *ctx =
+			&stats->contexts[stats->hash[h] - 1];
+
+		if (ctx->hw_id == hw_id)
+			return ctx;
+		h = (h + 1) & (stats->hash_size - 1);
+	}
+
+	return NULL;
+}
+
+void
+intel_perf_context_stats_fini(struct intel_perf_context_stats *stats)
+{
+	for (uint32_t i = 0; i < stats->n_contexts; i++)
+		free(stats->contexts[i].buckets);
+	free(stats->contexts);
+	free(stats->hash);
+	memset(stats, 0, sizeof(*stats));
+}
+
+/* Identifies a recording, to check that a cached series was computed
+ * from it. FNV-1a over the size and the last records, which change with
+ * any recording of the same metric set.
+ */
+uint64_t
+intel_perf_data_reader_source_id(const struct intel_perf_data_reader *reader)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	size_t tail = reader->mmap_size > 4096 ? reader->mmap_size - 4096 : 0;
+
+	for (uint32_t i = 0; i < sizeof(reader->mmap_size); i++) {
+		hash ^= (reader->mmap_size >> (8 * i)) & 0xff;
+		hash *= 0x100000001b3ull;
+	}
+
+	for (size_t i = tail; i < reader->mmap_size; i++) {
+		hash ^= reader->mmap_data[i];
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+/* Timeline of a counter, one sample per pair of consecutive OA reports,
+ * timestamped with the GPU time in ns from the first report at the end of
+ * the pair. The pyramid is built with the default resolution so that the
+ * series is ready to be queried or saved.
+ */
+bool
+intel_perf_data_reader_counter_series(struct intel_perf_data_reader *reader,
+				      const struct intel_perf_logical_counter *counter,
+				      struct intel_perf_series *series)
+{
+	uint64_t elapsed = 0;
+	int gpu_time_offset;
+
+	intel_perf_series_init(series);
+
+	if (!reader->metric_set) {
+		snprintf(reader->error_msg, sizeof(reader->error_msg),
+			 "Unknown metric set '%s'", reader->metric_set_name);
+		return false;
+	}
+
+	gpu_time_offset = reader->metric_set->gpu_time_offset;
+
+	for (uint32_t i = 1; i < reader->n_records; i++) {
+		struct intel_perf_accumulator accu;
+		double value;
+
+		intel_perf_accumulate_reports(&accu, reader->metric_set->perf_oa_format,
+					      reader->records[i - 1], reader->records[i]);
+		elapsed += accu.deltas[gpu_time_offset];
+
+		switch (counter->storage) {
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
+			value = counter->read_uint64(reader->perf, reader->metric_set,
+						     accu.deltas);
+			break;
+		default:
+			value = counter->read_float(reader->perf, reader->metric_set,
+						    accu.deltas);
+			break;
+		}
+
+		intel_perf_series_add(series, timestamp_to_ns(reader, elapsed), value);
+	}
+
+	series->source_id = intel_perf_data_reader_source_id(reader);
+	intel_perf_series_build(series, 0, 16);
+
+	return true;
+}
@@ -34,6 +34,7 @@ extern "C" {
 
 #include "perf.h"
 #include "perf_data.h"
+#include "perf_series.h"
 
 struct intel_perf_timeline_item {
 	uint64_t ts_start;
@@ -53,6 +54,26 @@ struct intel_perf_timeline_item {
 	void *user_data;
 };
 
+enum intel_perf_event_type {
+	INTEL_PERF_EVENT_OA_REPORT,
+	INTEL_PERF_EVENT_PMU_SAMPLE,
+	INTEL_PERF_EVENT_REQUEST,
+};
+
+/* An entry of the recording, placed on the CPU timeline. */
+struct intel_perf_event {
+	uint64_t cpu_ts;
+
+	enum intel_perf_event_type type;
+
+	union {
+		/* Offset into intel_perf_data_reader.records */
+		uint32_t record;
+		const struct intel_perf_record_pmu_sample *pmu_sample;
+		const struct intel_perf_record_request *request;
+	};
+};
+
 struct intel_perf_data_reader {
 	/* Array of pointers into the mmapped i915 perf file. */
 	const struct drm_i915_perf_record_header **records;
@@ -76,6 +97,17 @@ struct intel_perf_data_reader {
 	} correlation_chunks[4];
 	uint32_t n_correlation_chunks;
 
+	/* OA reports, PMU samples and request tracepoints merged in CPU
+	 * timestamp order. OA reports are only included when the recording
+	 * has enough correlation points to place them.
+	 */
+	struct intel_perf_event *events;
+	uint32_t n_events;
+	uint32_t n_allocated_events;
+
+	/* Counters of the PMU samples, NULL if none were recorded. */
+	const struct intel_perf_record_pmu_config *pmu_config;
+
 	const char *metric_set_uuid;
 	const char *metric_set_name;
 
@@ -94,10 +126,61 @@ struct intel_perf_data_reader {
 	size_t mmap_size;
 };
 
+/* Counter deltas attributed to one context (hw_id) of a recording. */
+struct intel_perf_context_totals {
+	uint32_t hw_id;
+
+	/* Number of report pairs accumulated. */
+	uint32_t n_deltas;
+
+	/* Time the context was running on the GPU. */
+	uint64_t gpu_time_ns;
+
+	struct intel_perf_accumulator totals;
+
+	/* Per time bucket deltas, bucket i covers
+	 * [i * bucket_ns, (i + 1) * bucket_ns) from the first report.
+	 */
+	struct intel_perf_accumulator *buckets;
+	uint32_t n_buckets;
+};
+
+struct intel_perf_context_stats {
+	struct intel_perf_context_totals *contexts;
+	uint32_t n_contexts;
+	uint32_t n_allocated_contexts;
+
+	/* Open addressed hw_id -> contexts[] index + 1 */
+	uint32_t *hash;
+	uint32_t hash_size;
+
+	/* 0 when no time series was requested */
+	uint64_t bucket_ns;
+	uint32_t n_buckets;
+
+	/* CPU time of the first report, 0 without correlation points */
+	uint64_t cpu_ts_start;
+
+	uint64_t gpu_time_ns;
+};
+
 bool intel_perf_data_reader_init(struct intel_perf_data_reader *reader,
 				 int perf_file_fd);
 void intel_perf_data_reader_fini(struct intel_perf_data_reader *reader);
 
+bool intel_perf_data_reader_context_stats(struct intel_perf_data_reader *reader,
+					  uint64_t bucket_ns,
+					  struct intel_perf_context_stats *stats);
+const struct intel_perf_context_totals *
+intel_perf_context_stats_find(const struct intel_perf_context_stats *stats,
+			      uint32_t hw_id);
+void intel_perf_context_stats_fini(struct intel_perf_context_stats *stats);
+
+bool intel_perf_data_reader_counter_series(struct intel_perf_data_reader *reader,
+					   const struct intel_perf_logical_counter *counter,
+					   struct intel_perf_series *series);
+uint64_t intel_perf_data_reader_source_id(const struct intel_perf_data_reader *reader);
+
 #ifdef __cplusplus
 };
 #endif
@@ -0,0 +1,406 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "perf_series.h"
+
+#define MAX(a,b) ((a) > (b) ? (a) : (b))
+#define MIN(a,b) ((a) > (b) ? (b) : (a))
+
+#define SERIES_MAGIC "i915srs"
+#define SERIES_VERSION 1
+
+/* Layout of a cache file, followed by the sample timestamps, the sample
+ * values and the buckets of each level, so that it can be mapped and
+ * queried in place.
+ */
+struct series_file_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t fanout;
+	uint64_t source_id;
+	uint64_t start_ns;
+	uint64_t n_samples;
+	uint64_t n_levels;
+	uint64_t bucket_ns[INTEL_PERF_SERIES_MAX_LEVELS];
+	uint64_t n_buckets[INTEL_PERF_SERIES_MAX_LEVELS];
+};
+
+void
+intel_perf_series_init(struct intel_perf_series *series)
+{
+	memset(series, 0, sizeof(*series));
+}
+
+void
+intel_perf_series_fini(struct intel_perf_series *series)
+{
+	if (series->mmap_data) {
+		munmap((void *) series->mmap_data, series->mmap_size);
+	} else {
+		free(series->ts);
+		free(series->values);
+		for (uint32_t i = 0; i < series->n_levels; i++)
+			free(series->levels[i].buckets);
+	}
+
+	memset(series, 0, sizeof(*series));
+}
+
+void
+intel_perf_series_add(struct intel_perf_series *series,
+		      uint64_t ts, double value)
+{
+	assert(!series->mmap_data);
+	assert(!series->n_samples || ts >= series->ts[series->n_samples - 1]);
+
+	if (series->n_samples >= series->n_allocated_samples) {
+		series->n_allocated_samples =
+			MAX(1024, 2 * series->n_allocated_samples);
+		series->ts = (uint64_t *)
+			realloc((void *) series->ts,
+				series->n_allocated_samples * sizeof(*series->ts));
+		series->values = (double *)
+			realloc((void *) series->values,
+				series->n_allocated_samples * sizeof(*series->values));
+		assert(series->ts && series->values);
+	}
+
+	series->ts[series->n_samples] = ts;
+	series->values[series->n_samples] = value;
+	series->n_samples++;
+}
+
+static inline void
+bucket_add(struct intel_perf_series_bucket *dst,
+	   const struct intel_perf_series_bucket *src)
+{
+	if (!src->n)
+		return;
+
+	if (!dst->n) {
+		*dst = *src;
+		return;
+	}
+
+	dst->n += src->n;
+	dst->min = MIN(dst->min, src->min);
+	dst->max = MAX(dst->max, src->max);
+	dst->sum += src->sum;
+	/* Sources are always merged in time order. */
+	dst->last = src->last;
+}
+
+static inline void
+bucket_add_sample(struct intel_perf_series_bucket *dst, double value)
+{
+	const struct intel_perf_series_bucket sample = {
+		.n = 1, .min = value, .max = value, .sum = value, .last = value,
+	};
+
+	bucket_add(dst, &sample);
+}
+
+/* Build the pyramid over the samples added so far. With a base_ns of 0, the
+ * bottom level gets about one bucket per fanout samples. Building is a
+ * single pass over the samples and then over each level in turn.
+ */
+void
+intel_perf_series_build(struct intel_perf_series *series,
+			uint64_t base_ns, uint32_t fanout)
+{
+	struct intel_perf_series_level *level;
+	uint64_t span;
+
+	assert(!series->mmap_data);
+	assert(fanout >= 2);
+
+	for (uint32_t i = 0; i < series->n_levels; i++)
+		free(series->levels[i].buckets);
+	series->n_levels = 0;
+	series->fanout = fanout;
+
+	if (!series->n_samples)
+		return;
+
+	series->start_ns = series->ts[0];
+	span = series->ts[series->n_samples - 1] - series->start_ns;
+	if (!base_ns)
+		base_ns = MAX(1, span / series->n_samples * fanout);
+
+	level = &series->levels[series->n_levels++];
+	level->bucket_ns = base_ns;
+	level->n_buckets = span / base_ns + 1;
+	level->buckets = (struct intel_perf_series_bucket *)
+		calloc(level->n_buckets, sizeof(*level->buckets));
+	assert(level->buckets);
+
+	for (uint64_t i = 0; i < series->n_samples; i++) {
+		uint64_t b = (series->ts[i] - series->start_ns) / base_ns;
+
+		bucket_add_sample(&level->buckets[b], series->values[i]);
+	}
+
+	while (level->n_buckets > 1 &&
+	       series->n_levels < INTEL_PERF_SERIES_MAX_LEVELS) {
+		struct intel_perf_series_level *below = level;
+
+		level = &series->levels[series->n_levels++];
+		level->bucket_ns = below->bucket_ns * fanout;
+		level->n_buckets = (below->n_buckets + fanout - 1) / fanout;
+		level->buckets = (struct intel_perf_series_bucket *)
+			calloc(level->n_buckets, sizeof(*level->buckets));
+		assert(level->buckets);
+
+		for (uint64_t i = 0; i < below->n_buckets; i++)
+			bucket_add(&level->buckets[i / fanout], &below->buckets[i]);
+	}
+}
+
+static uint64_t
+first_sample_at(const struct intel_perf_series *series, uint64_t ts)
+{
+	uint64_t lo = 0, hi = series->n_samples;
+
+	while (lo < hi) {
+		uint64_t mid = lo + (hi - lo) / 2;
+
+		if (series->ts[mid] < ts)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+/* Summary of the samples in [start_ns, end_ns) using the buckets of
+ * levels[level] and below: whole buckets in the middle of the range, and
+ * the finer levels down to the raw samples for the partial ones at the
+ * edges, so that at most about 2 * fanout items are visited per level.
+ */
+static void
+series_range(const struct intel_perf_series *series, int level,
+	     uint64_t start_ns, uint64_t end_ns,
+	     struct intel_perf_series_bucket *dst)
+{
+	const struct intel_perf_series_level *l;
+	uint64_t first, last;
+
+	if (level < 0) {
+		for (uint64_t i = first_sample_at(series, start_ns);
+		     i < series->n_samples && series->ts[i] < end_ns; i++)
+			bucket_add_sample(dst, series->values[i]);
+		return;
+	}
+
+	l = &series->levels[level];
+	start_ns = MAX(start_ns, series->start_ns);
+	if (end_ns <= start_ns)
+		return;
+
+	/* Buckets entirely within the range */
+	first = (start_ns - series->start_ns + l->bucket_ns - 1) / l->bucket_ns;
+	last = MIN((end_ns - series->start_ns) / l->bucket_ns, l->n_buckets);
+	if (first >= last) {
+		series_range(series, level - 1, start_ns, end_ns, dst);
+		return;
+	}
+
+	series_range(series, level - 1, start_ns,
+		     series->start_ns + first * l->bucket_ns, dst);
+	for (uint64_t i = first; i < last; i++)
+		bucket_add(dst, &l->buckets[i]);
+	series_range(series, level - 1,
+		     series->start_ns + last * l->bucket_ns, end_ns, dst);
+}
+
+/* Summarize [start_ns, end_ns) into n_buckets buckets of equal width.
+ *
+ * Each output bucket is computed from the coarsest level whose buckets fit
+ * into it, so the cost depends on the number of output buckets and not on
+ * the length of the range, from hours down to single samples.
+ *
+ * Returns the number of output buckets.
+ */
+uint32_t
+intel_perf_series_query(const struct intel_perf_series *series,
+			uint64_t start_ns, uint64_t end_ns,
+			uint32_t n_buckets,
+			struct intel_perf_series_bucket *buckets)
+{
+	uint64_t width;
+	int level = -1;
+
+	if (!n_buckets || end_ns <= start_ns)
+		return 0;
+
+	memset(buckets, 0, n_buckets * sizeof(*buckets));
+	width = MAX(1, (end_ns - start_ns + n_buckets - 1) / n_buckets);
+
+	while (level + 1 < (int) series->n_levels &&
+	       series->levels[level + 1].bucket_ns <= width)
+		level++;
+
+	for (uint32_t i = 0; i < n_buckets; i++) {
+		uint64_t bucket_start = start_ns + i * width;
+
+		if (bucket_start >= end_ns)
+			break;
+
+		series_range(series, level, bucket_start,
+			     MIN(bucket_start + width, end_ns), &buckets[i]);
+	}
+
+	return n_buckets;
+}
+
+static bool
+write_all(int fd, const void *data, size_t size)
+{
+	const uint8_t *ptr = (const uint8_t *) data;
+
+	while (size) {
+		ssize_t ret = write(fd, ptr, size);
+
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+
+		ptr += ret;
+		size -= ret;
+	}
+
+	return true;
+}
+
+/* Write the samples and the pyramid to fd, to be mapped back with
+ * intel_perf_series_load(). The file is in native byte order.
+ */
+bool
+intel_perf_series_save(const struct intel_perf_series *series, int fd)
+{
+	struct series_file_header header;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SERIES_MAGIC, sizeof(header.magic));
+	header.version = SERIES_VERSION;
+	header.fanout = series->fanout;
+	header.source_id = series->source_id;
+	header.start_ns = series->start_ns;
+	header.n_samples = series->n_samples;
+	header.n_levels = series->n_levels;
+	for (uint32_t i = 0; i < series->n_levels; i++) {
+		header.bucket_ns[i] = series->levels[i].bucket_ns;
+		header.n_buckets[i] = series->levels[i].n_buckets;
+	}
+
+	if (!write_all(fd, &header, sizeof(header)) ||
+	    !write_all(fd, series->ts, series->n_samples * sizeof(*series->ts)) ||
+	    !write_all(fd, series->values,
+		       series->n_samples * sizeof(*series->values)))
+		return false;
+
+	for (uint32_t i = 0; i < series->n_levels; i++) {
+		const struct intel_perf_series_level *level = &series->levels[i];
+
+		if (!write_all(fd, level->buckets,
+			       level->n_buckets * sizeof(*level->buckets)))
+			return false;
+	}
+
+	return true;
+}
+
+/* Map a series written by intel_perf_series_save(). Only the pages
+ * covering the queried ranges are ever read in.
+ */
+bool
+intel_perf_series_load(struct intel_perf_series *series, int fd)
+{
+	const struct series_file_header *header;
+	const uint8_t *data;
+	struct stat st;
+	uint64_t offset;
+
+	intel_perf_series_init(series);
+
+	if (fstat(fd, &st) || st.st_size < (off_t) sizeof(*header))
+		return false;
+
+	data = (const uint8_t *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+				      fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+	series->mmap_data = data;
+	series->mmap_size = st.st_size;
+
+	header = (const struct series_file_header *) data;
+	if (memcmp(header->magic, SERIES_MAGIC, sizeof(header->magic)) ||
+	    header->version != SERIES_VERSION ||
+	    header->n_levels > INTEL_PERF_SERIES_MAX_LEVELS ||
+	    header->n_samples > st.st_size)
+		goto err;
+
+	offset = sizeof(*header);
+	series->ts = (uint64_t *) (data + offset);
+	offset += header->n_samples * sizeof(*series->ts);
+	series->values = (double *) (data + offset);
+	offset += header->n_samples * sizeof(*series->values);
+
+	for (uint32_t i = 0; i < header->n_levels; i++) {
+		struct intel_perf_series_level *level = &series->levels[i];
+
+		if (header->n_buckets[i] > st.st_size || !header->bucket_ns[i])
+			goto err;
+
+		level->bucket_ns = header->bucket_ns[i];
+		level->n_buckets = header->n_buckets[i];
+		level->buckets = (struct intel_perf_series_bucket *) (data + offset);
+		offset += level->n_buckets * sizeof(*level->buckets);
+	}
+
+	if (offset != (uint64_t) st.st_size)
+		goto err;
+
+	series->n_samples = series->n_allocated_samples = header->n_samples;
+	series->fanout = header->fanout;
+	series->n_levels = header->n_levels;
+	series->start_ns = header->start_ns;
+	series->source_id = header->source_id;
+
+	return true;
+
+err:
+	intel_perf_series_fini(series);
+	return false;
+}
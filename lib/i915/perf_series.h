@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PERF_SERIES_H
+#define PERF_SERIES_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Downsampling of a counter timeline for display at a fixed resolution. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Summary of the samples falling into a time interval. Keeping the min and
+ * max rather than just the mean preserves spikes however coarse the
+ * resolution.
+ */
+struct intel_perf_series_bucket {
+	/* Number of samples, 0 for an empty bucket. */
+	uint64_t n;
+
+	double min;
+	double max;
+	double sum; /* mean is sum / n */
+	double last;
+};
+
+struct intel_perf_series_level {
+	uint64_t bucket_ns;
+	uint64_t n_buckets;
+	struct intel_perf_series_bucket *buckets;
+};
+
+#define INTEL_PERF_SERIES_MAX_LEVELS 32
+
+struct intel_perf_series {
+	/* Raw samples, timestamps in ns, in increasing order. */
+	uint64_t *ts;
+	double *values;
+	uint64_t n_samples;
+	uint64_t n_allocated_samples;
+
+	/* Pyramid of buckets aligned on start_ns. Level 0 buckets are
+	 * base_ns wide, each level above merges fanout buckets of the one
+	 * below, up to a single bucket.
+	 */
+	uint64_t start_ns;
+	uint32_t fanout;
+	uint32_t n_levels;
+	struct intel_perf_series_level levels[INTEL_PERF_SERIES_MAX_LEVELS];
+
+	/* Identifies the data the series was computed from, so that a
+	 * cached copy can be checked against it.
+	 */
+	uint64_t source_id;
+
+	/* Set when loaded from a cache file, read only. */
+	const void *mmap_data;
+	size_t mmap_size;
+};
+
+void intel_perf_series_init(struct intel_perf_series *series);
+void intel_perf_series_fini(struct intel_perf_series *series);
+
+void intel_perf_series_add(struct intel_perf_series *series,
+			   uint64_t ts, double value);
+void intel_perf_series_build(struct intel_perf_series *series,
+			     uint64_t base_ns, uint32_t fanout);
+
+uint32_t intel_perf_series_query(const struct intel_perf_series *series,
+				 uint64_t start_ns, uint64_t end_ns,
+				 uint32_t n_buckets,
+				 struct intel_perf_series_bucket *buckets);
+
+bool intel_perf_series_save(const struct intel_perf_series *series, int fd);
+bool intel_perf_series_load(struct intel_perf_series *series, int fd);
+
+#ifdef __cplusplus
+};
+#endif
+
+#endif /* PERF_SERIES_H */
@@ -29,6 +29,8 @@
 #ifdef HAVE_LIBGEN_H
 #include <libgen.h>
 #endif
+#include <errno.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <fcntl.h>
 #include <sys/stat.h>
@@ -1527,3 +1529,82 @@ uint64_t vfs_file_max(void)
 	}
 	return max;
 }
+
+static void make_parents(char *path)
+{
+	char *s;
+
+	for (s = path + 1; (s = strchr(s, '/')); s++) {
+		*s = '\0';
+		igt_assert_f(mkdir(path, 0755) == 0 || errno == EEXIST,
+			     "mkdir %s: %m\n", path);
+		*s = '/';
+	}
+}
+
+/**
+ * igt_make_dirs:
+ * @fmt: printf format of the path
+ *
+ * Creates a directory along with its missing parents, like mkdir -p. Meant
+ * for building fake sysfs and procfs trees in tests.
+ */
+void igt_make_dirs(const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(path, sizeof(path), fmt, ap);
+	va_end(ap);
+
+	make_parents(path);
+	igt_assert_f(mkdir(path, 0755) == 0 || errno == EEXIST,
+		     "mkdir %s: %m\n", path);
+}
+
+/**
+ * igt_write_file:
+ * @content: nul terminated contents of the file
+ * @fmt: printf format of the path
+ *
+ * Creates or truncates a file, and its missing parent directories, and
+ * writes @content to it.
+ */
+void igt_write_file(const char *content, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	size_t len = strlen(content);
+	va_list ap;
+	int fd;
+
+	va_start(ap, fmt);
+	vsnprintf(path, sizeof(path), fmt, ap);
+	va_end(ap);
+
+	make_parents(path);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	igt_assert_f(fd >= 0, "open %s: %m\n", path);
+	igt_assert_eq(write(fd, content, len), len);
+	close(fd);
+}
+
+/**
+ * igt_make_symlink:
+ * @target: contents of the link
+ * @fmt: printf format of the path of the link
+ *
+ * Creates a symbolic link, and its missing parent directories.
+ */
+void igt_make_symlink(const char *target, const char *fmt, ...)
+{
+	char path[PATH_MAX];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(path, sizeof(path), fmt, ap);
+	va_end(ap);
+
+	make_parents(path);
+	igt_assert_f(symlink(target, path) == 0, "symlink %s: %m\n", path);
+}
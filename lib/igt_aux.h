@@ -306,4 +306,11 @@ void igt_lsof(const char *dpath);
 
 uint64_t vfs_file_max(void);
 
+__attribute__((format(printf, 1, 2)))
+void igt_make_dirs(const char *fmt, ...);
+__attribute__((format(printf, 2, 3)))
+void igt_write_file(const char *content, const char *fmt, ...);
+__attribute__((format(printf, 2, 3)))
+void igt_make_symlink(const char *target, const char *fmt, ...);
+
 #endif /* IGT_AUX_H */
@@ -0,0 +1,779 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "igt_bench_history.h"
+#include "igt_core.h"
+#include "igt_rand.h"
+
+/**
+ * SECTION:igt_bench_history
+ * @short_description: Regression detection over benchmark results
+ * @title: Benchmark history
+ * @include: igt_bench_history.h
+ *
+ * Keeps the samples of repeated benchmark runs per commit in a local file,
+ * and looks for the commits where the distribution of the results changed.
+ *
+ * Change points are found by E-divisive: binary segmentation on the energy
+ * distance between the samples before and after each commit boundary, which
+ * compares whole distributions so a benchmark flipping between two modes is
+ * not mistaken for a change as long as it keeps flipping in the same
+ * proportion. Each change point must pass a permutation test, permuting
+ * whole commits since the runs on one commit share their conditions.
+ *
+ * The size of each change is the relative change of the mean of the commit
+ * means, with a confidence interval from a two level bootstrap resampling the
+ * commits and then the samples of each. The range of commits to bisect comes
+ * from bootstrapping the location of the change point.
+ *
+ * Everything is computed offline from the file, with a seeded generator so
+ * that the results are reproducible.
+ */
+
+/*
+ * The file is the magic followed by one record per call to
+ * igt_bench_history_append(), in host byte order.
+ */
+#define HISTORY_MAGIC "IGTBHST1"
+
+struct history_record {
+	uint16_t name_len;
+	uint16_t commit_len;
+	uint32_t n_samples;
+	/* name, commit, then n_samples floats */
+};
+
+static void *grow(void *ptr, unsigned int *capacity, unsigned int need,
+		  size_t size)
+{
+	if (need <= *capacity)
+		return ptr;
+
+	*capacity = need < 8 ? 8 : need * 2;
+	ptr = realloc(ptr, *capacity * size);
+	igt_assert(ptr);
+
+	return ptr;
+}
+
+/**
+ * igt_bench_history_init:
+ * @history: an empty history
+ */
+void igt_bench_history_init(struct igt_bench_history *history)
+{
+	memset(history, 0, sizeof(*history));
+}
+
+/**
+ * igt_bench_history_fini:
+ * @history: a history
+ *
+ * Frees everything in @history.
+ */
+void igt_bench_history_fini(struct igt_bench_history *history)
+{
+	for (unsigned int i = 0; i < history->n_series; i++) {
+		struct igt_bench_series *s = &history->series[i];
+
+		for (unsigned int j = 0; j < s->n_commits; j++) {
+			free(s->commits[j].id);
+			free(s->commits[j].samples);
+		}
+		free(s->commits);
+		free(s->name);
+	}
+	free(history->series);
+	memset(history, 0, sizeof(*history));
+}
+
+/**
+ * igt_bench_history_find:
+ * @history: a history
+ * @name: a benchmark
+ *
+ * Returns: the samples of @name, or NULL.
+ */
+struct igt_bench_series *
+igt_bench_history_find(const struct igt_bench_history *history,
+		       const char *name)
+{
+	for (unsigned int i = 0; i < history->n_series; i++) {
+		if (!strcmp(history->series[i].name, name))
+			return &history->series[i];
+	}
+
+	return NULL;
+}
+
+static struct igt_bench_commit *
+find_commit(struct igt_bench_series *s, const char *id)
+{
+	/* Results usually come in commit order, start from the last one. */
+	for (unsigned int i = s->n_commits; i--; ) {
+		if (!strcmp(s->commits[i].id, id))
+			return &s->commits[i];
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_bench_history_add:
+ * @history: a history
+ * @name: the benchmark
+ * @commit: the commit it ran on
+ * @samples: the results
+ * @n_samples: number of results
+ *
+ * Adds samples of @name on @commit to @history in memory. The samples of
+ * repeated runs on the same commit are merged.
+ */
+void igt_bench_history_add(struct igt_bench_history *history,
+			   const char *name, const char *commit,
+			   const double *samples, unsigned int n_samples)
+{
+	struct igt_bench_series *s;
+	struct igt_bench_commit *c;
+
+	if (!n_samples)
+		return;
+
+	s = igt_bench_history_find(history, name);
+	if (!s) {
+		history->series = grow(history->series, &history->capacity,
+				       history->n_series + 1,
+				       sizeof(*history->series));
+		s = &history->series[history->n_series++];
+		memset(s, 0, sizeof(*s));
+		s->name = strdup(name);
+		igt_assert(s->name);
+	}
+
+	c = find_commit(s, commit);
+	if (!c) {
+		s->commits = grow(s->commits, &s->capacity, s->n_commits + 1,
+				  sizeof(*s->commits));
+		c = &s->commits[s->n_commits++];
+		memset(c, 0, sizeof(*c));
+		c->id = strdup(commit);
+		igt_assert(c->id);
+	}
+
+	c->samples = grow(c->samples, &c->capacity, c->n_samples + n_samples,
+			  sizeof(*c->samples));
+	memcpy(c->samples + c->n_samples, samples,
+	       n_samples * sizeof(*samples));
+	c->n_samples += n_samples;
+}
+
+/**
+ * igt_bench_history_load:
+ * @history: a history
+ * @path: the history file
+ *
+ * Adds the samples stored in @path to @history. A record cut short at the
+ * end of the file, by a run interrupted while appending, is ignored.
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_bench_history_load(struct igt_bench_history *history,
+			   const char *path)
+{
+	const size_t magic_len = sizeof(HISTORY_MAGIC) - 1;
+	struct history_record rec;
+	size_t pos, size;
+	struct stat st;
+	double *samples = NULL;
+	unsigned int capacity = 0;
+	char *buf;
+	int fd, ret = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st)) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	size = st.st_size;
+	buf = malloc(size + 1);
+	igt_assert(buf);
+	for (pos = 0; pos < size; ) {
+		ssize_t len = read(fd, buf + pos, size - pos);
+
+		if (len <= 0) {
+			size = pos;
+			break;
+		}
+		pos += len;
+	}
+	close(fd);
+
+	if (size < magic_len || memcmp(buf, HISTORY_MAGIC, magic_len)) {
+		free(buf);
+		return -EINVAL;
+	}
+
+	for (pos = magic_len; size - pos >= sizeof(rec); ) {
+		const float *values;
+		char *name, *commit;
+
+		memcpy(&rec, buf + pos, sizeof(rec));
+		if (size - pos - sizeof(rec) <
+		    rec.name_len + 1 + rec.commit_len + 1 +
+		    (size_t)rec.n_samples * sizeof(float))
+			break;
+		pos += sizeof(rec);
+
+		name = buf + pos;
+		pos += rec.name_len + 1;
+		commit = buf + pos;
+		pos += rec.commit_len + 1;
+		if (name[rec.name_len] || commit[rec.commit_len]) {
+			ret = -EINVAL;
+			break;
+		}
+
+		values = (const float *)(buf + pos);
+		pos += rec.n_samples * sizeof(float);
+
+		samples = grow(samples, &capacity, rec.n_samples,
+			       sizeof(*samples));
+		for (unsigned int i = 0; i < rec.n_samples; i++) {
+			float v;
+
+			memcpy(&v, &values[i], sizeof(v));
+			samples[i] = v;
+		}
+
+		igt_bench_history_add(history, name, commit,
+				      samples, rec.n_samples);
+	}
+
+	free(samples);
+	free(buf);
+	return ret;
+}
+
+/*
+ * Writes the magic to a temporary file and links it into place, so a
+ * concurrent appender never sees the file without it, and a failed write
+ * leaves nothing behind. Losing the race to another creator is fine.
+ */
+static int history_create(const char *path)
+{
+	char *tmp;
+	int fd, ret = 0;
+
+	if (asprintf(&tmp, "%s.XXXXXX", path) < 0)
+		return -ENOMEM;
+
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		ret = -errno;
+		free(tmp);
+		return ret;
+	}
+
+	if (fchmod(fd, 0644) ||
+	    write(fd, HISTORY_MAGIC, sizeof(HISTORY_MAGIC) - 1) !=
+	    sizeof(HISTORY_MAGIC) - 1)
+		ret = -EIO;
+	if (close(fd) && !ret)
+		ret = -EIO;
+
+	if (!ret && link(tmp, path) && errno != EEXIST)
+		ret = -errno;
+
+	unlink(tmp);
+	free(tmp);
+	return ret;
+}
+
+/**
+ * igt_bench_history_append:
+ * @path: the history file
+ * @name: the benchmark
+ * @commit: the commit it ran on
+ * @samples: the results
+ * @n_samples: number of results
+ *
+ * Appends the results of a run to @path, creating it if needed. The samples
+ * are stored as floats, the record is written at once so that concurrent
+ * runs can share the file.
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_bench_history_append(const char *path, const char *name,
+			     const char *commit,
+			     const double *samples, unsigned int n_samples)
+{
+	struct history_record rec = {
+		.name_len = strlen(name),
+		.commit_len = strlen(commit),
+		.n_samples = n_samples,
+	};
+	size_t size, pos;
+	char *buf;
+	int fd, ret = 0;
+
+	if (strlen(name) > UINT16_MAX || strlen(commit) > UINT16_MAX)
+		return -EINVAL;
+
+	fd = open(path, O_WRONLY | O_APPEND);
+	if (fd < 0 && errno == ENOENT) {
+		ret = history_create(path);
+		if (ret)
+			return ret;
+
+		fd = open(path, O_WRONLY | O_APPEND);
+	}
+	if (fd < 0)
+		return -errno;
+
+	size = sizeof(rec) + rec.name_len + 1 + rec.commit_len + 1 +
+	       n_samples * sizeof(float);
+	buf = malloc(size);
+	igt_assert(buf);
+
+	memcpy(buf, &rec, sizeof(rec));
+	pos = sizeof(rec);
+	memcpy(buf + pos, name, rec.name_len + 1);
+	pos += rec.name_len + 1;
+	memcpy(buf + pos, commit, rec.commit_len + 1);
+	pos += rec.commit_len + 1;
+	for (unsigned int i = 0; i < n_samples; i++) {
+		float v = samples[i];
+
+		memcpy(buf + pos, &v, sizeof(v));
+		pos += sizeof(v);
+	}
+
+	if (write(fd, buf, size) != size)
+		ret = -EIO;
+	free(buf);
+	close(fd);
+	return ret;
+}
+
+/**
+ * igt_bench_analysis_init:
+ * @opts: analysis parameters
+ *
+ * Sets @opts to the defaults: higher values are better, 5% significance,
+ * regressions of at least 1% with two commits at least on either side, 199
+ * permutations and 1000 bootstrap resamples.
+ */
+void igt_bench_analysis_init(struct igt_bench_analysis *opts)
+{
+	memset(opts, 0, sizeof(*opts));
+	opts->alpha = 0.05;
+	opts->min_change = 0.01;
+	opts->min_commits = 2;
+	opts->permutations = 199;
+	opts->resamples = 1000;
+	opts->seed = 0x243f6a8885a308d3ull;
+}
+
+/* The samples of a run of commits laid out back to back */
+struct flat {
+	unsigned int n_commits;
+	unsigned int n;
+	unsigned int *off;
+	double *x;
+};
+
+static void flat_init(struct flat *f, const struct igt_bench_series *s,
+		      unsigned int lo, unsigned int hi)
+{
+	unsigned int n = 0;
+
+	for (unsigned int c = lo; c < hi; c++)
+		n += s->commits[c].n_samples;
+
+	f->n_commits = hi - lo;
+	f->n = n;
+	f->off = malloc((f->n_commits + 1) * sizeof(*f->off));
+	f->x = malloc(n * sizeof(*f->x));
+	igt_assert(f->off && f->x);
+}
+
+static void flat_fini(struct flat *f)
+{
+	free(f->off);
+	free(f->x);
+}
+
+/*
+ * Lays out commits order[0..n_commits) of @s, resampling the samples of each
+ * if @rng is given.
+ */
+static void flat_fill(struct flat *f, const struct igt_bench_series *s,
+		      const unsigned int *order, igt_philox_t *rng)
+{
+	unsigned int n = 0;
+
+	for (unsigned int k = 0; k < f->n_commits; k++) {
+		const struct igt_bench_commit *c = &s->commits[order[k]];
+
+		f->off[k] = n;
+		for (unsigned int i = 0; i < c->n_samples; i++) {
+			unsigned int j = rng ?
+				igt_philox_random_max(rng, c->n_samples) : i;
+
+			f->x[n++] = c->samples[j];
+		}
+	}
+	f->off[f->n_commits] = n;
+}
+
+static double pairs(unsigned int n)
+{
+	return n * (n - 1) / 2.0;
+}
+
+/*
+ * E-divisive statistic of splitting @f at each commit boundary, with at
+ * least @min_commits on either side. The sums of distances within and
+ * between both sides are updated as the samples move from the right to the
+ * left one by one, O(n^2) for all the boundaries.
+ *
+ * Returns the largest statistic, and its boundary in @best, or -1.
+ */
+static double energy_best(const struct flat *f, unsigned int min_commits,
+			  unsigned int *best)
+{
+	double within_l = 0, within_r = 0, between = 0, best_q = -1;
+	const double *x = f->x;
+	unsigned int n = f->n, k = 0;
+
+	for (unsigned int i = 0; i < n; i++) {
+		for (unsigned int j = i + 1; j < n; j++)
+			within_r += fabs(x[i] - x[j]);
+	}
+
+	for (unsigned int t = 0; t < n; t++) {
+		double sl = 0, sr = 0;
+
+		if (t == f->off[k]) {
+			if (k >= min_commits && f->n_commits - k >= min_commits) {
+				unsigned int m = t, r = n - t;
+				double e, q;
+
+				e = 2 * between / ((double)m * r);
+				if (m > 1)
+					e -= within_l / pairs(m);
+				if (r > 1)
+					e -= within_r / pairs(r);
+
+				q = (double)m * r / n * e;
+				if (q > best_q) {
+					best_q = q;
+					*best = k;
+				}
+			}
+			k++;
+		}
+
+		for (unsigned int i = 0; i < t; i++)
+			sl += fabs(x[i] - x[t]);
+		for (unsigned int j = t + 1; j < n; j++)
+			sr += fabs(x[t] - x[j]);
+
+		within_l += sl;
+		within_r -= sr;
+		between += sr - sl;
+	}
+
+	return best_q;
+}
+
+struct analysis {
+	const struct igt_bench_series *series;
+	const struct igt_bench_analysis *opts;
+	igt_philox_t rng;
+	unsigned int *order;
+
+	struct igt_bench_change *changes;
+	unsigned int n_changes;
+	unsigned int max_changes;
+};
+
+static void shuffle(igt_philox_t *rng, unsigned int *order, unsigned int n)
+{
+	for (unsigned int i = n; i > 1; i--) {
+		unsigned int j = igt_philox_random_max(rng, i), tmp;
+
+		tmp = order[i - 1];
+		order[i - 1] = order[j];
+		order[j] = tmp;
+	}
+}
+
+/* Binary segmentation of commits [lo, hi) */
+static void segment(struct analysis *a, unsigned int lo, unsigned int hi)
+{
+	const struct igt_bench_analysis *opts = a->opts;
+	unsigned int min_commits = opts->min_commits ?: 1;
+	unsigned int best, dummy, exceed = 0;
+	struct flat f;
+	double q, p;
+
+	if (hi - lo < 2 * min_commits || a->n_changes == a->max_changes)
+		return;
+
+	flat_init(&f, a->series, lo, hi);
+	for (unsigned int k = 0; k < hi - lo; k++)
+		a->order[k] = lo + k;
+	flat_fill(&f, a->series, a->order, NULL);
+
+	q = energy_best(&f, min_commits, &best);
+	if (q <= 0) {
+		flat_fini(&f);
+		return;
+	}
+
+	/* Under no change the commits are exchangeable. */
+	for (unsigned int r = 0; r < opts->permutations; r++) {
+		shuffle(&a->rng, a->order, hi - lo);
+		flat_fill(&f, a->series, a->order, NULL);
+		if (energy_best(&f, min_commits, &dummy) >= q)
+			exceed++;
+	}
+	flat_fini(&f);
+
+	/*
+	 * The segments at each level of the recursion partition the series,
+	 * testing each at its share of alpha bounds the false positives per
+	 * level. Short segments need stronger evidence.
+	 */
+	p = (exceed + 1.0) / (opts->permutations + 1.0);
+	if (p > opts->alpha * (hi - lo) / a->series->n_commits)
+		return;
+
+	a->changes[a->n_changes++] = (struct igt_bench_change) {
+		.commit = lo + best,
+		.p_value = p,
+	};
+
+	segment(a, lo, lo + best);
+	segment(a, lo + best, hi);
+}
+
+static int cmp_change(const void *a, const void *b)
+{
+	const struct igt_bench_change *ca = a, *cb = b;
+
+	return (int)ca->commit - (int)cb->commit;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double da = *(const double *)a, db = *(const double *)b;
+
+	return da < db ? -1 : da > db;
+}
+
+static int cmp_uint(const void *a, const void *b)
+{
+	unsigned int ua = *(const unsigned int *)a;
+	unsigned int ub = *(const unsigned int *)b;
+
+	return ua < ub ? -1 : ua > ub;
+}
+
+/* Mean of the commit means of [lo, hi), resampled at both levels by @rng */
+static double segment_mean(const struct igt_bench_series *s,
+			   unsigned int lo, unsigned int hi,
+			   igt_philox_t *rng)
+{
+	double total = 0;
+
+	for (unsigned int k = lo; k < hi; k++) {
+		const struct igt_bench_commit *c;
+		double sum = 0;
+
+		c = &s->commits[rng ? lo + igt_philox_random_max(rng, hi - lo) : k];
+		for (unsigned int i = 0; i < c->n_samples; i++)
+			sum += c->samples[rng ?
+					  igt_philox_random_max(rng, c->n_samples) :
+					  i];
+		total += sum / c->n_samples;
+	}
+
+	return total / (hi - lo);
+}
+
+static unsigned int percentile(unsigned int n, double p)
+{
+	unsigned int i = p * n;
+
+	return i < n ? i : n - 1;
+}
+
+/* Relative change of the mean, infinite rather than NaN from a zero mean */
+static double relative_change(double before, double after)
+{
+	if (before == 0)
+		return after == 0 ? 0 : copysign(INFINITY, after);
+
+	return (after - before) / before;
+}
+
+/* Bootstrap confidence interval of the relative change of the mean */
+static void change_ci(struct analysis *a, struct igt_bench_change *c,
+		      unsigned int lo, unsigned int hi)
+{
+	const struct igt_bench_analysis *opts = a->opts;
+	unsigned int n = opts->resamples ?: 1;
+	double *rel;
+
+	c->before = segment_mean(a->series, lo, c->commit, NULL);
+	c->after = segment_mean(a->series, c->commit, hi, NULL);
+	c->change = relative_change(c->before, c->after);
+
+	rel = malloc(n * sizeof(*rel));
+	igt_assert(rel);
+	for (unsigned int r = 0; r < n; r++) {
+		double before = segment_mean(a->series, lo, c->commit, &a->rng);
+		double after = segment_mean(a->series, c->commit, hi, &a->rng);
+
+		rel[r] = relative_change(before, after);
+	}
+	qsort(rel, n, sizeof(*rel), cmp_double);
+
+	c->change_lo = rel[percentile(n, opts->alpha / 2)];
+	c->change_hi = rel[percentile(n, 1 - opts->alpha / 2)];
+	free(rel);
+}
+
+/*
+ * Bootstrap of the location of the change point within [lo, hi), resampling
+ * the samples of each commit in place, for the range of commits to bisect.
+ */
+static void change_location(struct analysis *a, struct igt_bench_change *c,
+			    unsigned int lo, unsigned int hi)
+{
+	const struct igt_bench_analysis *opts = a->opts;
+	unsigned int n = opts->resamples ?: 1;
+	unsigned int *where;
+	struct flat f;
+
+	where = malloc(n * sizeof(*where));
+	igt_assert(where);
+
+	flat_init(&f, a->series, lo, hi);
+	for (unsigned int k = 0; k < hi - lo; k++)
+		a->order[k] = lo + k;
+
+	for (unsigned int r = 0; r < n; r++) {
+		unsigned int best = c->commit - lo;
+
+		flat_fill(&f, a->series, a->order, &a->rng);
+		energy_best(&f, 1, &best);
+		where[r] = lo + best;
+	}
+	flat_fini(&f);
+
+	qsort(where, n, sizeof(*where), cmp_uint);
+	c->bisect_first = where[percentile(n, opts->alpha / 2)];
+	c->bisect_last = where[percentile(n, 1 - opts->alpha / 2)];
+	if (c->bisect_first > c->commit)
+		c->bisect_first = c->commit;
+	if (c->bisect_last < c->commit)
+		c->bisect_last = c->commit;
+
+	free(where);
+}
+
+/**
+ * igt_bench_series_analyse:
+ * @series: the samples of a benchmark
+ * @opts: analysis parameters
+ * @changes: the change points found
+ * @max_changes: size of @changes
+ *
+ * Looks for the commits of @series where the distribution of the samples
+ * changed significantly, and estimates the size of each change against the
+ * neighbouring change points.
+ *
+ * The first bad commit is somewhere in the commits between @bisect_first
+ * and @bisect_last of each change, inclusive, and the last good commit is
+ * the one before @bisect_first.
+ *
+ * Returns: the number of change points, in commit order.
+ */
+unsigned int igt_bench_series_analyse(const struct igt_bench_series *series,
+				      const struct igt_bench_analysis *opts,
+				      struct igt_bench_change *changes,
+				      unsigned int max_changes)
+{
+	struct analysis a = {
+		.series = series,
+		.opts = opts,
+		.changes = changes,
+		.max_changes = max_changes,
+	};
+
+	if (!series->n_commits)
+		return 0;
+
+	igt_philox_init(&a.rng, opts->seed);
+	a.order = malloc(series->n_commits * sizeof(*a.order));
+	igt_assert(a.order);
+
+	segment(&a, 0, series->n_commits);
+	qsort(changes, a.n_changes, sizeof(*changes), cmp_change);
+
+	for (unsigned int i = 0; i < a.n_changes; i++) {
+		struct igt_bench_change *c = &changes[i];
+		unsigned int lo = i ? changes[i - 1].commit : 0;
+		unsigned int hi = i + 1 < a.n_changes ?
+				  changes[i + 1].commit : series->n_commits;
+		bool worse;
+
+		change_ci(&a, c, lo, hi);
+		change_location(&a, c, lo, hi);
+
+		worse = opts->lower_is_better ? c->change_lo > 0 :
+						c->change_hi < 0;
+		c->regression = worse && fabs(c->change) >= opts->min_change;
+	}
+
+	free(a.order);
+	return a.n_changes;
+}
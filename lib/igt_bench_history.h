@@ -0,0 +1,144 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __IGT_BENCH_HISTORY_H__
+#define __IGT_BENCH_HISTORY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * igt_bench_commit:
+ * @id: the commit the samples were measured on
+ * @n_samples: number of samples
+ * @samples: the samples of all the runs on @id
+ */
+struct igt_bench_commit {
+	char *id;
+	unsigned int n_samples;
+	double *samples;
+
+	/*< private >*/
+	unsigned int capacity;
+};
+
+/**
+ * igt_bench_series:
+ * @name: the benchmark
+ * @n_commits: number of commits
+ * @commits: the commits in the order they were first added
+ */
+struct igt_bench_series {
+	char *name;
+	unsigned int n_commits;
+	struct igt_bench_commit *commits;
+
+	/*< private >*/
+	unsigned int capacity;
+};
+
+/**
+ * igt_bench_history:
+ * @n_series: number of benchmarks
+ * @series: the samples of each benchmark
+ */
+struct igt_bench_history {
+	unsigned int n_series;
+	struct igt_bench_series *series;
+
+	/*< private >*/
+	unsigned int capacity;
+};
+
+void igt_bench_history_init(struct igt_bench_history *history);
+void igt_bench_history_fini(struct igt_bench_history *history);
+void igt_bench_history_add(struct igt_bench_history *history,
+			   const char *name, const char *commit,
+			   const double *samples, unsigned int n_samples);
+struct igt_bench_series *
+igt_bench_history_find(const struct igt_bench_history *history,
+		       const char *name);
+int igt_bench_history_load(struct igt_bench_history *history,
+			   const char *path);
+int igt_bench_history_append(const char *path, const char *name,
+			     const char *commit,
+			     const double *samples, unsigned int n_samples);
+
+/**
+ * igt_bench_analysis:
+ * @lower_is_better: whether an increase of the values is a regression
+ * @alpha: significance level of the change points and confidence intervals
+ * @min_change: smallest relative change of the mean flagged as a regression
+ * @min_commits: fewest commits on either side of a change point
+ * @permutations: permutations for the significance of each change point
+ * @resamples: bootstrap resamples for the intervals and the bisect ranges
+ * @seed: seed of the permutations and resamples
+ *
+ * Parameters of igt_bench_series_analyse(), see igt_bench_analysis_init()
+ * for the defaults.
+ */
+struct igt_bench_analysis {
+	bool lower_is_better;
+	double alpha;
+	double min_change;
+	unsigned int min_commits;
+	unsigned int permutations;
+	unsigned int resamples;
+	uint64_t seed;
+};
+
+/**
+ * igt_bench_change:
+ * @commit: index of the first commit after the change
+ * @bisect_first: first commit of the confidence interval of @commit
+ * @bisect_last: last commit of the confidence interval of @commit
+ * @p_value: significance of the change point
+ * @before: mean of the segment before the change
+ * @after: mean of the segment after the change
+ * @change: relative change of the mean, (@after - @before) / @before
+ * @change_lo: lower bound of the confidence interval of @change
+ * @change_hi: upper bound of the confidence interval of @change
+ * @regression: whether the change is significant, large enough and in the
+ *		wrong direction
+ */
+struct igt_bench_change {
+	unsigned int commit;
+	unsigned int bisect_first;
+	unsigned int bisect_last;
+	double p_value;
+	double before;
+	double after;
+	double change;
+	double change_lo;
+	double change_hi;
+	bool regression;
+};
+
+void igt_bench_analysis_init(struct igt_bench_analysis *opts);
+unsigned int igt_bench_series_analyse(const struct igt_bench_series *series,
+				      const struct igt_bench_analysis *opts,
+				      struct igt_bench_change *changes,
+				      unsigned int max_changes);
+
+#endif /* __IGT_BENCH_HISTORY_H__ */
@@ -0,0 +1,964 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_dpcd.h"
+
+/**
+ * SECTION:igt_dpcd
+ * @short_description: DPCD snapshots through drm_dp_aux
+ * @title: DPCD
+ * @include: igt_dpcd.h
+ *
+ * Reads the standard DPCD register map through a /dev/drm_dp_auxN device,
+ * or anything else that can be pread(), diffs the snapshots and decodes the
+ * registers.
+ *
+ * Every AUX transaction takes hundreds of microseconds, so the map is read
+ * in as few transactions as the AUX channel allows, 16 bytes at a time,
+ * skipping the reserved ranges and remembering the chunks the sink would
+ * not give. Refreshing a snapshot rereads only the registers the sink
+ * updates on its own, the link status and the IRQ vectors.
+ */
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+#define SNAPSHOT_MAGIC "IGTDPCD1"
+
+struct dpcd_range {
+	uint32_t offset;
+	uint32_t count;
+};
+
+/* The standard registers, as of DP 1.4 and eDP 1.4 */
+static const struct dpcd_range dpcd_map[] = {
+	{ 0x00000, 0x100 },	/* Receiver capability */
+	{ 0x00100, 0x100 },	/* Link configuration */
+	{ 0x00200, 0x100 },	/* Link and sink status */
+	{ 0x00300, 0x00c },	/* Source device OUI and id */
+	{ 0x00400, 0x00c },	/* Sink device OUI and id */
+	{ 0x00500, 0x00c },	/* Branch device OUI and id */
+	{ 0x00600, 0x001 },	/* Power control */
+	{ 0x00700, 0x040 },	/* eDP */
+	{ 0x02002, 0x00e },	/* Event status indicators */
+	{ 0x02200, 0x020 },	/* Extended receiver capability */
+};
+
+/* Reserved within the map, which some sinks NAK instead of reading as 0 */
+static const struct dpcd_range dpcd_holes[] = {
+	{ 0x00040, 0x020 },
+	{ 0x00705, 0x01b },
+};
+
+/* Updated by the sink on its own */
+static const struct dpcd_range dpcd_volatile[] = {
+	{ 0x00200, 0x018 },	/* SINK_COUNT to SYMBOL_ERROR_COUNT_LANE3 */
+	{ 0x00240, 0x006 },	/* TEST_CRC_R_CR to TEST_CRC_B_CB */
+	{ 0x002c0, 0x001 },	/* PAYLOAD_TABLE_UPDATE_STATUS */
+	{ 0x02002, 0x00e },	/* SINK_COUNT_ESI to SINK_STATUS_ESI */
+};
+
+static const struct dpcd_range *
+find_range(const struct dpcd_range *ranges, int count, uint32_t offset)
+{
+	for (int i = 0; i < count; i++)
+		if (offset >= ranges[i].offset &&
+		    offset < ranges[i].offset + ranges[i].count)
+			return &ranges[i];
+
+	return NULL;
+}
+
+/* Moves @limit down to the first edge of @ranges after @offset */
+static uint32_t clip(const struct dpcd_range *ranges, int count,
+		     uint32_t offset, uint32_t limit)
+{
+	for (int i = 0; i < count; i++) {
+		uint32_t start = ranges[i].offset;
+		uint32_t end = start + ranges[i].count;
+
+		if (start > offset && start < limit)
+			limit = start;
+		if (end > offset && end < limit)
+			limit = end;
+	}
+
+	return limit;
+}
+
+static struct igt_dpcd_chunk *add_chunk(struct igt_dpcd_snapshot *snap,
+					unsigned int *capacity)
+{
+	if (snap->num_chunks == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 64;
+		snap->chunks = realloc(snap->chunks,
+				       *capacity * sizeof(*snap->chunks));
+		igt_assert(snap->chunks);
+	}
+
+	return memset(&snap->chunks[snap->num_chunks++], 0,
+		      sizeof(*snap->chunks));
+}
+
+/**
+ * igt_dpcd_snapshot_init:
+ * @snap: the snapshot
+ *
+ * Splits the standard register map into the chunks to read, of up to
+ * #IGT_DPCD_CHUNK_SIZE bytes and not crossing a 16 byte boundary, around
+ * the reserved ranges and with the volatile registers in chunks of their
+ * own. None of the chunks are valid until igt_dpcd_snapshot_read().
+ */
+void igt_dpcd_snapshot_init(struct igt_dpcd_snapshot *snap)
+{
+	unsigned int capacity = 0;
+
+	memset(snap, 0, sizeof(*snap));
+
+	for (int i = 0; i < ARRAY_SIZE(dpcd_map); i++) {
+		uint32_t offset = dpcd_map[i].offset;
+		uint32_t end = offset + dpcd_map[i].count;
+
+		while (offset < end) {
+			const struct dpcd_range *hole;
+			struct igt_dpcd_chunk *chunk;
+			uint32_t limit;
+
+			hole = find_range(dpcd_holes, ARRAY_SIZE(dpcd_holes),
+					  offset);
+			if (hole) {
+				offset = hole->offset + hole->count;
+				continue;
+			}
+
+			limit = (offset & ~(IGT_DPCD_CHUNK_SIZE - 1)) +
+				IGT_DPCD_CHUNK_SIZE;
+			if (limit > end)
+				limit = end;
+			limit = clip(dpcd_holes, ARRAY_SIZE(dpcd_holes),
+				     offset, limit);
+			limit = clip(dpcd_volatile, ARRAY_SIZE(dpcd_volatile),
+				     offset, limit);
+
+			chunk = add_chunk(snap, &capacity);
+			chunk->offset = offset;
+			chunk->len = limit - offset;
+			chunk->volatile_ = find_range(dpcd_volatile,
+						      ARRAY_SIZE(dpcd_volatile),
+						      offset);
+
+			offset = limit;
+		}
+	}
+}
+
+/**
+ * igt_dpcd_snapshot_fini:
+ * @snap: the snapshot
+ */
+void igt_dpcd_snapshot_fini(struct igt_dpcd_snapshot *snap)
+{
+	free(snap->chunks);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/*
+ * A NAK or a timeout only loses the chunk, anything else, such as the
+ * device going away with the connector, is the end of the snapshot.
+ */
+static int read_chunk(struct igt_dpcd_chunk *chunk, int fd)
+{
+	ssize_t ret;
+
+	ret = pread(fd, chunk->data, chunk->len, chunk->offset);
+	chunk->valid = ret == chunk->len;
+	if (chunk->valid)
+		return 0;
+
+	memset(chunk->data, 0, sizeof(chunk->data));
+	if (ret >= 0 || errno == EIO || errno == ETIMEDOUT)
+		return -EIO;
+
+	return -errno;
+}
+
+/**
+ * igt_dpcd_snapshot_read:
+ * @snap: a snapshot from igt_dpcd_snapshot_init()
+ * @fd: the drm_dp_aux device
+ *
+ * Reads all the chunks of @snap, one AUX transaction each. The chunks that
+ * cannot be read are left invalid.
+ *
+ * Returns: 0 if any of the chunks could be read, a negative errno
+ * otherwise.
+ */
+int igt_dpcd_snapshot_read(struct igt_dpcd_snapshot *snap, int fd)
+{
+	bool any = false;
+	int ret = -ENODATA;
+
+	for (unsigned int i = 0; i < snap->num_chunks; i++) {
+		ret = read_chunk(&snap->chunks[i], fd);
+		if (ret && ret != -EIO)
+			return ret;
+
+		snap->chunks[i].readable = snap->chunks[i].valid;
+		any |= snap->chunks[i].valid;
+	}
+
+	return any ? 0 : ret;
+}
+
+/**
+ * igt_dpcd_snapshot_refresh:
+ * @snap: a snapshot from igt_dpcd_snapshot_read()
+ * @fd: the drm_dp_aux device
+ *
+ * Rereads the volatile chunks of @snap that igt_dpcd_snapshot_read() could
+ * read, leaving the rest as it was. Those failing now are left invalid and
+ * retried by the next refresh.
+ *
+ * Returns: the number of chunks that changed, or a negative errno.
+ */
+int igt_dpcd_snapshot_refresh(struct igt_dpcd_snapshot *snap, int fd)
+{
+	int changed = 0;
+
+	for (unsigned int i = 0; i < snap->num_chunks; i++) {
+		struct igt_dpcd_chunk *chunk = &snap->chunks[i];
+		uint8_t old[IGT_DPCD_CHUNK_SIZE];
+		int ret;
+
+		bool was_valid = chunk->valid;
+
+		if (!chunk->volatile_ || !chunk->readable)
+			continue;
+
+		memcpy(old, chunk->data, sizeof(old));
+		ret = read_chunk(chunk, fd);
+		if (ret && ret != -EIO)
+			return ret;
+
+		changed += chunk->valid != was_valid ||
+			   memcmp(old, chunk->data, chunk->len);
+	}
+
+	return changed;
+}
+
+/**
+ * igt_dpcd_snapshot_copy:
+ * @dst: the copy
+ * @src: the snapshot to copy
+ */
+void igt_dpcd_snapshot_copy(struct igt_dpcd_snapshot *dst,
+			    const struct igt_dpcd_snapshot *src)
+{
+	size_t size = src->num_chunks * sizeof(*src->chunks);
+
+	dst->num_chunks = src->num_chunks;
+	dst->chunks = malloc(size);
+	igt_assert(dst->chunks || !size);
+	memcpy(dst->chunks, src->chunks, size);
+}
+
+static const struct igt_dpcd_chunk *
+find_chunk(const struct igt_dpcd_snapshot *snap, uint32_t offset)
+{
+	unsigned int lo = 0, hi = snap->num_chunks;
+
+	while (lo < hi) {
+		unsigned int mid = (lo + hi) / 2;
+		const struct igt_dpcd_chunk *chunk = &snap->chunks[mid];
+
+		if (offset < chunk->offset)
+			hi = mid;
+		else if (offset >= chunk->offset + chunk->len)
+			lo = mid + 1;
+		else
+			return chunk;
+	}
+
+	return NULL;
+}
+
+/**
+ * igt_dpcd_snapshot_get:
+ * @snap: the snapshot
+ * @offset: DPCD address
+ * @value: the register
+ *
+ * Returns: whether @snap has a valid value for the register at @offset.
+ */
+bool igt_dpcd_snapshot_get(const struct igt_dpcd_snapshot *snap,
+			   uint32_t offset, uint8_t *value)
+{
+	const struct igt_dpcd_chunk *chunk = find_chunk(snap, offset);
+
+	if (!chunk || !chunk->valid)
+		return false;
+
+	*value = chunk->data[offset - chunk->offset];
+	return true;
+}
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t num_chunks;
+	uint32_t pad;
+};
+
+struct snapshot_chunk {
+	uint32_t offset;
+	uint8_t len;
+	uint8_t flags;
+#define CHUNK_VALID (1 << 0)
+#define CHUNK_VOLATILE (1 << 1)
+#define CHUNK_READABLE (1 << 2)
+	uint8_t pad[2];
+	uint8_t data[IGT_DPCD_CHUNK_SIZE];
+};
+
+/**
+ * igt_dpcd_snapshot_save:
+ * @snap: the snapshot
+ * @path: the file to write
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_dpcd_snapshot_save(const struct igt_dpcd_snapshot *snap,
+			   const char *path)
+{
+	struct snapshot_header hdr = {
+		.num_chunks = snap->num_chunks,
+	};
+	struct snapshot_chunk *chunks;
+	size_t size = snap->num_chunks * sizeof(*chunks);
+	int fd, ret = 0;
+
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+
+	chunks = calloc(snap->num_chunks, sizeof(*chunks));
+	igt_assert(chunks || !size);
+	for (unsigned int i = 0; i < snap->num_chunks; i++) {
+		const struct igt_dpcd_chunk *c = &snap->chunks[i];
+
+		chunks[i].offset = c->offset;
+		chunks[i].len = c->len;
+		chunks[i].flags = (c->valid ? CHUNK_VALID : 0) |
+				  (c->volatile_ ? CHUNK_VOLATILE : 0) |
+				  (c->readable ? CHUNK_READABLE : 0);
+		memcpy(chunks[i].data, c->data, sizeof(c->data));
+	}
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    write(fd, chunks, size) != size)
+		ret = -EIO;
+
+	close(fd);
+out:
+	free(chunks);
+	return ret;
+}
+
+/**
+ * igt_dpcd_snapshot_load:
+ * @snap: the snapshot
+ * @path: a file written by igt_dpcd_snapshot_save()
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_dpcd_snapshot_load(struct igt_dpcd_snapshot *snap, const char *path)
+{
+	struct snapshot_header hdr;
+	struct snapshot_chunk c;
+	struct stat st;
+	uint32_t end = 0;
+	int fd, ret = 0;
+
+	memset(snap, 0, sizeof(*snap));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) ||
+	    read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.num_chunks > (st.st_size - sizeof(hdr)) / sizeof(c)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	snap->chunks = calloc(hdr.num_chunks, sizeof(*snap->chunks));
+	igt_assert(snap->chunks || !hdr.num_chunks);
+
+	for (unsigned int i = 0; i < hdr.num_chunks; i++) {
+		struct igt_dpcd_chunk *chunk = &snap->chunks[i];
+
+		/* Chunks in order and not overlapping, for find_chunk() */
+		if (read(fd, &c, sizeof(c)) != sizeof(c) ||
+		    !c.len || c.len > IGT_DPCD_CHUNK_SIZE ||
+		    c.offset < end) {
+			ret = -EINVAL;
+			break;
+		}
+		end = c.offset + c.len;
+
+		chunk->offset = c.offset;
+		chunk->len = c.len;
+		chunk->valid = c.flags & CHUNK_VALID;
+		chunk->volatile_ = c.flags & CHUNK_VOLATILE;
+		chunk->readable = c.flags & CHUNK_READABLE;
+		memcpy(chunk->data, c.data, sizeof(c.data));
+		snap->num_chunks++;
+	}
+	close(fd);
+
+	if (ret)
+		igt_dpcd_snapshot_fini(snap);
+
+	return ret;
+}
+
+static void add_change(struct igt_dpcd_change **changes, unsigned int *count,
+		       unsigned int *capacity, uint32_t offset,
+		       const struct igt_dpcd_chunk *old,
+		       const struct igt_dpcd_chunk *new)
+{
+	struct igt_dpcd_change *c;
+
+	if (*count == *capacity) {
+		*capacity = *capacity ? 2 * *capacity : 16;
+		*changes = realloc(*changes, *capacity * sizeof(**changes));
+		igt_assert(*changes);
+	}
+
+	c = &(*changes)[(*count)++];
+	memset(c, 0, sizeof(*c));
+	c->offset = offset;
+	if (old && old->valid) {
+		c->old_valid = true;
+		c->old = old->data[offset - old->offset];
+	}
+	if (new && new->valid) {
+		c->new_valid = true;
+		c->new = new->data[offset - new->offset];
+	}
+}
+
+static int cmp_change(const void *A, const void *B)
+{
+	const struct igt_dpcd_change *a = A, *b = B;
+
+	return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+/**
+ * igt_dpcd_snapshot_diff:
+ * @old: the first snapshot
+ * @new: the second snapshot
+ * @changes: returns the registers that differ, in DPCD order, to be freed
+ *	     by the caller
+ *
+ * Compares the registers that are valid in either snapshot. Snapshots read
+ * with the same register map are compared a chunk at a time, others a
+ * register at a time.
+ *
+ * Returns: the number of registers that differ.
+ */
+unsigned int igt_dpcd_snapshot_diff(const struct igt_dpcd_snapshot *old,
+				    const struct igt_dpcd_snapshot *new,
+				    struct igt_dpcd_change **changes)
+{
+	unsigned int count = 0, capacity = 0;
+	bool sorted = true;
+
+	*changes = NULL;
+
+	for (unsigned int i = 0; i < old->num_chunks; i++) {
+		const struct igt_dpcd_chunk *a = &old->chunks[i];
+		const struct igt_dpcd_chunk *b = find_chunk(new, a->offset);
+
+		if (b && b->offset == a->offset && b->len == a->len &&
+		    b->valid == a->valid &&
+		    (!a->valid || !memcmp(a->data, b->data, a->len)))
+			continue;
+
+		for (uint32_t offset = a->offset;
+		     offset < a->offset + a->len; offset++) {
+			uint8_t x = 0, y = 0;
+			bool vx, vy;
+
+			b = find_chunk(new, offset);
+			vx = igt_dpcd_snapshot_get(old, offset, &x);
+			vy = igt_dpcd_snapshot_get(new, offset, &y);
+			if ((vx || vy) && (vx != vy || x != y))
+				add_change(changes, &count, &capacity,
+					   offset, a, b);
+		}
+	}
+
+	/* And the registers only the second snapshot has */
+	for (unsigned int i = 0; i < new->num_chunks; i++) {
+		const struct igt_dpcd_chunk *b = &new->chunks[i];
+
+		if (!b->valid)
+			continue;
+
+		for (uint32_t offset = b->offset;
+		     offset < b->offset + b->len; offset++) {
+			if (find_chunk(old, offset))
+				continue;
+
+			add_change(changes, &count, &capacity,
+				   offset, NULL, b);
+			sorted = false;
+		}
+	}
+
+	if (!sorted)
+		qsort(*changes, count, sizeof(**changes), cmp_change);
+
+	return count;
+}
+
+#define LANE_STATUS(a, b) \
+	{ "LANE" #a "_CR_DONE", 0x01 }, \
+	{ "LANE" #a "_CHANNEL_EQ_DONE", 0x02 }, \
+	{ "LANE" #a "_SYMBOL_LOCKED", 0x04 }, \
+	{ "LANE" #b "_CR_DONE", 0x10 }, \
+	{ "LANE" #b "_CHANNEL_EQ_DONE", 0x20 }, \
+	{ "LANE" #b "_SYMBOL_LOCKED", 0x40 }, \
+	{}
+
+#define ADJUST_REQUEST(a, b) \
+	{ "ADJUST_VOLTAGE_SWING_LANE" #a, 0x03 }, \
+	{ "ADJUST_PRE_EMPHASIS_LANE" #a, 0x0c }, \
+	{ "ADJUST_VOLTAGE_SWING_LANE" #b, 0x30 }, \
+	{ "ADJUST_PRE_EMPHASIS_LANE" #b, 0xc0 }, \
+	{}
+
+static const struct igt_dpcd_field max_lane_count[] = {
+	{ "MAX_LANE_COUNT", 0x1f },
+	{ "TPS3_SUPPORTED", 0x40 },
+	{ "ENHANCED_FRAME_CAP", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field max_downspread[] = {
+	{ "MAX_DOWNSPREAD_0_5", 0x01 },
+	{ "STREAM_REGENERATION_STATUS_CAP", 0x02 },
+	{ "NO_AUX_HANDSHAKE_LINK_TRAINING", 0x40 },
+	{ "TPS4_SUPPORTED", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field downstreamport_present[] = {
+	{ "DWN_STRM_PORT_PRESENT", 0x01 },
+	{ "DWN_STRM_PORT_TYPE", 0x06 },
+	{ "FORMAT_CONVERSION", 0x08 },
+	{ "DETAILED_CAP_INFO_AVAILABLE", 0x10 },
+	{}
+};
+
+static const struct igt_dpcd_field main_link_channel_coding[] = {
+	{ "CAP_ANSI_8B10B", 0x01 },
+	{ "CAP_ANSI_128B132B", 0x02 },
+	{}
+};
+
+static const struct igt_dpcd_field down_stream_port_count[] = {
+	{ "PORT_COUNT", 0x0f },
+	{ "MSA_TIMING_PAR_IGNORED", 0x40 },
+	{ "OUI_SUPPORT", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_configuration_cap[] = {
+	{ "ALTERNATE_SCRAMBLER_RESET_CAP", 0x01 },
+	{ "FRAMING_CHANGE_CAP", 0x02 },
+	{ "DPCD_DISPLAY_CONTROL_CAPABLE", 0x08 },
+	{}
+};
+
+static const struct igt_dpcd_field training_aux_rd_interval[] = {
+	{ "TRAINING_AUX_RD_MASK", 0x7f },
+	{ "EXTENDED_RECEIVER_CAP_FIELD_PRESENT", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field mstm_cap[] = {
+	{ "MST_CAP", 0x01 },
+	{}
+};
+
+static const struct igt_dpcd_field psr_caps[] = {
+	{ "PSR_NO_TRAIN_ON_EXIT", 0x01 },
+	{ "PSR_SETUP_TIME", 0x0e },
+	{ "PSR2_SU_Y_COORDINATE_REQUIRED", 0x10 },
+	{ "PSR2_SU_GRANULARITY_REQUIRED", 0x20 },
+	{}
+};
+
+static const struct igt_dpcd_field lane_count_set[] = {
+	{ "LANE_COUNT", 0x1f },
+	{ "ENHANCED_FRAME_EN", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field training_pattern_set[] = {
+	{ "TRAINING_PATTERN", 0x0f },
+	{ "RECOVERED_CLOCK_OUT_EN", 0x10 },
+	{ "LINK_SCRAMBLING_DISABLE", 0x20 },
+	{ "SYMBOL_ERROR_COUNT_SEL", 0xc0 },
+	{}
+};
+
+static const struct igt_dpcd_field training_lane_set[] = {
+	{ "VOLTAGE_SWING", 0x03 },
+	{ "MAX_SWING_REACHED", 0x04 },
+	{ "PRE_EMPHASIS", 0x18 },
+	{ "MAX_PRE_EMPHASIS_REACHED", 0x20 },
+	{}
+};
+
+static const struct igt_dpcd_field downspread_ctrl[] = {
+	{ "SPREAD_AMP_0_5", 0x10 },
+	{ "MSA_TIMING_PAR_IGNORE_EN", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_configuration_set[] = {
+	{ "ALTERNATE_SCRAMBLER_RESET_ENABLE", 0x01 },
+	{ "FRAMING_CHANGE_ENABLE", 0x02 },
+	{ "PANEL_SELF_TEST_ENABLE", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field mstm_ctrl[] = {
+	{ "MST_EN", 0x01 },
+	{ "UP_REQ_EN", 0x02 },
+	{ "UPSTREAM_IS_SRC", 0x04 },
+	{}
+};
+
+static const struct igt_dpcd_field psr_en_cfg[] = {
+	{ "PSR_ENABLE", 0x01 },
+	{ "PSR_MAIN_LINK_ACTIVE", 0x02 },
+	{ "PSR_CRC_VERIFICATION", 0x04 },
+	{ "PSR_FRAME_CAPTURE", 0x08 },
+	{ "PSR_SU_REGION_SCANLINE_CAPTURE", 0x10 },
+	{ "PSR_IRQ_HPD_WITH_CRC_ERRORS", 0x20 },
+	{ "PSR_ENABLE_PSR2", 0x40 },
+	{}
+};
+
+static const struct igt_dpcd_field sink_count[] = {
+	{ "SINK_COUNT", 0x3f },
+	{ "SINK_CP_READY", 0x40 },
+	{}
+};
+
+static const struct igt_dpcd_field device_service_irq_vector[] = {
+	{ "REMOTE_CONTROL_COMMAND_PENDING", 0x01 },
+	{ "AUTOMATED_TEST_REQUEST", 0x02 },
+	{ "CP_IRQ", 0x04 },
+	{ "MCCS_IRQ", 0x08 },
+	{ "DOWN_REP_MSG_RDY", 0x10 },
+	{ "UP_REQ_MSG_RDY", 0x20 },
+	{ "SINK_SPECIFIC_IRQ", 0x40 },
+	{}
+};
+
+static const struct igt_dpcd_field lane0_1_status[] = {
+	LANE_STATUS(0, 1)
+};
+
+static const struct igt_dpcd_field lane2_3_status[] = {
+	LANE_STATUS(2, 3)
+};
+
+static const struct igt_dpcd_field lane_align_status_updated[] = {
+	{ "INTERLANE_ALIGN_DONE", 0x01 },
+	{ "DOWNSTREAM_PORT_STATUS_CHANGED", 0x40 },
+	{ "LINK_STATUS_UPDATED", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field sink_status[] = {
+	{ "RECEIVE_PORT_0_STATUS", 0x01 },
+	{ "RECEIVE_PORT_1_STATUS", 0x02 },
+	{}
+};
+
+static const struct igt_dpcd_field adjust_request_lane0_1[] = {
+	ADJUST_REQUEST(0, 1)
+};
+
+static const struct igt_dpcd_field adjust_request_lane2_3[] = {
+	ADJUST_REQUEST(2, 3)
+};
+
+static const struct igt_dpcd_field test_request[] = {
+	{ "TEST_LINK_TRAINING", 0x01 },
+	{ "TEST_LINK_VIDEO_PATTERN", 0x02 },
+	{ "TEST_LINK_EDID_READ", 0x04 },
+	{ "TEST_LINK_PHY_TEST_PATTERN", 0x08 },
+	{ "TEST_LINK_FAUX_PATTERN", 0x10 },
+	{}
+};
+
+static const struct igt_dpcd_field payload_table_update_status[] = {
+	{ "PAYLOAD_TABLE_UPDATED", 0x01 },
+	{ "PAYLOAD_ACT_HANDLED", 0x02 },
+	{}
+};
+
+static const struct igt_dpcd_field set_power[] = {
+	{ "SET_POWER", 0x07 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_general_cap_1[] = {
+	{ "EDP_TCON_BACKLIGHT_ADJUSTMENT_CAP", 0x01 },
+	{ "EDP_BACKLIGHT_PIN_ENABLE_CAP", 0x02 },
+	{ "EDP_BACKLIGHT_AUX_ENABLE_CAP", 0x04 },
+	{ "EDP_PANEL_SELF_TEST_PIN_ENABLE_CAP", 0x08 },
+	{ "EDP_PANEL_SELF_TEST_AUX_ENABLE_CAP", 0x10 },
+	{ "EDP_FRC_ENABLE_CAP", 0x20 },
+	{ "EDP_COLOR_ENGINE_CAP", 0x40 },
+	{ "EDP_SET_POWER_CAP", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_backlight_adjustment_cap[] = {
+	{ "EDP_BACKLIGHT_BRIGHTNESS_PWM_PIN_CAP", 0x01 },
+	{ "EDP_BACKLIGHT_BRIGHTNESS_AUX_SET_CAP", 0x02 },
+	{ "EDP_BACKLIGHT_BRIGHTNESS_BYTE_COUNT", 0x04 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_display_control_register[] = {
+	{ "EDP_BACKLIGHT_ENABLE", 0x01 },
+	{ "EDP_BLACK_VIDEO_ENABLE", 0x02 },
+	{ "EDP_FRC_ENABLE", 0x04 },
+	{ "EDP_COLOR_ENGINE_ENABLE", 0x08 },
+	{ "EDP_VBLANK_BACKLIGHT_UPDATE_ENABLE", 0x80 },
+	{}
+};
+
+static const struct igt_dpcd_field edp_backlight_mode_set_register[] = {
+	{ "EDP_BACKLIGHT_CONTROL_MODE", 0x03 },
+	{}
+};
+
+static const struct igt_dpcd_field device_service_irq_vector_esi1[] = {
+	{ "RX_GTC_MSTR_REQ_STATUS_CHANGE", 0x01 },
+	{ "LOCK_ACQUISITION_REQUEST", 0x02 },
+	{ "CEC_IRQ", 0x04 },
+	{}
+};
+
+static const struct igt_dpcd_field link_service_irq_vector_esi0[] = {
+	{ "RX_CAP_CHANGED", 0x01 },
+	{ "LINK_STATUS_CHANGED", 0x02 },
+	{ "STREAM_STATUS_CHANGED", 0x04 },
+	{ "HDMI_LINK_STATUS_CHANGED", 0x08 },
+	{ "CONNECTED_OFF_ENTRY_REQUESTED", 0x10 },
+	{}
+};
+
+static const struct igt_dpcd_field psr_error_status[] = {
+	{ "PSR_LINK_CRC_ERROR", 0x01 },
+	{ "PSR_RFB_STORAGE_ERROR", 0x02 },
+	{ "PSR_VSC_SDP_UNCORRECTABLE_ERROR", 0x04 },
+	{}
+};
+
+static const struct igt_dpcd_field psr_esi[] = {
+	{ "PSR_CAPS_CHANGE", 0x01 },
+	{}
+};
+
+static const struct igt_dpcd_field psr_status[] = {
+	{ "PSR_SINK_STATE", 0x07 },
+	{}
+};
+
+static const struct igt_dpcd_field dprx_feature_enumeration_list[] = {
+	{ "GTC_CAP", 0x01 },
+	{ "SST_SPLIT_SDP_CAP", 0x02 },
+	{ "AV_SYNC_CAP", 0x04 },
+	{ "VSC_SDP_EXT_FOR_COLORIMETRY_SUPPORTED", 0x08 },
+	{}
+};
+
+/* In DPCD order, for igt_dpcd_reg_lookup() */
+static const struct igt_dpcd_reg dpcd_regs[] = {
+	{ 0x00000, "DPCD_REV" },
+	{ 0x00001, "MAX_LINK_RATE" },
+	{ 0x00002, "MAX_LANE_COUNT", max_lane_count },
+	{ 0x00003, "MAX_DOWNSPREAD", max_downspread },
+	{ 0x00004, "NORP" },
+	{ 0x00005, "DOWNSTREAMPORT_PRESENT", downstreamport_present },
+	{ 0x00006, "MAIN_LINK_CHANNEL_CODING", main_link_channel_coding },
+	{ 0x00007, "DOWN_STREAM_PORT_COUNT", down_stream_port_count },
+	{ 0x00008, "RECEIVE_PORT_0_CAP_0" },
+	{ 0x00009, "RECEIVE_PORT_0_BUFFER_SIZE" },
+	{ 0x0000d, "EDP_CONFIGURATION_CAP", edp_configuration_cap },
+	{ 0x0000e, "TRAINING_AUX_RD_INTERVAL", training_aux_rd_interval },
+	{ 0x00021, "MSTM_CAP", mstm_cap },
+	{ 0x00060, "DSC_SUPPORT" },
+	{ 0x00070, "PSR_SUPPORT" },
+	{ 0x00071, "PSR_CAPS", psr_caps },
+	{ 0x00100, "LINK_BW_SET" },
+	{ 0x00101, "LANE_COUNT_SET", lane_count_set },
+	{ 0x00102, "TRAINING_PATTERN_SET", training_pattern_set },
+	{ 0x00103, "TRAINING_LANE0_SET", training_lane_set },
+	{ 0x00104, "TRAINING_LANE1_SET", training_lane_set },
+	{ 0x00105, "TRAINING_LANE2_SET", training_lane_set },
+	{ 0x00106, "TRAINING_LANE3_SET", training_lane_set },
+	{ 0x00107, "DOWNSPREAD_CTRL", downspread_ctrl },
+	{ 0x00108, "MAIN_LINK_CHANNEL_CODING_SET" },
+	{ 0x0010a, "EDP_CONFIGURATION_SET", edp_configuration_set },
+	{ 0x00111, "MSTM_CTRL", mstm_ctrl },
+	{ 0x00115, "LINK_RATE_SET" },
+	{ 0x00170, "PSR_EN_CFG", psr_en_cfg },
+	{ 0x00200, "SINK_COUNT", sink_count },
+	{ 0x00201, "DEVICE_SERVICE_IRQ_VECTOR", device_service_irq_vector },
+	{ 0x00202, "LANE0_1_STATUS", lane0_1_status },
+	{ 0x00203, "LANE2_3_STATUS", lane2_3_status },
+	{ 0x00204, "LANE_ALIGN_STATUS_UPDATED", lane_align_status_updated },
+	{ 0x00205, "SINK_STATUS", sink_status },
+	{ 0x00206, "ADJUST_REQUEST_LANE0_1", adjust_request_lane0_1 },
+	{ 0x00207, "ADJUST_REQUEST_LANE2_3", adjust_request_lane2_3 },
+	{ 0x00210, "SYMBOL_ERROR_COUNT_LANE0" },
+	{ 0x00212, "SYMBOL_ERROR_COUNT_LANE1" },
+	{ 0x00214, "SYMBOL_ERROR_COUNT_LANE2" },
+	{ 0x00216, "SYMBOL_ERROR_COUNT_LANE3" },
+	{ 0x00218, "TEST_REQUEST", test_request },
+	{ 0x00240, "TEST_CRC_R_CR" },
+	{ 0x00242, "TEST_CRC_G_Y" },
+	{ 0x00244, "TEST_CRC_B_CB" },
+	{ 0x002c0, "PAYLOAD_TABLE_UPDATE_STATUS", payload_table_update_status },
+	{ 0x00300, "SOURCE_OUI" },
+	{ 0x00400, "SINK_OUI" },
+	{ 0x00500, "BRANCH_OUI" },
+	{ 0x00600, "SET_POWER", set_power },
+	{ 0x00700, "EDP_DPCD_REV" },
+	{ 0x00701, "EDP_GENERAL_CAP_1", edp_general_cap_1 },
+	{ 0x00702, "EDP_BACKLIGHT_ADJUSTMENT_CAP", edp_backlight_adjustment_cap },
+	{ 0x00703, "EDP_GENERAL_CAP_2" },
+	{ 0x00704, "EDP_GENERAL_CAP_3" },
+	{ 0x00720, "EDP_DISPLAY_CONTROL_REGISTER", edp_display_control_register },
+	{ 0x00721, "EDP_BACKLIGHT_MODE_SET_REGISTER", edp_backlight_mode_set_register },
+	{ 0x00722, "EDP_BACKLIGHT_BRIGHTNESS_MSB" },
+	{ 0x00723, "EDP_BACKLIGHT_BRIGHTNESS_LSB" },
+	{ 0x02002, "SINK_COUNT_ESI" },
+	{ 0x02003, "DEVICE_SERVICE_IRQ_VECTOR_ESI0", device_service_irq_vector },
+	{ 0x02004, "DEVICE_SERVICE_IRQ_VECTOR_ESI1", device_service_irq_vector_esi1 },
+	{ 0x02005, "LINK_SERVICE_IRQ_VECTOR_ESI0", link_service_irq_vector_esi0 },
+	{ 0x02006, "PSR_ERROR_STATUS", psr_error_status },
+	{ 0x02007, "PSR_ESI", psr_esi },
+	{ 0x02008, "PSR_STATUS", psr_status },
+	{ 0x0200c, "LANE0_1_STATUS_ESI", lane0_1_status },
+	{ 0x0200d, "LANE2_3_STATUS_ESI", lane2_3_status },
+	{ 0x0200e, "LANE_ALIGN_STATUS_UPDATED_ESI", lane_align_status_updated },
+	{ 0x0200f, "SINK_STATUS_ESI", sink_status },
+	{ 0x02200, "DP13_DPCD_REV" },
+	{ 0x02210, "DPRX_FEATURE_ENUMERATION_LIST", dprx_feature_enumeration_list },
+};
+
+static int cmp_reg(const void *key, const void *elem)
+{
+	uint32_t offset = *(const uint32_t *)key;
+	const struct igt_dpcd_reg *reg = elem;
+
+	return offset < reg->offset ? -1 : offset > reg->offset;
+}
+
+/**
+ * igt_dpcd_reg_lookup:
+ * @offset: DPCD address
+ *
+ * Returns: the description of the register at @offset, or NULL for the
+ * registers without one.
+ */
+const struct igt_dpcd_reg *igt_dpcd_reg_lookup(uint32_t offset)
+{
+	return bsearch(&offset, dpcd_regs, ARRAY_SIZE(dpcd_regs),
+		       sizeof(dpcd_regs[0]), cmp_reg);
+}
+
+/**
+ * igt_dpcd_decode:
+ * @offset: DPCD address
+ * @value: the register
+ * @buf: returns the text
+ * @size: size of @buf
+ *
+ * Formats the register at @offset as its name and value followed by its
+ * fields, as in "LANE_COUNT_SET 0x84 [LANE_COUNT=4 ENHANCED_FRAME_EN=1]",
+ * or just its value when it has no description.
+ *
+ * Returns: the length of the text, as snprintf().
+ */
+int igt_dpcd_decode(uint32_t offset, uint8_t value, char *buf, size_t size)
+{
+	const struct igt_dpcd_reg *reg = igt_dpcd_reg_lookup(offset);
+	const struct igt_dpcd_field *f;
+	int len;
+
+	if (!reg)
+		return snprintf(buf, size, "0x%02x", value);
+
+	len = snprintf(buf, size, "%s 0x%02x", reg->name, value);
+	if (!reg->fields)
+		return len;
+
+	for (f = reg->fields; f->name; f++)
+		len += snprintf(len < size ? buf + len : NULL,
+				len < size ? size - len : 0,
+				"%s%s=%x", f == reg->fields ? " [" : " ",
+				f->name, (value & f->mask) >> __builtin_ctz(f->mask));
+
+	return len + snprintf(len < size ? buf + len : NULL,
+			      len < size ? size - len : 0, "]");
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __IGT_DPCD_H__
+#define __IGT_DPCD_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Largest native AUX transfer */
+#define IGT_DPCD_CHUNK_SIZE 16
+
+/**
+ * igt_dpcd_chunk:
+ * @offset: DPCD address of the first byte
+ * @len: number of bytes, up to #IGT_DPCD_CHUNK_SIZE
+ * @valid: whether the chunk could be read
+ * @readable: whether the chunk could be read by igt_dpcd_snapshot_read()
+ * @volatile_: whether the sink updates the registers on its own
+ * @data: the registers
+ *
+ * The registers read with a single AUX transaction.
+ */
+struct igt_dpcd_chunk {
+	uint32_t offset;
+	uint8_t len;
+	bool valid;
+	bool readable;
+	bool volatile_;
+	uint8_t data[IGT_DPCD_CHUNK_SIZE];
+};
+
+/**
+ * igt_dpcd_snapshot:
+ * @num_chunks: number of chunks
+ * @chunks: the chunks, in DPCD order
+ */
+struct igt_dpcd_snapshot {
+	unsigned int num_chunks;
+	struct igt_dpcd_chunk *chunks;
+};
+
+void igt_dpcd_snapshot_init(struct igt_dpcd_snapshot *snap);
+void igt_dpcd_snapshot_fini(struct igt_dpcd_snapshot *snap);
+int igt_dpcd_snapshot_read(struct igt_dpcd_snapshot *snap, int fd);
+int igt_dpcd_snapshot_refresh(struct igt_dpcd_snapshot *snap, int fd);
+void igt_dpcd_snapshot_copy(struct igt_dpcd_snapshot *dst,
+			    const struct igt_dpcd_snapshot *src);
+bool igt_dpcd_snapshot_get(const struct igt_dpcd_snapshot *snap,
+			   uint32_t offset, uint8_t *value);
+int igt_dpcd_snapshot_save(const struct igt_dpcd_snapshot *snap,
+			   const char *path);
+int igt_dpcd_snapshot_load(struct igt_dpcd_snapshot *snap, const char *path);
+
+/**
+ * igt_dpcd_change:
+ * @offset: DPCD address of the register
+ * @old: its value in the first snapshot
+ * @new: its value in the second snapshot
+ * @old_valid: whether the first snapshot has the register
+ * @new_valid: whether the second snapshot has the register
+ */
+struct igt_dpcd_change {
+	uint32_t offset;
+	uint8_t old, new;
+	bool old_valid, new_valid;
+};
+
+unsigned int igt_dpcd_snapshot_diff(const struct igt_dpcd_snapshot *old,
+				    const struct igt_dpcd_snapshot *new,
+				    struct igt_dpcd_change **changes);
+
+/**
+ * igt_dpcd_field:
+ * @name: name of the field
+ * @mask: bits of the field in the register
+ */
+struct igt_dpcd_field {
+	const char *name;
+	uint8_t mask;
+};
+
+/**
+ * igt_dpcd_reg:
+ * @offset: DPCD address
+ * @name: name of the register, as in drm_dp_helper.h without DP_
+ * @fields: the fields of the register, terminated by an empty one, or NULL
+ */
+struct igt_dpcd_reg {
+	uint32_t offset;
+	const char *name;
+	const struct igt_dpcd_field *fields;
+};
+
+const struct igt_dpcd_reg *igt_dpcd_reg_lookup(uint32_t offset);
+int igt_dpcd_decode(uint32_t offset, uint8_t value, char *buf, size_t size);
+
+#endif /* __IGT_DPCD_H__ */
@@ -0,0 +1,843 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "igt_drm_fdinfo.h"
+
+/* Fds found not to be DRM ones are only looked at again this often. */
+#define DRM_MEM_RESCAN 16
+
+struct drm_mem_fd {
+	int fd;
+	dev_t dev;
+	ino_t ino;
+	bool drm;
+	unsigned long id;
+};
+
+struct drm_mem_pid {
+	pid_t pid;
+	unsigned int generation;
+	unsigned int scans;
+	char comm[32];
+	char *cgroup;
+	struct drm_mem_fd *fds;
+	unsigned int num_fds;
+};
+
+static uint64_t parse_size(const char *s)
+{
+	uint64_t val;
+	char *end;
+
+	val = strtoull(s, &end, 10);
+	while (*end == ' ')
+		end++;
+
+	if (!strncmp(end, "KiB", 3))
+		val <<= 10;
+	else if (!strncmp(end, "MiB", 3))
+		val <<= 20;
+	else if (!strncmp(end, "GiB", 3))
+		val <<= 30;
+
+	return val;
+}
+
+static struct drm_fdinfo_memory *
+find_region(struct drm_fdinfo_memory *region, unsigned int *num_regions,
+	    const char *name, size_t len)
+{
+	unsigned int i;
+
+	if (len >= sizeof(region->region))
+		return NULL;
+
+	for (i = 0; i < *num_regions; i++) {
+		if (!strncmp(region[i].region, name, len) &&
+		    !region[i].region[len])
+			return &region[i];
+	}
+
+	if (i == DRM_FDINFO_MAX_REGIONS)
+		return NULL;
+
+	memset(&region[i], 0, sizeof(region[i]));
+	memcpy(region[i].region, name, len);
+	(*num_regions)++;
+
+	return &region[i];
+}
+
+static struct drm_fdinfo_engine *
+find_engine(struct drm_client_fdinfo *info, const char *name, size_t len)
+{
+	struct drm_fdinfo_engine *engine;
+	unsigned int i;
+
+	if (len >= sizeof(engine->name))
+		return NULL;
+
+	for (i = 0; i < info->num_engines; i++) {
+		engine = &info->engine[i];
+		if (!strncmp(engine->name, name, len) && !engine->name[len])
+			return engine;
+	}
+
+	if (i == DRM_FDINFO_MAX_ENGINES)
+		return NULL;
+
+	engine = &info->engine[info->num_engines++];
+	memcpy(engine->name, name, len);
+	engine->name[len] = '\0';
+	engine->capacity = 1;
+
+	return engine;
+}
+
+static void copy_value(char *dst, size_t size, const char *src, size_t len)
+{
+	if (len >= size)
+		len = size - 1;
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+/**
+ * __igt_parse_drm_fdinfo:
+ * @buf: nul terminated contents of a fdinfo file
+ * @info: parsed client
+ *
+ * Parses the drm-driver, drm-pdev and drm-client-id keys, the engine ones,
+ * drm-engine-<name> and drm-engine-capacity-<name>, and the memory ones,
+ * drm-{total,shared,resident,purgeable,active}-<region> as well as the
+ * older drm-memory-<region>, which is taken as the resident size.
+ *
+ * Returns: the number of DRM keys found.
+ */
+unsigned int __igt_parse_drm_fdinfo(const char *buf,
+				    struct drm_client_fdinfo *info)
+{
+	static const struct {
+		const char *prefix;
+		size_t len;
+		size_t offset;
+	} sizes[] = {
+#define SIZE_KEY(p, f) { p, sizeof(p) - 1, offsetof(struct drm_fdinfo_memory, f) }
+		SIZE_KEY("drm-total-", total),
+		SIZE_KEY("drm-shared-", shared),
+		SIZE_KEY("drm-resident-", resident),
+		SIZE_KEY("drm-purgeable-", purgeable),
+		SIZE_KEY("drm-active-", active),
+		SIZE_KEY("drm-memory-", resident),
+#undef SIZE_KEY
+	};
+	unsigned int found = 0;
+	const char *line;
+
+	memset(info, 0, sizeof(*info));
+
+	for (line = buf; line && *line; line = strchr(line, '\n'),
+	     line = line ? line + 1 : NULL) {
+		struct drm_fdinfo_engine *engine;
+		const char *colon, *val, *eol;
+		unsigned int i;
+
+		if (strncmp(line, "drm-", 4))
+			continue;
+
+		colon = strchr(line, ':');
+		if (!colon)
+			break;
+
+		for (val = colon + 1; *val == ' ' || *val == '\t'; val++)
+			;
+		eol = strchrnul(val, '\n');
+
+		if (!strncmp(line, "drm-driver:", 11)) {
+			copy_value(info->driver, sizeof(info->driver),
+				   val, eol - val);
+			found++;
+			continue;
+		} else if (!strncmp(line, "drm-pdev:", 9)) {
+			copy_value(info->pdev, sizeof(info->pdev),
+				   val, eol - val);
+			found++;
+			continue;
+		} else if (!strncmp(line, "drm-client-id:", 14)) {
+			info->id = strtoul(val, NULL, 10);
+			found++;
+			continue;
+		} else if (!strncmp(line, "drm-engine-capacity-", 20)) {
+			engine = find_engine(info, line + 20, colon - line - 20);
+			if (engine) {
+				engine->capacity = strtoul(val, NULL, 10) ?: 1;
+				found++;
+			}
+			continue;
+		} else if (!strncmp(line, "drm-engine-", 11)) {
+			engine = find_engine(info, line + 11, colon - line - 11);
+			if (engine) {
+				engine->busy_ns = strtoull(val, NULL, 10);
+				found++;
+			}
+			continue;
+		}
+
+		for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			struct drm_fdinfo_memory *region;
+
+			if (strncmp(line, sizes[i].prefix, sizes[i].len))
+				continue;
+
+			region = find_region(info->region, &info->num_regions,
+					     line + sizes[i].len,
+					     colon - line - sizes[i].len);
+			if (region) {
+				*(uint64_t *)((char *)region +
+					      sizes[i].offset) =
+					parse_size(val);
+				found++;
+			}
+			break;
+		}
+	}
+
+	return found;
+}
+
+/**
+ * igt_parse_drm_fdinfo:
+ * @dir: fdinfo directory of a process
+ * @fd: name of the fd in @dir
+ * @info: parsed client
+ *
+ * Returns: the number of DRM keys found, 0 if it is not a DRM fd.
+ */
+unsigned int igt_parse_drm_fdinfo(int dir, const char *fd,
+				  struct drm_client_fdinfo *info)
+{
+	char buf[8192];
+	ssize_t len;
+	int fdinfo;
+
+	fdinfo = openat(dir, fd, O_RDONLY);
+	if (fdinfo < 0)
+		return 0;
+
+	len = read(fdinfo, buf, sizeof(buf) - 1);
+	close(fdinfo);
+	if (len <= 0)
+		return 0;
+	buf[len] = '\0';
+
+	return __igt_parse_drm_fdinfo(buf, info);
+}
+
+static void close_process(struct igt_drm_clients_iter *it)
+{
+	if (it->fds)
+		closedir(it->fds);
+	if (it->fdinfo_dir >= 0)
+		close(it->fdinfo_dir);
+	if (it->pid_dir >= 0)
+		close(it->pid_dir);
+
+	it->fds = NULL;
+	it->fdinfo_dir = -1;
+	it->pid_dir = -1;
+	it->fd = -1;
+	it->fd_name = NULL;
+}
+
+/**
+ * igt_drm_clients_iter_init:
+ * @it: iterator
+ * @root: prefix of the procfs path, "" for the live system
+ *
+ * Starts a walk over the fds of all processes, as in:
+ *
+ * |[<!-- language="c" -->
+ *	igt_drm_clients_iter_init(&it, "");
+ *	while (igt_drm_clients_next_process(&it))
+ *		while (igt_drm_clients_next_fd(&it))
+ *			if (igt_drm_clients_fd_is_drm(&it) &&
+ *			    igt_drm_clients_fd_parse(&it, &info))
+ *				...
+ *	igt_drm_clients_iter_fini(&it);
+ * ]|
+ *
+ * Returns: 0 on success, negative error code otherwise.
+ */
+int igt_drm_clients_iter_init(struct igt_drm_clients_iter *it,
+			      const char *root)
+{
+	char path[PATH_MAX];
+
+	memset(it, 0, sizeof(*it));
+	it->pid_dir = -1;
+	it->fdinfo_dir = -1;
+	it->fd = -1;
+
+	snprintf(path, sizeof(path), "%s/proc", root);
+	it->proc = opendir(path);
+	if (!it->proc)
+		return -errno;
+
+	return 0;
+}
+
+/**
+ * igt_drm_clients_next_process:
+ * @it: iterator
+ *
+ * Moves to the next process whose fds can be listed.
+ *
+ * Returns: false once all processes have been walked.
+ */
+bool igt_drm_clients_next_process(struct igt_drm_clients_iter *it)
+{
+	struct dirent *dent;
+
+	close_process(it);
+
+	while ((dent = readdir(it->proc))) {
+		int fd_dir;
+
+		if (!isdigit(dent->d_name[0]))
+			continue;
+
+		it->pid_dir = openat(dirfd(it->proc), dent->d_name,
+				     O_RDONLY | O_DIRECTORY);
+		if (it->pid_dir < 0)
+			continue;
+
+		fd_dir = openat(it->pid_dir, "fd", O_RDONLY | O_DIRECTORY);
+		if (fd_dir >= 0) {
+			it->fds = fdopendir(fd_dir);
+			if (!it->fds)
+				close(fd_dir);
+		}
+		it->fdinfo_dir = openat(it->pid_dir, "fdinfo",
+					O_RDONLY | O_DIRECTORY);
+		if (!it->fds || it->fdinfo_dir < 0) {
+			close_process(it);
+			continue;
+		}
+
+		it->pid = atoi(dent->d_name);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * igt_drm_clients_next_fd:
+ * @it: iterator
+ *
+ * Moves to the next fd of the current process.
+ *
+ * Returns: false once all its fds have been walked.
+ */
+bool igt_drm_clients_next_fd(struct igt_drm_clients_iter *it)
+{
+	struct dirent *dent;
+
+	while ((dent = readdir(it->fds))) {
+		if (!isdigit(dent->d_name[0]))
+			continue;
+
+		it->fd = atoi(dent->d_name);
+		it->fd_name = dent->d_name;
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * igt_drm_clients_fd_is_drm:
+ * @it: iterator
+ *
+ * Returns: whether the current fd points into /dev/dri.
+ */
+bool igt_drm_clients_fd_is_drm(struct igt_drm_clients_iter *it)
+{
+	char target[64];
+	ssize_t len;
+
+	len = readlinkat(dirfd(it->fds), it->fd_name, target,
+			 sizeof(target) - 1);
+	if (len <= 0)
+		return false;
+	target[len] = '\0';
+
+	return !strncmp(target, "/dev/dri/", 9);
+}
+
+/**
+ * igt_drm_clients_fd_parse:
+ * @it: iterator
+ * @info: parsed client
+ *
+ * Returns: the number of DRM keys in the fdinfo of the current fd.
+ */
+unsigned int igt_drm_clients_fd_parse(struct igt_drm_clients_iter *it,
+				      struct drm_client_fdinfo *info)
+{
+	return igt_parse_drm_fdinfo(it->fdinfo_dir, it->fd_name, info);
+}
+
+/**
+ * igt_drm_clients_iter_fini:
+ * @it: iterator
+ */
+void igt_drm_clients_iter_fini(struct igt_drm_clients_iter *it)
+{
+	close_process(it);
+	if (it->proc)
+		closedir(it->proc);
+	it->proc = NULL;
+}
+
+/**
+ * igt_drm_mem_init:
+ * @mem: collector
+ * @root: prefix of the procfs and debugfs paths, "" for the live system
+ * @driver: only account clients of this driver, or NULL for all
+ */
+void igt_drm_mem_init(struct igt_drm_mem *mem, const char *root,
+		      const char *driver)
+{
+	memset(mem, 0, sizeof(*mem));
+	mem->root = root;
+	mem->driver = driver;
+}
+
+static int pid_cmp(const void *A, const void *B)
+{
+	const struct drm_mem_pid *a = A, *b = B;
+
+	return a->pid < b->pid ? -1 : a->pid > b->pid;
+}
+
+static int process_cmp(const void *A, const void *B)
+{
+	const struct igt_drm_mem_process *a = A, *b = B;
+
+	return a->pid < b->pid ? -1 : a->pid > b->pid;
+}
+
+static int fd_cmp(const void *A, const void *B)
+{
+	const struct drm_mem_fd *a = A, *b = B;
+
+	return a->fd < b->fd ? -1 : a->fd > b->fd;
+}
+
+static int read_small(int dir, const char *name, char *buf, size_t size)
+{
+	ssize_t len;
+	int fd;
+
+	fd = openat(dir, name, O_RDONLY);
+	if (fd < 0)
+		return -1;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len < 0)
+		return -1;
+
+	while (len && buf[len - 1] == '\n')
+		len--;
+	buf[len] = '\0';
+
+	return len;
+}
+
+/* The cgroup v2 path, or the one of the first hierarchy on v1. */
+static char *read_cgroup(int dir)
+{
+	char buf[4096], *line, *path = NULL;
+
+	if (read_small(dir, "cgroup", buf, sizeof(buf)) <= 0)
+		return NULL;
+
+	for (line = strtok(buf, "\n"); line; line = strtok(NULL, "\n")) {
+		char *s = strchr(line, ':');
+
+		if (!s || !(s = strchr(s + 1, ':')))
+			continue;
+
+		if (!strncmp(line, "0::", 3) || !path)
+			path = s + 1;
+	}
+
+	return path ? strdup(path) : NULL;
+}
+
+static void add_regions(struct igt_drm_mem_process *p,
+			const struct drm_client_fdinfo *info)
+{
+	unsigned int i;
+
+	for (i = 0; i < info->num_regions; i++) {
+		const struct drm_fdinfo_memory *src = &info->region[i];
+		struct drm_fdinfo_memory *dst;
+
+		dst = find_region(p->region, &p->num_regions,
+				  src->region, strlen(src->region));
+		if (!dst)
+			continue;
+
+		dst->total += src->total;
+		dst->shared += src->shared;
+		dst->resident += src->resident;
+		dst->purgeable += src->purgeable;
+		dst->active += src->active;
+	}
+}
+
+static bool seen_client(const unsigned long *ids, unsigned int count,
+			unsigned long id)
+{
+	while (count--)
+		if (ids[count] == id)
+			return true;
+
+	return false;
+}
+
+/*
+ * Identifies what the current fd points to, so a number closed and reused for
+ * another file is not mistaken for the cached one. Links in a fake tree under
+ * a root point at device nodes which don't exist, those use the link itself.
+ */
+static bool fd_stat(struct igt_drm_clients_iter *it, struct stat *st)
+{
+	int dir = dirfd(it->fds);
+
+	return fstatat(dir, it->fd_name, st, 0) == 0 ||
+	       fstatat(dir, it->fd_name, st, AT_SYMLINK_NOFOLLOW) == 0;
+}
+
+/*
+ * Walk the fds of one process. Only fds which weren't there on the previous
+ * update, or now point to another file, are resolved, and fdinfo is read once
+ * for each DRM client.
+ */
+static void scan_pid(struct igt_drm_mem *mem, struct drm_mem_pid *pid,
+		     struct igt_drm_clients_iter *it,
+		     struct igt_drm_mem_process *out,
+		     unsigned int *clients_without_memory)
+{
+	struct drm_mem_fd *fds = NULL;
+	unsigned int num_fds = 0, max_fds = 0;
+	unsigned long *ids = NULL;
+	unsigned int num_ids = 0;
+	bool full = pid->scans++ % DRM_MEM_RESCAN == 0;
+
+	while (igt_drm_clients_next_fd(it)) {
+		struct drm_mem_fd key, *cached, *entry;
+		struct drm_client_fdinfo info;
+		struct stat st;
+
+		/* Closed since it was listed. */
+		if (!fd_stat(it, &st))
+			continue;
+
+		key.fd = it->fd;
+		cached = bsearch(&key, pid->fds, pid->num_fds,
+				 sizeof(*pid->fds), fd_cmp);
+		if (cached &&
+		    (cached->dev != st.st_dev || cached->ino != st.st_ino))
+			cached = NULL;
+
+		if (num_fds == max_fds) {
+			max_fds = max_fds ? 2 * max_fds : 16;
+			fds = realloc(fds, max_fds * sizeof(*fds));
+			if (!fds)
+				break;
+		}
+		entry = &fds[num_fds++];
+
+		if (cached && !full) {
+			*entry = *cached;
+		} else {
+			mem->fds_resolved++;
+
+			entry->fd = key.fd;
+			entry->dev = st.st_dev;
+			entry->ino = st.st_ino;
+			entry->drm = igt_drm_clients_fd_is_drm(it);
+			entry->id = cached ? cached->id : 0;
+		}
+
+		if (!entry->drm)
+			continue;
+
+		/* Another fd of a client already accounted for. */
+		if (!full && entry->id && seen_client(ids, num_ids, entry->id))
+			continue;
+
+		mem->fdinfo_reads++;
+		if (!igt_drm_clients_fd_parse(it, &info)) {
+			entry->drm = false;
+			continue;
+		}
+
+		entry->id = info.id;
+		if (seen_client(ids, num_ids, info.id))
+			continue;
+
+		if (mem->driver && strcmp(info.driver, mem->driver))
+			continue;
+
+		ids = realloc(ids, (num_ids + 1) * sizeof(*ids));
+		if (!ids)
+			break;
+		ids[num_ids++] = info.id;
+
+		if (!info.num_regions)
+			(*clients_without_memory)++;
+
+		out->num_clients++;
+		add_regions(out, &info);
+	}
+
+	free(ids);
+
+	qsort(fds, num_fds, sizeof(*fds), fd_cmp);
+	free(pid->fds);
+	pid->fds = fds;
+	pid->num_fds = num_fds;
+}
+
+/*
+ * Fallback for drivers without memory keys in fdinfo, the per command totals
+ * from i915_gem_objects:
+ *
+ *	Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound)
+ */
+static void scan_debugfs(struct igt_drm_mem *mem)
+{
+	char path[PATH_MAX];
+	struct dirent *dent;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "%s/sys/kernel/debug/dri", mem->root);
+	d = opendir(path);
+	if (!d)
+		return;
+
+	while ((dent = readdir(d))) {
+		static char buf[64 << 10];
+		char *line, *save;
+		int dir;
+
+		if (!isdigit(dent->d_name[0]))
+			continue;
+
+		dir = openat(dirfd(d), dent->d_name, O_RDONLY | O_DIRECTORY);
+		if (dir < 0)
+			continue;
+
+		if (read_small(dir, "i915_gem_objects", buf, sizeof(buf)) <= 0) {
+			close(dir);
+			continue;
+		}
+		close(dir);
+
+		for (line = strtok_r(buf, "\n", &save); line;
+		     line = strtok_r(NULL, "\n", &save)) {
+			struct igt_drm_mem_process *p;
+			unsigned long count, bytes;
+			char *colon = strchr(line, ':');
+
+			if (!colon ||
+			    sscanf(colon + 1, "%lu objects, %lu bytes",
+				   &count, &bytes) != 2)
+				continue;
+
+			p = realloc(mem->processes,
+				    (mem->num_processes + 1) * sizeof(*p));
+			if (!p)
+				break;
+			mem->processes = p;
+
+			p = &mem->processes[mem->num_processes++];
+			memset(p, 0, sizeof(*p));
+			while (isspace(*line))
+				line++;
+			copy_value(p->comm, sizeof(p->comm), line, colon - line);
+			p->num_clients = 1;
+			p->num_regions = 1;
+			strcpy(p->region[0].region, "gem");
+			p->region[0].total = bytes;
+			p->region[0].resident = bytes;
+		}
+	}
+
+	closedir(d);
+
+	mem->debugfs = true;
+}
+
+/**
+ * igt_drm_mem_update:
+ * @mem: collector
+ *
+ * Rescans the DRM clients of all processes and rebuilds mem->processes,
+ * which stays valid until the next update. Memory is taken from the fdinfo
+ * keys, falling back to debugfs when the driver doesn't provide them.
+ *
+ * Returns: 0 on success, negative error code otherwise.
+ */
+int igt_drm_mem_update(struct igt_drm_mem *mem)
+{
+	struct drm_mem_pid *pids = NULL;
+	unsigned int num_pids = 0, max_pids = 0;
+	unsigned int clients_without_memory = 0, clients = 0;
+	struct igt_drm_clients_iter it;
+	unsigned int i;
+	int ret;
+
+	mem->generation++;
+	mem->fds_resolved = 0;
+	mem->fdinfo_reads = 0;
+	mem->num_processes = 0;
+	mem->debugfs = false;
+
+	ret = igt_drm_clients_iter_init(&it, mem->root);
+	if (ret)
+		return ret;
+
+	while (igt_drm_clients_next_process(&it)) {
+		struct igt_drm_mem_process process = { };
+		struct drm_mem_pid key, *pid;
+
+		if (num_pids == max_pids) {
+			max_pids = max_pids ? 2 * max_pids : 256;
+			pids = realloc(pids, max_pids * sizeof(*pids));
+			if (!pids) {
+				igt_drm_clients_iter_fini(&it);
+				return -ENOMEM;
+			}
+		}
+
+		key.pid = it.pid;
+		pid = bsearch(&key, mem->pids, mem->num_pids,
+			      sizeof(*mem->pids), pid_cmp);
+		if (pid) {
+			/* Moved over, the old array no longer owns it. */
+			pids[num_pids] = *pid;
+			pid->generation = 0;
+		} else {
+			memset(&pids[num_pids], 0, sizeof(pids[num_pids]));
+			pids[num_pids].pid = key.pid;
+		}
+		pid = &pids[num_pids++];
+		pid->generation = mem->generation;
+
+		scan_pid(mem, pid, &it, &process, &clients_without_memory);
+
+		clients += process.num_clients;
+		if (process.num_clients) {
+			struct igt_drm_mem_process *p;
+
+			if (!pid->comm[0])
+				read_small(it.pid_dir, "comm", pid->comm,
+					   sizeof(pid->comm));
+			if (!pid->cgroup)
+				pid->cgroup = read_cgroup(it.pid_dir);
+
+			p = realloc(mem->processes,
+				    (mem->num_processes + 1) * sizeof(*p));
+			if (p) {
+				mem->processes = p;
+				process.pid = pid->pid;
+				memcpy(process.comm, pid->comm,
+				       sizeof(process.comm));
+				process.cgroup = pid->cgroup;
+				mem->processes[mem->num_processes++] = process;
+			}
+		}
+	}
+	igt_drm_clients_iter_fini(&it);
+
+	/* Processes which exited. */
+	for (i = 0; i < mem->num_pids; i++) {
+		if (mem->pids[i].generation == mem->generation - 1) {
+			free(mem->pids[i].fds);
+			free(mem->pids[i].cgroup);
+		}
+	}
+	free(mem->pids);
+
+	qsort(pids, num_pids, sizeof(*pids), pid_cmp);
+	mem->pids = pids;
+	mem->num_pids = num_pids;
+
+	qsort(mem->processes, mem->num_processes, sizeof(*mem->processes),
+	      process_cmp);
+
+	/* None of the clients had memory keys, try debugfs instead. */
+	if (clients && clients_without_memory == clients) {
+		mem->num_processes = 0;
+		scan_debugfs(mem);
+	}
+
+	return 0;
+}
+
+/**
+ * igt_drm_mem_fini:
+ * @mem: collector
+ */
+void igt_drm_mem_fini(struct igt_drm_mem *mem)
+{
+	unsigned int i;
+
+	for (i = 0; i < mem->num_pids; i++) {
+		free(mem->pids[i].fds);
+		free(mem->pids[i].cgroup);
+	}
+	free(mem->pids);
+	free(mem->processes);
+	memset(mem, 0, sizeof(*mem));
+}
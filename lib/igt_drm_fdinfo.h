@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+#ifndef IGT_DRM_FDINFO_H
+#define IGT_DRM_FDINFO_H
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define DRM_FDINFO_MAX_REGIONS 8
+#define DRM_FDINFO_MAX_ENGINES 16
+
+/* Busy time of a client on one engine class. */
+struct drm_fdinfo_engine {
+	char name[32];
+	uint64_t busy_ns;
+	unsigned int capacity;
+};
+
+/* Sizes in bytes of the objects of a client in one memory region. */
+struct drm_fdinfo_memory {
+	char region[16];
+	uint64_t total;
+	uint64_t shared;
+	uint64_t resident;
+	uint64_t purgeable;
+	uint64_t active;
+};
+
+struct drm_client_fdinfo {
+	char driver[32];
+	char pdev[32];
+	unsigned long id;
+
+	unsigned int num_engines;
+	struct drm_fdinfo_engine engine[DRM_FDINFO_MAX_ENGINES];
+
+	unsigned int num_regions;
+	struct drm_fdinfo_memory region[DRM_FDINFO_MAX_REGIONS];
+};
+
+unsigned int __igt_parse_drm_fdinfo(const char *buf,
+				    struct drm_client_fdinfo *info);
+unsigned int igt_parse_drm_fdinfo(int dir, const char *fd,
+				  struct drm_client_fdinfo *info);
+
+/* Walks the fds of all processes, see igt_drm_clients_iter_init(). */
+struct igt_drm_clients_iter {
+	/* The current process and its /proc directory. */
+	pid_t pid;
+	int pid_dir;
+
+	/* The current fd of that process and its name in fdinfo. */
+	int fd;
+	const char *fd_name;
+
+	/* Internal. */
+	DIR *proc;
+	DIR *fds;
+	int fdinfo_dir;
+};
+
+int igt_drm_clients_iter_init(struct igt_drm_clients_iter *it,
+			      const char *root);
+bool igt_drm_clients_next_process(struct igt_drm_clients_iter *it);
+bool igt_drm_clients_next_fd(struct igt_drm_clients_iter *it);
+bool igt_drm_clients_fd_is_drm(struct igt_drm_clients_iter *it);
+unsigned int igt_drm_clients_fd_parse(struct igt_drm_clients_iter *it,
+				      struct drm_client_fdinfo *info);
+void igt_drm_clients_iter_fini(struct igt_drm_clients_iter *it);
+
+/* GPU memory of one process, summed over its DRM clients. */
+struct igt_drm_mem_process {
+	pid_t pid;
+	char comm[32];
+	char *cgroup;
+	unsigned int num_clients;
+	unsigned int num_regions;
+	struct drm_fdinfo_memory region[DRM_FDINFO_MAX_REGIONS];
+};
+
+struct igt_drm_mem {
+	const char *root;
+	const char *driver;
+
+	/* Sorted by pid, only processes with DRM clients are reported. */
+	struct igt_drm_mem_process *processes;
+	unsigned int num_processes;
+
+	/* Set when memory comes from debugfs, per comm without pid. */
+	bool debugfs;
+
+	/* Work done by the last update, for the incremental tracking. */
+	unsigned long fds_resolved;
+	unsigned long fdinfo_reads;
+
+	/* Internal. */
+	struct drm_mem_pid *pids;
+	unsigned int num_pids;
+	unsigned int generation;
+};
+
+void igt_drm_mem_init(struct igt_drm_mem *mem, const char *root,
+		      const char *driver);
+int igt_drm_mem_update(struct igt_drm_mem *mem);
+void igt_drm_mem_fini(struct igt_drm_mem *mem);
+
+#endif /* IGT_DRM_FDINFO_H */
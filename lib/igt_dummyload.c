@@ -381,7 +381,7 @@ spin_create(int fd, const struct igt_spin_factory *opts)
 	spin = calloc(1, sizeof(struct igt_spin));
 	igt_assert(spin);
 
-	spin->timerfd = -1;
+	spin->timer_idx = -1;
 	spin->out_fence = emit_recursive_batch(spin, fd, opts);
 
 	pthread_mutex_lock(&list_lock);
@@ -451,20 +451,201 @@ igt_spin_factory(int fd, const struct igt_spin_factory *opts)
 	return spin;
 }
 
+/*
+ * All spinner timeouts are serviced by a single lazily started realtime thread
+ * waiting on one timerfd, which is always armed for the earliest deadline kept
+ * at the top of a binary min-heap of spinners. Each spinner tracks its own
+ * position in the heap so cancelling a timeout is O(log n) as well.
+ */
+static struct {
+	pthread_mutex_t lock;
+	pthread_t thread;
+	int timerfd;
+	igt_spin_t **heap;
+	unsigned int count, size;
+} timers = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.timerfd = -1,
+};
+
+static void timer_heap_set(unsigned int idx, igt_spin_t *spin)
+{
+	timers.heap[idx] = spin;
+	spin->timer_idx = idx;
+}
+
+static void timer_heap_up(unsigned int idx)
+{
+	igt_spin_t *spin = timers.heap[idx];
+
+	while (idx) {
+		unsigned int parent = (idx - 1) / 2;
+
+		if (timers.heap[parent]->timeout <= spin->timeout)
+			break;
+
+		timer_heap_set(idx, timers.heap[parent]);
+		idx = parent;
+	}
+
+	timer_heap_set(idx, spin);
+}
+
+static void timer_heap_down(unsigned int idx)
+{
+	igt_spin_t *spin = timers.heap[idx];
+
+	for (;;) {
+		unsigned int child = 2 * idx + 1;
+
+		if (child >= timers.count)
+			break;
+
+		if (child + 1 < timers.count &&
+		    timers.heap[child + 1]->timeout < timers.heap[child]->timeout)
+			child++;
+
+		if (spin->timeout <= timers.heap[child]->timeout)
+			break;
+
+		timer_heap_set(idx, timers.heap[child]);
+		idx = child;
+	}
+
+	timer_heap_set(idx, spin);
+}
+
+static void timer_heap_remove(igt_spin_t *spin)
+{
+	unsigned int idx = spin->timer_idx;
+	igt_spin_t *last;
+
+	igt_assert(idx < timers.count && timers.heap[idx] == spin);
+	spin->timer_idx = -1;
+
+	last = timers.heap[--timers.count];
+	if (last == spin)
+		return;
+
+	timer_heap_set(idx, last);
+	if (idx && timers.heap[(idx - 1) / 2]->timeout > last->timeout)
+		timer_heap_up(idx);
+	else
+		timer_heap_down(idx);
+}
+
+static void timer_rearm(void)
+{
+	struct itimerspec its = {};
+
+	/* A zeroed it_value disarms the timer when nothing is pending. */
+	if (timers.count) {
+		uint64_t ns = timers.heap[0]->timeout;
+
+		its.it_value.tv_sec = ns / NSEC_PER_SEC;
+		its.it_value.tv_nsec = ns % NSEC_PER_SEC;
+	}
+
+	igt_assert(timerfd_settime(timers.timerfd, TFD_TIMER_ABSTIME,
+				   &its, NULL) == 0);
+}
+
+static uint64_t timer_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
 static void *timer_thread(void *data)
 {
-	igt_spin_t *spin = data;
-	uint64_t overruns = 0;
+	for (;;) {
+		uint64_t overruns = 0, now;
 
-	/* Wait until we see the timer fire, or we get cancelled */
-	do {
-		read(spin->timerfd, &overruns, sizeof(overruns));
-	} while (!overruns);
+		if (read(timers.timerfd, &overruns, sizeof(overruns)) < 0 &&
+		    errno != EINTR)
+			break;
+
+		pthread_mutex_lock(&timers.lock);
+		now = timer_now();
+		while (timers.count && timers.heap[0]->timeout <= now) {
+			igt_spin_t *spin = timers.heap[0];
+
+			timer_heap_remove(spin);
+			igt_spin_end(spin);
+		}
+		timer_rearm();
+		pthread_mutex_unlock(&timers.lock);
+	}
 
-	igt_spin_end(spin);
 	return NULL;
 }
 
+static void timer_atfork_child(void)
+{
+	unsigned int i;
+
+	/*
+	 * The service thread does not survive fork and the timerfd is shared
+	 * with the parent, so start afresh on next use. Inherited spinners
+	 * keep being timed out by the parent only.
+	 */
+	pthread_mutex_init(&timers.lock, NULL);
+
+	for (i = 0; i < timers.count; i++)
+		timers.heap[i]->timer_idx = -1;
+	timers.count = 0;
+
+	if (timers.timerfd >= 0)
+		close(timers.timerfd);
+	timers.timerfd = -1;
+}
+
+static void timer_start(void)
+{
+	struct sched_param param = { .sched_priority = 99 };
+	static bool registered;
+	pthread_attr_t attr;
+	int err;
+
+	if (timers.timerfd >= 0)
+		return;
+
+	if (!registered) {
+		pthread_atfork(NULL, NULL, timer_atfork_child);
+		registered = true;
+	}
+
+	timers.timerfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	igt_assert(timers.timerfd >= 0);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+	pthread_attr_setschedparam(&attr, &param);
+
+	err = pthread_create(&timers.thread, &attr, timer_thread, NULL);
+	if (err == EPERM) /* Unprivileged, fall back to normal scheduling. */
+		err = pthread_create(&timers.thread, NULL, timer_thread, NULL);
+	igt_assert_eq(err, 0);
+	pthread_attr_destroy(&attr);
+}
+
+static void timer_cancel(igt_spin_t *spin)
+{
+	pthread_mutex_lock(&timers.lock);
+	if (spin->timer_idx >= 0) {
+		bool first = spin->timer_idx == 0;
+
+		timer_heap_remove(spin);
+		if (first)
+			timer_rearm();
+	}
+	pthread_mutex_unlock(&timers.lock);
+}
+
 /**
  * igt_spin_set_timeout:
  * @spin: spin state from igt_spin_new()
@@ -476,33 +657,30 @@ static void *timer_thread(void *data)
  */
 void igt_spin_set_timeout(igt_spin_t *spin, int64_t ns)
 {
-	struct sched_param param = { .sched_priority = 99 };
-	struct itimerspec its;
-	pthread_attr_t attr;
-	int timerfd;
-
 	igt_assert(ns > 0);
 	if (!spin)
 		return;
 
-	igt_assert(spin->timerfd == -1);
-	timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
-	igt_assert(timerfd >= 0);
-	spin->timerfd = timerfd;
+	pthread_mutex_lock(&timers.lock);
 
-	pthread_attr_init(&attr);
-	pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-	pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-	pthread_attr_setschedparam(&attr, &param);
+	igt_assert(spin->timer_idx < 0);
+	timer_start();
 
-	igt_assert(pthread_create(&spin->timer_thread, &attr,
-				  timer_thread, spin) == 0);
-	pthread_attr_destroy(&attr);
+	if (timers.count == timers.size) {
+		timers.size = timers.size ? 2 * timers.size : 64;
+		timers.heap = realloc(timers.heap,
+				      timers.size * sizeof(*timers.heap));
+		igt_assert(timers.heap);
+	}
+
+	spin->timeout = timer_now() + ns;
+	timer_heap_set(timers.count++, spin);
+	timer_heap_up(spin->timer_idx);
 
-	memset(&its, 0, sizeof(its));
-	its.it_value.tv_sec = ns / NSEC_PER_SEC;
-	its.it_value.tv_nsec = ns % NSEC_PER_SEC;
-	igt_assert(timerfd_settime(timerfd, 0, &its, NULL) == 0);
+	if (spin->timer_idx == 0)
+		timer_rearm();
+
+	pthread_mutex_unlock(&timers.lock);
 }
 
 /**
@@ -540,11 +718,7 @@ void igt_spin_end(igt_spin_t *spin)
 
 static void __igt_spin_free(int fd, igt_spin_t *spin)
 {
-	if (spin->timerfd >= 0) {
-		pthread_cancel(spin->timer_thread);
-		igt_assert(pthread_join(spin->timer_thread, NULL) == 0);
-		close(spin->timerfd);
-	}
+	timer_cancel(spin);
 
 	igt_spin_end(spin);
 
@@ -47,8 +47,8 @@ typedef struct igt_spin {
 #define SPIN_POLL_START_IDX 0
 
 	struct timespec last_signal;
-	pthread_t timer_thread;
-	int timerfd;
+	uint64_t timeout; /* CLOCK_MONOTONIC deadline, ns */
+	int timer_idx;
 
 	int out_fence;
 	struct drm_i915_gem_exec_object2 obj[2];
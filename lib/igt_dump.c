@@ -0,0 +1,589 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "drm_fourcc.h"
+#include "igt_core.h"
+#include "igt_dump.h"
+#include "igt_list.h"
+
+/**
+ * SECTION:igt_dump
+ * @short_description: Asynchronous frame dumping
+ * @title: Frame dumps
+ * @include: igt_dump.h
+ *
+ * Encoding debug frames as PNG in the test thread can slow a test down so
+ * much that timing sensitive failures no longer reproduce. When the
+ * IGT_FRAME_DUMP_ASYNC environment variable is set, the frame dumping helpers
+ * instead copy the pixels into a pooled buffer and queue them for a
+ * background thread, which writes them compressed with zlib at its fastest
+ * setting into .igtdump files. Use igt_dump_to_png to convert those for
+ * viewing.
+ *
+ * IGT_FRAME_DUMP_ASYNC=drop discards frames while the queue is full rather
+ * than waiting for it to drain, and IGT_FRAME_DUMP_QUEUE sets the queue
+ * size in MiB (default 256).
+ */
+
+#define DUMP_MAX_IDLE 8
+#define DUMP_CHUNK (256 << 10)
+
+struct dump_job {
+	struct igt_list_head link;
+	char *path;
+	struct igt_dump_header hdr;
+	void *data;
+	size_t alloc;
+};
+
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t queued;
+	pthread_cond_t retired;
+	pthread_t thread;
+	pid_t pid;
+	bool running, stop, busy;
+
+	struct igt_list_head queue;
+	struct igt_list_head idle;
+	unsigned int nidle;
+	size_t queued_bytes, max_bytes;
+
+	enum igt_dump_policy policy;
+	unsigned long dropped;
+} dump = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.queued = PTHREAD_COND_INITIALIZER,
+	.retired = PTHREAD_COND_INITIALIZER,
+	.queue = { &dump.queue, &dump.queue },
+	.idle = { &dump.idle, &dump.idle },
+	.max_bytes = 256ul << 20,
+};
+
+/**
+ * igt_dump_is_async:
+ *
+ * Returns: whether frame dumps should go through the asynchronous service,
+ * as requested by the IGT_FRAME_DUMP_ASYNC environment variable.
+ */
+bool igt_dump_is_async(void)
+{
+	const char *env = getenv("IGT_FRAME_DUMP_ASYNC");
+
+	return env && strcmp(env, "0");
+}
+
+/**
+ * igt_dump_set_policy:
+ * @policy: what to do when the queue is full
+ * @max_bytes: size of the queue of pending frames, 0 to keep the current
+ *
+ * Overrides the back-pressure policy picked from the environment.
+ */
+void igt_dump_set_policy(enum igt_dump_policy policy, size_t max_bytes)
+{
+	pthread_mutex_lock(&dump.lock);
+	dump.policy = policy;
+	if (max_bytes)
+		dump.max_bytes = max_bytes;
+	pthread_cond_broadcast(&dump.retired);
+	pthread_mutex_unlock(&dump.lock);
+}
+
+/**
+ * igt_dump_filename:
+ * @path: the path a PNG would have been written to
+ *
+ * Returns: a newly allocated copy of @path with a trailing ".png" replaced
+ * by ".igtdump", or with ".igtdump" appended otherwise.
+ */
+char *igt_dump_filename(const char *path)
+{
+	size_t len = strlen(path);
+	char *name;
+
+	if (len > 4 && !strcmp(path + len - 4, ".png"))
+		len -= 4;
+
+	igt_assert(asprintf(&name, "%.*s.igtdump", (int)len, path) != -1);
+
+	return name;
+}
+
+static int write_all(int fd, const void *buf, size_t len)
+{
+	while (len) {
+		ssize_t ret = write(fd, buf, len);
+
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static int dump_write(const struct dump_job *job, void *out)
+{
+	z_stream zs = {};
+	int fd, err;
+
+	fd = open(job->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	err = write_all(fd, &job->hdr, sizeof(job->hdr));
+	if (err)
+		goto out;
+
+	/* Frames are mostly flat colours, run-length matching is plenty */
+	if (deflateInit2(&zs, Z_BEST_SPEED, Z_DEFLATED, 15, 8, Z_RLE) != Z_OK) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	zs.next_in = job->data;
+	zs.avail_in = job->hdr.size;
+	do {
+		zs.next_out = out;
+		zs.avail_out = DUMP_CHUNK;
+		deflate(&zs, Z_FINISH);
+
+		err = write_all(fd, out, DUMP_CHUNK - zs.avail_out);
+	} while (!err && zs.avail_out == 0);
+
+	deflateEnd(&zs);
+out:
+	close(fd);
+	return err;
+}
+
+static void retire_job(struct dump_job *job)
+{
+	free(job->path);
+	job->path = NULL;
+
+	if (dump.nidle < DUMP_MAX_IDLE) {
+		igt_list_add(&job->link, &dump.idle);
+		dump.nidle++;
+	} else {
+		free(job->data);
+		free(job);
+	}
+}
+
+static void *dump_thread(void *arg)
+{
+	void *out = malloc(DUMP_CHUNK);
+
+	pthread_mutex_lock(&dump.lock);
+	for (;;) {
+		struct dump_job *job;
+		int err;
+
+		while (igt_list_empty(&dump.queue) && !dump.stop)
+			pthread_cond_wait(&dump.queued, &dump.lock);
+		if (igt_list_empty(&dump.queue))
+			break;
+
+		job = igt_list_first_entry(&dump.queue, job, link);
+		igt_list_del(&job->link);
+		dump.busy = true;
+		pthread_mutex_unlock(&dump.lock);
+
+		err = out ? dump_write(job, out) : -ENOMEM;
+		if (err)
+			igt_warn("Failed to write frame dump %s: %s\n",
+				 job->path, strerror(-err));
+		else
+			igt_debug("Dumped frame to %s\n", job->path);
+
+		pthread_mutex_lock(&dump.lock);
+		dump.queued_bytes -= job->hdr.size;
+		dump.busy = false;
+		retire_job(job);
+		pthread_cond_broadcast(&dump.retired);
+	}
+	pthread_mutex_unlock(&dump.lock);
+
+	free(out);
+	return NULL;
+}
+
+static void dump_stop(void)
+{
+	pthread_mutex_lock(&dump.lock);
+	if (!dump.running) {
+		pthread_mutex_unlock(&dump.lock);
+		return;
+	}
+	dump.stop = true;
+	pthread_cond_signal(&dump.queued);
+	pthread_mutex_unlock(&dump.lock);
+
+	pthread_join(dump.thread, NULL);
+
+	dump.running = false;
+	dump.stop = false;
+
+	if (dump.dropped)
+		igt_warn("%lu frame dumps dropped, the encoder could not keep up\n",
+			 dump.dropped);
+}
+
+static void dump_exit_handler(int sig)
+{
+	/* Only drain the queue on a normal exit, not from a signal handler */
+	if (!sig)
+		dump_stop();
+}
+
+static void dump_atfork_child(void)
+{
+	/* The encoder and its queue stayed with the parent */
+	pthread_mutex_init(&dump.lock, NULL);
+	pthread_cond_init(&dump.queued, NULL);
+	pthread_cond_init(&dump.retired, NULL);
+	IGT_INIT_LIST_HEAD(&dump.queue);
+	IGT_INIT_LIST_HEAD(&dump.idle);
+	dump.nidle = 0;
+	dump.queued_bytes = 0;
+	dump.running = false;
+	dump.stop = false;
+	dump.busy = false;
+	dump.dropped = 0;
+}
+
+/* Called with dump.lock held */
+static bool dump_start(void)
+{
+	const char *env;
+
+	if (dump.running)
+		return true;
+
+	if (!dump.pid) {
+		env = getenv("IGT_FRAME_DUMP_ASYNC");
+		if (env && !strcmp(env, "drop"))
+			dump.policy = IGT_DUMP_DROP;
+
+		env = getenv("IGT_FRAME_DUMP_QUEUE");
+		if (env && atol(env) > 0)
+			dump.max_bytes = (size_t)atol(env) << 20;
+
+		pthread_atfork(NULL, NULL, dump_atfork_child);
+	}
+
+	if (pthread_create(&dump.thread, NULL, dump_thread, NULL))
+		return false;
+
+	if (dump.pid != getpid())
+		igt_install_exit_handler(dump_exit_handler);
+
+	dump.pid = getpid();
+	dump.running = true;
+
+	return true;
+}
+
+/* Called with dump.lock held */
+static struct dump_job *get_job(size_t size)
+{
+	struct dump_job *job, *best = NULL;
+
+	igt_list_for_each_entry(job, &dump.idle, link) {
+		if (job->alloc >= size) {
+			best = job;
+			break;
+		}
+		best = job;
+	}
+
+	if (best) {
+		igt_list_del(&best->link);
+		dump.nidle--;
+	} else {
+		best = calloc(1, sizeof(*best));
+		if (!best)
+			return NULL;
+	}
+
+	if (best->alloc < size) {
+		free(best->data);
+		best->data = malloc(size);
+		best->alloc = best->data ? size : 0;
+		if (!best->data) {
+			free(best);
+			return NULL;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * igt_dump_frame:
+ * @path: where to write the frame, see igt_dump_filename()
+ * @format: DRM fourcc of the pixels
+ * @width: width in pixels
+ * @height: height in pixels
+ * @stride: bytes per line
+ * @data: the pixels
+ *
+ * Copies the frame and queues it to be written in the background. Depending
+ * on the policy this waits for room in the queue or drops the frame when the
+ * queue is full. igt_dump_flush() waits for all queued frames to be written.
+ *
+ * Returns: false if the frame was dropped.
+ */
+bool igt_dump_frame(const char *path, uint32_t format,
+		    int width, int height, int stride, const void *data)
+{
+	size_t size = (size_t)stride * height;
+	struct dump_job *job;
+
+	pthread_mutex_lock(&dump.lock);
+	if (!dump_start())
+		goto drop;
+
+	/* An oversized frame still goes through once everything else is out */
+	while (dump.queued_bytes &&
+	       dump.queued_bytes + size > dump.max_bytes) {
+		if (dump.policy == IGT_DUMP_DROP)
+			goto drop;
+
+		pthread_cond_wait(&dump.retired, &dump.lock);
+	}
+
+	job = get_job(size);
+	if (!job)
+		goto drop;
+
+	/* Reserve our place in the queue while copying unlocked */
+	dump.queued_bytes += size;
+	pthread_mutex_unlock(&dump.lock);
+
+	job->path = igt_dump_filename(path);
+	memcpy(job->hdr.magic, IGT_DUMP_MAGIC, sizeof(job->hdr.magic));
+	job->hdr.format = format;
+	job->hdr.width = width;
+	job->hdr.height = height;
+	job->hdr.stride = stride;
+	job->hdr.size = size;
+	memcpy(job->data, data, size);
+
+	pthread_mutex_lock(&dump.lock);
+	igt_list_add_tail(&job->link, &dump.queue);
+	pthread_cond_signal(&dump.queued);
+	pthread_mutex_unlock(&dump.lock);
+
+	return true;
+
+drop:
+	dump.dropped++;
+	pthread_mutex_unlock(&dump.lock);
+	igt_debug("Dropped frame dump %s\n", path);
+	return false;
+}
+
+/**
+ * igt_dump_cairo_to_drm_format:
+ * @format: a cairo image format
+ *
+ * Returns: the matching DRM fourcc, or 0 if there is none.
+ */
+uint32_t igt_dump_cairo_to_drm_format(cairo_format_t format)
+{
+	switch (format) {
+	case CAIRO_FORMAT_ARGB32:
+		return DRM_FORMAT_ARGB8888;
+	case CAIRO_FORMAT_RGB24:
+		return DRM_FORMAT_XRGB8888;
+	case CAIRO_FORMAT_RGB30:
+		return DRM_FORMAT_XRGB2101010;
+	case CAIRO_FORMAT_RGB16_565:
+		return DRM_FORMAT_RGB565;
+	case CAIRO_FORMAT_A8:
+		return DRM_FORMAT_C8;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * igt_dump_drm_to_cairo_format:
+ * @format: a DRM fourcc
+ *
+ * Returns: the cairo image format matching a format written by
+ * igt_dump_cairo_surface(), or CAIRO_FORMAT_INVALID.
+ */
+cairo_format_t igt_dump_drm_to_cairo_format(uint32_t format)
+{
+	switch (format) {
+	case DRM_FORMAT_ARGB8888:
+		return CAIRO_FORMAT_ARGB32;
+	case DRM_FORMAT_XRGB8888:
+		return CAIRO_FORMAT_RGB24;
+	case DRM_FORMAT_XRGB2101010:
+		return CAIRO_FORMAT_RGB30;
+	case DRM_FORMAT_RGB565:
+		return CAIRO_FORMAT_RGB16_565;
+	case DRM_FORMAT_C8:
+		return CAIRO_FORMAT_A8;
+	default:
+		return CAIRO_FORMAT_INVALID;
+	}
+}
+
+/**
+ * igt_dump_cairo_surface:
+ * @path: where to write the frame, see igt_dump_filename()
+ * @surface: a cairo image surface
+ *
+ * Queues the contents of @surface with igt_dump_frame().
+ *
+ * Returns: false if the frame was dropped.
+ */
+bool igt_dump_cairo_surface(const char *path, cairo_surface_t *surface)
+{
+	uint32_t format;
+
+	cairo_surface_flush(surface);
+
+	format = igt_dump_cairo_to_drm_format(cairo_image_surface_get_format(surface));
+	igt_assert_f(format, "Unsupported cairo format for frame dumps\n");
+
+	return igt_dump_frame(path, format,
+			      cairo_image_surface_get_width(surface),
+			      cairo_image_surface_get_height(surface),
+			      cairo_image_surface_get_stride(surface),
+			      cairo_image_surface_get_data(surface));
+}
+
+/**
+ * igt_dump_flush:
+ *
+ * Waits until all queued frames have been written out.
+ */
+void igt_dump_flush(void)
+{
+	pthread_mutex_lock(&dump.lock);
+	if (dump.running)
+		while (!igt_list_empty(&dump.queue) || dump.busy)
+			pthread_cond_wait(&dump.retired, &dump.lock);
+	pthread_mutex_unlock(&dump.lock);
+}
+
+/**
+ * igt_dump_dropped:
+ *
+ * Returns: the number of frames dropped so far because the queue was full.
+ */
+unsigned long igt_dump_dropped(void)
+{
+	unsigned long dropped;
+
+	pthread_mutex_lock(&dump.lock);
+	dropped = dump.dropped;
+	pthread_mutex_unlock(&dump.lock);
+
+	return dropped;
+}
+
+/**
+ * igt_dump_read:
+ * @path: an .igtdump file
+ * @hdr: returns the header of the frame
+ * @data: returns the uncompressed pixels, to be freed by the caller
+ *
+ * Returns: 0 on success, or a negative error code.
+ */
+int igt_dump_read(const char *path, struct igt_dump_header *hdr, void **data)
+{
+	unsigned char in[64 << 10];
+	z_stream zs = {};
+	int fd, ret, err = 0;
+	void *out;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (read(fd, hdr, sizeof(*hdr)) != sizeof(*hdr) ||
+	    memcmp(hdr->magic, IGT_DUMP_MAGIC, sizeof(hdr->magic)) ||
+	    hdr->size < (uint64_t)hdr->stride * hdr->height) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	out = malloc(hdr->size);
+	if (!out || inflateInit(&zs) != Z_OK) {
+		free(out);
+		close(fd);
+		return -ENOMEM;
+	}
+
+	zs.next_out = out;
+	zs.avail_out = hdr->size;
+	do {
+		ssize_t len = read(fd, in, sizeof(in));
+
+		if (len <= 0) {
+			err = len < 0 ? -errno : -EINVAL;
+			break;
+		}
+
+		zs.next_in = in;
+		zs.avail_in = len;
+		ret = inflate(&zs, Z_NO_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END) {
+			err = -EINVAL;
+			break;
+		}
+	} while (ret != Z_STREAM_END);
+
+	inflateEnd(&zs);
+	close(fd);
+
+	if (err || zs.total_out != hdr->size) {
+		free(out);
+		return err ?: -EINVAL;
+	}
+
+	*data = out;
+	return 0;
+}
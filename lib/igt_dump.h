@@ -0,0 +1,80 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef IGT_DUMP_H
+#define IGT_DUMP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <cairo.h>
+
+/**
+ * igt_dump_policy:
+ * @IGT_DUMP_BLOCK: wait for the encoder to catch up when the queue is full
+ * @IGT_DUMP_DROP: discard frames submitted while the queue is full
+ *
+ * What igt_dump_frame() does when the queue of pending frames is full.
+ */
+enum igt_dump_policy {
+	IGT_DUMP_BLOCK,
+	IGT_DUMP_DROP,
+};
+
+#define IGT_DUMP_MAGIC "IGTDUMP1"
+
+/**
+ * igt_dump_header:
+ * @magic: #IGT_DUMP_MAGIC
+ * @format: DRM fourcc of the pixels
+ * @width: width in pixels
+ * @height: height in pixels
+ * @stride: bytes per line
+ * @size: size of the uncompressed pixel data
+ *
+ * Header of an .igtdump file. The pixel data follows as a zlib stream.
+ */
+struct igt_dump_header {
+	char magic[8];
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t stride;
+	uint64_t size;
+};
+
+bool igt_dump_is_async(void);
+void igt_dump_set_policy(enum igt_dump_policy policy, size_t max_bytes);
+char *igt_dump_filename(const char *path);
+bool igt_dump_frame(const char *path, uint32_t format,
+		    int width, int height, int stride, const void *data);
+bool igt_dump_cairo_surface(const char *path, cairo_surface_t *surface);
+void igt_dump_flush(void);
+unsigned long igt_dump_dropped(void);
+
+int igt_dump_read(const char *path, struct igt_dump_header *hdr, void **data);
+uint32_t igt_dump_cairo_to_drm_format(cairo_format_t format);
+cairo_format_t igt_dump_drm_to_cairo_format(uint32_t format);
+
+#endif /* IGT_DUMP_H */
@@ -116,6 +116,38 @@ enum igt_text_align {
 	align_hcenter	= 0x08,
 };
 
+/**
+ * IGT_FB_POOL_CLEAR:
+ *
+ * Flag for igt_fb_pool_enable() to zero (or, for YUV formats, clear to
+ * black) recycled buffers before handing them out again.
+ */
+#define IGT_FB_POOL_CLEAR (1 << 0)
+
+/**
+ * igt_fb_pool_stats:
+ * @created: buffer objects allocated from the kernel
+ * @reused: buffer objects recycled from the pool
+ * @mapped: CPU mappings created for pooled buffer objects
+ * @map_reused: CPU mappings recycled from the pool
+ * @ioctls_saved: ioctls avoided by recycling buffers and mappings
+ * @cached: idle buffer objects currently held by the pool
+ *
+ * Counters reported by igt_fb_pool_get_stats().
+ */
+struct igt_fb_pool_stats {
+	uint64_t created;
+	uint64_t reused;
+	uint64_t mapped;
+	uint64_t map_reused;
+	uint64_t ioctls_saved;
+	unsigned int cached;
+};
+
+void igt_fb_pool_enable(int fd, unsigned int flags);
+void igt_fb_pool_disable(int fd);
+bool igt_fb_pool_get_stats(int fd, struct igt_fb_pool_stats *stats);
+
 void igt_get_fb_tile_size(int fd, uint64_t modifier, int fb_bpp,
 			  unsigned *width_ret, unsigned *height_ret);
 void igt_calc_fb_size(int fd, int width, int height, uint32_t format, uint64_t modifier,
@@ -215,6 +247,7 @@ int igt_fill_cts_framebuffer(uint32_t *pixmap, uint32_t video_width,
 		uint32_t video_height, uint32_t bitdepth, int alpha);
 
 int igt_fb_get_fnv1a_crc(struct igt_fb *fb, igt_crc_t *crc);
+int igt_fb_get_fnv1a_crc_mapped(struct igt_fb *fb, void *map, igt_crc_t *crc);
 
 #endif /* __IGT_FB_H__ */
 
@@ -34,6 +34,7 @@
 
 #include "igt_frame.h"
 #include "igt_core.h"
+#include "igt_dump.h"
 
 /**
  * SECTION:igt_frame
@@ -77,11 +78,21 @@ static void igt_write_frame_to_png(cairo_surface_t *surface, int fd,
 		snprintf(path, PATH_MAX, "%s/frame-%s-%s-%s.png",
 			 igt_frame_dump_path, test_name, subtest_name, qualifier);
 
-	igt_debug("Dumping %s frame to %s...\n", qualifier, path);
+	if (igt_dump_is_async()) {
+		char *name = igt_dump_filename(path);
 
-	status = cairo_surface_write_to_png(surface, path);
+		igt_debug("Queueing %s frame dump to %s...\n", qualifier, name);
+		igt_dump_cairo_surface(path, surface);
 
-	igt_assert_eq(status, CAIRO_STATUS_SUCCESS);
+		snprintf(path, PATH_MAX, "%s", name);
+		free(name);
+	} else {
+		igt_debug("Dumping %s frame to %s...\n", qualifier, path);
+
+		status = cairo_surface_write_to_png(surface, path);
+
+		igt_assert_eq(status, CAIRO_STATUS_SUCCESS);
+	}
 
 	index = strlen(path);
 
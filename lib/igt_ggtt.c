@@ -0,0 +1,656 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_ggtt.h"
+#include "igt_x86.h"
+#include "intel_chipset.h"
+
+/**
+ * SECTION:igt_ggtt
+ * @short_description: GGTT layout and fragmentation
+ * @title: GGTT analysis
+ * @include: igt_ggtt.h
+ *
+ * Takes a copy of the global GTT page table, read live or saved to a file
+ * earlier, and works out what is bound where: runs of PTEs pointing to
+ * physically contiguous pages, to the scratch page or invalid, the holes
+ * left for new bindings and the largest allocation each alignment still
+ * fits, and how two snapshots differ.
+ *
+ * A 4GiB GGTT is a million PTEs, the boundaries between extents are found
+ * in a single pass four PTEs at a time with AVX2 where available.
+ */
+
+#define SNAPSHOT_MAGIC "IGTGGTT1"
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t devid;
+	uint32_t pte_size;
+	uint64_t num_entries;
+};
+
+static unsigned int pte_size(uint32_t devid)
+{
+	return intel_gen(devid) < 8 ? 4 : 8;
+}
+
+/* The physical address and flags of each PTE, as in get_phys() of intel_gtt */
+static void decode_ptes(struct igt_ggtt_snapshot *snap)
+{
+	unsigned int gen = intel_gen(snap->devid);
+	uint64_t addr_mask, pae_mask = 0;
+
+	if (gen >= 8) {
+		const uint64_t *pte = snap->ptes;
+
+		addr_mask = gen >= 12 ? 0x3ffffffff000ull : 0x7ffffff000ull;
+		for (uint64_t i = 0; i < snap->num_entries; i++)
+			snap->entries[i] = pte[i] &
+					   (addr_mask | IGT_GGTT_PTE_FLAGS);
+		return;
+	}
+
+	if (gen >= 6)
+		pae_mask = IS_HASWELL(snap->devid) ? 0x7f0 : 0xff0;
+	else if (gen >= 4 || IS_G33(snap->devid))
+		pae_mask = 0xf0;
+
+	for (uint64_t i = 0; i < snap->num_entries; i++) {
+		uint32_t pte = ((const uint32_t *)snap->ptes)[i];
+
+		snap->entries[i] = (pte & ~0xfffull) |
+				   (uint64_t)(pte & pae_mask) << 28 |
+				   (pte & 0xf);
+	}
+}
+
+/*
+ * The unused PTEs all point to the scratch page, which shows as the same
+ * address in consecutive PTEs. Other pages are bound once, bar the odd
+ * remapped view, so the scratch page is the majority of those.
+ */
+static uint64_t find_scratch(const struct igt_ggtt_snapshot *snap)
+{
+	const uint64_t *e = snap->entries;
+	uint64_t candidate = IGT_GGTT_NO_SCRATCH, votes = 0;
+	uint64_t repeats = 0, count = 0;
+
+	for (uint64_t i = 1; i < snap->num_entries; i++) {
+		if (!(e[i] & IGT_GGTT_PTE_VALID) || e[i] != e[i - 1])
+			continue;
+
+		if (!votes)
+			candidate = e[i] & ~IGT_GGTT_PTE_FLAGS;
+		if (candidate == (e[i] & ~IGT_GGTT_PTE_FLAGS))
+			votes++;
+		else
+			votes--;
+	}
+
+	for (uint64_t i = 1; i < snap->num_entries; i++) {
+		if (!(e[i] & IGT_GGTT_PTE_VALID) || e[i] != e[i - 1])
+			continue;
+
+		repeats++;
+		count += (e[i] & ~IGT_GGTT_PTE_FLAGS) == candidate;
+	}
+
+	return count && 2 * count > repeats ? candidate : IGT_GGTT_NO_SCRATCH;
+}
+
+static void snapshot_decode(struct igt_ggtt_snapshot *snap)
+{
+	snap->entries = malloc(snap->num_entries * sizeof(*snap->entries));
+	igt_assert(snap->entries || !snap->num_entries);
+
+	decode_ptes(snap);
+	snap->scratch = find_scratch(snap);
+}
+
+/**
+ * igt_ggtt_snapshot_init:
+ * @snap: the snapshot
+ * @devid: the PCI device id
+ * @ptes: the PTEs, 4 or 8 bytes each depending on @devid
+ * @num_entries: number of PTEs
+ *
+ * Takes a copy of the GGTT PTEs in @ptes, from a mapping of the GSM or
+ * anywhere else, and decodes them. The scratch page is guessed from the
+ * PTEs and can be overridden in @snap before igt_ggtt_analyse().
+ */
+void igt_ggtt_snapshot_init(struct igt_ggtt_snapshot *snap, uint32_t devid,
+			    const void *ptes, uint64_t num_entries)
+{
+	memset(snap, 0, sizeof(*snap));
+	snap->devid = devid;
+	snap->pte_size = pte_size(devid);
+	snap->num_entries = num_entries;
+
+	snap->ptes = malloc(num_entries * snap->pte_size);
+	igt_assert(snap->ptes || !num_entries);
+	memcpy(snap->ptes, ptes, num_entries * snap->pte_size);
+
+	snapshot_decode(snap);
+}
+
+/**
+ * igt_ggtt_snapshot_fini:
+ * @snap: the snapshot
+ */
+void igt_ggtt_snapshot_fini(struct igt_ggtt_snapshot *snap)
+{
+	free(snap->ptes);
+	free(snap->entries);
+	memset(snap, 0, sizeof(*snap));
+}
+
+/**
+ * igt_ggtt_snapshot_save:
+ * @snap: the snapshot
+ * @path: the file to write
+ *
+ * Saves the PTEs of @snap as they were read, along with the device id to
+ * decode them.
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_ggtt_snapshot_save(const struct igt_ggtt_snapshot *snap,
+			   const char *path)
+{
+	struct snapshot_header hdr = {
+		.devid = snap->devid,
+		.pte_size = snap->pte_size,
+		.num_entries = snap->num_entries,
+	};
+	size_t size = snap->num_entries * snap->pte_size;
+	int fd, ret = 0;
+
+	memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+		return -errno;
+
+	if (write(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    write(fd, snap->ptes, size) != size)
+		ret = -EIO;
+
+	close(fd);
+	return ret;
+}
+
+/**
+ * igt_ggtt_snapshot_load:
+ * @snap: the snapshot
+ * @path: a file written by igt_ggtt_snapshot_save()
+ *
+ * Returns: 0 on success, a negative errno otherwise.
+ */
+int igt_ggtt_snapshot_load(struct igt_ggtt_snapshot *snap, const char *path)
+{
+	struct snapshot_header hdr;
+	size_t size, pos;
+	struct stat st;
+	int fd;
+
+	memset(snap, 0, sizeof(*snap));
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	if (fstat(fd, &st) ||
+	    read(fd, &hdr, sizeof(hdr)) != sizeof(hdr) ||
+	    memcmp(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic)) ||
+	    hdr.pte_size != pte_size(hdr.devid) ||
+	    hdr.num_entries > (st.st_size - sizeof(hdr)) / hdr.pte_size) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	snap->devid = hdr.devid;
+	snap->pte_size = hdr.pte_size;
+	snap->num_entries = hdr.num_entries;
+
+	size = snap->num_entries * snap->pte_size;
+	snap->ptes = malloc(size);
+	igt_assert(snap->ptes || !size);
+	for (pos = 0; pos < size; ) {
+		ssize_t len = read(fd, (char *)snap->ptes + pos, size - pos);
+
+		if (len <= 0) {
+			close(fd);
+			igt_ggtt_snapshot_fini(snap);
+			return -EIO;
+		}
+		pos += len;
+	}
+	close(fd);
+
+	snapshot_decode(snap);
+	return 0;
+}
+
+static inline enum igt_ggtt_kind entry_kind(uint64_t e, uint64_t scratch)
+{
+	if (!(e & IGT_GGTT_PTE_VALID))
+		return IGT_GGTT_INVALID;
+
+	return (e & ~IGT_GGTT_PTE_FLAGS) == scratch ?
+		IGT_GGTT_SCRATCH : IGT_GGTT_MAPPED;
+}
+
+/*
+ * Sets the bit of each entry in [from, to) that starts a new extent in
+ * @breaks, and of each mapped entry not physically following the previous
+ * mapped entry in @chunks. @from must be at least 1.
+ */
+static void find_breaks(const uint64_t *e, uint64_t from, uint64_t to,
+			uint64_t scratch, uint64_t *breaks, uint64_t *chunks)
+{
+	for (uint64_t i = from; i < to; i++) {
+		enum igt_ggtt_kind k = entry_kind(e[i], scratch);
+		enum igt_ggtt_kind pk = entry_kind(e[i - 1], scratch);
+		bool mapped = k == IGT_GGTT_MAPPED && pk == IGT_GGTT_MAPPED;
+		bool brk, chk;
+
+		brk = k != pk ||
+		      (mapped && ((e[i] ^ e[i - 1]) & IGT_GGTT_PTE_FLAGS));
+		chk = mapped && e[i] != e[i - 1] + IGT_GGTT_PAGE_SIZE;
+
+		breaks[i / 64] |= (uint64_t)brk << (i % 64);
+		chunks[i / 64] |= (uint64_t)chk << (i % 64);
+	}
+}
+
+static void find_breaks_all(const uint64_t *e, uint64_t n, uint64_t scratch,
+			    uint64_t *breaks, uint64_t *chunks)
+{
+	find_breaks(e, 1, n, scratch, breaks, chunks);
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+/*
+ * The same four entries at a time, against the previous four through an
+ * unaligned load. Starting at entry 4, each group of four lands in the
+ * same word of the bitmaps.
+ */
+static void find_breaks_avx2(const uint64_t *e, uint64_t n, uint64_t scratch,
+			     uint64_t *breaks, uint64_t *chunks)
+{
+	const __m256i valid = _mm256_set1_epi64x(IGT_GGTT_PTE_VALID);
+	const __m256i flags = _mm256_set1_epi64x(IGT_GGTT_PTE_FLAGS);
+	const __m256i addr = _mm256_set1_epi64x(~IGT_GGTT_PTE_FLAGS);
+	const __m256i page = _mm256_set1_epi64x(IGT_GGTT_PAGE_SIZE);
+	const __m256i scr = _mm256_set1_epi64x(scratch);
+	uint64_t i;
+
+	find_breaks(e, 1, n < 4 ? n : 4, scratch, breaks, chunks);
+
+	for (i = 4; i + 4 <= n; i += 4) {
+		__m256i cur = _mm256_loadu_si256((const __m256i *)(e + i));
+		__m256i prev = _mm256_loadu_si256((const __m256i *)(e + i - 1));
+		__m256i cv, pv, cs, ps, cm, pm, mapped, brk, chk;
+
+		cv = _mm256_cmpeq_epi64(_mm256_and_si256(cur, valid), valid);
+		pv = _mm256_cmpeq_epi64(_mm256_and_si256(prev, valid), valid);
+		cs = _mm256_and_si256(cv, _mm256_cmpeq_epi64(_mm256_and_si256(cur, addr), scr));
+		ps = _mm256_and_si256(pv, _mm256_cmpeq_epi64(_mm256_and_si256(prev, addr), scr));
+		cm = _mm256_andnot_si256(cs, cv);
+		pm = _mm256_andnot_si256(ps, pv);
+		mapped = _mm256_and_si256(cm, pm);
+
+		brk = _mm256_or_si256(_mm256_xor_si256(cv, pv),
+				      _mm256_xor_si256(cs, ps));
+		brk = _mm256_or_si256(brk,
+				      _mm256_andnot_si256(_mm256_cmpeq_epi64(_mm256_and_si256(cur, flags),
+									     _mm256_and_si256(prev, flags)),
+							  mapped));
+		chk = _mm256_andnot_si256(_mm256_cmpeq_epi64(cur, _mm256_add_epi64(prev, page)),
+					  mapped);
+
+		breaks[i / 64] |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(brk)) << (i % 64);
+		chunks[i / 64] |= (uint64_t)_mm256_movemask_pd(_mm256_castsi256_pd(chk)) << (i % 64);
+	}
+
+	find_breaks(e, i, n, scratch, breaks, chunks);
+}
+
+#pragma GCC pop_options
+
+static void (*resolve_find_breaks(void))(const uint64_t *, uint64_t, uint64_t,
+					 uint64_t *, uint64_t *)
+{
+	if (igt_x86_features() & AVX2)
+		return find_breaks_avx2;
+
+	return find_breaks_all;
+}
+
+static void find_breaks_bulk(const uint64_t *e, uint64_t n, uint64_t scratch,
+			     uint64_t *breaks, uint64_t *chunks)
+	__attribute__((ifunc("resolve_find_breaks")));
+#else
+static void find_breaks_bulk(const uint64_t *e, uint64_t n, uint64_t scratch,
+			     uint64_t *breaks, uint64_t *chunks)
+{
+	find_breaks_all(e, n, scratch, breaks, chunks);
+}
+#endif
+
+/* Number of bits set in [from, to) */
+static uint64_t count_bits(const uint64_t *bitmap, uint64_t from, uint64_t to)
+{
+	uint64_t count = 0;
+
+	while (from < to) {
+		uint64_t word = bitmap[from / 64] >> (from % 64);
+		unsigned int len = 64 - from % 64;
+
+		if (to - from < len) {
+			word &= (1ull << (to - from)) - 1;
+			len = to - from;
+		}
+
+		count += __builtin_popcountll(word);
+		from += len;
+	}
+
+	return count;
+}
+
+static unsigned int order(uint64_t pages)
+{
+	unsigned int o = 63 - __builtin_clzll(pages);
+
+	return o < IGT_GGTT_ORDERS ? o : IGT_GGTT_ORDERS - 1;
+}
+
+static uint64_t align_up(uint64_t x, uint64_t alignment)
+{
+	return (x + alignment - 1) & -alignment;
+}
+
+static void add_hole(struct igt_ggtt_analysis *a, uint64_t offset,
+		     uint64_t size)
+{
+	uint64_t end = offset + size;
+
+	a->holes[a->num_holes++] = (struct igt_ggtt_range) {
+		.offset = offset,
+		.size = size,
+	};
+
+	a->hole_histogram[order(size / IGT_GGTT_PAGE_SIZE)]++;
+
+	for (unsigned int k = 0; k < IGT_GGTT_ORDERS; k++) {
+		uint64_t start = align_up(offset, IGT_GGTT_PAGE_SIZE << k);
+
+		if (start >= end)
+			break;
+		if (end - start > a->largest[k])
+			a->largest[k] = end - start;
+	}
+}
+
+/**
+ * igt_ggtt_analyse:
+ * @snap: the snapshot
+ * @analysis: the extents, holes and fragmentation of @snap
+ *
+ * Splits the GGTT of @snap into extents, and the invalid and scratch
+ * extents into holes. Release @analysis with igt_ggtt_analysis_fini().
+ */
+void igt_ggtt_analyse(const struct igt_ggtt_snapshot *snap,
+		      struct igt_ggtt_analysis *analysis)
+{
+	const uint64_t *e = snap->entries;
+	uint64_t n = snap->num_entries, words = (n + 63) / 64;
+	uint64_t *breaks, *chunks, *starts;
+	uint64_t num_starts = 0, hole = 0;
+	bool in_hole = false;
+
+	memset(analysis, 0, sizeof(*analysis));
+	if (!n)
+		return;
+
+	breaks = calloc(words, sizeof(*breaks));
+	chunks = calloc(words, sizeof(*chunks));
+	igt_assert(breaks && chunks);
+
+	find_breaks_bulk(e, n, snap->scratch, breaks, chunks);
+	breaks[0] |= 1;
+
+	for (uint64_t w = 0; w < words; w++)
+		num_starts += __builtin_popcountll(breaks[w]);
+
+	starts = malloc((num_starts + 1) * sizeof(*starts));
+	igt_assert(starts);
+	num_starts = 0;
+	for (uint64_t w = 0; w < words; w++) {
+		for (uint64_t bits = breaks[w]; bits; bits &= bits - 1)
+			starts[num_starts++] = w * 64 + __builtin_ctzll(bits);
+	}
+	starts[num_starts] = n;
+
+	analysis->extents = malloc(num_starts * sizeof(*analysis->extents));
+	analysis->holes = malloc(num_starts * sizeof(*analysis->holes));
+	igt_assert(analysis->extents && analysis->holes);
+
+	for (uint64_t x = 0; x < num_starts; x++) {
+		uint64_t s = starts[x], t = starts[x + 1];
+		struct igt_ggtt_extent *ext =
+			&analysis->extents[analysis->num_extents++];
+
+		ext->offset = s * IGT_GGTT_PAGE_SIZE;
+		ext->size = (t - s) * IGT_GGTT_PAGE_SIZE;
+		ext->kind = entry_kind(e[s], snap->scratch);
+		ext->phys = e[s] & ~IGT_GGTT_PTE_FLAGS;
+		ext->flags = e[s] & IGT_GGTT_PTE_FLAGS;
+		ext->chunks = 0;
+		analysis->pages[ext->kind] += t - s;
+
+		if (ext->kind == IGT_GGTT_MAPPED) {
+			ext->chunks = 1 + count_bits(chunks, s + 1, t);
+			analysis->chunks += ext->chunks;
+
+			if (in_hole)
+				add_hole(analysis, hole, ext->offset - hole);
+			in_hole = false;
+		} else if (!in_hole) {
+			hole = ext->offset;
+			in_hole = true;
+		}
+	}
+	if (in_hole)
+		add_hole(analysis, hole, n * IGT_GGTT_PAGE_SIZE - hole);
+
+	free(starts);
+	free(chunks);
+	free(breaks);
+}
+
+/**
+ * igt_ggtt_analysis_fini:
+ * @analysis: the analysis
+ */
+void igt_ggtt_analysis_fini(struct igt_ggtt_analysis *analysis)
+{
+	free(analysis->extents);
+	free(analysis->holes);
+	memset(analysis, 0, sizeof(*analysis));
+}
+
+/**
+ * igt_ggtt_largest_range:
+ * @analysis: the analysis
+ * @alignment: alignment of the allocation, a power of two
+ * @start: start of the range allowed for the allocation
+ * @end: end of the range allowed for the allocation
+ * @offset: returns the offset of the allocation, if not NULL
+ *
+ * Finds the largest allocation aligned to @alignment that fits within
+ * [@start, @end), such as in the mappable aperture.
+ *
+ * Returns: the size of the largest allocation, 0 if none fits.
+ */
+uint64_t igt_ggtt_largest_range(const struct igt_ggtt_analysis *analysis,
+				uint64_t alignment, uint64_t start,
+				uint64_t end, uint64_t *offset)
+{
+	uint64_t best = 0;
+
+	for (uint64_t h = 0; h < analysis->num_holes; h++) {
+		const struct igt_ggtt_range *r = &analysis->holes[h];
+		uint64_t s = r->offset > start ? r->offset : start;
+		uint64_t t = r->offset + r->size < end ? r->offset + r->size : end;
+
+		s = align_up(s, alignment);
+		if (s < t && t - s > best) {
+			best = t - s;
+			if (offset)
+				*offset = s;
+		}
+	}
+
+	return best;
+}
+
+static enum igt_ggtt_change classify_change(enum igt_ggtt_kind from,
+					    enum igt_ggtt_kind to)
+{
+	if (from != IGT_GGTT_MAPPED)
+		return to == IGT_GGTT_MAPPED ? IGT_GGTT_BOUND : IGT_GGTT_CLEARED;
+
+	return to == IGT_GGTT_MAPPED ? IGT_GGTT_REBOUND : IGT_GGTT_UNBOUND;
+}
+
+/**
+ * igt_ggtt_snapshot_diff:
+ * @old: the earlier snapshot
+ * @new: the later snapshot
+ * @diffs: returns the changes, to be freed by the caller
+ *
+ * Compares the GGTT of two snapshots over the size of the smaller one.
+ * Ranges of 64 unchanged PTEs are skipped at once with memcmp().
+ *
+ * Returns: the number of ranges of PTEs that changed the same way.
+ */
+uint64_t igt_ggtt_snapshot_diff(const struct igt_ggtt_snapshot *old,
+				const struct igt_ggtt_snapshot *new,
+				struct igt_ggtt_diff **diffs)
+{
+	uint64_t n = old->num_entries < new->num_entries ?
+		     old->num_entries : new->num_entries;
+	const uint64_t *a = old->entries, *b = new->entries;
+	struct igt_ggtt_diff *d = NULL, *last = NULL;
+	uint64_t count = 0, capacity = 0;
+
+	for (uint64_t i = 0; i < n; i++) {
+		enum igt_ggtt_change change;
+		uint64_t offset;
+
+		if (!(i % 64) && n - i >= 64 &&
+		    !memcmp(a + i, b + i, 64 * sizeof(*a))) {
+			i += 63;
+			continue;
+		}
+
+		if (a[i] == b[i])
+			continue;
+
+		change = classify_change(entry_kind(a[i], old->scratch),
+					 entry_kind(b[i], new->scratch));
+		offset = i * IGT_GGTT_PAGE_SIZE;
+
+		if (last && last->change == change &&
+		    last->offset + last->size == offset) {
+			last->size += IGT_GGTT_PAGE_SIZE;
+			continue;
+		}
+
+		if (count == capacity) {
+			capacity = capacity ? 2 * capacity : 64;
+			d = realloc(d, capacity * sizeof(*d));
+			igt_assert(d);
+		}
+
+		last = &d[count++];
+		last->offset = offset;
+		last->size = IGT_GGTT_PAGE_SIZE;
+		last->change = change;
+	}
+
+	*diffs = d;
+	return count;
+}
+
+/**
+ * igt_ggtt_kind_name:
+ * @kind: an extent kind
+ *
+ * Returns: the name of @kind.
+ */
+const char *igt_ggtt_kind_name(enum igt_ggtt_kind kind)
+{
+	static const char *names[] = {
+		[IGT_GGTT_INVALID] = "invalid",
+		[IGT_GGTT_SCRATCH] = "scratch",
+		[IGT_GGTT_MAPPED] = "mapped",
+	};
+
+	return kind < IGT_GGTT_NUM_KINDS ? names[kind] : "unknown";
+}
+
+/**
+ * igt_ggtt_change_name:
+ * @change: a change between snapshots
+ *
+ * Returns: the name of @change.
+ */
+const char *igt_ggtt_change_name(enum igt_ggtt_change change)
+{
+	static const char *names[] = {
+		[IGT_GGTT_BOUND] = "bound",
+		[IGT_GGTT_UNBOUND] = "unbound",
+		[IGT_GGTT_REBOUND] = "rebound",
+		[IGT_GGTT_CLEARED] = "cleared",
+	};
+
+	return change <= IGT_GGTT_CLEARED ? names[change] : "unknown";
+}
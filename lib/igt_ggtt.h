@@ -0,0 +1,164 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#ifndef __IGT_GGTT_H__
+#define __IGT_GGTT_H__
+
+#include <stdint.h>
+
+#define IGT_GGTT_PAGE_SIZE 4096ull
+
+/* Entries are the physical address of the page ORed with these */
+#define IGT_GGTT_PTE_VALID (1ull << 0)
+#define IGT_GGTT_PTE_FLAGS 0xfffull
+
+#define IGT_GGTT_NO_SCRATCH (~0ull)
+
+/* Holes of up to 2^IGT_GGTT_ORDERS pages, alignments up to 4KiB << 31 */
+#define IGT_GGTT_ORDERS 32
+
+/**
+ * igt_ggtt_snapshot:
+ * @devid: the PCI device id, for the PTE format
+ * @pte_size: size of a PTE in bytes, 4 before gen8 and 8 after
+ * @num_entries: number of PTEs, one per 4KiB of GGTT
+ * @entries: the physical address of each page ORed with the flags of its PTE
+ * @scratch: physical address of the scratch page the unused PTEs point to,
+ *	     or #IGT_GGTT_NO_SCRATCH
+ */
+struct igt_ggtt_snapshot {
+	uint32_t devid;
+	unsigned int pte_size;
+	uint64_t num_entries;
+	uint64_t *entries;
+	uint64_t scratch;
+
+	/*< private >*/
+	void *ptes;
+};
+
+void igt_ggtt_snapshot_init(struct igt_ggtt_snapshot *snap, uint32_t devid,
+			    const void *ptes, uint64_t num_entries);
+void igt_ggtt_snapshot_fini(struct igt_ggtt_snapshot *snap);
+int igt_ggtt_snapshot_save(const struct igt_ggtt_snapshot *snap,
+			   const char *path);
+int igt_ggtt_snapshot_load(struct igt_ggtt_snapshot *snap, const char *path);
+
+enum igt_ggtt_kind {
+	IGT_GGTT_INVALID,
+	IGT_GGTT_SCRATCH,
+	IGT_GGTT_MAPPED,
+	IGT_GGTT_NUM_KINDS
+};
+
+/**
+ * igt_ggtt_extent:
+ * @offset: offset of the extent in the GGTT
+ * @size: size of the extent
+ * @kind: what the PTEs of the extent point to
+ * @phys: physical address of the first page
+ * @flags: flags of the PTEs
+ * @chunks: number of physically contiguous runs of pages in the extent
+ *
+ * A run of PTEs of the same kind, and for mapped pages with the same flags.
+ */
+struct igt_ggtt_extent {
+	uint64_t offset;
+	uint64_t size;
+	enum igt_ggtt_kind kind;
+	uint64_t phys;
+	unsigned int flags;
+	uint64_t chunks;
+};
+
+/**
+ * igt_ggtt_range:
+ * @offset: start of the range in the GGTT
+ * @size: size of the range
+ */
+struct igt_ggtt_range {
+	uint64_t offset;
+	uint64_t size;
+};
+
+/**
+ * igt_ggtt_analysis:
+ * @num_extents: number of extents
+ * @extents: the extents in GGTT order
+ * @num_holes: number of holes
+ * @holes: the runs of invalid and scratch PTEs free for new bindings
+ * @pages: number of pages of each #igt_ggtt_kind
+ * @chunks: number of physically contiguous runs of mapped pages
+ * @hole_histogram: number of holes of 2^k to 2^(k+1) - 1 pages
+ * @largest: largest allocation aligned to 4KiB << k that fits in a hole
+ */
+struct igt_ggtt_analysis {
+	uint64_t num_extents;
+	struct igt_ggtt_extent *extents;
+	uint64_t num_holes;
+	struct igt_ggtt_range *holes;
+
+	uint64_t pages[IGT_GGTT_NUM_KINDS];
+	uint64_t chunks;
+	uint64_t hole_histogram[IGT_GGTT_ORDERS];
+	uint64_t largest[IGT_GGTT_ORDERS];
+};
+
+void igt_ggtt_analyse(const struct igt_ggtt_snapshot *snap,
+		      struct igt_ggtt_analysis *analysis);
+void igt_ggtt_analysis_fini(struct igt_ggtt_analysis *analysis);
+uint64_t igt_ggtt_largest_range(const struct igt_ggtt_analysis *analysis,
+				uint64_t alignment, uint64_t start,
+				uint64_t end, uint64_t *offset);
+
+enum igt_ggtt_change {
+	IGT_GGTT_BOUND,
+	IGT_GGTT_UNBOUND,
+	IGT_GGTT_REBOUND,
+	IGT_GGTT_CLEARED,
+};
+
+/**
+ * igt_ggtt_diff:
+ * @offset: start of the range in the GGTT
+ * @size: size of the range
+ * @change: #IGT_GGTT_BOUND for free pages mapped, #IGT_GGTT_UNBOUND for
+ *	    mapped pages freed, #IGT_GGTT_REBOUND for mapped pages mapped
+ *	    elsewhere, #IGT_GGTT_CLEARED for free pages changed between
+ *	    invalid and scratch
+ */
+struct igt_ggtt_diff {
+	uint64_t offset;
+	uint64_t size;
+	enum igt_ggtt_change change;
+};
+
+uint64_t igt_ggtt_snapshot_diff(const struct igt_ggtt_snapshot *old,
+				const struct igt_ggtt_snapshot *new,
+				struct igt_ggtt_diff **diffs);
+
+const char *igt_ggtt_kind_name(enum igt_ggtt_kind kind);
+const char *igt_ggtt_change_name(enum igt_ggtt_change change);
+
+#endif /* __IGT_GGTT_H__ */
@@ -47,6 +47,7 @@
 #include <poll.h>
 #include <errno.h>
 #include <time.h>
+#include <pthread.h>
 
 #include <i915_drm.h>
 
@@ -1922,6 +1923,8 @@ __get_crtc_mask_for_pipe(drmModeRes *resources, igt_pipe_t *pipe)
 	return (1 << offset);
 }
 
+static void probe_connectors(int drm_fd, const uint32_t *ids, int count);
+
 /**
  * igt_display_require:
  * @display: a pointer to an #igt_display_t structure
@@ -1932,6 +1935,10 @@ __get_crtc_mask_for_pipe(drmModeRes *resources, igt_pipe_t *pipe)
  *
  * This function automatically skips if the kernel driver doesn't support any
  * CRTC or outputs.
+ *
+ * Connectors are only fully probed if they have not been since the last
+ * hotplug event, so repeated calls in the same test binary are cheap. Set
+ * #igt_output_t.force_reprobe to refresh an output regardless.
  */
 void igt_display_require(igt_display_t *display, int drm_fd)
 {
@@ -2133,9 +2140,11 @@ void igt_display_require(igt_display_t *display, int drm_fd)
 	display->outputs = calloc(display->n_outputs, sizeof(igt_output_t));
 	igt_assert_f(display->outputs, "Failed to allocate memory for %d outputs\n", display->n_outputs);
 
+	probe_connectors(drm_fd, resources->connectors,
+			 resources->count_connectors);
+
 	for (i = 0; i < display->n_outputs; i++) {
 		igt_output_t *output = &display->outputs[i];
-		drmModeConnector *connector;
 
 		/*
 		 * We don't assign each output a pipe unless
@@ -2146,13 +2155,6 @@ void igt_display_require(igt_display_t *display, int drm_fd)
 		output->display = display;
 
 		igt_output_refresh(output);
-
-		connector = output->config.connector;
-		if (connector && (!connector->count_modes ||
-		    connector->connection == DRM_MODE_UNKNOWNCONNECTION)) {
-			output->force_reprobe = true;
-			igt_output_refresh(output);
-		}
 	}
 
 	drmModeFreePlaneResources(plane_resources);
@@ -4233,6 +4235,213 @@ void igt_wait_for_vblank(int drm_fd, int crtc_offset)
 	igt_wait_for_vblank_count(drm_fd, crtc_offset, 1);
 }
 
+/*
+ * Connector probe cache
+ *
+ * A full probe (drmModeGetConnector) of a connector without a sink can take
+ * a long time on DDC/AUX timeouts, and used to be done serially for every
+ * such connector each time a display was initialised. We now probe the
+ * connectors which need it concurrently, and remember per device which ones
+ * have been probed so that later subtests can trust
+ * drmModeGetConnectorCurrent() for them. Any hotplug uevent drops the cache.
+ */
+static struct {
+	struct udev_monitor *mon;
+	pid_t pid;
+	struct probed_connector {
+		dev_t rdev;
+		uint32_t id;
+	} *connectors;
+	unsigned int count, size;
+} probe_cache;
+
+static struct udev_monitor *__igt_watch_uevents(void)
+{
+	struct udev_monitor *mon;
+	struct udev *udev;
+	int flags, fd;
+
+	udev = udev_new();
+	if (!udev)
+		return NULL;
+
+	mon = udev_monitor_new_from_netlink(udev, "udev");
+	if (!mon)
+		goto err_udev;
+
+	if (udev_monitor_filter_add_match_subsystem_devtype(mon, "drm",
+							    "drm_minor") ||
+	    udev_monitor_filter_update(mon) ||
+	    udev_monitor_enable_receiving(mon))
+		goto err_mon;
+
+	/* Set the fd for udev as non blocking */
+	fd = udev_monitor_get_fd(mon);
+	flags = fcntl(fd, F_GETFL, 0);
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+		goto err_mon;
+
+	return mon;
+
+err_mon:
+	udev_monitor_unref(mon);
+err_udev:
+	udev_unref(udev);
+	return NULL;
+}
+
+/* Returns false if hotplugs cannot be tracked, and so nothing may be cached */
+static bool probe_cache_sync(void)
+{
+	struct udev_device *dev;
+
+	/* The monitor socket is shared with our parent after a fork */
+	if (probe_cache.mon && probe_cache.pid != getpid()) {
+		probe_cache.mon = NULL;
+		probe_cache.count = 0;
+	}
+
+	if (!probe_cache.mon) {
+		probe_cache.mon = __igt_watch_uevents();
+		probe_cache.pid = getpid();
+		probe_cache.count = 0;
+		if (!probe_cache.mon)
+			return false;
+	}
+
+	while ((dev = udev_monitor_receive_device(probe_cache.mon))) {
+		const char *hotplug;
+
+		hotplug = udev_device_get_property_value(dev, "HOTPLUG");
+		if (hotplug && atoi(hotplug) == 1)
+			probe_cache.count = 0;
+
+		udev_device_unref(dev);
+	}
+
+	return true;
+}
+
+static bool probe_cache_lookup(dev_t rdev, uint32_t id)
+{
+	for (unsigned int i = 0; i < probe_cache.count; i++)
+		if (probe_cache.connectors[i].rdev == rdev &&
+		    probe_cache.connectors[i].id == id)
+			return true;
+
+	return false;
+}
+
+static void probe_cache_add(dev_t rdev, uint32_t id)
+{
+	if (probe_cache.count == probe_cache.size) {
+		probe_cache.size = probe_cache.size ? 2 * probe_cache.size : 16;
+		probe_cache.connectors =
+			realloc(probe_cache.connectors,
+				probe_cache.size * sizeof(*probe_cache.connectors));
+		igt_assert(probe_cache.connectors);
+	}
+
+	probe_cache.connectors[probe_cache.count].rdev = rdev;
+	probe_cache.connectors[probe_cache.count].id = id;
+	probe_cache.count++;
+}
+
+struct connector_probe {
+	pthread_t thread;
+	bool spawned;
+	int drm_fd;
+	uint32_t id;
+	int connection;
+	int type, type_id;
+	int count_modes;
+};
+
+static void *probe_connector(void *arg)
+{
+	struct connector_probe *p = arg;
+	drmModeConnector *c;
+
+	c = drmModeGetConnector(p->drm_fd, p->id);
+	if (c) {
+		p->connection = c->connection;
+		p->type = c->connector_type;
+		p->type_id = c->connector_type_id;
+		p->count_modes = c->count_modes;
+		drmModeFreeConnector(c);
+	}
+
+	return NULL;
+}
+
+/*
+ * Fully probe those of the connectors which have no modes or an unknown
+ * status, unless they have already been probed since the last hotplug.
+ * Afterwards drmModeGetConnectorCurrent() returns the probed state.
+ */
+static void probe_connectors(int drm_fd, const uint32_t *ids, int count)
+{
+	struct connector_probe *probes;
+	bool cache = probe_cache_sync();
+	struct stat st;
+	int n = 0;
+
+	if (fstat(drm_fd, &st))
+		cache = false;
+
+	probes = calloc(count, sizeof(*probes));
+	igt_assert(probes);
+
+	for (int i = 0; i < count; i++) {
+		drmModeConnector *c;
+		bool needs_probe;
+
+		if (cache && probe_cache_lookup(st.st_rdev, ids[i]))
+			continue;
+
+		c = drmModeGetConnectorCurrent(drm_fd, ids[i]);
+		if (!c)
+			continue;
+
+		needs_probe = !c->count_modes ||
+			      c->connection == DRM_MODE_UNKNOWNCONNECTION;
+		drmModeFreeConnector(c);
+
+		if (needs_probe) {
+			probes[n].drm_fd = drm_fd;
+			probes[n].id = ids[i];
+			n++;
+		} else if (cache) {
+			probe_cache_add(st.st_rdev, ids[i]);
+		}
+	}
+
+	/* Probing is mostly waiting for the sink, so do it all at once */
+	for (int i = 0; i < n; i++)
+		probes[i].spawned = pthread_create(&probes[i].thread, NULL,
+						   probe_connector,
+						   &probes[i]) == 0;
+
+	for (int i = 0; i < n; i++) {
+		if (probes[i].spawned)
+			pthread_join(probes[i].thread, NULL);
+		else
+			probe_connector(&probes[i]);
+
+		if (probes[i].connection == DRM_MODE_CONNECTED &&
+		    !probes[i].count_modes)
+			igt_warn("connector %d/%s-%d has no modes\n",
+				 probes[i].id,
+				 kmstest_connector_type_str(probes[i].type),
+				 probes[i].type_id);
+
+		if (cache)
+			probe_cache_add(st.st_rdev, probes[i].id);
+	}
+
+	free(probes);
+}
+
 /**
  * igt_enable_connectors:
  * @drm_fd: A drm file descriptor
@@ -4251,11 +4460,13 @@ void igt_enable_connectors(int drm_fd)
 	if (!res)
 		return;
 
+	/* Do a probe. This may be the first action after booting */
+	probe_connectors(drm_fd, res->connectors, res->count_connectors);
+
 	for (int i = 0; i < res->count_connectors; i++) {
 		drmModeConnector *c;
 
-		/* Do a probe. This may be the first action after booting */
-		c = drmModeGetConnector(drm_fd, res->connectors[i]);
+		c = drmModeGetConnectorCurrent(drm_fd, res->connectors[i]);
 		if (!c) {
 			igt_warn("Could not read connector %u: %m\n", res->connectors[i]);
 			continue;
@@ -4300,33 +4511,11 @@ void igt_reset_connectors(void)
  */
 struct udev_monitor *igt_watch_uevents(void)
 {
-	struct udev *udev;
 	struct udev_monitor *mon;
-	int ret, flags, fd;
-
-	udev = udev_new();
-	igt_assert(udev != NULL);
 
-	mon = udev_monitor_new_from_netlink(udev, "udev");
+	mon = __igt_watch_uevents();
 	igt_assert(mon != NULL);
 
-	ret = udev_monitor_filter_add_match_subsystem_devtype(mon,
-							      "drm",
-							      "drm_minor");
-	igt_assert_eq(ret, 0);
-	ret = udev_monitor_filter_update(mon);
-	igt_assert_eq(ret, 0);
-	ret = udev_monitor_enable_receiving(mon);
-	igt_assert_eq(ret, 0);
-
-	/* Set the fd for udev as non blocking */
-	fd = udev_monitor_get_fd(mon);
-	flags = fcntl(fd, F_GETFL, 0);
-	igt_assert(flags);
-
-	flags |= O_NONBLOCK;
-	igt_assert_neq(fcntl(fd, F_SETFL, flags), -1);
-
 	return mon;
 }
 
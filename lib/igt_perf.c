@@ -1,6 +1,11 @@
+#include <ctype.h>
+#include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <locale.h>
+#include <math.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
@@ -157,3 +162,386 @@ int igt_perf_open_group(uint64_t type, uint64_t config, int group)
 	return _perf_open(type, config, group,
 			  PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_GROUP);
 }
+
+static int read_attr(const char *path, char *buf, int buflen)
+{
+	ssize_t ret;
+	int fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+
+	ret = read(fd, buf, buflen - 1);
+	close(fd);
+	if (ret < 0)
+		return -errno;
+
+	while (ret && isspace(buf[ret - 1]))
+		ret--;
+	buf[ret] = '\0';
+
+	return ret;
+}
+
+/*
+ * Scatter @value into the attr config field named by the format attribute of
+ * the term, "config:0-7", "config1:0-15" or "config:0-7,32-35" style.
+ */
+static int apply_format(const char *fmt, uint64_t value,
+			struct igt_perf_event *ev)
+{
+	const char *s = strchr(fmt, ':');
+	uint64_t *field;
+
+	if (!s)
+		return -EINVAL;
+
+	if (!strncmp(fmt, "config:", s - fmt + 1))
+		field = &ev->config;
+	else if (!strncmp(fmt, "config1:", s - fmt + 1))
+		field = &ev->config1;
+	else if (!strncmp(fmt, "config2:", s - fmt + 1))
+		field = &ev->config2;
+	else
+		return -EINVAL;
+
+	do {
+		unsigned long lo, hi, bit;
+		char *end;
+
+		lo = strtoul(s + 1, &end, 10);
+		hi = lo;
+		if (*end == '-')
+			hi = strtoul(end + 1, &end, 10);
+		if (end == s + 1 || hi < lo || hi > 63)
+			return -EINVAL;
+
+		for (bit = lo; bit <= hi; bit++) {
+			*field |= (value & 1ull) << bit;
+			value >>= 1;
+		}
+
+		s = end;
+	} while (*s == ',');
+
+	return 0;
+}
+
+/**
+ * igt_perf_event_parse:
+ * @root: prefix for the sysfs paths, "" for the live system
+ * @pmu: name of the PMU under /sys/devices
+ * @event: name of the event under /sys/devices/@pmu/events
+ * @ev: parsed event
+ *
+ * Parses the type of the PMU and the "term=value,..." description of the
+ * event into the attr config fields, together with the optional scale and
+ * unit of the event.
+ *
+ * Returns: 0 on success, negative error code otherwise.
+ */
+int igt_perf_event_parse(const char *root, const char *pmu, const char *event,
+			 struct igt_perf_event *ev)
+{
+	char path[PATH_MAX], desc[256], buf[64];
+	locale_t locale, oldlocale;
+	char *term, *save;
+	int ret;
+
+	memset(ev, 0, sizeof(*ev));
+	ev->scale = 1.0;
+
+	snprintf(path, sizeof(path), "%s/sys/devices/%s/type", root, pmu);
+	ret = read_attr(path, buf, sizeof(buf));
+	if (ret < 0)
+		return ret;
+	ev->type = strtoull(buf, NULL, 0);
+
+	snprintf(path, sizeof(path), "%s/sys/devices/%s/events/%s",
+		 root, pmu, event);
+	ret = read_attr(path, desc, sizeof(desc));
+	if (ret < 0)
+		return ret;
+
+	for (term = strtok_r(desc, ",", &save); term;
+	     term = strtok_r(NULL, ",", &save)) {
+		char *eq = strchr(term, '=');
+		uint64_t value = 1;
+
+		if (eq) {
+			*eq = '\0';
+			value = strtoull(eq + 1, NULL, 0);
+		}
+
+		if (!strcmp(term, "config")) {
+			ev->config = value;
+			continue;
+		} else if (!strcmp(term, "config1")) {
+			ev->config1 = value;
+			continue;
+		} else if (!strcmp(term, "config2")) {
+			ev->config2 = value;
+			continue;
+		}
+
+		snprintf(path, sizeof(path), "%s/sys/devices/%s/format/%s",
+			 root, pmu, term);
+		ret = read_attr(path, buf, sizeof(buf));
+		if (ret < 0)
+			return ret;
+
+		ret = apply_format(buf, value, ev);
+		if (ret)
+			return ret;
+	}
+
+	snprintf(path, sizeof(path), "%s/sys/devices/%s/events/%s.scale",
+		 root, pmu, event);
+	if (read_attr(path, buf, sizeof(buf)) > 0) {
+		/* Replace user environment with plain C to match kernel format */
+		locale = newlocale(LC_ALL, "C", 0);
+		oldlocale = uselocale(locale);
+		ev->scale = strtod(buf, NULL);
+		uselocale(oldlocale);
+		freelocale(locale);
+
+		if (isnan(ev->scale) || !ev->scale)
+			return -ERANGE;
+	}
+
+	snprintf(path, sizeof(path), "%s/sys/devices/%s/events/%s.unit",
+		 root, pmu, event);
+	if (read_attr(path, ev->unit, sizeof(ev->unit)) < 0)
+		ev->unit[0] = '\0';
+
+	return 0;
+}
+
+/**
+ * igt_perf_event_open_cpu:
+ * @ev: event to open
+ * @cpu: CPU to count on
+ * @group: group leader or -1
+ *
+ * Opens a system wide counter for @ev on @cpu, as needed by the uncore PMUs
+ * which only accept the CPUs from their cpumask.
+ *
+ * Returns: the perf fd, or -1 with errno set.
+ */
+int igt_perf_event_open_cpu(const struct igt_perf_event *ev, int cpu,
+			    int group)
+{
+	struct perf_event_attr attr = { };
+
+	attr.type = ev->type;
+	attr.config = ev->config;
+	attr.config1 = ev->config1;
+	attr.config2 = ev->config2;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED;
+	if (group < 0)
+		attr.read_format |= PERF_FORMAT_GROUP;
+	attr.use_clockid = 1;
+	attr.clockid = CLOCK_MONOTONIC;
+
+	return perf_event_open(&attr, -1, cpu, group, 0);
+}
+
+/**
+ * igt_perf_unit_bytes:
+ * @unit: unit string of an event
+ *
+ * Returns: the size in bytes of one @unit, or 0 if it is not a size.
+ */
+double igt_perf_unit_bytes(const char *unit)
+{
+	static const struct {
+		const char *unit;
+		double bytes;
+	} units[] = {
+		{ "B", 1.0 },
+		{ "Bytes", 1.0 },
+		{ "KiB", 1024.0 },
+		{ "MiB", 1024.0 * 1024.0 },
+		{ "GiB", 1024.0 * 1024.0 * 1024.0 },
+		{ "kB", 1e3 },
+		{ "KB", 1e3 },
+		{ "MB", 1e6 },
+		{ "GB", 1e9 },
+	};
+	unsigned int i;
+
+	for (i = 0; i < sizeof(units) / sizeof(units[0]); i++)
+		if (!strcmp(unit, units[i].unit))
+			return units[i].bytes;
+
+	return 0.0;
+}
+
+/* Parses a cpumask list such as "0,28" or "0-1" into @cpus. */
+static int parse_cpulist(const char *list, int *cpus, int max)
+{
+	const char *s = list;
+	int n = 0;
+
+	while (*s) {
+		long lo, hi;
+		char *end;
+
+		lo = strtol(s, &end, 10);
+		if (end == s)
+			break;
+		hi = lo;
+		if (*end == '-')
+			hi = strtol(end + 1, &end, 10);
+
+		for (; lo <= hi && n < max; lo++)
+			cpus[n++] = lo;
+
+		if (*end != ',')
+			break;
+		s = end + 1;
+	}
+
+	return n;
+}
+
+static int cpu_package(const char *root, int cpu, int fallback)
+{
+	char path[PATH_MAX], buf[16];
+
+	snprintf(path, sizeof(path),
+		 "%s/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+		 root, cpu);
+	if (read_attr(path, buf, sizeof(buf)) <= 0)
+		return fallback;
+
+	return atoi(buf);
+}
+
+static int imc_cmp(const void *A, const void *B)
+{
+	const struct igt_perf_imc *a = A, *b = B;
+
+	if (a->socket != b->socket)
+		return a->socket < b->socket ? -1 : 1;
+
+	return strverscmp(a->pmu, b->pmu);
+}
+
+#define IMC_MAX_SOCKETS 64
+
+static int imc_scan(const char *root, bool free_running,
+		    struct igt_perf_imc **imc, int count)
+{
+	/* Client, client free running and server event names. */
+	static const struct {
+		const char *reads;
+		const char *writes;
+	} names[] = {
+		{ "data_reads", "data_writes" },
+		{ "data_read", "data_write" },
+		{ "cas_count_read", "cas_count_write" },
+	};
+	char path[PATH_MAX], buf[256];
+	struct dirent *dent;
+	DIR *d;
+
+	snprintf(path, sizeof(path), "%s/sys/devices", root);
+	d = opendir(path);
+	if (!d)
+		return -errno;
+
+	while ((dent = readdir(d))) {
+		struct igt_perf_event reads, writes;
+		int cpus[IMC_MAX_SOCKETS];
+		unsigned int i;
+		int n, j;
+
+		if (strncmp(dent->d_name, "uncore_imc", strlen("uncore_imc")))
+			continue;
+
+		if (!!strstr(dent->d_name, "free_running") != free_running)
+			continue;
+
+		if (strlen(dent->d_name) >= sizeof((*imc)->pmu))
+			continue;
+
+		for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			if (igt_perf_event_parse(root, dent->d_name,
+						 names[i].reads, &reads) == 0 &&
+			    igt_perf_event_parse(root, dent->d_name,
+						 names[i].writes, &writes) == 0)
+				break;
+		}
+		if (i == sizeof(names) / sizeof(names[0]))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/sys/devices/%s/cpumask",
+			 root, dent->d_name);
+		if (read_attr(path, buf, sizeof(buf)) > 0)
+			n = parse_cpulist(buf, cpus, IMC_MAX_SOCKETS);
+		else
+			n = 0;
+		if (!n) {
+			cpus[0] = 0;
+			n = 1;
+		}
+
+		for (j = 0; j < n; j++) {
+			struct igt_perf_imc *entry;
+
+			entry = realloc(*imc, (count + 1) * sizeof(**imc));
+			if (!entry) {
+				closedir(d);
+				return -ENOMEM;
+			}
+			*imc = entry;
+
+			entry = &(*imc)[count++];
+			memset(entry, 0, sizeof(*entry));
+			strcpy(entry->pmu, dent->d_name);
+			entry->cpu = cpus[j];
+			entry->socket = cpu_package(root, cpus[j], j);
+			entry->reads = reads;
+			entry->writes = writes;
+		}
+	}
+
+	closedir(d);
+
+	return count;
+}
+
+/**
+ * igt_perf_imc_discover:
+ * @root: prefix for the sysfs paths, "" for the live system
+ * @imc: returned array, to be freed by the caller
+ *
+ * Finds all the uncore memory controller PMUs providing read and write
+ * traffic events, with one entry for every package a PMU counts on. The
+ * free running PMUs are only used when there are no others, so the same
+ * traffic is not counted twice. Entries are sorted by socket.
+ *
+ * Returns: the number of entries, or negative error code.
+ */
+int igt_perf_imc_discover(const char *root, struct igt_perf_imc **imc)
+{
+	int count;
+
+	*imc = NULL;
+
+	count = imc_scan(root, false, imc, 0);
+	if (count == 0)
+		count = imc_scan(root, true, imc, 0);
+
+	if (count < 0) {
+		free(*imc);
+		*imc = NULL;
+		return count;
+	}
+
+	qsort(*imc, count, sizeof(**imc), imc_cmp);
+
+	return count;
+}
@@ -64,4 +64,38 @@ int perf_igfx_open_group(uint64_t config, int group);
 int perf_i915_open(int i915, uint64_t config);
 int perf_i915_open_group(int i915, uint64_t config, int group);
 
+/*
+ * An event as described by /sys/devices/<pmu>/events/<name>, with the terms
+ * mapped onto the attr config fields through /sys/devices/<pmu>/format.
+ */
+struct igt_perf_event {
+	uint64_t type;
+	uint64_t config;
+	uint64_t config1;
+	uint64_t config2;
+	double scale;
+	char unit[16];
+};
+
+int igt_perf_event_parse(const char *root, const char *pmu, const char *event,
+			 struct igt_perf_event *ev);
+int igt_perf_event_open_cpu(const struct igt_perf_event *ev, int cpu,
+			    int group);
+double igt_perf_unit_bytes(const char *unit);
+
+/*
+ * One uncore memory controller PMU instance as seen from one package. Uncore
+ * PMUs count per package and have to be opened on the CPU(s) listed in their
+ * cpumask, one for each package.
+ */
+struct igt_perf_imc {
+	char pmu[64];
+	int cpu;
+	int socket;
+	struct igt_perf_event reads;
+	struct igt_perf_event writes;
+};
+
+int igt_perf_imc_discover(const char *root, struct igt_perf_imc **imc);
+
 #endif /* I915_PERF_H */
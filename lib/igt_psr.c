@@ -21,10 +21,14 @@
  * IN THE SOFTWARE.
  */
 
+#include "drmtest.h"
 #include "igt_params.h"
 #include "igt_psr.h"
 #include "igt_sysfs.h"
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
 
 bool psr_disabled_check(int debugfs_fd)
 {
@@ -251,3 +255,554 @@ void psr_print_debugfs(int debugfs_fd)
 
 	igt_info("%s", buf);
 }
+
+static const struct {
+	const char *name;
+	size_t len;
+	enum igt_psr_state state;
+} psr_states[] = {
+#define PSR_STATE(x) { #x, sizeof(#x) - 1, IGT_PSR_STATE_##x }
+	PSR_STATE(IDLE),
+	PSR_STATE(SRDONACK),
+	PSR_STATE(SRDENT),
+	PSR_STATE(BUFOFF),
+	PSR_STATE(BUFON),
+	PSR_STATE(AUXACK),
+	PSR_STATE(SRDOFFACK),
+	PSR_STATE(SRDENT_ON),
+	PSR_STATE(CAPTURE),
+	PSR_STATE(CAPTURE_FS),
+	PSR_STATE(SLEEP),
+	PSR_STATE(BUFON_FW),
+	PSR_STATE(ML_UP),
+	PSR_STATE(SU_STANDBY),
+	PSR_STATE(FAST_SLEEP),
+	PSR_STATE(DEEP_SLEEP),
+	PSR_STATE(BUF_ON),
+	PSR_STATE(TG_ON),
+#undef PSR_STATE
+};
+
+/**
+ * igt_psr_state_name:
+ * @state: a PSR source state
+ *
+ * Returns: the name of @state as printed by the kernel.
+ */
+const char *igt_psr_state_name(enum igt_psr_state state)
+{
+	if (state == IGT_PSR_STATE_DISABLED)
+		return "disabled";
+
+	for (int i = 0; i < ARRAY_SIZE(psr_states); i++) {
+		if (psr_states[i].state == state)
+			return psr_states[i].name;
+	}
+
+	return "unknown";
+}
+
+/**
+ * igt_psr_state_active:
+ * @state: a PSR source state
+ *
+ * Returns: whether @state is one where the sink self refreshes, with the
+ * main link down for PSR1 or in one of the sleep states for PSR2.
+ */
+bool igt_psr_state_active(enum igt_psr_state state)
+{
+	switch (state) {
+	case IGT_PSR_STATE_SRDENT:
+	case IGT_PSR_STATE_SLEEP:
+	case IGT_PSR_STATE_FAST_SLEEP:
+	case IGT_PSR_STATE_DEEP_SLEEP:
+		return true;
+	default:
+		return false;
+	}
+}
+
+struct psr_parse {
+	struct igt_psr_status *status;
+	bool su_blocks;
+};
+
+static const char *skip_space(const char *s, const char *end)
+{
+	while (s < end && (*s == ' ' || *s == '\t'))
+		s++;
+
+	return s;
+}
+
+static bool starts_with(const char *s, const char *end, const char *prefix,
+			size_t len)
+{
+	return end - s >= len && !memcmp(s, prefix, len);
+}
+
+static uint32_t parse_hex(const char *s, const char *end)
+{
+	uint32_t val = 0;
+
+	if (starts_with(s, end, "0x", 2))
+		s += 2;
+
+	for (; s < end; s++) {
+		int digit;
+
+		if (*s >= '0' && *s <= '9')
+			digit = *s - '0';
+		else if ((*s | 0x20) >= 'a' && (*s | 0x20) <= 'f')
+			digit = (*s | 0x20) - 'a' + 10;
+		else
+			break;
+
+		val = val << 4 | digit;
+	}
+
+	return val;
+}
+
+static void parse_mode(struct psr_parse *p, const char *s, const char *end)
+{
+	static const struct {
+		const char *prefix;
+		size_t len;
+		enum igt_psr_status_mode mode;
+	} modes[] = {
+		{ "disabled", 8, IGT_PSR_STATUS_DISABLED },
+		{ "PSR1", 4, IGT_PSR_STATUS_PSR1 },
+		{ "PSR2", 4, IGT_PSR_STATUS_PSR2 },
+		{ "Panel Replay", 12, IGT_PSR_STATUS_PANEL_REPLAY },
+	};
+
+	for (int i = 0; i < ARRAY_SIZE(modes); i++) {
+		if (starts_with(s, end, modes[i].prefix, modes[i].len)) {
+			p->status->mode = modes[i].mode;
+			return;
+		}
+	}
+}
+
+/*
+ * "DEEP_SLEEP [0x80010000]" since 4.20, the other way around before, with
+ * "unknown" for values the kernel has no name for.
+ */
+static void parse_source_status(struct psr_parse *p,
+				const char *s, const char *end)
+{
+	while (s < end) {
+		const char *tok;
+
+		s = skip_space(s, end);
+		if (s < end && *s == '[')
+			s++;
+
+		tok = s;
+		while (s < end && *s != ' ' && *s != ']')
+			s++;
+		if (s == tok) {
+			s++;
+			continue;
+		}
+
+		if (starts_with(tok, s, "0x", 2)) {
+			p->status->source_status = parse_hex(tok, s);
+			continue;
+		}
+
+		for (int i = 0; i < ARRAY_SIZE(psr_states); i++) {
+			if (s - tok == psr_states[i].len &&
+			    *tok == psr_states[i].name[0] &&
+			    !memcmp(tok, psr_states[i].name, psr_states[i].len)) {
+				p->status->state = psr_states[i].state;
+				break;
+			}
+		}
+	}
+}
+
+/* "yes [0x03]", or "PSR = yes [0x03], Panel Replay = no" since 6.8 */
+static void parse_sink_support(struct psr_parse *p,
+			       const char *s, const char *end)
+{
+	if (starts_with(s, end, "PSR = ", 6))
+		s += 6;
+
+	p->status->sink_support = starts_with(s, end, "yes", 3);
+}
+
+static void parse_sink_not_reliable(struct psr_parse *p,
+				    const char *s, const char *end)
+{
+	p->status->sink_not_reliable = starts_with(s, end, "yes", 3);
+}
+
+static void parse_busy_bits(struct psr_parse *p,
+			    const char *s, const char *end)
+{
+	p->status->busy_frontbuffer_bits = parse_hex(s, end);
+}
+
+/* "0x2 [active, display from RFB]", from i915_psr_sink_status */
+static void parse_sink_status(struct psr_parse *p,
+			      const char *s, const char *end)
+{
+	p->status->sink_state = parse_hex(s, end) & 0x7;
+}
+
+/* "Frame:\tPSR2 SU blocks:" followed by one "frame\tblocks" line each */
+static void parse_su_blocks(struct psr_parse *p,
+			    const char *s, const char *end)
+{
+	p->su_blocks = true;
+}
+
+static const struct {
+	const char *prefix;
+	size_t len;
+	void (*parse)(struct psr_parse *p, const char *s, const char *end);
+} psr_status_fields[] = {
+#define PSR_FIELD(x, fn) { x, sizeof(x) - 1, fn }
+	PSR_FIELD("PSR mode:", parse_mode),
+	PSR_FIELD("Source PSR status:", parse_source_status),
+	PSR_FIELD("Source PSR/PanelReplay status:", parse_source_status),
+	PSR_FIELD("Sink support:", parse_sink_support),
+	PSR_FIELD("Sink_Support:", parse_sink_support),
+	PSR_FIELD("PSR sink not reliable:", parse_sink_not_reliable),
+	PSR_FIELD("Busy frontbuffer bits:", parse_busy_bits),
+	PSR_FIELD("Sink PSR status:", parse_sink_status),
+	PSR_FIELD("Frame:", parse_su_blocks),
+#undef PSR_FIELD
+};
+
+static void parse_su_frame(struct psr_parse *p, const char *s, const char *end)
+{
+	struct igt_psr_status *status = p->status;
+	unsigned int blocks = 0;
+
+	/* The frame number, then the block count */
+	while (s < end && *s >= '0' && *s <= '9')
+		s++;
+	s = skip_space(s, end);
+	for (; s < end && *s >= '0' && *s <= '9'; s++)
+		blocks = blocks * 10 + *s - '0';
+
+	if (status->num_su_frames < IGT_PSR2_SU_FRAMES)
+		status->su_blocks[status->num_su_frames++] = blocks;
+}
+
+/**
+ * igt_psr_status_parse:
+ * @buf: contents of i915_edp_psr_status, optionally followed by those of
+ *       i915_psr_sink_status
+ * @len: length of @buf, which need not be nul terminated
+ * @status: the parsed status
+ *
+ * Parses the lines of the PSR status debugfs files through a table of the
+ * known line prefixes, ignoring anything else. This covers the formats of
+ * the kernels since 4.14.
+ */
+void igt_psr_status_parse(const char *buf, size_t len,
+			  struct igt_psr_status *status)
+{
+	struct psr_parse p = { .status = status };
+	const char *end = buf + len;
+
+	memset(status, 0, sizeof(*status));
+	status->sink_state = -1;
+
+	while (buf < end) {
+		const char *eol = memchr(buf, '\n', end - buf);
+		int i;
+
+		if (!eol)
+			eol = end;
+
+		if (p.su_blocks && *buf >= '0' && *buf <= '9') {
+			parse_su_frame(&p, buf, eol);
+			buf = eol + 1;
+			continue;
+		}
+		p.su_blocks = false;
+
+		for (i = 0; i < ARRAY_SIZE(psr_status_fields); i++) {
+			const char *prefix = psr_status_fields[i].prefix;
+			size_t prefix_len = psr_status_fields[i].len;
+
+			/* The first character rules out most of the table */
+			if (*buf == prefix[0] &&
+			    starts_with(buf, eol, prefix, prefix_len)) {
+				psr_status_fields[i].parse(&p,
+							   skip_space(buf + prefix_len, eol),
+							   eol);
+				break;
+			}
+		}
+
+		buf = eol + 1;
+	}
+
+	if (status->mode == IGT_PSR_STATUS_DISABLED &&
+	    status->state == IGT_PSR_STATE_UNKNOWN)
+		status->state = IGT_PSR_STATE_DISABLED;
+}
+
+/**
+ * igt_psr_trace_init:
+ * @trace: the trace to initialise
+ * @status_fd: fd of i915_edp_psr_status, owned by the trace from now on
+ * @sink_fd: fd of i915_psr_sink_status, or -1
+ *
+ * Prepares a trace sampling the given files, each sample rereads them from
+ * the start through the same fds.
+ */
+void igt_psr_trace_init(struct igt_psr_trace *trace, int status_fd,
+			int sink_fd)
+{
+	memset(trace, 0, sizeof(*trace));
+	trace->status_fd = status_fd;
+	trace->sink_fd = sink_fd;
+	trace->status.state = IGT_PSR_STATE_UNKNOWN;
+	trace->status.sink_state = -1;
+}
+
+/**
+ * igt_psr_trace_open:
+ * @trace: the trace to initialise
+ * @debugfs_fd: the debugfs directory of the device
+ *
+ * igt_psr_trace_init() on the PSR status files of the device.
+ *
+ * Returns: false if there is no PSR status file.
+ */
+bool igt_psr_trace_open(struct igt_psr_trace *trace, int debugfs_fd)
+{
+	int fd;
+
+	fd = openat(debugfs_fd, "i915_edp_psr_status", O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	igt_psr_trace_init(trace, fd,
+			   openat(debugfs_fd, "i915_psr_sink_status", O_RDONLY));
+	return true;
+}
+
+/**
+ * igt_psr_trace_fini:
+ * @trace: the trace
+ *
+ * Closes the files of @trace and frees its transitions.
+ */
+void igt_psr_trace_fini(struct igt_psr_trace *trace)
+{
+	if (trace->status_fd >= 0)
+		close(trace->status_fd);
+	if (trace->sink_fd >= 0)
+		close(trace->sink_fd);
+	free(trace->transitions);
+	trace->transitions = NULL;
+}
+
+/**
+ * igt_psr_trace_record:
+ * @trace: the trace
+ * @ts_ns: the CLOCK_MONOTONIC time of the status
+ * @status: a parsed status
+ *
+ * Adds a sample to @trace, keeping a transition if the source or the sink
+ * state changed. The first sample is recorded as a transition from
+ * %IGT_PSR_STATE_UNKNOWN.
+ */
+void igt_psr_trace_record(struct igt_psr_trace *trace, uint64_t ts_ns,
+			  const struct igt_psr_status *status)
+{
+	uint16_t su_blocks = status->num_su_frames ? status->su_blocks[0] : 0;
+
+	if (!trace->num_samples++)
+		trace->first_ns = ts_ns;
+	trace->last_ns = ts_ns;
+
+	if (su_blocks > trace->su_blocks_max)
+		trace->su_blocks_max = su_blocks;
+
+	if (trace->num_transitions &&
+	    status->state == trace->status.state &&
+	    status->sink_state == trace->status.sink_state) {
+		trace->status = *status;
+		return;
+	}
+
+	if (trace->num_transitions == trace->max_transitions) {
+		trace->max_transitions = trace->max_transitions ?
+					 2 * trace->max_transitions : 256;
+		trace->transitions = realloc(trace->transitions,
+					     trace->max_transitions *
+					     sizeof(*trace->transitions));
+		igt_assert(trace->transitions);
+	}
+
+	trace->transitions[trace->num_transitions++] =
+		(struct igt_psr_transition) {
+			.ts_ns = ts_ns,
+			.from = trace->status.state,
+			.to = status->state,
+			.sink_state = status->sink_state,
+			.su_blocks = su_blocks,
+		};
+	trace->status = *status;
+}
+
+static uint64_t psr_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * igt_psr_trace_sample:
+ * @trace: the trace
+ *
+ * Reads, parses and records the current PSR status, timestamped with the
+ * middle of the reads.
+ *
+ * Returns: false if the status could not be read.
+ */
+bool igt_psr_trace_sample(struct igt_psr_trace *trace)
+{
+	struct igt_psr_status status;
+	uint64_t start, end;
+	ssize_t len, sink_len = 0;
+
+	start = psr_now_ns();
+	len = pread(trace->status_fd, trace->buf, sizeof(trace->buf), 0);
+	if (len > 0 && trace->sink_fd >= 0) {
+		sink_len = pread(trace->sink_fd, trace->buf + len,
+				 sizeof(trace->buf) - len, 0);
+		if (sink_len < 0)
+			sink_len = 0;
+	}
+	end = psr_now_ns();
+
+	if (len < 0)
+		return false;
+
+	igt_psr_status_parse(trace->buf, len + sink_len, &status);
+	igt_psr_trace_record(trace, start + (end - start) / 2, &status);
+
+	return true;
+}
+
+/**
+ * igt_psr_trace_run:
+ * @trace: the trace
+ * @duration_ns: how long to sample for
+ * @period_ns: time between the samples, 0 to sample back to back
+ *
+ * Returns: false if the status could not be read.
+ */
+bool igt_psr_trace_run(struct igt_psr_trace *trace, uint64_t duration_ns,
+		       uint64_t period_ns)
+{
+	uint64_t start = psr_now_ns(), next = start;
+
+	do {
+		if (!igt_psr_trace_sample(trace))
+			return false;
+
+		if (period_ns) {
+			struct timespec ts;
+
+			next += period_ns;
+			ts.tv_sec = next / NSEC_PER_SEC;
+			ts.tv_nsec = next % NSEC_PER_SEC;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&ts, NULL);
+		}
+	} while (psr_now_ns() - start < duration_ns);
+
+	return true;
+}
+
+static void psr_latency_add(struct igt_psr_latency *l, uint64_t ns)
+{
+	if (!l->count || ns < l->min_ns)
+		l->min_ns = ns;
+	if (ns > l->max_ns)
+		l->max_ns = ns;
+	l->total_ns += ns;
+	l->count++;
+}
+
+/**
+ * igt_psr_trace_stats:
+ * @trace: the trace
+ * @flap_ns: self refresh periods shorter than this count as flaps
+ * @stats: the statistics
+ *
+ * Computes the residency of each source state over @trace, the number of
+ * entries into and exits from self refresh and their latencies. Latencies
+ * are only as precise as the sampling period, and are only counted between
+ * transitions seen by the trace.
+ */
+void igt_psr_trace_stats(const struct igt_psr_trace *trace, uint64_t flap_ns,
+			 struct igt_psr_trace_stats *stats)
+{
+	uint64_t active_since = 0, idle_since = 0, exit_since = 0;
+	bool active = false, idle = false, exiting = false;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!trace->num_samples)
+		return;
+
+	stats->duration_ns = trace->last_ns - trace->first_ns;
+
+	for (unsigned int i = 0; i < trace->num_transitions; i++) {
+		const struct igt_psr_transition *t = &trace->transitions[i];
+		uint64_t until = i + 1 < trace->num_transitions ?
+				 trace->transitions[i + 1].ts_ns :
+				 trace->last_ns;
+		bool known = t->from != IGT_PSR_STATE_UNKNOWN;
+
+		stats->residency_ns[t->to] += until - t->ts_ns;
+		if (igt_psr_state_active(t->to))
+			stats->active_ns += until - t->ts_ns;
+
+		/* Only a change of the sink state */
+		if (i && t->from == t->to)
+			continue;
+
+		if (igt_psr_state_active(t->to) && !active) {
+			if (known) {
+				stats->entries++;
+				if (idle)
+					psr_latency_add(&stats->entry,
+							t->ts_ns - idle_since);
+			}
+			active = true;
+			active_since = t->ts_ns;
+			idle = exiting = false;
+		} else if (!igt_psr_state_active(t->to) && active) {
+			stats->exits++;
+			if (t->ts_ns - active_since < flap_ns)
+				stats->flaps++;
+			active = false;
+			exiting = true;
+			exit_since = t->ts_ns;
+		}
+
+		if (t->to == IGT_PSR_STATE_IDLE) {
+			if (exiting)
+				psr_latency_add(&stats->exit,
+						t->ts_ns - exit_since);
+			exiting = false;
+			idle = known;
+			idle_since = t->ts_ns;
+		}
+	}
+}
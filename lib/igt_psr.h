@@ -45,4 +45,118 @@ bool psr_sink_support(int device, int debugfs_fd, enum psr_mode mode);
 bool psr2_wait_su(int debugfs_fd, uint16_t *num_su_blocks);
 void psr_print_debugfs(int debugfs_fd);
 
+/* State of the source as reported by i915_edp_psr_status */
+enum igt_psr_state {
+	IGT_PSR_STATE_UNKNOWN,
+	IGT_PSR_STATE_DISABLED,
+	IGT_PSR_STATE_IDLE,
+	/* PSR1 */
+	IGT_PSR_STATE_SRDONACK,
+	IGT_PSR_STATE_SRDENT,
+	IGT_PSR_STATE_BUFOFF,
+	IGT_PSR_STATE_BUFON,
+	IGT_PSR_STATE_AUXACK,
+	IGT_PSR_STATE_SRDOFFACK,
+	IGT_PSR_STATE_SRDENT_ON,
+	/* PSR2 */
+	IGT_PSR_STATE_CAPTURE,
+	IGT_PSR_STATE_CAPTURE_FS,
+	IGT_PSR_STATE_SLEEP,
+	IGT_PSR_STATE_BUFON_FW,
+	IGT_PSR_STATE_ML_UP,
+	IGT_PSR_STATE_SU_STANDBY,
+	IGT_PSR_STATE_FAST_SLEEP,
+	IGT_PSR_STATE_DEEP_SLEEP,
+	IGT_PSR_STATE_BUF_ON,
+	IGT_PSR_STATE_TG_ON,
+	IGT_PSR_NUM_STATES
+};
+
+enum igt_psr_status_mode {
+	IGT_PSR_STATUS_UNKNOWN,
+	IGT_PSR_STATUS_DISABLED,
+	IGT_PSR_STATUS_PSR1,
+	IGT_PSR_STATUS_PSR2,
+	IGT_PSR_STATUS_PANEL_REPLAY,
+};
+
+#define IGT_PSR2_SU_FRAMES 8
+
+struct igt_psr_status {
+	enum igt_psr_status_mode mode;
+	enum igt_psr_state state;
+	uint32_t source_status;
+	uint32_t busy_frontbuffer_bits;
+	bool sink_support;
+	bool sink_not_reliable;
+	/* DP_PSR_SINK_STATE from i915_psr_sink_status, -1 if not read */
+	int8_t sink_state;
+	uint8_t num_su_frames;
+	uint16_t su_blocks[IGT_PSR2_SU_FRAMES];
+};
+
+const char *igt_psr_state_name(enum igt_psr_state state);
+bool igt_psr_state_active(enum igt_psr_state state);
+void igt_psr_status_parse(const char *buf, size_t len,
+			  struct igt_psr_status *status);
+
+/* A change of the source or of the sink state */
+struct igt_psr_transition {
+	uint64_t ts_ns;
+	uint8_t from;
+	uint8_t to;
+	int8_t sink_state;
+	uint16_t su_blocks;
+};
+
+struct igt_psr_trace {
+	int status_fd;
+	int sink_fd;
+
+	struct igt_psr_status status;
+	uint64_t first_ns;
+	uint64_t last_ns;
+	uint64_t num_samples;
+	uint16_t su_blocks_max;
+
+	struct igt_psr_transition *transitions;
+	unsigned int num_transitions;
+	unsigned int max_transitions;
+
+	char buf[4096];
+};
+
+struct igt_psr_latency {
+	unsigned int count;
+	uint64_t min_ns;
+	uint64_t max_ns;
+	uint64_t total_ns;
+};
+
+struct igt_psr_trace_stats {
+	uint64_t duration_ns;
+	uint64_t residency_ns[IGT_PSR_NUM_STATES];
+	uint64_t active_ns;
+	unsigned int entries;
+	unsigned int exits;
+	/* Self refresh periods shorter than the flap threshold */
+	unsigned int flaps;
+	/* From reaching IDLE to entering self refresh */
+	struct igt_psr_latency entry;
+	/* From leaving self refresh to reaching IDLE */
+	struct igt_psr_latency exit;
+};
+
+void igt_psr_trace_init(struct igt_psr_trace *trace, int status_fd,
+			int sink_fd);
+bool igt_psr_trace_open(struct igt_psr_trace *trace, int debugfs_fd);
+void igt_psr_trace_fini(struct igt_psr_trace *trace);
+void igt_psr_trace_record(struct igt_psr_trace *trace, uint64_t ts_ns,
+			  const struct igt_psr_status *status);
+bool igt_psr_trace_sample(struct igt_psr_trace *trace);
+bool igt_psr_trace_run(struct igt_psr_trace *trace, uint64_t duration_ns,
+		       uint64_t period_ns);
+void igt_psr_trace_stats(const struct igt_psr_trace *trace, uint64_t flap_ns,
+			 struct igt_psr_trace_stats *stats);
+
 #endif
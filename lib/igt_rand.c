@@ -1,4 +1,7 @@
+#include <string.h>
+
 #include "igt_rand.h"
+#include "igt_x86.h"
 
 /**
  * SECTION:igt_rand
@@ -35,3 +38,390 @@ uint32_t hars_petruska_f54_1_random_unsafe(void)
 {
 	return hars_petruska_f54_1_random(&global);
 }
+
+/*
+ * Philox4x32-10 from "Parallel Random Numbers: As Easy as 1, 2, 3",
+ * Salmon et al., SC11. Each 128 bit counter is encrypted independently
+ * into 4 dwords, so any position of any stream can be computed directly.
+ * The counter holds the 64 bit block index and the 64 bit stream id.
+ */
+
+#define PHILOX_M0 0xd2511f53
+#define PHILOX_M1 0xcd9e8d57
+#define PHILOX_W0 0x9e3779b9
+#define PHILOX_W1 0xbb67ae85
+#define PHILOX_ROUNDS 10
+
+static void philox_block(const uint32_t key[2], uint64_t block,
+			 const uint32_t stream[2], uint32_t out[4])
+{
+	uint32_t c0 = block, c1 = block >> 32, c2 = stream[0], c3 = stream[1];
+	uint32_t k0 = key[0], k1 = key[1];
+
+	for (int r = 0; r < PHILOX_ROUNDS; r++) {
+		uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+		uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+
+		c0 = (p1 >> 32) ^ c1 ^ k0;
+		c1 = p1;
+		c2 = (p0 >> 32) ^ c3 ^ k1;
+		c3 = p0;
+
+		k0 += PHILOX_W0;
+		k1 += PHILOX_W1;
+	}
+
+	out[0] = c0;
+	out[1] = c1;
+	out[2] = c2;
+	out[3] = c3;
+}
+
+static void philox_blocks(const uint32_t key[2], uint64_t block,
+			  const uint32_t stream[2], uint32_t *out, size_t count)
+{
+	while (count--) {
+		philox_block(key, block++, stream, out);
+		out += 4;
+	}
+}
+
+#if defined(__x86_64__) && !defined(__clang__)
+#pragma GCC push_options
+#pragma GCC target("sse4.1")
+
+#include <smmintrin.h>
+
+/*
+ * 4 blocks in parallel, one block per lane. The 32x32->64 multiplies only
+ * operate on the even lanes, so the odd ones go through a shifted copy.
+ */
+static inline void philox_mul_sse41(__m128i a, __m128i m,
+				    __m128i *hi, __m128i *lo)
+{
+	__m128i even = _mm_mul_epu32(a, m);
+	__m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), m);
+
+	*lo = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xcc);
+	*hi = _mm_blend_epi16(_mm_srli_epi64(even, 32), odd, 0xcc);
+}
+
+static void philox_blocks_sse41(const uint32_t key[2], uint64_t block,
+				const uint32_t stream[2], uint32_t *out,
+				size_t count)
+{
+	const __m128i m0 = _mm_set1_epi32(PHILOX_M0);
+	const __m128i m1 = _mm_set1_epi32(PHILOX_M1);
+
+	for (; count >= 4; count -= 4, block += 4, out += 16) {
+		__m128i c0 = _mm_set_epi32(block + 3, block + 2, block + 1, block);
+		__m128i c1 = _mm_set_epi32((block + 3) >> 32, (block + 2) >> 32,
+					   (block + 1) >> 32, block >> 32);
+		__m128i c2 = _mm_set1_epi32(stream[0]);
+		__m128i c3 = _mm_set1_epi32(stream[1]);
+		uint32_t k0 = key[0], k1 = key[1];
+		__m128i t0, t1, t2, t3;
+
+		for (int r = 0; r < PHILOX_ROUNDS; r++) {
+			__m128i hi0, lo0, hi1, lo1;
+
+			philox_mul_sse41(c0, m0, &hi0, &lo0);
+			philox_mul_sse41(c2, m1, &hi1, &lo1);
+
+			c0 = _mm_xor_si128(_mm_xor_si128(hi1, c1),
+					   _mm_set1_epi32(k0));
+			c1 = lo1;
+			c2 = _mm_xor_si128(_mm_xor_si128(hi0, c3),
+					   _mm_set1_epi32(k1));
+			c3 = lo0;
+
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		/* Back to one block per 16 bytes */
+		t0 = _mm_unpacklo_epi32(c0, c1);
+		t1 = _mm_unpacklo_epi32(c2, c3);
+		t2 = _mm_unpackhi_epi32(c0, c1);
+		t3 = _mm_unpackhi_epi32(c2, c3);
+
+		_mm_storeu_si128((__m128i *)out + 0, _mm_unpacklo_epi64(t0, t1));
+		_mm_storeu_si128((__m128i *)out + 1, _mm_unpackhi_epi64(t0, t1));
+		_mm_storeu_si128((__m128i *)out + 2, _mm_unpacklo_epi64(t2, t3));
+		_mm_storeu_si128((__m128i *)out + 3, _mm_unpackhi_epi64(t2, t3));
+	}
+
+	philox_blocks(key, block, stream, out, count);
+}
+
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+
+#include <immintrin.h>
+
+static inline void philox_mul_avx2(__m256i a, __m256i m,
+				   __m256i *hi, __m256i *lo)
+{
+	__m256i even = _mm256_mul_epu32(a, m);
+	__m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), m);
+
+	*lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xaa);
+	*hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xaa);
+}
+
+static void philox_blocks_avx2(const uint32_t key[2], uint64_t block,
+			       const uint32_t stream[2], uint32_t *out,
+			       size_t count)
+{
+	const __m256i m0 = _mm256_set1_epi32(PHILOX_M0);
+	const __m256i m1 = _mm256_set1_epi32(PHILOX_M1);
+
+	for (; count >= 8; count -= 8, block += 8, out += 32) {
+		uint32_t lo[8], hi[8];
+		__m256i c0, c1, c2, c3, t0, t1, t2, t3, r0, r1, r2, r3;
+		uint32_t k0 = key[0], k1 = key[1];
+
+		for (int i = 0; i < 8; i++) {
+			lo[i] = block + i;
+			hi[i] = (block + i) >> 32;
+		}
+		c0 = _mm256_loadu_si256((const __m256i *)lo);
+		c1 = _mm256_loadu_si256((const __m256i *)hi);
+		c2 = _mm256_set1_epi32(stream[0]);
+		c3 = _mm256_set1_epi32(stream[1]);
+
+		for (int r = 0; r < PHILOX_ROUNDS; r++) {
+			__m256i hi0, lo0, hi1, lo1;
+
+			philox_mul_avx2(c0, m0, &hi0, &lo0);
+			philox_mul_avx2(c2, m1, &hi1, &lo1);
+
+			c0 = _mm256_xor_si256(_mm256_xor_si256(hi1, c1),
+					      _mm256_set1_epi32(k0));
+			c1 = lo1;
+			c2 = _mm256_xor_si256(_mm256_xor_si256(hi0, c3),
+					      _mm256_set1_epi32(k1));
+			c3 = lo0;
+
+			k0 += PHILOX_W0;
+			k1 += PHILOX_W1;
+		}
+
+		/* Transpose within each 128 bit half: blocks 0-3 and 4-7 */
+		t0 = _mm256_unpacklo_epi32(c0, c1);
+		t1 = _mm256_unpacklo_epi32(c2, c3);
+		t2 = _mm256_unpackhi_epi32(c0, c1);
+		t3 = _mm256_unpackhi_epi32(c2, c3);
+		r0 = _mm256_unpacklo_epi64(t0, t1);
+		r1 = _mm256_unpackhi_epi64(t0, t1);
+		r2 = _mm256_unpacklo_epi64(t2, t3);
+		r3 = _mm256_unpackhi_epi64(t2, t3);
+
+		_mm256_storeu_si256((__m256i *)out + 0,
+				    _mm256_permute2x128_si256(r0, r1, 0x20));
+		_mm256_storeu_si256((__m256i *)out + 1,
+				    _mm256_permute2x128_si256(r2, r3, 0x20));
+		_mm256_storeu_si256((__m256i *)out + 2,
+				    _mm256_permute2x128_si256(r0, r1, 0x31));
+		_mm256_storeu_si256((__m256i *)out + 3,
+				    _mm256_permute2x128_si256(r2, r3, 0x31));
+	}
+
+	philox_blocks_sse41(key, block, stream, out, count);
+}
+
+#pragma GCC pop_options
+
+static void (*resolve_philox_blocks(void))(const uint32_t *, uint64_t,
+					   const uint32_t *, uint32_t *, size_t)
+{
+	unsigned features = igt_x86_features();
+
+	if (features & AVX2)
+		return philox_blocks_avx2;
+	if (features & SSE4_1)
+		return philox_blocks_sse41;
+
+	return philox_blocks;
+}
+
+static void philox_blocks_bulk(const uint32_t key[2], uint64_t block,
+			       const uint32_t stream[2], uint32_t *out,
+			       size_t count)
+	__attribute__((ifunc("resolve_philox_blocks")));
+#else
+static void philox_blocks_bulk(const uint32_t key[2], uint64_t block,
+			       const uint32_t stream[2], uint32_t *out,
+			       size_t count)
+{
+	philox_blocks(key, block, stream, out, count);
+}
+#endif
+
+/**
+ * igt_philox_init:
+ * @rng: generator state
+ * @seed: seed
+ *
+ * Initializes @rng to the start of the master stream of @seed.
+ *
+ * Unlike hars_petruska_f54_1_random(), the output at any position can be
+ * computed directly, so the generator can be moved around in O(1) with
+ * igt_philox_jump(), and independent streams can be derived for child
+ * processes or threads with igt_philox_split(), reproducibly from the one
+ * seed.
+ */
+void igt_philox_init(igt_philox_t *rng, uint64_t seed)
+{
+	rng->key[0] = seed;
+	rng->key[1] = seed >> 32;
+	rng->stream[0] = 0;
+	rng->stream[1] = 0;
+	rng->pos = 0;
+	rng->cached = UINT64_MAX;
+}
+
+/**
+ * igt_philox_split:
+ * @parent: generator to derive from
+ * @child: returns the derived generator
+ * @id: index of the child, e.g. the child number of igt_fork()
+ *
+ * Initializes @child to the start of a stream derived from the stream of
+ * @parent and @id, independent of the position of @parent. The same @id
+ * always gives the same stream, and children can be split further.
+ *
+ * |[<!-- language="C" -->
+ * igt_philox_init(&rng, seed);
+ * igt_fork(child, ncpus) {
+ *	igt_philox_t local;
+ *
+ *	igt_philox_split(&rng, &local, child);
+ *	...
+ * }
+ * ]|
+ */
+void igt_philox_split(const igt_philox_t *parent, igt_philox_t *child,
+		      uint64_t id)
+{
+	uint32_t out[4];
+
+	/*
+	 * Stream ids are a function of the parent stream and id under the
+	 * same key, distinct streams colliding with probability 2^-64.
+	 * Stream 0 is kept for the master.
+	 */
+	philox_block(parent->key, id, parent->stream, out);
+
+	child->key[0] = parent->key[0];
+	child->key[1] = parent->key[1];
+	child->stream[0] = out[0];
+	child->stream[1] = out[1] ?: 1;
+	child->pos = 0;
+	child->cached = UINT64_MAX;
+}
+
+/**
+ * igt_philox_jump:
+ * @rng: generator state
+ * @n_dwords: number of dwords to skip
+ *
+ * Advances @rng by @n_dwords in constant time, as if that many calls to
+ * igt_philox_random() had been made.
+ */
+void igt_philox_jump(igt_philox_t *rng, uint64_t n_dwords)
+{
+	rng->pos += n_dwords;
+}
+
+/**
+ * igt_philox_random:
+ * @rng: generator state
+ *
+ * Returns: the next 32 bit pseudo-random number of the stream.
+ */
+uint32_t igt_philox_random(igt_philox_t *rng)
+{
+	uint64_t block = rng->pos / 4;
+
+	if (rng->cached != block) {
+		philox_block(rng->key, block, rng->stream, rng->buf);
+		rng->cached = block;
+	}
+
+	return rng->buf[rng->pos++ % 4];
+}
+
+/**
+ * igt_philox_random64:
+ * @rng: generator state
+ *
+ * Returns: the next 64 bit pseudo-random number of the stream, made of
+ * the next two dwords.
+ */
+uint64_t igt_philox_random64(igt_philox_t *rng)
+{
+	uint32_t l = igt_philox_random(rng);
+	uint32_t h = igt_philox_random(rng);
+
+	return (uint64_t)h << 32 | l;
+}
+
+/**
+ * igt_philox_fill:
+ * @rng: generator state
+ * @dst: buffer to fill
+ * @size: size of @dst in bytes
+ *
+ * Fills @dst with the next dwords of the stream, the same as storing the
+ * results of igt_philox_random() one after the other, but generating
+ * several blocks at a time with SSE4.1 or AVX2 when available. A trailing
+ * partial dword consumes a whole one.
+ */
+void igt_philox_fill(igt_philox_t *rng, void *dst, size_t size)
+{
+	uint8_t *out = dst;
+	size_t blocks;
+
+	/* Up to the next block boundary */
+	while (size >= 4 && rng->pos % 4) {
+		uint32_t v = igt_philox_random(rng);
+
+		memcpy(out, &v, 4);
+		out += 4;
+		size -= 4;
+	}
+
+	blocks = size / 16;
+	if (blocks) {
+		if (((uintptr_t)out & 3) == 0) {
+			philox_blocks_bulk(rng->key, rng->pos / 4, rng->stream,
+					   (uint32_t *)out, blocks);
+		} else {
+			uint32_t tmp[64];
+
+			for (size_t i = 0; i < blocks; i += 16) {
+				size_t n = blocks - i < 16 ? blocks - i : 16;
+
+				philox_blocks_bulk(rng->key, rng->pos / 4 + i,
+						   rng->stream, tmp, n);
+				memcpy(out + i * 16, tmp, n * 16);
+			}
+		}
+
+		rng->pos += 4 * blocks;
+		out += 16 * blocks;
+		size -= 16 * blocks;
+	}
+
+	while (size) {
+		uint32_t v = igt_philox_random(rng);
+		size_t n = size < 4 ? size : 4;
+
+		memcpy(out, &v, n);
+		out += n;
+		size -= n;
+	}
+}
@@ -24,6 +24,7 @@
 #ifndef IGT_RAND_H
 #define IGT_RAND_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 uint32_t hars_petruska_f54_1_random(uint32_t *state);
@@ -45,4 +46,37 @@ static inline uint32_t hars_petruska_f54_1_random_unsafe_max(uint32_t ep_ro)
 	return ((uint64_t)hars_petruska_f54_1_random_unsafe() * ep_ro) >> 32;
 }
 
+/**
+ * igt_philox_t:
+ * @key: the seed
+ * @stream: stream id, 0 for the master stream
+ * @pos: index of the next dword in the stream
+ *
+ * State of a Philox4x32-10 counter based generator, see igt_philox_init().
+ */
+typedef struct igt_philox {
+	uint32_t key[2];
+	uint32_t stream[2];
+	uint64_t pos;
+
+	/*< private >*/
+	uint64_t cached;
+	uint32_t buf[4];
+} igt_philox_t;
+
+void igt_philox_init(igt_philox_t *rng, uint64_t seed);
+void igt_philox_split(const igt_philox_t *parent, igt_philox_t *child,
+		      uint64_t id);
+void igt_philox_jump(igt_philox_t *rng, uint64_t n_dwords);
+
+uint32_t igt_philox_random(igt_philox_t *rng);
+uint64_t igt_philox_random64(igt_philox_t *rng);
+void igt_philox_fill(igt_philox_t *rng, void *dst, size_t size);
+
+/* Returns: pseudo-random number in interval [0, ep_ro) */
+static inline uint32_t igt_philox_random_max(igt_philox_t *rng, uint32_t ep_ro)
+{
+	return ((uint64_t)igt_philox_random(rng) * ep_ro) >> 32;
+}
+
 #endif /* IGT_RAND_H */
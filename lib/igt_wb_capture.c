@@ -0,0 +1,369 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_fb.h"
+#include "igt_wb_capture.h"
+#include "sw_sync.h"
+
+/**
+ * SECTION:igt_wb_capture
+ * @short_description: Writeback connector based frame capture
+ * @title: Writeback capture
+ * @include: igt_wb_capture.h
+ *
+ * This library captures the output of a pipe through a writeback connector
+ * and reduces each captured frame to an #igt_crc_t. This needs neither
+ * hardware CRC support nor a Chamelium, so it works on virtual drivers like
+ * vkms.
+ *
+ * Frames are written into a ring of framebuffers which are allocated and
+ * mapped up front. The writeback out-fence of each commit is handed to a
+ * worker thread, which waits for it and hashes the frame with the same FNV-1a
+ * hash as igt_fb_get_fnv1a_crc(). A reference CRC can therefore be computed
+ * from the input framebuffer directly.
+ *
+ * Each captured frame is bracketed around an atomic commit:
+ *
+ * |[<!-- language="C" -->
+ *	igt_wb_capture_queue(wb);
+ *	igt_display_commit_atomic(display, 0, NULL);
+ *	igt_wb_capture_submit(wb);
+ * ]|
+ *
+ * and the results are collected with igt_wb_capture_get_crcs(), in
+ * submission order.
+ */
+
+#define WB_FENCE_TIMEOUT_MS 1000
+
+enum wb_slot_state {
+	WB_SLOT_FREE,
+	WB_SLOT_QUEUED,
+	WB_SLOT_INFLIGHT,
+};
+
+struct wb_slot {
+	struct igt_fb fb;
+	void *map;
+	int fence;
+	uint32_t frame;
+	enum wb_slot_state state;
+};
+
+struct igt_wb_capture {
+	igt_output_t *output;
+	int drm_fd;
+
+	struct wb_slot *slots;
+	unsigned int n_slots;
+	/* next slot to attach to a commit */
+	unsigned int head;
+	/* next slot for the worker to hash */
+	unsigned int tail;
+	uint32_t frame;
+	/* frames submitted but not yet handed out */
+	unsigned int outstanding;
+
+	igt_crc_t *crcs;
+	unsigned int n_crcs, max_crcs;
+	/* first crc not yet handed out */
+	unsigned int read;
+
+	int error;
+	bool stop;
+
+	pthread_t worker;
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+};
+
+static void wb_push_crc(igt_wb_capture_t *wb, const igt_crc_t *crc)
+{
+	if (wb->n_crcs == wb->max_crcs) {
+		wb->max_crcs = wb->max_crcs ? 2 * wb->max_crcs : 64;
+		wb->crcs = realloc(wb->crcs, wb->max_crcs * sizeof(*wb->crcs));
+	}
+
+	wb->crcs[wb->n_crcs++] = *crc;
+}
+
+static void *wb_worker(void *data)
+{
+	igt_wb_capture_t *wb = data;
+
+	pthread_mutex_lock(&wb->lock);
+	for (;;) {
+		struct wb_slot *slot = &wb->slots[wb->tail];
+		igt_crc_t crc = {};
+		int ret;
+
+		if (slot->state != WB_SLOT_INFLIGHT) {
+			if (wb->stop)
+				break;
+
+			pthread_cond_wait(&wb->cond, &wb->lock);
+			continue;
+		}
+
+		/* The slot is ours until we mark it free again */
+		pthread_mutex_unlock(&wb->lock);
+
+		ret = sync_fence_wait(slot->fence, WB_FENCE_TIMEOUT_MS);
+		if (ret == 0)
+			ret = igt_fb_get_fnv1a_crc_mapped(&slot->fb, slot->map,
+							  &crc);
+		crc.frame = slot->frame;
+		crc.has_valid_frame = true;
+
+		close(slot->fence);
+		slot->fence = -1;
+
+		pthread_mutex_lock(&wb->lock);
+		if (ret && !wb->error)
+			wb->error = ret;
+		else if (!ret)
+			wb_push_crc(wb, &crc);
+
+		slot->state = WB_SLOT_FREE;
+		wb->tail = (wb->tail + 1) % wb->n_slots;
+		pthread_cond_broadcast(&wb->cond);
+	}
+	pthread_mutex_unlock(&wb->lock);
+
+	return NULL;
+}
+
+/**
+ * igt_wb_capture_new:
+ * @output: writeback output to capture from
+ * @width: width of the capture framebuffers
+ * @height: height of the capture framebuffers
+ * @format: DRM format of the capture framebuffers
+ * @n_buffers: number of capture framebuffers in the ring
+ *
+ * Allocates and maps @n_buffers linear framebuffers and starts the hashing
+ * worker. The output must already be routed to a pipe with a mode of the
+ * given size.
+ *
+ * Returns: A writeback capture object, to be released with
+ * igt_wb_capture_free().
+ */
+igt_wb_capture_t *igt_wb_capture_new(igt_output_t *output,
+				     int width, int height, uint32_t format,
+				     unsigned int n_buffers)
+{
+	igt_wb_capture_t *wb;
+	unsigned int i;
+
+	igt_assert(output->config.connector->connector_type ==
+		   DRM_MODE_CONNECTOR_WRITEBACK);
+	igt_assert(n_buffers > 0);
+
+	wb = calloc(1, sizeof(*wb));
+	igt_assert(wb);
+
+	wb->output = output;
+	wb->drm_fd = output->display->drm_fd;
+	wb->n_slots = n_buffers;
+	wb->slots = calloc(n_buffers, sizeof(*wb->slots));
+	igt_assert(wb->slots);
+
+	for (i = 0; i < n_buffers; i++) {
+		struct wb_slot *slot = &wb->slots[i];
+
+		igt_create_fb(wb->drm_fd, width, height, format,
+			      DRM_FORMAT_MOD_LINEAR, &slot->fb);
+		igt_assert(slot->fb.num_planes == 1);
+
+		slot->map = igt_fb_map_buffer(wb->drm_fd, &slot->fb);
+		igt_assert(slot->map);
+		slot->fence = -1;
+	}
+
+	pthread_mutex_init(&wb->lock, NULL);
+	pthread_cond_init(&wb->cond, NULL);
+	igt_assert_eq(pthread_create(&wb->worker, NULL, wb_worker, wb), 0);
+
+	return wb;
+}
+
+/**
+ * igt_wb_capture_free:
+ * @wb: writeback capture object
+ *
+ * Waits for the worker to hash the outstanding frames, then releases all
+ * resources of @wb. A frame which was queued but never submitted is dropped.
+ */
+void igt_wb_capture_free(igt_wb_capture_t *wb)
+{
+	unsigned int i;
+
+	if (!wb)
+		return;
+
+	pthread_mutex_lock(&wb->lock);
+	wb->stop = true;
+	pthread_cond_broadcast(&wb->cond);
+	pthread_mutex_unlock(&wb->lock);
+	pthread_join(wb->worker, NULL);
+
+	if (wb->slots[wb->head].state == WB_SLOT_QUEUED)
+		igt_output_set_writeback_fb(wb->output, NULL);
+
+	for (i = 0; i < wb->n_slots; i++) {
+		struct wb_slot *slot = &wb->slots[i];
+
+		igt_fb_unmap_buffer(&slot->fb, slot->map);
+		igt_remove_fb(wb->drm_fd, &slot->fb);
+	}
+
+	pthread_cond_destroy(&wb->cond);
+	pthread_mutex_destroy(&wb->lock);
+	free(wb->slots);
+	free(wb->crcs);
+	free(wb);
+}
+
+/**
+ * igt_wb_capture_queue:
+ * @wb: writeback capture object
+ *
+ * Attaches the next framebuffer of the ring to the writeback output, so that
+ * the next atomic commit captures into it. Blocks while every framebuffer of
+ * the ring is still waiting to be hashed.
+ */
+void igt_wb_capture_queue(igt_wb_capture_t *wb)
+{
+	struct wb_slot *slot = &wb->slots[wb->head];
+
+	igt_assert(slot->state != WB_SLOT_QUEUED);
+
+	pthread_mutex_lock(&wb->lock);
+	while (slot->state != WB_SLOT_FREE)
+		pthread_cond_wait(&wb->cond, &wb->lock);
+	slot->state = WB_SLOT_QUEUED;
+	pthread_mutex_unlock(&wb->lock);
+
+	igt_output_set_writeback_fb(wb->output, &slot->fb);
+}
+
+/**
+ * igt_wb_capture_submit:
+ * @wb: writeback capture object
+ *
+ * Hands the out-fence of the atomic commit following igt_wb_capture_queue()
+ * over to the worker, which hashes the frame once the fence signals. Must be
+ * called after every such commit.
+ */
+void igt_wb_capture_submit(igt_wb_capture_t *wb)
+{
+	struct wb_slot *slot = &wb->slots[wb->head];
+	igt_output_t *output = wb->output;
+
+	igt_assert(slot->state == WB_SLOT_QUEUED);
+	igt_assert(output->writeback_out_fence_fd >= 0);
+
+	pthread_mutex_lock(&wb->lock);
+	slot->fence = output->writeback_out_fence_fd;
+	output->writeback_out_fence_fd = -1;
+	slot->frame = wb->frame++;
+	wb->outstanding++;
+	slot->state = WB_SLOT_INFLIGHT;
+	wb->head = (wb->head + 1) % wb->n_slots;
+	pthread_cond_broadcast(&wb->cond);
+	pthread_mutex_unlock(&wb->lock);
+}
+
+/**
+ * igt_wb_capture_get_crcs:
+ * @wb: writeback capture object
+ * @n_crcs: number of CRCs to wait for
+ * @out_crcs: return location for the CRCs
+ *
+ * Waits until @n_crcs frames submitted with igt_wb_capture_submit() have
+ * been hashed, in submission order. The @frame field of each CRC is the
+ * submission sequence number, starting at 0. Fails the test if a writeback
+ * fence timed out, or if fewer than @n_crcs frames are outstanding.
+ *
+ * Callers must free the returned array with free().
+ *
+ * Returns: The number of CRCs returned, which is always @n_crcs.
+ */
+int igt_wb_capture_get_crcs(igt_wb_capture_t *wb, int n_crcs,
+			    igt_crc_t **out_crcs)
+{
+	igt_crc_t *crcs;
+
+	crcs = calloc(n_crcs, sizeof(*crcs));
+	igt_assert(crcs);
+
+	igt_assert_f(n_crcs <= wb->outstanding,
+		     "Waiting for %d writeback frames, only %u submitted\n",
+		     n_crcs, wb->outstanding);
+
+	pthread_mutex_lock(&wb->lock);
+	while (!wb->error && wb->n_crcs - wb->read < n_crcs)
+		pthread_cond_wait(&wb->cond, &wb->lock);
+
+	if (wb->error) {
+		int error = wb->error;
+
+		pthread_mutex_unlock(&wb->lock);
+		free(crcs);
+		igt_assert_f(0, "Writeback capture failed: %s\n",
+			     strerror(-error));
+	}
+
+	memcpy(crcs, &wb->crcs[wb->read], n_crcs * sizeof(*crcs));
+	wb->read += n_crcs;
+	if (wb->read == wb->n_crcs)
+		wb->n_crcs = wb->read = 0;
+	wb->outstanding -= n_crcs;
+	pthread_mutex_unlock(&wb->lock);
+
+	*out_crcs = crcs;
+	return n_crcs;
+}
+
+/**
+ * igt_wb_capture_get_single:
+ * @wb: writeback capture object
+ * @crc: CRC object
+ *
+ * Convenience wrapper around igt_wb_capture_get_crcs() for a single frame.
+ */
+void igt_wb_capture_get_single(igt_wb_capture_t *wb, igt_crc_t *crc)
+{
+	igt_crc_t *crcs;
+
+	igt_wb_capture_get_crcs(wb, 1, &crcs);
+	*crc = crcs[0];
+	free(crcs);
+}
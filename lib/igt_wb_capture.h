@@ -0,0 +1,52 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef IGT_WB_CAPTURE_H
+#define IGT_WB_CAPTURE_H
+
+#include <stdint.h>
+
+#include "igt_debugfs.h"
+#include "igt_kms.h"
+
+/**
+ * igt_wb_capture_t:
+ *
+ * Writeback capture structure. Needs to be allocated and set up with
+ * igt_wb_capture_new() for a writeback output.
+ */
+typedef struct igt_wb_capture igt_wb_capture_t;
+
+igt_wb_capture_t *igt_wb_capture_new(igt_output_t *output,
+				     int width, int height, uint32_t format,
+				     unsigned int n_buffers);
+void igt_wb_capture_free(igt_wb_capture_t *wb);
+
+void igt_wb_capture_queue(igt_wb_capture_t *wb);
+void igt_wb_capture_submit(igt_wb_capture_t *wb);
+
+int igt_wb_capture_get_crcs(igt_wb_capture_t *wb, int n_crcs,
+			    igt_crc_t **out_crcs);
+void igt_wb_capture_get_single(igt_wb_capture_t *wb, igt_crc_t *crc);
+
+#endif /* IGT_WB_CAPTURE_H */
@@ -25,6 +25,7 @@
 #include <sys/ioctl.h>
 #include <cairo.h>
 #include "igt.h"
+#include "igt_dump.h"
 #include "igt_x86.h"
 #include "intel_bufops.h"
 
@@ -1055,6 +1056,14 @@ static void __intel_buf_write_to_png(struct buf_ops *bops,
 
 	intel_buf_to_linear(bops, buf, linear);
 
+	if (igt_dump_is_async()) {
+		igt_dump_frame(filename, igt_dump_cairo_to_drm_format(format),
+			       width, height, stride,
+			       (uint8_t *) linear + offset);
+		free(linear);
+		return;
+	}
+
 	surface = cairo_image_surface_create_for_data((uint8_t *) linear + offset,
 						      format, width, height,
 						      stride);
@@ -0,0 +1,301 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <i915_drm.h>
+
+#include "igt_core.h"
+
+#include "i915/perf_data.h"
+#include "i915/perf_data_reader.h"
+
+/* Skylake GT2, with the Gen9 256 bytes OA report layout. */
+#define DEVICE_ID 0x1916
+#define OA_REPORT_SIZE 256
+
+/* CPU time is 1000000 + 2 * (GPU time - 1000) at every correlation point. */
+static const uint64_t correlations[][2] = {
+	{ 1000000, 1000 },
+	{ 1002000, 2000 },
+	{ 1004000, 3000 },
+};
+
+static void write_record(FILE *f, uint32_t type, const void *data, size_t size)
+{
+	struct drm_i915_perf_record_header header = {
+		.type = type,
+		.size = sizeof(header) + size,
+	};
+
+	igt_assert_eq(fwrite(&header, sizeof(header), 1, f), 1);
+	igt_assert_eq(fwrite(data, size, 1, f), 1);
+}
+
+static void write_header(FILE *f)
+{
+	struct intel_perf_record_version version = {
+		.version = INTEL_PERF_RECORD_VERSION,
+	};
+	struct intel_perf_record_device_info info = {
+		.timestamp_frequency = 1000000000ull,
+		.device_id = DEVICE_ID,
+		.gt_min_frequency = 300000000,
+		.gt_max_frequency = 1000000000,
+		.oa_format = I915_OA_FORMAT_A32u40_A4u32_B8_C8,
+		.metric_set_name = "RenderBasic",
+	};
+	struct {
+		struct drm_i915_query_topology_info topology;
+		uint8_t data[8];
+	} topology = {
+		/* One slice, 3 subslices of 8 EUs */
+		.topology = {
+			.max_slices = 1,
+			.max_subslices = 3,
+			.max_eus_per_subslice = 8,
+			.subslice_offset = 1,
+			.subslice_stride = 1,
+			.eu_offset = 2,
+			.eu_stride = 1,
+		},
+		.data = { 0x1, 0x7, 0xff, 0xff, 0xff },
+	};
+
+	write_record(f, INTEL_PERF_RECORD_TYPE_VERSION, &version, sizeof(version));
+	write_record(f, INTEL_PERF_RECORD_TYPE_DEVICE_INFO, &info, sizeof(info));
+	write_record(f, INTEL_PERF_RECORD_TYPE_DEVICE_TOPOLOGY,
+		     &topology, sizeof(topology));
+}
+
+static void write_correlations(FILE *f)
+{
+	for (int i = 0; i < 3; i++) {
+		struct intel_perf_record_timestamp_correlation corr = {
+			.cpu_timestamp = correlations[i][0],
+			.gpu_timestamp = correlations[i][1],
+		};
+
+		write_record(f, INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+			     &corr, sizeof(corr));
+	}
+}
+
+static void write_report(FILE *f, uint32_t gpu_ts, uint32_t hw_id, uint32_t b0)
+{
+	uint32_t report[OA_REPORT_SIZE / 4] = {};
+
+	report[0] = 1 << 16; /* context valid */
+	report[1] = gpu_ts;
+	report[2] = hw_id;
+	report[48] = b0;
+
+	write_record(f, DRM_I915_PERF_RECORD_SAMPLE, report, sizeof(report));
+}
+
+static void write_request(FILE *f, uint64_t cpu_ts, uint32_t seqno)
+{
+	struct intel_perf_record_request request = {
+		.cpu_timestamp = cpu_ts,
+		.ctx = 1,
+		.seqno = seqno,
+		.event = INTEL_PERF_REQUEST_SUBMIT,
+	};
+
+	write_record(f, INTEL_PERF_RECORD_TYPE_REQUEST, &request, sizeof(request));
+}
+
+static void open_reader(FILE *f, struct intel_perf_data_reader *reader)
+{
+	igt_assert_eq(fflush(f), 0);
+	igt_assert_f(intel_perf_data_reader_init(reader, fileno(f)),
+		     "%s\n", reader->error_msg);
+}
+
+static void test_merged_events(void)
+{
+	/* Expected order, OA reports first on CPU timestamp ties and
+	 * requests of the same timestamp in file order.
+	 */
+	static const struct {
+		enum intel_perf_event_type type;
+		uint64_t cpu_ts;
+		uint32_t id; /* record index or seqno */
+	} expected[] = {
+		{ INTEL_PERF_EVENT_OA_REPORT, 999000, 0 },	/* before the first point */
+		{ INTEL_PERF_EVENT_REQUEST, 999500, 1 },
+		{ INTEL_PERF_EVENT_OA_REPORT, 1001000, 1 },
+		{ INTEL_PERF_EVENT_REQUEST, 1001000, 2 },
+		{ INTEL_PERF_EVENT_OA_REPORT, 1003000, 2 },
+		{ INTEL_PERF_EVENT_REQUEST, 1004000, 3 },
+		{ INTEL_PERF_EVENT_REQUEST, 1004000, 4 },
+		{ INTEL_PERF_EVENT_OA_REPORT, 1005000, 3 },	/* extrapolated */
+		{ INTEL_PERF_EVENT_REQUEST, 1006000, 5 },
+	};
+	struct intel_perf_data_reader reader;
+	FILE *f = tmpfile();
+
+	igt_assert(f);
+
+	write_header(f);
+	write_correlations(f);
+
+	/* Each stream in its own order, the reader has to interleave them. */
+	write_report(f, 500, 1, 0);
+	write_report(f, 1500, 1, 0);
+	write_report(f, 2500, 1, 0);
+	write_report(f, 3500, 1, 0);
+
+	write_request(f, 999500, 1);
+	write_request(f, 1001000, 2);
+	write_request(f, 1004000, 3);
+	write_request(f, 1004000, 4);
+	write_request(f, 1006000, 5);
+
+	open_reader(f, &reader);
+
+	igt_assert_eq(reader.n_records, 4);
+	igt_assert_eq(reader.n_correlations, 3);
+	igt_assert_eq(reader.n_events, 9);
+
+	for (int i = 0; i < 9; i++) {
+		const struct intel_perf_event *event = &reader.events[i];
+
+		igt_assert_eq(event->type, expected[i].type);
+		igt_assert_eq_u64(event->cpu_ts, expected[i].cpu_ts);
+
+		if (event->type == INTEL_PERF_EVENT_OA_REPORT)
+			igt_assert_eq_u32(event->record, expected[i].id);
+		else
+			igt_assert_eq_u32(event->request->seqno, expected[i].id);
+	}
+
+	intel_perf_data_reader_fini(&reader);
+	fclose(f);
+}
+
+static void test_no_correlation(void)
+{
+	struct intel_perf_data_reader reader;
+	FILE *f = tmpfile();
+
+	igt_assert(f);
+
+	/* A single point gives no slope, OA reports can't be placed. */
+	write_header(f);
+	write_record(f, INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+		     &(struct intel_perf_record_timestamp_correlation) {
+			     .cpu_timestamp = correlations[0][0],
+			     .gpu_timestamp = correlations[0][1],
+		     },
+		     sizeof(struct intel_perf_record_timestamp_correlation));
+	write_report(f, 1500, 1, 0);
+	write_request(f, 1004000, 1);
+
+	open_reader(f, &reader);
+
+	igt_assert_eq(reader.n_records, 1);
+	igt_assert_eq(reader.n_events, 1);
+	igt_assert_eq(reader.events[0].type, INTEL_PERF_EVENT_REQUEST);
+
+	intel_perf_data_reader_fini(&reader);
+	fclose(f);
+}
+
+/* Index of B0 in the accumulated deltas of the A32u40_A4u32_B8_C8 format,
+ * after the timestamp, the clock, 32 A40 and 4 A32 counters.
+ */
+#define B0_DELTA 38
+
+static void test_context_stats(void)
+{
+	struct intel_perf_context_stats stats;
+	const struct intel_perf_context_totals *a, *b;
+	struct intel_perf_data_reader reader;
+	FILE *f = tmpfile();
+
+	igt_assert(f);
+
+	write_header(f);
+	write_correlations(f);
+
+	/* Context 0x10, switch to 0x20 at 1300, back to 0x10 at 1600. The
+	 * B0 counter wraps during the first slice of 0x10.
+	 */
+	write_report(f, 1000, 0x10, 0xfffffff0);
+	write_report(f, 1100, 0x10, 0xfffffff5);
+	write_report(f, 1200, 0x10, 0xfffffffa);
+	write_report(f, 1300, 0x20, 0x0000000e);
+	write_report(f, 1500, 0x20, 0x00000036);
+	write_report(f, 1600, 0x10, 0x0000003b);
+	write_report(f, 1650, 0x10, 0x00000040);
+
+	open_reader(f, &reader);
+
+	igt_assert(intel_perf_data_reader_context_stats(&reader, 200, &stats));
+
+	igt_assert_eq(stats.n_contexts, 2);
+	igt_assert_eq_u64(stats.gpu_time_ns, 650);
+	igt_assert_eq_u64(stats.cpu_ts_start, 1000000);
+	igt_assert(!intel_perf_context_stats_find(&stats, 0x30));
+
+	/* Each delta goes to the context of its earlier report. */
+	a = intel_perf_context_stats_find(&stats, 0x10);
+	igt_assert(a);
+	igt_assert_eq(a->n_deltas, 4);
+	igt_assert_eq_u64(a->gpu_time_ns, 350);
+	igt_assert_eq_u64(a->totals.deltas[B0_DELTA], 35);
+
+	b = intel_perf_context_stats_find(&stats, 0x20);
+	igt_assert(b);
+	igt_assert_eq(b->n_deltas, 2);
+	igt_assert_eq_u64(b->gpu_time_ns, 300);
+	igt_assert_eq_u64(b->totals.deltas[B0_DELTA], 45);
+
+	/* 200ns buckets from the first report, on accumulated GPU time. */
+	igt_assert_eq(stats.n_buckets, 4);
+	igt_assert_eq_u64(a->buckets[0].deltas[0], 200);
+	igt_assert_eq_u64(a->buckets[1].deltas[0], 100);
+	igt_assert_eq_u64(a->buckets[3].deltas[0], 50);
+	igt_assert_eq_u64(b->buckets[1].deltas[0], 200);
+	igt_assert_eq_u64(b->buckets[2].deltas[0], 100);
+
+	intel_perf_context_stats_fini(&stats);
+	intel_perf_data_reader_fini(&reader);
+	fclose(f);
+}
+
+igt_main
+{
+	igt_subtest("merged-events")
+		test_merged_events();
+
+	igt_subtest("no-correlation")
+		test_no_correlation();
+
+	igt_subtest("context-stats")
+		test_context_stats();
+}
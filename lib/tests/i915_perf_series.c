@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+
+#include "i915/perf_series.h"
+
+#define N_SAMPLES 100000
+#define PERIOD_NS 1000
+#define SPIKE 31337
+
+/* A flat 1.0 signal sampled every PERIOD_NS, with a single spike. */
+static void fill(struct intel_perf_series *series)
+{
+	intel_perf_series_init(series);
+
+	for (uint64_t i = 0; i < N_SAMPLES; i++)
+		intel_perf_series_add(series, i * PERIOD_NS,
+				      i == SPIKE ? 100.0 : 1.0);
+
+	intel_perf_series_build(series, 0, 16);
+}
+
+static void check_overview(const struct intel_perf_series *series)
+{
+	struct intel_perf_series_bucket buckets[10];
+	uint64_t total = 0;
+
+	igt_assert_eq(intel_perf_series_query(series, 0,
+					      N_SAMPLES * PERIOD_NS,
+					      10, buckets), 10);
+
+	for (int i = 0; i < 10; i++) {
+		total += buckets[i].n;
+		igt_assert_eq_double(buckets[i].min, 1.0);
+		igt_assert_eq_double(buckets[i].last, 1.0);
+
+		/* The spike survives in its bucket, only. */
+		if (i == SPIKE * 10 / N_SAMPLES)
+			igt_assert_eq_double(buckets[i].max, 100.0);
+		else
+			igt_assert_eq_double(buckets[i].max, 1.0);
+	}
+
+	igt_assert_eq_u64(total, N_SAMPLES);
+}
+
+static void check_zoom(const struct intel_perf_series *series)
+{
+	struct intel_perf_series_bucket buckets[4];
+	uint64_t start = (SPIKE - 2) * PERIOD_NS;
+
+	/* Finer than the bottom level, from the raw samples. */
+	igt_assert_eq(intel_perf_series_query(series, start,
+					      start + 4 * PERIOD_NS,
+					      4, buckets), 4);
+
+	for (int i = 0; i < 4; i++) {
+		igt_assert_eq(buckets[i].n, 1);
+		igt_assert_eq_double(buckets[i].sum, i == 2 ? 100.0 : 1.0);
+	}
+}
+
+static void test_downsample(void)
+{
+	struct intel_perf_series series;
+
+	fill(&series);
+
+	igt_assert(series.n_levels > 1);
+	igt_assert_eq(series.levels[series.n_levels - 1].n_buckets, 1);
+	igt_assert_eq(series.levels[series.n_levels - 1].buckets[0].n,
+		      N_SAMPLES);
+
+	check_overview(&series);
+	check_zoom(&series);
+
+	intel_perf_series_fini(&series);
+}
+
+static void test_empty_range(void)
+{
+	struct intel_perf_series_bucket buckets[8];
+	struct intel_perf_series series;
+
+	fill(&series);
+
+	/* Past the end of the samples */
+	igt_assert_eq(intel_perf_series_query(&series,
+					      2 * N_SAMPLES * PERIOD_NS,
+					      3 * N_SAMPLES * PERIOD_NS,
+					      8, buckets), 8);
+	for (int i = 0; i < 8; i++)
+		igt_assert_eq(buckets[i].n, 0);
+
+	igt_assert_eq(intel_perf_series_query(&series, 10, 10, 8, buckets), 0);
+
+	intel_perf_series_fini(&series);
+}
+
+static void test_save_load(void)
+{
+	struct intel_perf_series series, loaded;
+	char path[] = "/tmp/igt-perf-series.XXXXXX";
+	int fd;
+
+	fill(&series);
+	series.source_id = 0xdeadbeef;
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	unlink(path);
+
+	igt_assert(intel_perf_series_save(&series, fd));
+	igt_assert(intel_perf_series_load(&loaded, fd));
+	close(fd);
+
+	igt_assert_eq_u64(loaded.source_id, 0xdeadbeef);
+	igt_assert_eq_u64(loaded.n_samples, series.n_samples);
+	igt_assert_eq(loaded.n_levels, series.n_levels);
+
+	check_overview(&loaded);
+	check_zoom(&loaded);
+
+	intel_perf_series_fini(&loaded);
+	intel_perf_series_fini(&series);
+}
+
+igt_simple_main
+{
+	test_downsample();
+	test_empty_range();
+	test_save_load();
+}
@@ -0,0 +1,256 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_bench_history.h"
+#include "igt_rand.h"
+
+#define COMMITS 40
+#define SAMPLES 5
+
+static double gaussian(igt_philox_t *rng)
+{
+	double u = (igt_philox_random(rng) + 1.0) / 4294967297.0;
+	double v = igt_philox_random(rng) / 4294967296.0;
+
+	return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+/*
+ * A synthetic benchmark around 1000 with 1% noise, scaled by @step from
+ * commit @at onwards. With @bimodal each run lands in a slow mode 10% lower
+ * with a probability of one in three.
+ */
+static void synthesize(struct igt_bench_history *history, uint64_t seed,
+		       unsigned int at, double step, bool bimodal)
+{
+	igt_philox_t rng;
+
+	igt_philox_init(&rng, seed);
+	for (unsigned int c = 0; c < COMMITS; c++) {
+		double samples[SAMPLES];
+		char id[16];
+
+		for (unsigned int i = 0; i < SAMPLES; i++) {
+			double x = 1000 * (1 + 0.01 * gaussian(&rng));
+
+			if (bimodal && igt_philox_random_max(&rng, 3) == 0)
+				x *= 0.9;
+			if (c >= at)
+				x *= step;
+			samples[i] = x;
+		}
+
+		snprintf(id, sizeof(id), "%08x", c * 0x1234567u);
+		igt_bench_history_add(history, "fps", id, samples, SAMPLES);
+	}
+}
+
+static unsigned int analyse(struct igt_bench_history *history,
+			    struct igt_bench_change *changes)
+{
+	struct igt_bench_analysis opts;
+	struct igt_bench_series *s;
+
+	s = igt_bench_history_find(history, "fps");
+	igt_assert(s);
+	igt_assert_eq(s->n_commits, COMMITS);
+
+	igt_bench_analysis_init(&opts);
+	opts.resamples = 500;
+
+	return igt_bench_series_analyse(s, &opts, changes, 8);
+}
+
+static void test_step(bool bimodal)
+{
+	struct igt_bench_history history;
+	struct igt_bench_change changes[8];
+	unsigned int n;
+
+	igt_bench_history_init(&history);
+	synthesize(&history, 1, 25, 0.95, bimodal);
+
+	n = analyse(&history, changes);
+	igt_assert_eq(n, 1);
+	igt_assert(changes[0].regression);
+	igt_assert(changes[0].p_value <= 0.05);
+	igt_assert(changes[0].change_lo < -0.05 * 0.5);
+	igt_assert(changes[0].change_hi < 0);
+	igt_assert(changes[0].change_lo <= changes[0].change);
+	igt_assert(changes[0].change <= changes[0].change_hi);
+
+	/* The slow mode blurs the exact commit, but not the bisect range. */
+	if (!bimodal)
+		igt_assert_eq(changes[0].commit, 25);
+	igt_assert(changes[0].bisect_first <= 25);
+	igt_assert(changes[0].bisect_last >= 25);
+	igt_assert(changes[0].bisect_last - changes[0].bisect_first < 5);
+
+	igt_bench_history_fini(&history);
+}
+
+static void test_stationary(void)
+{
+	for (uint64_t seed = 1; seed <= 4; seed++) {
+		struct igt_bench_history history;
+		struct igt_bench_change changes[8];
+		unsigned int n;
+
+		igt_bench_history_init(&history);
+		synthesize(&history, seed, COMMITS, 1, true);
+
+		n = analyse(&history, changes);
+		for (unsigned int i = 0; i < n; i++)
+			igt_assert_f(!changes[i].regression,
+				     "seed %d: regression of %.2f%% at %u\n",
+				     (int)seed, 100 * changes[i].change,
+				     changes[i].commit);
+
+		igt_bench_history_fini(&history);
+	}
+}
+
+static void test_improvement(void)
+{
+	struct igt_bench_history history;
+	struct igt_bench_change changes[8];
+	unsigned int n;
+
+	igt_bench_history_init(&history);
+	synthesize(&history, 3, 10, 1.05, false);
+
+	n = analyse(&history, changes);
+	igt_assert(n >= 1);
+	igt_assert_eq(changes[0].commit, 10);
+	igt_assert(changes[0].change > 0.025);
+
+	for (unsigned int i = 0; i < n; i++)
+		igt_assert(!changes[i].regression);
+
+	igt_bench_history_fini(&history);
+}
+
+static void test_file(void)
+{
+	const double first[] = { 1.5, 2.5 }, second[] = { 3.5 };
+	char path[] = "/tmp/igt-bench-history.XXXXXX";
+	struct igt_bench_history history;
+	struct igt_bench_series *s;
+	int fd;
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	close(fd);
+	unlink(path);
+
+	igt_assert_eq(igt_bench_history_append(path, "a", "c0", first, 2), 0);
+	igt_assert_eq(igt_bench_history_append(path, "b", "c0", second, 1), 0);
+	igt_assert_eq(igt_bench_history_append(path, "a", "c1", second, 1), 0);
+	igt_assert_eq(igt_bench_history_append(path, "a", "c0", second, 1), 0);
+
+	igt_bench_history_init(&history);
+	igt_assert_eq(igt_bench_history_load(&history, path), 0);
+	unlink(path);
+
+	igt_assert_eq(history.n_series, 2);
+	s = igt_bench_history_find(&history, "a");
+	igt_assert(s);
+	igt_assert_eq(s->n_commits, 2);
+	igt_assert(!strcmp(s->commits[0].id, "c0"));
+	igt_assert_eq(s->commits[0].n_samples, 3);
+	igt_assert(s->commits[0].samples[0] == 1.5);
+	igt_assert(s->commits[0].samples[2] == 3.5);
+	igt_assert(!strcmp(s->commits[1].id, "c1"));
+	igt_assert_eq(s->commits[1].n_samples, 1);
+
+	s = igt_bench_history_find(&history, "b");
+	igt_assert(s);
+	igt_assert_eq(s->n_commits, 1);
+
+	igt_bench_history_fini(&history);
+}
+
+/* Appenders racing to create the file all land their records in it. */
+static void test_concurrent(void)
+{
+	const double sample[] = { 1.0 };
+	char path[] = "/tmp/igt-bench-history.XXXXXX";
+	struct igt_bench_history history;
+	struct igt_bench_series *s;
+	int fd;
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	close(fd);
+	unlink(path);
+
+	igt_fork(child, 8) {
+		char id[16];
+
+		snprintf(id, sizeof(id), "c%d", child);
+		for (unsigned int i = 0; i < 16; i++)
+			igt_assert_eq(igt_bench_history_append(path, "a", id,
+							       sample, 1), 0);
+	}
+	igt_waitchildren();
+
+	igt_bench_history_init(&history);
+	igt_assert_eq(igt_bench_history_load(&history, path), 0);
+	unlink(path);
+
+	s = igt_bench_history_find(&history, "a");
+	igt_assert(s);
+	igt_assert_eq(s->n_commits, 8);
+	for (unsigned int i = 0; i < s->n_commits; i++)
+		igt_assert_eq(s->commits[i].n_samples, 16);
+
+	igt_bench_history_fini(&history);
+}
+
+igt_main
+{
+	igt_subtest("step")
+		test_step(false);
+
+	igt_subtest("bimodal-step")
+		test_step(true);
+
+	igt_subtest("bimodal-stationary")
+		test_stationary();
+
+	igt_subtest("improvement")
+		test_improvement();
+
+	igt_subtest("file")
+		test_file();
+
+	igt_subtest("concurrent-append")
+		test_concurrent();
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_dpcd.h"
+
+/* Ends where DPRX_FEATURE_ENUMERATION_LIST starts, losing its chunk */
+#define AUX_SIZE 0x2210
+
+static uint8_t pattern(uint32_t offset)
+{
+	return offset * 7 + 3;
+}
+
+/* A regular file standing in for /dev/drm_dp_auxN */
+static int fake_aux(char *path)
+{
+	uint8_t buf[AUX_SIZE];
+	int fd;
+
+	for (uint32_t i = 0; i < AUX_SIZE; i++)
+		buf[i] = pattern(i);
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	igt_assert_eq(pwrite(fd, buf, sizeof(buf), 0), sizeof(buf));
+
+	return fd;
+}
+
+static void poke(int fd, uint32_t offset, uint8_t value)
+{
+	igt_assert_eq(pwrite(fd, &value, 1, offset), 1);
+}
+
+static const struct igt_dpcd_chunk *
+chunk_at(const struct igt_dpcd_snapshot *snap, uint32_t offset)
+{
+	for (unsigned int i = 0; i < snap->num_chunks; i++)
+		if (snap->chunks[i].offset == offset)
+			return &snap->chunks[i];
+
+	return NULL;
+}
+
+static void test_chunks(void)
+{
+	struct igt_dpcd_snapshot snap;
+	const struct igt_dpcd_chunk *c;
+	uint32_t end = 0;
+
+	igt_dpcd_snapshot_init(&snap);
+	igt_assert(snap.num_chunks);
+
+	for (unsigned int i = 0; i < snap.num_chunks; i++) {
+		c = &snap.chunks[i];
+
+		igt_assert(c->offset >= end);
+		igt_assert(c->len && c->len <= IGT_DPCD_CHUNK_SIZE);
+		igt_assert_eq(c->offset / 16, (c->offset + c->len - 1) / 16);
+		igt_assert(!c->valid);
+		end = c->offset + c->len;
+
+		/* Nothing from the reserved 0x40-0x5f */
+		igt_assert(c->offset >= 0x60 || end <= 0x40);
+	}
+
+	/* Whole chunks for the capabilities */
+	c = chunk_at(&snap, 0x00000);
+	igt_assert(c && c->len == 16 && !c->volatile_);
+
+	/* The status split around the volatile registers */
+	c = chunk_at(&snap, 0x00200);
+	igt_assert(c && c->len == 16 && c->volatile_);
+	c = chunk_at(&snap, 0x00210);
+	igt_assert(c && c->len == 8 && c->volatile_);
+	c = chunk_at(&snap, 0x00218);
+	igt_assert(c && c->len == 8 && !c->volatile_);
+	c = chunk_at(&snap, 0x00240);
+	igt_assert(c && c->len == 6 && c->volatile_);
+	c = chunk_at(&snap, 0x00246);
+	igt_assert(c && c->len == 10 && !c->volatile_);
+
+	c = chunk_at(&snap, 0x02002);
+	igt_assert(c && c->len == 14 && c->volatile_);
+
+	igt_dpcd_snapshot_fini(&snap);
+}
+
+static void test_read(void)
+{
+	char path[] = "/tmp/igt_dpcd.XXXXXX";
+	struct igt_dpcd_snapshot snap, before;
+	struct igt_dpcd_change *changes;
+	unsigned int n;
+	uint8_t v;
+	int fd;
+
+	fd = fake_aux(path);
+	igt_dpcd_snapshot_init(&snap);
+	igt_assert_eq(igt_dpcd_snapshot_read(&snap, fd), 0);
+
+	for (unsigned int i = 0; i < snap.num_chunks; i++) {
+		const struct igt_dpcd_chunk *c = &snap.chunks[i];
+
+		igt_assert_eq(c->valid, c->offset + c->len <= AUX_SIZE);
+		for (unsigned int k = 0; c->valid && k < c->len; k++)
+			igt_assert_eq(c->data[k], pattern(c->offset + k));
+	}
+
+	igt_assert(igt_dpcd_snapshot_get(&snap, 0x00202, &v));
+	igt_assert_eq(v, pattern(0x202));
+	igt_assert(!igt_dpcd_snapshot_get(&snap, 0x00040, &v));
+	igt_assert(!igt_dpcd_snapshot_get(&snap, 0x02210, &v));
+	igt_assert(!igt_dpcd_snapshot_get(&snap, 0x10000, &v));
+
+	/* A refresh only picks up the volatile registers */
+	igt_dpcd_snapshot_copy(&before, &snap);
+	poke(fd, 0x00100, 0x14);
+	poke(fd, 0x00202, 0x77);
+	poke(fd, 0x02008, 0x02);
+	igt_assert_eq(igt_dpcd_snapshot_refresh(&snap, fd), 2);
+	igt_assert_eq(igt_dpcd_snapshot_refresh(&snap, fd), 0);
+
+	igt_assert(igt_dpcd_snapshot_get(&snap, 0x00100, &v));
+	igt_assert_eq(v, pattern(0x100));
+	igt_assert(igt_dpcd_snapshot_get(&snap, 0x00202, &v));
+	igt_assert_eq(v, 0x77);
+
+	n = igt_dpcd_snapshot_diff(&before, &snap, &changes);
+	igt_assert_eq(n, 2);
+	igt_assert_eq(changes[0].offset, 0x00202);
+	igt_assert_eq(changes[0].old, pattern(0x202));
+	igt_assert_eq(changes[0].new, 0x77);
+	igt_assert(changes[0].old_valid && changes[0].new_valid);
+	igt_assert_eq(changes[1].offset, 0x02008);
+	igt_assert_eq(changes[1].new, 0x02);
+	free(changes);
+
+	/* And a full read everything */
+	igt_assert_eq(igt_dpcd_snapshot_read(&snap, fd), 0);
+	n = igt_dpcd_snapshot_diff(&before, &snap, &changes);
+	igt_assert_eq(n, 3);
+	igt_assert_eq(changes[0].offset, 0x00100);
+	igt_assert_eq(changes[0].new, 0x14);
+	free(changes);
+
+	igt_assert_eq(igt_dpcd_snapshot_diff(&snap, &snap, &changes), 0);
+	free(changes);
+
+	/* A volatile chunk failing once is read again by the next refresh */
+	igt_assert_eq(ftruncate(fd, 0x02008), 0);
+	igt_assert_eq(igt_dpcd_snapshot_refresh(&snap, fd), 1);
+	igt_assert(!igt_dpcd_snapshot_get(&snap, 0x02002, &v));
+	igt_assert_eq(igt_dpcd_snapshot_refresh(&snap, fd), 0);
+
+	igt_assert_eq(ftruncate(fd, AUX_SIZE), 0);
+	poke(fd, 0x02008, 0x05);
+	igt_assert_eq(igt_dpcd_snapshot_refresh(&snap, fd), 1);
+	igt_assert(igt_dpcd_snapshot_get(&snap, 0x02002, &v));
+	igt_assert_eq(v, pattern(0x2002));
+	igt_assert(igt_dpcd_snapshot_get(&snap, 0x02008, &v));
+	igt_assert_eq(v, 0x05);
+
+	/* Nothing at all to read */
+	igt_assert_eq(ftruncate(fd, 0), 0);
+	igt_assert_eq(igt_dpcd_snapshot_read(&snap, fd), -EIO);
+
+	igt_dpcd_snapshot_fini(&before);
+	igt_dpcd_snapshot_fini(&snap);
+	close(fd);
+	unlink(path);
+}
+
+static void test_file(void)
+{
+	static const char zeros[16];
+	char aux[] = "/tmp/igt_dpcd.XXXXXX";
+	char path[] = "/tmp/igt_dpcd.XXXXXX";
+	struct igt_dpcd_snapshot snap, loaded, other;
+	struct igt_dpcd_chunk chunk = {
+		.offset = 0x3000,
+		.len = 2,
+		.valid = true,
+		.data = { 0xaa, 0xbb },
+	};
+	struct igt_dpcd_change *changes;
+	unsigned int n, valid = 0;
+	int fd, aux_fd;
+
+	aux_fd = fake_aux(aux);
+	igt_dpcd_snapshot_init(&snap);
+	igt_assert_eq(igt_dpcd_snapshot_read(&snap, aux_fd), 0);
+	close(aux_fd);
+	unlink(aux);
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	close(fd);
+
+	igt_assert_eq(igt_dpcd_snapshot_save(&snap, path), 0);
+	igt_assert_eq(igt_dpcd_snapshot_load(&loaded, path), 0);
+	igt_assert_eq(loaded.num_chunks, snap.num_chunks);
+	igt_assert(!memcmp(loaded.chunks, snap.chunks,
+			   snap.num_chunks * sizeof(*snap.chunks)));
+	igt_assert_eq(igt_dpcd_snapshot_diff(&snap, &loaded, &changes), 0);
+	free(changes);
+	igt_dpcd_snapshot_fini(&loaded);
+
+	/* Against a snapshot of other registers */
+	other.num_chunks = 1;
+	other.chunks = &chunk;
+	for (unsigned int i = 0; i < snap.num_chunks; i++)
+		valid += snap.chunks[i].valid ? snap.chunks[i].len : 0;
+
+	n = igt_dpcd_snapshot_diff(&snap, &other, &changes);
+	igt_assert_eq(n, valid + 2);
+	igt_assert(changes[0].old_valid && !changes[0].new_valid);
+	igt_assert_eq(changes[n - 2].offset, 0x3000);
+	igt_assert(!changes[n - 2].old_valid && changes[n - 2].new_valid);
+	igt_assert_eq(changes[n - 1].new, 0xbb);
+	for (unsigned int i = 1; i < n; i++)
+		igt_assert(changes[i - 1].offset < changes[i].offset);
+	free(changes);
+
+	/* Not a snapshot, a zeroed header */
+	fd = open(path, O_WRONLY | O_TRUNC);
+	igt_assert_eq(write(fd, zeros, sizeof(zeros)), sizeof(zeros));
+	close(fd);
+	igt_assert_eq(igt_dpcd_snapshot_load(&loaded, path), -EINVAL);
+
+	unlink(path);
+	igt_assert_eq(igt_dpcd_snapshot_load(&loaded, path), -ENOENT);
+
+	igt_dpcd_snapshot_fini(&snap);
+}
+
+static void test_decode(void)
+{
+	char buf[256];
+
+	igt_dpcd_decode(0x00101, 0x84, buf, sizeof(buf));
+	igt_assert(!strcmp(buf, "LANE_COUNT_SET 0x84 [LANE_COUNT=4 ENHANCED_FRAME_EN=1]"));
+
+	igt_dpcd_decode(0x00206, 0x36, buf, sizeof(buf));
+	igt_assert(!strcmp(buf, "ADJUST_REQUEST_LANE0_1 0x36 ["
+			   "ADJUST_VOLTAGE_SWING_LANE0=2 ADJUST_PRE_EMPHASIS_LANE0=1 "
+			   "ADJUST_VOLTAGE_SWING_LANE1=3 ADJUST_PRE_EMPHASIS_LANE1=0]"));
+
+	igt_dpcd_decode(0x00001, 0x1e, buf, sizeof(buf));
+	igt_assert(!strcmp(buf, "MAX_LINK_RATE 0x1e"));
+
+	igt_dpcd_decode(0x01234, 0x5a, buf, sizeof(buf));
+	igt_assert(!strcmp(buf, "0x5a"));
+
+	/* Truncated as snprintf() */
+	igt_assert_eq(igt_dpcd_decode(0x00101, 0x84, buf, 8),
+		      strlen("LANE_COUNT_SET 0x84 [LANE_COUNT=4 ENHANCED_FRAME_EN=1]"));
+	igt_assert(!strcmp(buf, "LANE_CO"));
+
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x02008)->name, "PSR_STATUS"));
+	igt_assert(!igt_dpcd_reg_lookup(0x02009));
+
+	/* Across the table, which is searched by halves */
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x00000)->name, "DPCD_REV"));
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x00071)->name, "PSR_CAPS"));
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x00170)->name, "PSR_EN_CFG"));
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x002c0)->name, "PAYLOAD_TABLE_UPDATE_STATUS"));
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x00723)->name, "EDP_BACKLIGHT_BRIGHTNESS_LSB"));
+	igt_assert(!strcmp(igt_dpcd_reg_lookup(0x02210)->name, "DPRX_FEATURE_ENUMERATION_LIST"));
+}
+
+igt_main
+{
+	igt_subtest("chunks")
+		test_chunks();
+
+	igt_subtest("read")
+		test_read();
+
+	igt_subtest("file")
+		test_file();
+
+	igt_subtest("decode")
+		test_decode();
+}
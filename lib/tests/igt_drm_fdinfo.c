@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_drm_fdinfo.h"
+
+static char root[] = "/tmp/igt_drm_fdinfo.XXXXXX";
+
+static void add_fd(int pid, int fd, const char *target, const char *fdinfo)
+{
+	igt_make_symlink(target, "%s/proc/%d/fd/%d", root, pid, fd);
+	igt_write_file(fdinfo, "%s/proc/%d/fdinfo/%d", root, pid, fd);
+}
+
+static void add_client(int pid, int fd, const char *driver, int id,
+		       const char *memory)
+{
+	char *fdinfo;
+
+	igt_assert(asprintf(&fdinfo,
+			    "pos:\t0\nflags:\t02100002\n"
+			    "drm-driver:\t%s\n"
+			    "drm-pdev:\t0000:00:02.0\n"
+			    "drm-client-id:\t%d\n"
+			    "drm-engine-render:\t12345 ns\n"
+			    "%s", driver, id, memory) > 0);
+	add_fd(pid, fd, "/dev/dri/renderD128", fdinfo);
+	free(fdinfo);
+}
+
+static void move_entry(int pid, const char *dir, int from, int to)
+{
+	char src[PATH_MAX], dst[PATH_MAX];
+
+	snprintf(src, sizeof(src), "%s/proc/%d/%s/%d", root, pid, dir, from);
+	snprintf(dst, sizeof(dst), "%s/proc/%d/%s/%d", root, pid, dir, to);
+	igt_assert_eq(rename(src, dst), 0);
+}
+
+/* Replaces @to with @from, as if @to was closed and @from then got its number. */
+static void move_fd(int pid, int from, int to)
+{
+	move_entry(pid, "fd", from, to);
+	move_entry(pid, "fdinfo", from, to);
+}
+
+static const struct igt_drm_mem_process *
+find_process(const struct igt_drm_mem *mem, pid_t pid)
+{
+	for (unsigned int i = 0; i < mem->num_processes; i++)
+		if (mem->processes[i].pid == pid)
+			return &mem->processes[i];
+
+	return NULL;
+}
+
+static const struct drm_fdinfo_memory *
+find_region(const struct drm_fdinfo_memory *region, unsigned int count,
+	    const char *name)
+{
+	for (unsigned int i = 0; i < count; i++)
+		if (!strcmp(region[i].region, name))
+			return &region[i];
+
+	return NULL;
+}
+
+static void test_parse(void)
+{
+	struct drm_client_fdinfo info;
+	const struct drm_fdinfo_memory *r;
+
+	igt_assert_eq(__igt_parse_drm_fdinfo("pos:\t0\nflags:\t02\n", &info), 0);
+
+	igt_assert_eq(__igt_parse_drm_fdinfo("drm-driver:\ti915\n"
+					     "drm-pdev:\t0000:00:02.0\n"
+					     "drm-client-id:\t42\n"
+					     "drm-engine-capacity-render:\t2\n"
+					     "drm-engine-render:\t1 ns\n"
+					     "drm-engine-copy:\t12345 ns\n"
+					     "drm-total-system0:\t8 MiB\n"
+					     "drm-shared-system0:\t4096\n"
+					     "drm-resident-system0:\t512 KiB\n"
+					     "drm-total-local0:\t1 GiB\n"
+					     "drm-memory-vram:\t20 KiB", &info),
+		      11);
+	igt_assert(!strcmp(info.driver, "i915"));
+	igt_assert(!strcmp(info.pdev, "0000:00:02.0"));
+	igt_assert_eq(info.id, 42);
+
+	igt_assert_eq(info.num_engines, 2);
+	igt_assert(!strcmp(info.engine[0].name, "render"));
+	igt_assert_eq_u64(info.engine[0].busy_ns, 1);
+	igt_assert_eq(info.engine[0].capacity, 2);
+	igt_assert(!strcmp(info.engine[1].name, "copy"));
+	igt_assert_eq_u64(info.engine[1].busy_ns, 12345);
+	igt_assert_eq(info.engine[1].capacity, 1);
+
+	igt_assert_eq(info.num_regions, 3);
+
+	r = find_region(info.region, info.num_regions, "system0");
+	igt_assert(r);
+	igt_assert_eq_u64(r->total, 8 << 20);
+	igt_assert_eq_u64(r->shared, 4096);
+	igt_assert_eq_u64(r->resident, 512 << 10);
+
+	r = find_region(info.region, info.num_regions, "local0");
+	igt_assert(r);
+	igt_assert_eq_u64(r->total, 1ull << 30);
+
+	/* Older key, the resident size. */
+	r = find_region(info.region, info.num_regions, "vram");
+	igt_assert(r);
+	igt_assert_eq_u64(r->resident, 20 << 10);
+}
+
+igt_main
+{
+	struct igt_drm_mem mem;
+
+	igt_fixture
+		igt_assert(mkdtemp(root));
+
+	igt_subtest("parse")
+		test_parse();
+
+	igt_subtest("processes") {
+		const struct igt_drm_mem_process *p;
+		const struct drm_fdinfo_memory *r;
+
+		/* Two fds of the same client and one of another. */
+		add_client(100, 3, "i915", 7,
+			   "drm-resident-system0:\t1024 KiB\n"
+			   "drm-shared-system0:\t64 KiB\n");
+		add_client(100, 4, "i915", 7,
+			   "drm-resident-system0:\t1024 KiB\n"
+			   "drm-shared-system0:\t64 KiB\n");
+		add_client(100, 6, "i915", 9,
+			   "drm-resident-system0:\t1 MiB\n");
+		add_fd(100, 5, "socket:[1234]", "pos:\t0\n");
+		igt_write_file("app\n", "%s/proc/100/comm", root);
+		igt_write_file("0::/user.slice/app.scope\n", "%s/proc/100/cgroup", root);
+
+		add_client(200, 3, "amdgpu", 1, "drm-memory-vram:\t4096 KiB\n");
+		igt_write_file("other\n", "%s/proc/200/comm", root);
+		igt_write_file("0::/user.slice/app.scope\n", "%s/proc/200/cgroup", root);
+
+		add_fd(300, 0, "/dev/null", "pos:\t0\n");
+
+		igt_drm_mem_init(&mem, root, NULL);
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert(!mem.debugfs);
+		igt_assert_eq(mem.num_processes, 2);
+		igt_assert_eq(mem.fds_resolved, 6);
+
+		p = find_process(&mem, 100);
+		igt_assert(p);
+		igt_assert(!strcmp(p->comm, "app"));
+		igt_assert(!strcmp(p->cgroup, "/user.slice/app.scope"));
+		igt_assert_eq(p->num_clients, 2);
+		r = find_region(p->region, p->num_regions, "system0");
+		igt_assert(r);
+		igt_assert_eq_u64(r->resident, 2 << 20);
+		igt_assert_eq_u64(r->shared, 64 << 10);
+
+		p = find_process(&mem, 200);
+		igt_assert(p);
+		r = find_region(p->region, p->num_regions, "vram");
+		igt_assert(r);
+		igt_assert_eq_u64(r->resident, 4 << 20);
+
+		/* Nothing changed, one fdinfo read per client. */
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert_eq(mem.fds_resolved, 0);
+		igt_assert_eq(mem.fdinfo_reads, 3);
+		igt_assert_eq(mem.num_processes, 2);
+
+		/* Only the new fd is looked at. */
+		add_client(300, 7, "i915", 11, "drm-resident-system0:\t4096\n");
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert_eq(mem.fds_resolved, 1);
+		igt_assert_eq(mem.num_processes, 3);
+		p = find_process(&mem, 300);
+		igt_assert(p);
+		igt_assert_eq_u64(p->region[0].resident, 4096);
+
+		/* A closed fd number reused for a DRM client is resolved again. */
+		add_client(100, 8, "i915", 13, "drm-resident-system0:\t4096\n");
+		move_fd(100, 8, 5);
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert_eq(mem.fds_resolved, 1);
+		p = find_process(&mem, 100);
+		igt_assert(p);
+		igt_assert_eq(p->num_clients, 3);
+
+		igt_drm_mem_fini(&mem);
+
+		igt_drm_mem_init(&mem, root, "amdgpu");
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert_eq(mem.num_processes, 1);
+		igt_assert_eq(mem.processes[0].pid, 200);
+		igt_drm_mem_fini(&mem);
+	}
+
+	igt_subtest("debugfs") {
+		char *path;
+
+		igt_assert(asprintf(&path, "rm -rf %s/proc", root) > 0);
+		igt_assert_eq(igt_system_quiet(path), 0);
+		free(path);
+
+		/* A client, but without any memory keys. */
+		add_client(100, 3, "i915", 7, "");
+		igt_write_file("46 objects, 20107264 bytes\n"
+			   "42 [42] objects, 15863808 [15863808] bytes in gtt\n"
+			   "2145386496 [536870912] gtt total\n"
+			   "\n"
+			   "Xorg: 35 objects, 16347136 bytes (0 active, 12103680 inactive, 0 unbound)\n"
+			   "gnome-shell: 11 objects, 3760128 bytes (0 active, 3760128 inactive, 0 unbound)\n",
+			   "%s/sys/kernel/debug/dri/0/i915_gem_objects", root);
+
+		igt_drm_mem_init(&mem, root, NULL);
+		igt_assert_eq(igt_drm_mem_update(&mem), 0);
+		igt_assert(mem.debugfs);
+		igt_assert_eq(mem.num_processes, 2);
+		igt_assert(!strcmp(mem.processes[0].comm, "Xorg"));
+		igt_assert_eq_u64(mem.processes[0].region[0].resident, 16347136);
+		igt_assert(!strcmp(mem.processes[1].comm, "gnome-shell"));
+		igt_drm_mem_fini(&mem);
+	}
+
+	igt_fixture {
+		char *cmd;
+
+		igt_assert(asprintf(&cmd, "rm -rf %s", root) > 0);
+		igt_system_quiet(cmd);
+		free(cmd);
+	}
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "drm_fourcc.h"
+#include "igt_core.h"
+#include "igt_dump.h"
+
+#define WIDTH 512
+#define HEIGHT 256
+#define STRIDE (WIDTH * 4)
+#define COUNT 32
+
+static char tmpdir[] = "/tmp/igt_dump.XXXXXX";
+
+static void fill(uint32_t *pixels, unsigned int seed)
+{
+	for (int y = 0; y < HEIGHT; y++)
+		for (int x = 0; x < WIDTH; x++)
+			pixels[y * WIDTH + x] = (x / 16 + y / 16 + seed) & 1 ?
+				0xff000000 | seed : 0xffffffff - seed * x;
+}
+
+static char *frame_path(int n)
+{
+	char *path;
+
+	igt_assert(asprintf(&path, "%s/frame-%d.png", tmpdir, n) != -1);
+	return path;
+}
+
+static void check_frame(int n)
+{
+	struct igt_dump_header hdr;
+	uint32_t *expected, *data;
+	char *path, *name;
+
+	path = frame_path(n);
+	name = igt_dump_filename(path);
+	igt_assert(strstr(name, "frame-") && strstr(name, ".igtdump"));
+	igt_assert(!strstr(name, ".png"));
+
+	expected = malloc(STRIDE * HEIGHT);
+	fill(expected, n);
+
+	igt_assert_eq(igt_dump_read(name, &hdr, (void **)&data), 0);
+	igt_assert_eq_u32(hdr.format, DRM_FORMAT_XRGB8888);
+	igt_assert_eq_u32(hdr.width, WIDTH);
+	igt_assert_eq_u32(hdr.height, HEIGHT);
+	igt_assert_eq_u32(hdr.stride, STRIDE);
+	igt_assert(!memcmp(data, expected, STRIDE * HEIGHT));
+
+	unlink(name);
+	free(data);
+	free(expected);
+	free(name);
+	free(path);
+}
+
+static int submit(uint32_t *pixels, bool *written)
+{
+	int count = 0;
+
+	for (int n = 0; n < COUNT; n++) {
+		char *path = frame_path(n);
+
+		fill(pixels, n);
+		written[n] = igt_dump_frame(path, DRM_FORMAT_XRGB8888,
+					    WIDTH, HEIGHT, STRIDE, pixels);
+		count += written[n];
+		free(path);
+
+		/* The copy was taken, the caller may reuse its buffer */
+		memset(pixels, 0, STRIDE * HEIGHT);
+	}
+
+	igt_dump_flush();
+
+	return count;
+}
+
+igt_main
+{
+	uint32_t *pixels;
+	bool written[COUNT];
+
+	igt_fixture {
+		igt_assert(mkdtemp(tmpdir));
+		pixels = malloc(STRIDE * HEIGHT);
+		igt_assert(pixels);
+	}
+
+	igt_subtest("block") {
+		unsigned long dropped = igt_dump_dropped();
+
+		/* Room for two frames, so the queue is always under pressure */
+		igt_dump_set_policy(IGT_DUMP_BLOCK, 2 * STRIDE * HEIGHT);
+
+		igt_assert_eq(submit(pixels, written), COUNT);
+		igt_assert_eq(igt_dump_dropped(), dropped);
+
+		for (int n = 0; n < COUNT; n++)
+			check_frame(n);
+	}
+
+	igt_subtest("drop") {
+		unsigned long dropped = igt_dump_dropped();
+		int count;
+
+		igt_dump_set_policy(IGT_DUMP_DROP, STRIDE * HEIGHT);
+
+		count = submit(pixels, written);
+		igt_assert(count > 0);
+		igt_assert_eq(igt_dump_dropped() - dropped, COUNT - count);
+
+		for (int n = 0; n < COUNT; n++) {
+			if (written[n]) {
+				check_frame(n);
+			} else {
+				char *path = frame_path(n);
+				char *name = igt_dump_filename(path);
+
+				igt_assert(access(name, F_OK));
+				free(name);
+				free(path);
+			}
+		}
+	}
+
+	igt_fixture {
+		free(pixels);
+		rmdir(tmpdir);
+	}
+}
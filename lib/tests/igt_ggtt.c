@@ -0,0 +1,385 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_ggtt.h"
+#include "igt_rand.h"
+
+#define SKL_DEVID 0x1912 /* gen9, 64b PTEs */
+#define HSW_DEVID 0x0412 /* gen7.5, 32b PTEs */
+#define IVB_DEVID 0x0162 /* gen7, 32b PTEs */
+
+#define PAGE IGT_GGTT_PAGE_SIZE
+#define SCRATCH 0x7f000000ull
+#define VALID IGT_GGTT_PTE_VALID
+#define GEN8_CACHED (3 << 3)
+
+static void test_extents(void)
+{
+	uint64_t pte[64];
+	struct igt_ggtt_snapshot snap;
+	struct igt_ggtt_analysis a;
+	int i = 0;
+
+	/* 8 contiguous, 4 scattered, 8 scratch, 4 invalid, 4 contiguous cached */
+	for (int k = 0; k < 8; k++)
+		pte[i++] = (0x100000000ull + k * PAGE) | VALID;
+	for (int k = 0; k < 4; k++)
+		pte[i++] = (0x200000000ull + 2 * k * PAGE) | VALID;
+	for (int k = 0; k < 8; k++)
+		pte[i++] = SCRATCH | VALID;
+	for (int k = 0; k < 4; k++)
+		pte[i++] = 0;
+	for (int k = 0; k < 4; k++)
+		pte[i++] = (0x300000000ull + k * PAGE) | GEN8_CACHED | VALID;
+
+	igt_ggtt_snapshot_init(&snap, SKL_DEVID, pte, i);
+	igt_assert_eq_u64(snap.scratch, SCRATCH);
+
+	igt_ggtt_analyse(&snap, &a);
+	igt_assert_eq_u64(a.num_extents, 4);
+
+	igt_assert_eq(a.extents[0].kind, IGT_GGTT_MAPPED);
+	igt_assert_eq_u64(a.extents[0].offset, 0);
+	igt_assert_eq_u64(a.extents[0].size, 12 * PAGE);
+	igt_assert_eq_u64(a.extents[0].phys, 0x100000000ull);
+	igt_assert_eq_u64(a.extents[0].chunks, 5);
+
+	igt_assert_eq(a.extents[1].kind, IGT_GGTT_SCRATCH);
+	igt_assert_eq_u64(a.extents[1].size, 8 * PAGE);
+	igt_assert_eq(a.extents[2].kind, IGT_GGTT_INVALID);
+	igt_assert_eq_u64(a.extents[2].size, 4 * PAGE);
+
+	igt_assert_eq(a.extents[3].kind, IGT_GGTT_MAPPED);
+	igt_assert_eq(a.extents[3].flags, GEN8_CACHED | VALID);
+	igt_assert_eq_u64(a.extents[3].chunks, 1);
+
+	igt_assert_eq_u64(a.pages[IGT_GGTT_MAPPED], 16);
+	igt_assert_eq_u64(a.pages[IGT_GGTT_SCRATCH], 8);
+	igt_assert_eq_u64(a.pages[IGT_GGTT_INVALID], 4);
+	igt_assert_eq_u64(a.chunks, 6);
+
+	/* Scratch and invalid together make one hole of 12 pages at 48KiB */
+	igt_assert_eq_u64(a.num_holes, 1);
+	igt_assert_eq_u64(a.holes[0].offset, 12 * PAGE);
+	igt_assert_eq_u64(a.holes[0].size, 12 * PAGE);
+	igt_assert_eq_u64(a.hole_histogram[3], 1);
+	igt_assert_eq_u64(a.largest[0], 12 * PAGE);
+	igt_assert_eq_u64(a.largest[2], 12 * PAGE);
+	igt_assert_eq_u64(a.largest[3], 8 * PAGE);
+	igt_assert_eq_u64(a.largest[4], 8 * PAGE);
+	igt_assert_eq_u64(a.largest[5], 0);
+
+	igt_ggtt_analysis_fini(&a);
+	igt_ggtt_snapshot_fini(&snap);
+}
+
+/*
+ * A 4GiB GGTT of objects of random sizes, contiguous or not, between holes
+ * of scratch or invalid PTEs.
+ */
+static uint64_t *synthetic_ggtt(uint64_t n, uint64_t seed)
+{
+	uint64_t *pte = malloc(n * sizeof(*pte));
+	uint64_t phys = 0x100000000ull;
+	igt_philox_t rng;
+
+	igt_assert(pte);
+	igt_philox_init(&rng, seed);
+
+	for (uint64_t i = 0; i < n; ) {
+		uint64_t len = 1 + igt_philox_random_max(&rng, 1 << igt_philox_random_max(&rng, 12));
+		unsigned int what = igt_philox_random_max(&rng, 6);
+
+		if (len > n - i)
+			len = n - i;
+
+		for (uint64_t k = 0; k < len; k++, i++) {
+			switch (what) {
+			case 0:
+				pte[i] = 0;
+				break;
+			case 1:
+			case 2:
+				pte[i] = SCRATCH | VALID;
+				break;
+			case 3:
+				/* Scattered shmem pages */
+				pte[i] = (phys + igt_philox_random_max(&rng, 1 << 20) * PAGE) | VALID;
+				break;
+			default:
+				pte[i] = (phys + k * PAGE) | GEN8_CACHED | VALID;
+				break;
+			}
+		}
+		phys += 1ull << 32;
+	}
+
+	return pte;
+}
+
+static enum igt_ggtt_kind kind(uint64_t pte)
+{
+	if (!(pte & VALID))
+		return IGT_GGTT_INVALID;
+
+	return (pte & ~IGT_GGTT_PTE_FLAGS) == SCRATCH ?
+		IGT_GGTT_SCRATCH : IGT_GGTT_MAPPED;
+}
+
+/* One entry at a time, against the analysis */
+static void check_analysis(const uint64_t *pte, uint64_t n,
+			   const struct igt_ggtt_analysis *a)
+{
+	uint64_t pages[IGT_GGTT_NUM_KINDS] = {}, extents = 0, chunks = 0;
+	uint64_t holes = 0, hole_start = 0, largest[IGT_GGTT_ORDERS] = {};
+
+	for (uint64_t i = 0; i < n; i++) {
+		enum igt_ggtt_kind k = kind(pte[i]);
+		bool free = k != IGT_GGTT_MAPPED;
+
+		pages[k]++;
+
+		if (!i || k != kind(pte[i - 1]) ||
+		    (k == IGT_GGTT_MAPPED &&
+		     (pte[i] & IGT_GGTT_PTE_FLAGS) != (pte[i - 1] & IGT_GGTT_PTE_FLAGS))) {
+			igt_assert(extents < a->num_extents);
+			igt_assert_eq_u64(a->extents[extents].offset, i * PAGE);
+			igt_assert_eq(a->extents[extents].kind, k);
+			extents++;
+			chunks += k == IGT_GGTT_MAPPED;
+		} else if (k == IGT_GGTT_MAPPED && pte[i] != pte[i - 1] + PAGE) {
+			chunks++;
+		}
+
+		if (free && (!i || kind(pte[i - 1]) == IGT_GGTT_MAPPED))
+			hole_start = i;
+		if (free && (i == n - 1 || kind(pte[i + 1]) == IGT_GGTT_MAPPED)) {
+			uint64_t end = (i + 1) * PAGE;
+
+			igt_assert(holes < a->num_holes);
+			igt_assert_eq_u64(a->holes[holes].offset, hole_start * PAGE);
+			igt_assert_eq_u64(a->holes[holes].size, end - hole_start * PAGE);
+			holes++;
+
+			for (int o = 0; o < IGT_GGTT_ORDERS; o++) {
+				uint64_t align = PAGE << o;
+				uint64_t s = (hole_start * PAGE + align - 1) / align * align;
+
+				if (s < end && end - s > largest[o])
+					largest[o] = end - s;
+			}
+		}
+	}
+
+	igt_assert_eq_u64(a->num_extents, extents);
+	igt_assert_eq_u64(a->num_holes, holes);
+	igt_assert_eq_u64(a->chunks, chunks);
+	for (int k = 0; k < IGT_GGTT_NUM_KINDS; k++)
+		igt_assert_eq_u64(a->pages[k], pages[k]);
+	for (int o = 0; o < IGT_GGTT_ORDERS; o++)
+		igt_assert_eq_u64(a->largest[o], largest[o]);
+}
+
+static void test_full(void)
+{
+	/* Odd sizes to cover the tails of the vector loop too */
+	const uint64_t sizes[] = { 1, 3, 5, 67, 1 << 20 };
+
+	for (int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		uint64_t *pte = synthetic_ggtt(sizes[s], s + 1);
+		struct igt_ggtt_snapshot snap;
+		struct igt_ggtt_analysis a;
+		uint64_t total = 0;
+
+		igt_ggtt_snapshot_init(&snap, SKL_DEVID, pte, sizes[s]);
+		snap.scratch = SCRATCH;
+		igt_ggtt_analyse(&snap, &a);
+
+		check_analysis(pte, sizes[s], &a);
+		for (int o = 0; o < IGT_GGTT_ORDERS; o++)
+			total += a.hole_histogram[o];
+		igt_assert_eq_u64(total, a.num_holes);
+
+		igt_ggtt_analysis_fini(&a);
+		igt_ggtt_snapshot_fini(&snap);
+		free(pte);
+	}
+}
+
+static void test_largest_range(void)
+{
+	const uint64_t n = 1 << 16;
+	uint64_t *pte = calloc(n, sizeof(*pte));
+	struct igt_ggtt_snapshot snap;
+	struct igt_ggtt_analysis a;
+	uint64_t offset;
+
+	/* Free [0, 16), [17, 1000), [1001, n) */
+	pte[16] = 0x100000000ull | VALID;
+	pte[1000] = 0x200000000ull | VALID;
+
+	igt_ggtt_snapshot_init(&snap, SKL_DEVID, pte, n);
+	igt_ggtt_analyse(&snap, &a);
+	igt_assert_eq_u64(a.num_holes, 3);
+
+	igt_assert_eq_u64(igt_ggtt_largest_range(&a, PAGE, 0, n * PAGE, &offset),
+			  (n - 1001) * PAGE);
+	igt_assert_eq_u64(offset, 1001 * PAGE);
+
+	/* Within a 4MiB aperture, 64KiB aligned */
+	igt_assert_eq_u64(igt_ggtt_largest_range(&a, 64 << 10, 0, 4 << 20, &offset),
+			  (1000 - 32) * PAGE);
+	igt_assert_eq_u64(offset, 32 * PAGE);
+
+	igt_assert_eq_u64(igt_ggtt_largest_range(&a, PAGE, 0, 16 * PAGE, &offset),
+			  16 * PAGE);
+	igt_assert_eq_u64(offset, 0);
+	igt_assert_eq_u64(igt_ggtt_largest_range(&a, 1 << 30, PAGE, n * PAGE, NULL), 0);
+
+	igt_ggtt_analysis_fini(&a);
+	igt_ggtt_snapshot_fini(&snap);
+	free(pte);
+}
+
+static void test_diff(void)
+{
+	const uint64_t n = 1 << 20;
+	uint64_t *before = synthetic_ggtt(n, 7), *after;
+	struct igt_ggtt_snapshot a, b;
+	struct igt_ggtt_diff *diffs;
+	uint64_t count;
+
+	after = malloc(n * sizeof(*after));
+	memcpy(after, before, n * sizeof(*after));
+
+	/* Bind 3 pages over scratch, unbind one, remap two, invalidate one */
+	for (int i = 0; i < 3; i++)
+		after[1000 + i] = (0x900000000ull + i * PAGE) | VALID;
+	before[5000] = 0xa00000000ull | VALID;
+	after[5000] = SCRATCH | VALID;
+	before[70000] = before[70001] = 0xb00000000ull | VALID;
+	after[70000] = after[70001] = 0xc00000000ull | VALID;
+	before[n - 1] = SCRATCH | VALID;
+	after[n - 1] = 0;
+	for (int i = 0; i < 3; i++)
+		before[1000 + i] = SCRATCH | VALID;
+
+	igt_ggtt_snapshot_init(&a, SKL_DEVID, before, n);
+	igt_ggtt_snapshot_init(&b, SKL_DEVID, after, n);
+	a.scratch = b.scratch = SCRATCH;
+
+	count = igt_ggtt_snapshot_diff(&a, &b, &diffs);
+	igt_assert_eq_u64(count, 4);
+
+	igt_assert_eq_u64(diffs[0].offset, 1000 * PAGE);
+	igt_assert_eq_u64(diffs[0].size, 3 * PAGE);
+	igt_assert_eq(diffs[0].change, IGT_GGTT_BOUND);
+	igt_assert_eq_u64(diffs[1].offset, 5000 * PAGE);
+	igt_assert_eq(diffs[1].change, IGT_GGTT_UNBOUND);
+	igt_assert_eq_u64(diffs[2].offset, 70000 * PAGE);
+	igt_assert_eq_u64(diffs[2].size, 2 * PAGE);
+	igt_assert_eq(diffs[2].change, IGT_GGTT_REBOUND);
+	igt_assert_eq_u64(diffs[3].offset, (n - 1) * PAGE);
+	igt_assert_eq(diffs[3].change, IGT_GGTT_CLEARED);
+
+	free(diffs);
+	count = igt_ggtt_snapshot_diff(&a, &a, &diffs);
+	igt_assert_eq_u64(count, 0);
+	free(diffs);
+
+	igt_ggtt_snapshot_fini(&a);
+	igt_ggtt_snapshot_fini(&b);
+	free(before);
+	free(after);
+}
+
+static void test_file(void)
+{
+	/* HSW PTEs: address bits 32-38 in bits 4-10, valid in bit 0 */
+	const uint32_t pte[] = {
+		0x12345000 | 0x010 | 1,
+		0x12346000 | 0x010 | 1,
+		0x00001000 | 1,
+		0x00001000 | 1,
+		0x00001000 | 1,
+	};
+	char path[] = "/tmp/igt-ggtt.XXXXXX";
+	struct igt_ggtt_snapshot snap, loaded;
+	struct igt_ggtt_analysis a;
+	int fd;
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	close(fd);
+
+	igt_ggtt_snapshot_init(&snap, HSW_DEVID, pte, 5);
+	igt_assert_eq(snap.pte_size, 4);
+	igt_assert_eq_u64(snap.entries[0], 0x112345000ull | 1);
+	igt_assert_eq_u64(snap.scratch, 0x1000);
+
+	igt_assert_eq(igt_ggtt_snapshot_save(&snap, path), 0);
+	igt_assert_eq(igt_ggtt_snapshot_load(&loaded, path), 0);
+	unlink(path);
+
+	igt_assert_eq(loaded.devid, HSW_DEVID);
+	igt_assert_eq_u64(loaded.num_entries, 5);
+	igt_assert(!memcmp(loaded.entries, snap.entries,
+			   5 * sizeof(*snap.entries)));
+
+	igt_ggtt_analyse(&loaded, &a);
+	igt_assert_eq_u64(a.num_extents, 2);
+	igt_assert_eq_u64(a.extents[0].chunks, 1);
+	igt_assert_eq_u64(a.largest[0], 3 * PAGE);
+	igt_ggtt_analysis_fini(&a);
+
+	/* IVB has one more address bit */
+	igt_ggtt_snapshot_fini(&snap);
+	igt_ggtt_snapshot_init(&snap, IVB_DEVID, (uint32_t []){ 0x800 | 1 }, 1);
+	igt_assert_eq_u64(snap.entries[0], (0x80ull << 32) | 1);
+
+	igt_ggtt_snapshot_fini(&snap);
+	igt_ggtt_snapshot_fini(&loaded);
+}
+
+igt_main
+{
+	igt_subtest("extents")
+		test_extents();
+
+	igt_subtest("full")
+		test_full();
+
+	igt_subtest("largest-range")
+		test_largest_range();
+
+	igt_subtest("diff")
+		test_diff();
+
+	igt_subtest("file")
+		test_file();
+}
@@ -0,0 +1,171 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_aux.h"
+#include "igt_core.h"
+#include "igt_perf.h"
+
+static char root[] = "/tmp/igt_perf_imc.XXXXXX";
+
+__attribute__((format(printf, 1, 2)))
+static void remove_tree(const char *fmt, ...)
+{
+	char path[PATH_MAX], *cmd;
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(path, sizeof(path), fmt, ap);
+	va_end(ap);
+
+	igt_assert(asprintf(&cmd, "rm -rf %s", path) != -1);
+	igt_assert_eq(igt_system_quiet(cmd), 0);
+	free(cmd);
+}
+
+static void add_imc(const char *pmu, const char *cpumask, const char *read,
+		    const char *write)
+{
+	igt_write_file("16\n", "%s/sys/devices/%s/type", root, pmu);
+	igt_write_file(cpumask, "%s/sys/devices/%s/cpumask", root, pmu);
+	igt_write_file("config:0-7\n", "%s/sys/devices/%s/format/event", root, pmu);
+	igt_write_file("config:8-15\n", "%s/sys/devices/%s/format/umask", root, pmu);
+
+	igt_write_file("event=0x04,umask=0x03\n",
+		       "%s/sys/devices/%s/events/%s", root, pmu, read);
+	igt_write_file("6.103515625e-5\n",
+		       "%s/sys/devices/%s/events/%s.scale", root, pmu, read);
+	igt_write_file("MiB\n", "%s/sys/devices/%s/events/%s.unit", root, pmu, read);
+
+	igt_write_file("event=0x04,umask=0x0c\n",
+		       "%s/sys/devices/%s/events/%s", root, pmu, write);
+	igt_write_file("6.103515625e-5\n",
+		       "%s/sys/devices/%s/events/%s.scale", root, pmu, write);
+	igt_write_file("MiB\n", "%s/sys/devices/%s/events/%s.unit", root, pmu, write);
+}
+
+igt_main
+{
+	igt_fixture {
+		igt_assert(mkdtemp(root));
+
+		igt_write_file("0\n", "%s/sys/devices/system/cpu/cpu0/topology/physical_package_id", root);
+		igt_write_file("1\n", "%s/sys/devices/system/cpu/cpu28/topology/physical_package_id", root);
+	}
+
+	igt_subtest("event-parse") {
+		struct igt_perf_event ev;
+
+		igt_write_file("12\n", "%s/sys/devices/pmu/type", root);
+		igt_write_file("config:0-3,8-11\n", "%s/sys/devices/pmu/format/event", root);
+		igt_write_file("config1:0-15\n", "%s/sys/devices/pmu/format/filter", root);
+		igt_write_file("config:63\n", "%s/sys/devices/pmu/format/edge", root);
+		igt_write_file("event=0xab,filter=0x1234,edge\n",
+			       "%s/sys/devices/pmu/events/split", root);
+		igt_write_file("event=0x01\n", "%s/sys/devices/pmu/events/plain", root);
+		igt_write_file("event=0x01,bogus=1\n",
+			       "%s/sys/devices/pmu/events/unknown", root);
+
+		igt_assert_eq(igt_perf_event_parse(root, "pmu", "split", &ev), 0);
+		igt_assert_eq_u64(ev.type, 12);
+		igt_assert_eq_u64(ev.config, 0x8000000000000a0bull);
+		igt_assert_eq_u64(ev.config1, 0x1234);
+		igt_assert_eq_double(ev.scale, 1.0);
+		igt_assert_eq(strlen(ev.unit), 0);
+
+		igt_assert_eq(igt_perf_event_parse(root, "pmu", "plain", &ev), 0);
+		igt_assert_eq_u64(ev.config, 1);
+
+		igt_assert(igt_perf_event_parse(root, "pmu", "unknown", &ev) < 0);
+		igt_assert(igt_perf_event_parse(root, "pmu", "missing", &ev) < 0);
+	}
+
+	igt_subtest("units") {
+		igt_assert_eq_double(igt_perf_unit_bytes("MiB"), 1048576.0);
+		igt_assert_eq_double(igt_perf_unit_bytes("MB"), 1e6);
+		igt_assert_eq_double(igt_perf_unit_bytes("B"), 1.0);
+		igt_assert_eq_double(igt_perf_unit_bytes("Joules"), 0.0);
+	}
+
+	igt_subtest("imc-discover") {
+		struct igt_perf_imc *imc;
+		int n;
+
+		/* Two sockets with two controllers each, listed out of order. */
+		add_imc("uncore_imc_10", "0,28\n", "cas_count_read", "cas_count_write");
+		add_imc("uncore_imc_2", "0,28\n", "cas_count_read", "cas_count_write");
+		/* Counts the same traffic, must be ignored. */
+		add_imc("uncore_imc_free_running_0", "0,28\n", "data_read", "data_write");
+		/* Not a memory controller. */
+		igt_write_file("17\n", "%s/sys/devices/uncore_cha_0/type", root);
+
+		n = igt_perf_imc_discover(root, &imc);
+		igt_assert_eq(n, 4);
+
+		igt_assert_eq(imc[0].socket, 0);
+		igt_assert_eq(imc[0].cpu, 0);
+		igt_assert(!strcmp(imc[0].pmu, "uncore_imc_2"));
+		igt_assert_eq(imc[1].socket, 0);
+		igt_assert(!strcmp(imc[1].pmu, "uncore_imc_10"));
+		igt_assert_eq(imc[2].socket, 1);
+		igt_assert_eq(imc[2].cpu, 28);
+		igt_assert(!strcmp(imc[2].pmu, "uncore_imc_2"));
+		igt_assert_eq(imc[3].socket, 1);
+
+		igt_assert_eq_u64(imc[0].reads.type, 16);
+		igt_assert_eq_u64(imc[0].reads.config, 0x0304);
+		igt_assert_eq_u64(imc[0].writes.config, 0x0c04);
+		igt_assert_eq_double(imc[0].reads.scale, 6.103515625e-5);
+		igt_assert(!strcmp(imc[0].writes.unit, "MiB"));
+
+		free(imc);
+	}
+
+	igt_subtest("imc-free-running") {
+		struct igt_perf_imc *imc;
+		int n;
+
+		/* Only the free running counters, whatever ran before. */
+		remove_tree("%s/sys/devices/uncore_imc_2", root);
+		remove_tree("%s/sys/devices/uncore_imc_10", root);
+		add_imc("uncore_imc_free_running_0", "0,28\n", "data_read", "data_write");
+
+		n = igt_perf_imc_discover(root, &imc);
+		igt_assert_eq(n, 2);
+		igt_assert(!strcmp(imc[0].pmu, "uncore_imc_free_running_0"));
+		igt_assert_eq(imc[0].socket, 0);
+		igt_assert_eq(imc[1].socket, 1);
+
+		free(imc);
+	}
+
+	igt_fixture
+		remove_tree("%s", root);
+}
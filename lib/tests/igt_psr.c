@@ -0,0 +1,269 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "igt_psr.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+/* i915_edp_psr_status as printed by the kernels over the years */
+static const struct {
+	const char *kernel;
+	const char *text;
+	enum igt_psr_status_mode mode;
+	enum igt_psr_state state;
+	uint32_t source_status;
+	bool sink_support;
+	unsigned int num_su_frames;
+	uint16_t su_blocks;
+} captures[] = {
+	{
+		"4.14",
+		"Sink_Support: yes\n"
+		"PSR mode: PSR1\n"
+		"Enabled: yes\n"
+		"Active: yes\n"
+		"Busy frontbuffer bits: 0x000\n"
+		"Main link in standby mode: no\n"
+		"HW Enabled & Active bit: yes\n"
+		"Source PSR status: 0x24050006 [SRDONACK]\n",
+		IGT_PSR_STATUS_PSR1, IGT_PSR_STATE_SRDONACK, 0x24050006,
+		true, 0, 0,
+	},
+	{
+		"5.4",
+		"Sink support: yes [0x01]\n"
+		"PSR mode: PSR1 enabled\n"
+		"Source PSR ctl: enabled [0x81f00e26]\n"
+		"Source PSR status: SRDENT [0x40040006]\n"
+		"Busy frontbuffer bits: 0x00000000\n"
+		"Performance counter: 123\n",
+		IGT_PSR_STATUS_PSR1, IGT_PSR_STATE_SRDENT, 0x40040006,
+		true, 0, 0,
+	},
+	{
+		"5.15",
+		"Sink support: yes [0x03]\n"
+		"PSR mode: PSR2 enabled\n"
+		"Source PSR ctl: enabled [0x40000c32]\n"
+		"Source PSR status: IDLE [0x04010006]\n"
+		"Busy frontbuffer bits: 0x00000000\n"
+		"Frame:\tPSR2 SU blocks:\n"
+		"0\t10\n"
+		"1\t0\n"
+		"2\t0\n"
+		"3\t0\n"
+		"4\t0\n"
+		"5\t0\n"
+		"6\t0\n"
+		"7\t0\n"
+		"PSR2 selective fetch: enabled\n",
+		IGT_PSR_STATUS_PSR2, IGT_PSR_STATE_IDLE, 0x04010006,
+		true, 8, 10,
+	},
+	{
+		"6.8",
+		"Sink support: PSR = yes [0x03], Panel Replay = no\n"
+		"PSR mode: PSR2 enabled\n"
+		"Source PSR/PanelReplay ctl: enabled [0x40000c32]\n"
+		"Source PSR/PanelReplay status: DEEP_SLEEP [0x80010000]\n"
+		"Busy frontbuffer bits: 0x00000000\n"
+		"Frame:\tPSR2 SU blocks:\n"
+		"0\t4\n"
+		"1\t4\n"
+		"2\t0\n"
+		"3\t0\n"
+		"4\t0\n"
+		"5\t0\n"
+		"6\t0\n"
+		"7\t0\n"
+		"PSR2 selective fetch: enabled\n",
+		IGT_PSR_STATUS_PSR2, IGT_PSR_STATE_DEEP_SLEEP, 0x80010000,
+		true, 8, 4,
+	},
+	{
+		"disabled",
+		"Sink support: yes [0x03]\n"
+		"PSR mode: disabled\n",
+		IGT_PSR_STATUS_DISABLED, IGT_PSR_STATE_DISABLED, 0,
+		true, 0, 0,
+	},
+	{
+		"no sink",
+		"Sink support: no\n",
+		IGT_PSR_STATUS_UNKNOWN, IGT_PSR_STATE_UNKNOWN, 0,
+		false, 0, 0,
+	},
+};
+
+static void test_parse(void)
+{
+	for (int i = 0; i < ARRAY_SIZE(captures); i++) {
+		struct igt_psr_status status;
+
+		igt_debug("Parsing the status of %s\n", captures[i].kernel);
+		igt_psr_status_parse(captures[i].text,
+				     strlen(captures[i].text), &status);
+
+		igt_assert_eq(status.mode, captures[i].mode);
+		igt_assert_f(status.state == captures[i].state,
+			     "%s: state %s, expected %s\n", captures[i].kernel,
+			     igt_psr_state_name(status.state),
+			     igt_psr_state_name(captures[i].state));
+		igt_assert_eq_u32(status.source_status,
+				  captures[i].source_status);
+		igt_assert_eq(status.sink_support, captures[i].sink_support);
+		igt_assert_eq(status.sink_state, -1);
+		igt_assert_eq(status.num_su_frames, captures[i].num_su_frames);
+		if (status.num_su_frames)
+			igt_assert_eq(status.su_blocks[0], captures[i].su_blocks);
+	}
+}
+
+static void test_parse_sink(void)
+{
+	const char *text =
+		"PSR sink not reliable: yes\n"
+		"Sink PSR status: 0x2 [active, display from RFB]\n";
+	struct igt_psr_status status;
+
+	/* Without the trailing newline, as if cut short by the buffer */
+	igt_psr_status_parse(text, strlen(text) - 1, &status);
+	igt_assert(status.sink_not_reliable);
+	igt_assert_eq(status.sink_state, 2);
+}
+
+static void record(struct igt_psr_trace *trace, uint64_t ms,
+		   enum igt_psr_state state)
+{
+	struct igt_psr_status status = {
+		.mode = IGT_PSR_STATUS_PSR2,
+		.state = state,
+		.sink_state = -1,
+	};
+
+	igt_psr_trace_record(trace, ms * 1000000, &status);
+}
+
+static void test_stats(void)
+{
+	struct igt_psr_trace_stats stats;
+	struct igt_psr_trace trace;
+
+	igt_psr_trace_init(&trace, -1, -1);
+
+	/* Long enough in DEEP_SLEEP, then a flap, then back again. */
+	record(&trace, 0, IGT_PSR_STATE_IDLE);
+	record(&trace, 10, IGT_PSR_STATE_IDLE);
+	record(&trace, 20, IGT_PSR_STATE_CAPTURE);
+	record(&trace, 30, IGT_PSR_STATE_DEEP_SLEEP);
+	record(&trace, 230, IGT_PSR_STATE_ML_UP);
+	record(&trace, 232, IGT_PSR_STATE_IDLE);
+	record(&trace, 250, IGT_PSR_STATE_DEEP_SLEEP);
+	record(&trace, 255, IGT_PSR_STATE_ML_UP);
+	record(&trace, 259, IGT_PSR_STATE_IDLE);
+	record(&trace, 300, IGT_PSR_STATE_IDLE);
+
+	igt_assert_eq(trace.num_samples, 10);
+	igt_assert_eq(trace.num_transitions, 8);
+
+	igt_psr_trace_stats(&trace, 10 * 1000000, &stats);
+
+	igt_assert_eq_u64(stats.duration_ns, 300 * 1000000);
+	igt_assert_eq_u64(stats.residency_ns[IGT_PSR_STATE_DEEP_SLEEP],
+			  205 * 1000000);
+	igt_assert_eq_u64(stats.residency_ns[IGT_PSR_STATE_IDLE],
+			  (20 + 18 + 41) * 1000000);
+	igt_assert_eq_u64(stats.active_ns, 205 * 1000000);
+
+	igt_assert_eq(stats.entries, 2);
+	igt_assert_eq(stats.exits, 2);
+	igt_assert_eq(stats.flaps, 1);
+
+	/* The first IDLE was already there, its start is unknown. */
+	igt_assert_eq(stats.entry.count, 1);
+	igt_assert_eq_u64(stats.entry.min_ns, 18 * 1000000);
+
+	igt_assert_eq(stats.exit.count, 2);
+	igt_assert_eq_u64(stats.exit.min_ns, 2 * 1000000);
+	igt_assert_eq_u64(stats.exit.max_ns, 4 * 1000000);
+
+	igt_psr_trace_fini(&trace);
+}
+
+/* The tracer rereads the same fd, through a file rewritten in between. */
+static void test_sample(void)
+{
+	const char *states[] = {
+		"Source PSR status: IDLE [0x04010006]\n",
+		"Source PSR status: SRDENT [0x40040006]\n",
+		"Source PSR status: SRDENT [0x40040006]\n",
+	};
+	char path[] = "/tmp/igt-psr-status.XXXXXX";
+	struct igt_psr_trace trace;
+	int fd, wr;
+
+	fd = mkstemp(path);
+	igt_assert(fd >= 0);
+	wr = open(path, O_WRONLY);
+	igt_assert(wr >= 0);
+	unlink(path);
+
+	igt_psr_trace_init(&trace, fd, -1);
+	for (int i = 0; i < ARRAY_SIZE(states); i++) {
+		igt_assert(ftruncate(wr, 0) == 0);
+		igt_assert_eq(pwrite(wr, states[i], strlen(states[i]), 0),
+			      strlen(states[i]));
+		igt_assert(igt_psr_trace_sample(&trace));
+	}
+	close(wr);
+
+	igt_assert_eq(trace.num_samples, 3);
+	igt_assert_eq(trace.num_transitions, 2);
+	igt_assert_eq(trace.transitions[0].to, IGT_PSR_STATE_IDLE);
+	igt_assert_eq(trace.transitions[1].from, IGT_PSR_STATE_IDLE);
+	igt_assert_eq(trace.transitions[1].to, IGT_PSR_STATE_SRDENT);
+	igt_assert(trace.transitions[1].ts_ns >= trace.transitions[0].ts_ns);
+
+	igt_psr_trace_fini(&trace);
+}
+
+igt_main
+{
+	igt_subtest("parse")
+		test_parse();
+
+	igt_subtest("parse-sink")
+		test_parse_sink();
+
+	igt_subtest("stats")
+		test_stats();
+
+	igt_subtest("sample")
+		test_sample();
+}
@@ -0,0 +1,205 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+#include <inttypes.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "igt_core.h"
+#include "igt_rand.h"
+
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
+#define SEED 0x243f6a8885a308d3ull
+#define N_DWORDS (1 << 20)
+
+/* Critical value of chi-square with 255 degrees of freedom, p = 0.001 */
+#define CHI2_255 330.5
+
+static double byte_chi2(const uint32_t *v, size_t n)
+{
+	const uint8_t *bytes = (const uint8_t *)v;
+	double expected = 4.0 * n / 256, chi2 = 0;
+	uint64_t bins[256] = {};
+
+	for (size_t i = 0; i < 4 * n; i++)
+		bins[bytes[i]]++;
+
+	for (int i = 0; i < 256; i++)
+		chi2 += (bins[i] - expected) * (bins[i] - expected) / expected;
+
+	return chi2;
+}
+
+static uint32_t *generate(igt_philox_t *rng, size_t n)
+{
+	uint32_t *v = malloc(n * sizeof(*v));
+
+	igt_assert(v);
+	for (size_t i = 0; i < n; i++)
+		v[i] = igt_philox_random(rng);
+
+	return v;
+}
+
+static void test_known_answer(void)
+{
+	/* Philox4x32-10 of a zero counter and key, from Random123 */
+	const uint32_t expected[] = {
+		0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8,
+	};
+	igt_philox_t rng;
+
+	igt_philox_init(&rng, 0);
+	for (int i = 0; i < ARRAY_SIZE(expected); i++)
+		igt_assert_eq_u32(igt_philox_random(&rng), expected[i]);
+}
+
+static void test_jump(void)
+{
+	igt_philox_t rng, jumped;
+	uint32_t *v;
+
+	igt_philox_init(&rng, SEED);
+	v = generate(&rng, 4096);
+
+	for (uint64_t n = 0; n < 4096; n += 7) {
+		igt_philox_init(&jumped, SEED);
+		igt_philox_jump(&jumped, n);
+		igt_assert_eq_u32(igt_philox_random(&jumped), v[n]);
+	}
+
+	free(v);
+}
+
+static void test_fill(void)
+{
+	uint8_t buf[4096 + 4], ref[4096];
+
+	for (uint64_t skip = 0; skip < 8; skip++) {
+		for (size_t size = 0; size <= 4096; size += 61) {
+			igt_philox_t a, b;
+
+			igt_philox_init(&a, SEED);
+			igt_philox_jump(&a, skip);
+			b = a;
+
+			/* Unaligned destinations go through a bounce buffer */
+			igt_philox_fill(&a, buf + skip % 4, size);
+			for (size_t i = 0; i < size; i += 4) {
+				uint32_t v = igt_philox_random(&b);
+
+				memcpy(ref + i, &v, size - i < 4 ? size - i : 4);
+			}
+
+			igt_assert(memcmp(buf + skip % 4, ref, size) == 0);
+			igt_assert_eq_u64(a.pos, b.pos);
+		}
+	}
+}
+
+static void test_split(void)
+{
+	igt_philox_t master, a, b, c;
+	uint32_t *va, *vb, *vx;
+
+	igt_philox_init(&master, SEED);
+	igt_philox_split(&master, &a, 0);
+	igt_philox_split(&master, &b, 1);
+
+	/* Independent of the position of the parent */
+	igt_philox_jump(&master, 12345);
+	igt_philox_split(&master, &c, 1);
+	igt_assert(memcmp(&b, &c, sizeof(b)) == 0);
+
+	va = generate(&a, N_DWORDS);
+	vb = generate(&b, N_DWORDS);
+	vx = malloc(N_DWORDS * sizeof(*vx));
+	igt_assert(vx);
+
+	/* Sibling streams are not shifted or correlated copies */
+	igt_assert(memcmp(va, vb, N_DWORDS * sizeof(*va)));
+	for (size_t i = 0; i < N_DWORDS; i++)
+		vx[i] = va[i] ^ vb[i];
+	igt_assert_f(byte_chi2(vx, N_DWORDS) < CHI2_255,
+		     "xor of sibling streams is biased\n");
+
+	free(vx);
+	free(vb);
+	free(va);
+}
+
+static void test_statistics(void)
+{
+	double sum = 0, sum2 = 0, sum_xy = 0, mean, var, r;
+	uint64_t ones = 0;
+	igt_philox_t rng;
+	uint32_t *v;
+
+	igt_philox_init(&rng, SEED);
+	v = generate(&rng, N_DWORDS);
+
+	/* Monobit: within 4 standard deviations */
+	for (size_t i = 0; i < N_DWORDS; i++)
+		ones += __builtin_popcount(v[i]);
+	igt_assert_f(fabs(ones - 16.0 * N_DWORDS) < 4 * sqrt(8.0 * N_DWORDS),
+		     "%"PRIu64" bits set out of %d\n", ones, 32 * N_DWORDS);
+
+	igt_assert_f(byte_chi2(v, N_DWORDS) < CHI2_255,
+		     "byte distribution is biased\n");
+
+	/* Lag-1 serial correlation, standard deviation 1/sqrt(n) */
+	for (size_t i = 0; i < N_DWORDS; i++) {
+		sum += v[i];
+		sum2 += (double)v[i] * v[i];
+		if (i)
+			sum_xy += (double)v[i - 1] * v[i];
+	}
+	mean = sum / N_DWORDS;
+	var = sum2 / N_DWORDS - mean * mean;
+	r = (sum_xy / (N_DWORDS - 1) - mean * mean) / var;
+	igt_assert_f(fabs(r) < 4 / sqrt(N_DWORDS),
+		     "serial correlation %f\n", r);
+
+	free(v);
+}
+
+igt_main
+{
+	igt_subtest("known-answer")
+		test_known_answer();
+
+	igt_subtest("jump")
+		test_jump();
+
+	igt_subtest("fill")
+		test_fill();
+
+	igt_subtest("split")
+		test_split();
+
+	igt_subtest("statistics")
+		test_statistics();
+}
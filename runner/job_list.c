@@ -10,6 +10,7 @@
 #include <unistd.h>
 
 #include "job_list.h"
+#include "subtest_cache.h"
 #include "igt_core.h"
 
 static bool matches_any(const char *str, struct regex_list *list)
@@ -41,51 +42,25 @@ static void add_job_list_entry(struct job_list *job_list,
 }
 
 static void add_subtests(struct job_list *job_list, struct settings *settings,
-			 char *binary,
+			 struct subtest_list *list,
 			 struct regex_list *include, struct regex_list *exclude)
 {
-	FILE *p;
-	char cmd[256] = {};
-	char *subtestname;
+	char *binary = list->binary;
 	char **subtests = NULL;
 	size_t num_subtests = 0;
-	int s;
-
-	s = snprintf(cmd, sizeof(cmd), "%s/%s --list-subtests",
-		     settings->test_root, binary);
-	if (s < 0) {
-		fprintf(stderr, "Failure generating command string, this shouldn't happen.\n");
-		return;
-	}
-
-	if (s >= sizeof(cmd)) {
-		fprintf(stderr, "Path to binary too long, ignoring: %s/%s\n",
-			settings->test_root, binary);
-		return;
-	}
-
-	p = popen(cmd, "r");
-	if (!p) {
-		fprintf(stderr, "popen failed when executing %s: %s\n",
-			cmd,
-			strerror(errno));
-		return;
-	}
+	size_t i;
 
-	while (fscanf(p, "%ms", &subtestname) == 1) {
+	for (i = 0; i < list->size; i++) {
+		char *subtestname = list->subtests[i];
 		char piglitname[256];
 
 		generate_piglit_name(binary, subtestname, piglitname, sizeof(piglitname));
 
-		if (exclude && exclude->size && matches_any(piglitname, exclude)) {
-			free(subtestname);
+		if (exclude && exclude->size && matches_any(piglitname, exclude))
 			continue;
-		}
 
-		if (include && include->size && !matches_any(piglitname, include)) {
-			free(subtestname);
+		if (include && include->size && !matches_any(piglitname, include))
 			continue;
-		}
 
 		if (settings->multiple_mode) {
 			num_subtests++;
@@ -97,46 +72,45 @@ static void add_subtests(struct job_list *job_list, struct settings *settings,
 			add_job_list_entry(job_list, strdup(binary), subtests, 1);
 			subtests = NULL;
 		}
-
-		free(subtestname);
 	}
 
 	if (num_subtests)
 		add_job_list_entry(job_list, strdup(binary), subtests, num_subtests);
 
-	s = pclose(p);
-	if (s == 0) {
-		return;
-	} else if (s == -1) {
-		fprintf(stderr, "popen error when executing %s: %s\n", binary, strerror(errno));
-	} else if (WIFEXITED(s)) {
-		if (WEXITSTATUS(s) == IGT_EXIT_INVALID) {
-			char piglitname[256];
+	if (list->exitcode == IGT_EXIT_INVALID) {
+		char piglitname[256];
 
-			generate_piglit_name(binary, NULL,
-					     piglitname, sizeof(piglitname));
-			/* No subtests on this one */
-			if (exclude && exclude->size &&
-			    matches_any(piglitname, exclude)) {
-				return;
-			}
-			if (!include || !include->size ||
-			    matches_any(piglitname, include)) {
-				add_job_list_entry(job_list, strdup(binary), NULL, 0);
-				return;
-			}
+		generate_piglit_name(binary, NULL,
+				     piglitname, sizeof(piglitname));
+		/* No subtests on this one */
+		if (exclude && exclude->size &&
+		    matches_any(piglitname, exclude)) {
+			return;
+		}
+		if (!include || !include->size ||
+		    matches_any(piglitname, include)) {
+			add_job_list_entry(job_list, strdup(binary), NULL, 0);
+			return;
 		}
-	} else {
-		fprintf(stderr, "Test binary %s died unexpectedly\n", binary);
 	}
 }
 
+enum filter_action {
+	FILTER_SKIP,
+	FILTER_ALL_SUBTESTS,
+	FILTER_EXCLUDE_SUBTESTS,
+	FILTER_SUBTESTS,
+};
+
 static bool filtered_job_list(struct job_list *job_list,
 			      struct settings *settings,
 			      int fd)
 {
 	FILE *f;
 	char buf[128];
+	struct subtest_list *lists = NULL, **tolist;
+	enum filter_action *actions = NULL;
+	size_t count = 0, n = 0, i;
 	bool ok;
 
 	if (job_list->entries != NULL) {
@@ -147,21 +121,22 @@ static bool filtered_job_list(struct job_list *job_list,
 	f = fdopen(fd, "r");
 
 	while (fscanf(f, "%127s", buf) == 1) {
-		if (!strcmp(buf, "TESTLIST") || !(strcmp(buf, "END")))
-			continue;
+		enum filter_action action;
 
-		/*
-		 * If the binary name matches exclude filters, no
-		 * subtests are added.
-		 */
-		if (settings->exclude_regexes.size && matches_any(buf, &settings->exclude_regexes))
+		if (!strcmp(buf, "TESTLIST") || !(strcmp(buf, "END")))
 			continue;
 
-		/*
-		 * If the binary name matches include filters (or include filters not present),
-		 * all subtests except those matching exclude filters are added.
-		 */
-		if (!settings->include_regexes.size || matches_any(buf, &settings->include_regexes)) {
+		if (settings->exclude_regexes.size && matches_any(buf, &settings->exclude_regexes)) {
+			/*
+			 * If the binary name matches exclude filters, no
+			 * subtests are added.
+			 */
+			action = FILTER_SKIP;
+		} else if (!settings->include_regexes.size || matches_any(buf, &settings->include_regexes)) {
+			/*
+			 * If the binary name matches include filters (or include filters not present),
+			 * all subtests except those matching exclude filters are added.
+			 */
 			if (settings->multiple_mode && !settings->exclude_regexes.size)
 				/*
 				 * Optimization; we know that all
@@ -169,21 +144,62 @@ static bool filtered_job_list(struct job_list *job_list,
 				 * get to omit executing
 				 * --list-subtests.
 				 */
-				add_job_list_entry(job_list, strdup(buf), NULL, 0);
+				action = FILTER_ALL_SUBTESTS;
 			else
-				add_subtests(job_list, settings, buf,
-					     NULL, &settings->exclude_regexes);
-			continue;
+				action = FILTER_EXCLUDE_SUBTESTS;
+		} else {
+			/*
+			 * Binary name doesn't match exclude or include filters.
+			 */
+			action = FILTER_SUBTESTS;
 		}
 
-		/*
-		 * Binary name doesn't match exclude or include filters.
-		 */
-		add_subtests(job_list, settings, buf,
-			     &settings->include_regexes,
-			     &settings->exclude_regexes);
+		if (action == FILTER_SKIP)
+			continue;
+
+		count++;
+		lists = realloc(lists, count * sizeof(*lists));
+		actions = realloc(actions, count * sizeof(*actions));
+		memset(&lists[count - 1], 0, sizeof(*lists));
+		lists[count - 1].binary = strdup(buf);
+		actions[count - 1] = action;
 	}
 
+	/*
+	 * List the subtests of all binaries that need filtering in
+	 * one go so that cache misses can be listed in parallel.
+	 */
+	tolist = calloc(count, sizeof(*tolist));
+	for (i = 0; i < count; i++) {
+		if (actions[i] != FILTER_ALL_SUBTESTS)
+			tolist[n++] = &lists[i];
+	}
+	fill_subtest_lists(settings, tolist, n);
+	free(tolist);
+
+	for (i = 0; i < count; i++) {
+		switch (actions[i]) {
+		case FILTER_ALL_SUBTESTS:
+			add_job_list_entry(job_list, strdup(lists[i].binary), NULL, 0);
+			break;
+		case FILTER_EXCLUDE_SUBTESTS:
+			add_subtests(job_list, settings, &lists[i],
+				     NULL, &settings->exclude_regexes);
+			break;
+		case FILTER_SUBTESTS:
+			add_subtests(job_list, settings, &lists[i],
+				     &settings->include_regexes,
+				     &settings->exclude_regexes);
+			break;
+		case FILTER_SKIP:
+			break;
+		}
+	}
+
+	free_subtest_lists(lists, count);
+	free(lists);
+	free(actions);
+
 	ok = job_list->size != 0;
 	if (!ok)
 		fprintf(stderr, "Filter didn't match any job name\n");
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "settings.h"
+#include "job_list.h"
+
+#define REPS 5
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static bool time_job_list(struct settings *settings, const char *cache,
+			  bool cold, double *time, size_t *size)
+{
+	struct job_list job_list;
+	struct timespec start, end;
+	bool ok;
+
+	if (cold)
+		unlink(cache);
+
+	init_job_list(&job_list);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	ok = create_job_list(&job_list, settings);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	*time = elapsed(&start, &end);
+	*size = job_list.size;
+	free_job_list(&job_list);
+
+	return ok;
+}
+
+/*
+ * Usage: job_list_benchmark [runner options] [test_root]
+ *
+ * Builds the job list the way 'igt_runner --list-all' would, first
+ * with an empty subtest cache and then with a populated one, and
+ * reports the time each took.
+ */
+int main(int argc, char **argv)
+{
+	struct settings settings;
+	char cache[] = "/tmp/igt-subtest-cache.XXXXXX";
+	double cold = 0, warm = 0, t;
+	char **args;
+	size_t size;
+	int i, fd;
+
+	fd = mkstemp(cache);
+	if (fd < 0) {
+		fprintf(stderr, "Cannot create a temporary cache file\n");
+		return 1;
+	}
+	close(fd);
+	setenv("IGT_RUNNER_SUBTEST_CACHE", cache, 1);
+
+	/* Always list, no results directory is needed */
+	args = calloc(argc + 2, sizeof(*args));
+	args[0] = argv[0];
+	args[1] = "--list-all";
+	for (i = 1; i < argc; i++)
+		args[i + 1] = argv[i];
+
+	init_settings(&settings);
+	if (!parse_options(argc + 1, args, &settings)) {
+		unlink(cache);
+		return 1;
+	}
+
+	for (i = 0; i < REPS; i++) {
+		if (!time_job_list(&settings, cache, true, &t, &size))
+			goto err;
+		cold += t;
+
+		if (!time_job_list(&settings, cache, false, &t, &size))
+			goto err;
+		warm += t;
+	}
+
+	printf("%zu jobs from %s\n", size, settings.test_root);
+	printf("cold: %.3fms\n", cold * 1e3 / REPS);
+	printf("warm: %.3fms\n", warm * 1e3 / REPS);
+
+	unlink(cache);
+	free_settings(&settings);
+	free(args);
+
+	return 0;
+
+err:
+	unlink(cache);
+	free_settings(&settings);
+	free(args);
+
+	return 1;
+}
@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -817,21 +819,256 @@ static const char igt_dmesg_whitelist[] =
 static const char igt_piglit_style_dmesg_blacklist[] =
 	"(\\[drm:|drm_|intel_|i915_|\\[drm\\])";
 
-static bool init_regex_whitelist(struct settings* settings, GRegex **re)
+#define MAX_DMESG_ANCHORS 32
+
+/*
+ * Most kernel log records match none of the alternatives of the dmesg
+ * regexp. Each alternative spells out a literal that every match of it
+ * contains, so the messages are first scanned for these anchors and the
+ * regexp only runs on those containing one.
+ */
+struct dmesg_filter
 {
-	GError *err = NULL;
-	const char *regex = settings->piglit_style_dmesg ?
+	GRegex *re;
+	size_t num_anchors;
+	struct {
+		const char *str;
+		size_t len;
+		unsigned int pair;
+	} anchors[MAX_DMESG_ANCHORS];
+	/* Bitmap of the first two bytes of the anchors */
+	uint8_t pairs[65536 / 8];
+	char buf[];
+};
+
+static const char *skip_bracket(const char *p, const char *end)
+{
+	/* A ']' right after the opening '[' or '[^' is a member */
+	p++;
+	if (p < end && *p == '^')
+		p++;
+	if (p < end && *p == ']')
+		p++;
+	while (p < end && *p != ']')
+		p++;
+
+	return p < end ? p + 1 : end;
+}
+
+static const char *skip_group(const char *p, const char *end)
+{
+	int depth = 0;
+
+	for (; p < end; p++) {
+		if (*p == '\\') {
+			p++;
+		} else if (*p == '[') {
+			p = skip_bracket(p, end) - 1;
+		} else if (*p == '(') {
+			depth++;
+		} else if (*p == ')') {
+			if (--depth == 0)
+				return p + 1;
+		}
+	}
+
+	return end;
+}
+
+static const char *skip_alternative(const char *p, const char *end)
+{
+	while (p < end && *p != '|') {
+		if (*p == '\\')
+			p += 2;
+		else if (*p == '[')
+			p = skip_bracket(p, end);
+		else if (*p == '(')
+			p = skip_group(p, end);
+		else
+			p++;
+	}
+
+	return p < end ? p : end;
+}
+
+/*
+ * Copies the longest run of literal characters that any match of the
+ * alternative [p, end) contains to buf, returning its length.
+ */
+static size_t alternative_anchor(const char *p, const char *end, char *buf)
+{
+	size_t len = 0, best = 0;
+	char *run = buf;
+
+	while (p < end) {
+		bool literal = true;
+		char c = *p;
+
+		if (c == '\\' && p + 1 < end && !isalnum(p[1])) {
+			c = p[1];
+			p += 2;
+		} else if (c == '\\') {
+			/* \d and the like match no fixed text, give up on the rest */
+			if (p + 1 >= end || !strchr("dDwWsSbB", p[1]))
+				return 0;
+			literal = false;
+			p += 2;
+		} else if (c == '.' || c == '^' || c == '$') {
+			literal = false;
+			p++;
+		} else if (c == '[') {
+			literal = false;
+			p = skip_bracket(p, end);
+		} else if (c == '(') {
+			literal = false;
+			p = skip_group(p, end);
+		} else {
+			p++;
+		}
+
+		if (p < end && (*p == '?' || *p == '*' || *p == '{')) {
+			/* The atom may be missing, the run ends before it */
+			literal = false;
+			p = *p == '{' ? memchr(p, '}', end - p) ?: end : p;
+			p = p < end ? p + 1 : end;
+		} else {
+			if (literal)
+				run[len++] = c;
+			if (p < end && *p == '+') {
+				/* Repeated, the run ends with its first occurrence */
+				literal = false;
+				p++;
+			}
+		}
+
+		if (p < end && *p == '?')
+			p++;
+
+		if (!literal || p >= end) {
+			if (len > best) {
+				memmove(buf, run, len);
+				best = len;
+			}
+			run = buf + best;
+			len = 0;
+		}
+	}
+
+	return best;
+}
+
+static unsigned int anchor_pair(const char *str)
+{
+	return (unsigned char)str[0] | (unsigned char)str[1] << 8;
+}
+
+static bool find_anchors(struct dmesg_filter *filter, const char *regex)
+{
+	const char *end = regex + strlen(regex);
+	const char *p = regex, *alt;
+	char *buf = filter->buf;
+	size_t len;
+
+	/* Inline options could make the literals case insensitive */
+	if (strstr(regex, "(?"))
+		return false;
+
+	/* A regexp in a single group is the alternation inside it */
+	while (*p == '(' && skip_group(p, end) == end && end[-1] == ')') {
+		p++;
+		end--;
+	}
+
+	while (p < end) {
+		alt = skip_alternative(p, end);
+		if (filter->num_anchors == MAX_DMESG_ANCHORS)
+			return false;
+
+		len = alternative_anchor(p, alt, buf);
+		if (len < 2)
+			return false;
+
+		filter->anchors[filter->num_anchors].str = buf;
+		filter->anchors[filter->num_anchors].len = len;
+		filter->anchors[filter->num_anchors].pair = anchor_pair(buf);
+		filter->pairs[anchor_pair(buf) / 8] |= 1 << anchor_pair(buf) % 8;
+		filter->num_anchors++;
+		buf += len;
+
+		p = alt + 1;
+	}
+
+	return filter->num_anchors > 0;
+}
+
+static bool contains_anchor(const struct dmesg_filter *filter, const char *message)
+{
+	unsigned int pair;
+	const char *p;
+	size_t i;
+
+	for (p = message; p[0] && p[1]; p++) {
+		pair = anchor_pair(p);
+		if (!(filter->pairs[pair / 8] & 1 << pair % 8))
+			continue;
+
+		for (i = 0; i < filter->num_anchors; i++)
+			if (filter->anchors[i].pair == pair &&
+			    !strncmp(p, filter->anchors[i].str,
+				     filter->anchors[i].len))
+				return true;
+	}
+
+	return false;
+}
+
+struct dmesg_filter *dmesg_filter_new(bool piglit_style)
+{
+	const char *regex = piglit_style ?
 		igt_piglit_style_dmesg_blacklist :
 		igt_dmesg_whitelist;
+	struct dmesg_filter *filter;
+	GError *err = NULL;
 
-	*re = g_regex_new(regex, G_REGEX_OPTIMIZE, 0, &err);
+	filter = calloc(1, sizeof(*filter) + strlen(regex));
+	if (!filter)
+		return NULL;
+
+	filter->re = g_regex_new(regex, G_REGEX_OPTIMIZE, 0, &err);
 	if (err) {
 		fprintf(stderr, "Cannot compile dmesg regexp\n");
 		g_error_free(err);
-		return false;
+		free(filter);
+		return NULL;
 	}
 
-	return true;
+	/* Without an anchor in every alternative, always run the regexp */
+	if (!find_anchors(filter, regex))
+		filter->num_anchors = 0;
+
+	return filter;
+}
+
+bool dmesg_filter_match(const struct dmesg_filter *filter, const char *message)
+{
+	if (filter->num_anchors && !contains_anchor(filter, message))
+		return false;
+
+	return g_regex_match(filter->re, message, 0, NULL);
+}
+
+GRegex *dmesg_filter_regex(const struct dmesg_filter *filter)
+{
+	return filter->re;
+}
+
+void dmesg_filter_free(struct dmesg_filter *filter)
+{
+	if (!filter)
+		return;
+
+	g_regex_unref(filter->re);
+	free(filter);
 }
 
 static bool parse_dmesg_line(char* line,
@@ -950,6 +1187,7 @@ static void add_empty_dmesgs_where_missing(struct json_object *tests,
 
 static bool fill_from_dmesg(int fd,
 			    struct settings *settings,
+			    const struct dmesg_filter *filter,
 			    char *binary,
 			    struct subtest_list *subtests,
 			    struct json_object *tests)
@@ -967,17 +1205,11 @@ static bool fill_from_dmesg(int fd,
 	char dynamic_piglit_name[256];
 	ssize_t read;
 	size_t i;
-	GRegex *re;
 
 	if (!f) {
 		return false;
 	}
 
-	if (!init_regex_whitelist(settings, &re)) {
-		fclose(f);
-		return false;
-	}
-
 	while ((read = getline(&line, &linelen, f)) > 0) {
 		char *formatted;
 		unsigned flags;
@@ -1034,14 +1266,14 @@ static bool fill_from_dmesg(int fd,
 
 		if (settings->piglit_style_dmesg) {
 			if ((flags & 0x07) <= settings->dmesg_warn_level && continuation != 'c' &&
-			    g_regex_match(re, message, 0, NULL)) {
+			    dmesg_filter_match(filter, message)) {
 				append_line(&warnings, &warningslen, formatted);
 				if (current_test != NULL)
 					append_line(&dynamic_warnings, &dynamic_warnings_len, formatted);
 			}
 		} else {
 			if ((flags & 0x07) <= settings->dmesg_warn_level && continuation != 'c' &&
-			    !g_regex_match(re, message, 0, NULL)) {
+			    !dmesg_filter_match(filter, message)) {
 				append_line(&warnings, &warningslen, formatted);
 				if (current_test != NULL)
 					append_line(&dynamic_warnings, &dynamic_warnings_len, formatted);
@@ -1088,7 +1320,6 @@ static bool fill_from_dmesg(int fd,
 	free(dynamic_dmesg);
 	free(warnings);
 	free(dynamic_warnings);
-	g_regex_unref(re);
 	fclose(f);
 	return true;
 }
@@ -1446,6 +1677,7 @@ static void add_to_totals(const char *binary,
 static bool parse_test_directory(int dirfd,
 				 struct job_list_entry *entry,
 				 struct settings *settings,
+				 const struct dmesg_filter *filter,
 				 struct results *results)
 {
 	int fds[_F_LAST];
@@ -1465,7 +1697,7 @@ static bool parse_test_directory(int dirfd,
 
 	if (!fill_from_output(fds[_F_OUT], entry->binary, "out", &subtests, results->tests) ||
 	    !fill_from_output(fds[_F_ERR], entry->binary, "err", &subtests, results->tests) ||
-	    !fill_from_dmesg(fds[_F_DMESG], settings, entry->binary, &subtests, results->tests)) {
+	    !fill_from_dmesg(fds[_F_DMESG], settings, filter, entry->binary, &subtests, results->tests)) {
 		fprintf(stderr, "Error parsing output files\n");
 		status = false;
 		goto parse_output_end;
@@ -1532,13 +1764,180 @@ static void create_result_root_nodes(struct json_object *root,
 	json_object_object_add(root, "runtimes", results->runtimes);
 }
 
+/*
+ * Each job is parsed into a results tree of its own, so that the jobs can
+ * be parsed in parallel. The trees are then merged in job list order,
+ * giving the same results as parsing the jobs one after another. Parsing
+ * depends on the fields already set for a test, so a job running a test
+ * of an earlier job is parsed again into the merged tree instead.
+ */
+struct parsed_job
+{
+	struct json_object *root;
+	struct results results;
+	bool ok;
+};
+
+struct parse_pool
+{
+	int dirfd;
+	struct job_list *job_list;
+	struct settings *settings;
+	struct dmesg_filter *filter;
+	struct parsed_job *jobs;
+	size_t next;
+	bool failed;
+};
+
+static bool parse_job_into(struct parse_pool *pool, size_t i,
+			   struct results *results)
+{
+	struct job_list_entry *entry = &pool->job_list->entries[i];
+	char name[16];
+	int testdirfd;
+	bool ok;
+
+	snprintf(name, 16, "%zd", i);
+	if ((testdirfd = openat(pool->dirfd, name, O_DIRECTORY | O_RDONLY)) < 0) {
+		try_add_notrun_results(entry, pool->settings, results);
+		return true;
+	}
+
+	ok = parse_test_directory(testdirfd, entry, pool->settings,
+				  pool->filter, results);
+	close(testdirfd);
+
+	return ok;
+}
+
+static void parse_job(struct parse_pool *pool, size_t i)
+{
+	struct parsed_job *job = &pool->jobs[i];
+
+	job->root = json_object_new_object();
+	create_result_root_nodes(job->root, &job->results);
+
+	job->ok = parse_job_into(pool, i, &job->results);
+}
+
+static void *parse_worker(void *data)
+{
+	struct parse_pool *pool = data;
+	size_t i;
+
+	while (!__atomic_load_n(&pool->failed, __ATOMIC_RELAXED)) {
+		i = __atomic_fetch_add(&pool->next, 1, __ATOMIC_RELAXED);
+		if (i >= pool->job_list->size)
+			break;
+
+		parse_job(pool, i);
+		if (!pool->jobs[i].ok)
+			__atomic_store_n(&pool->failed, true, __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+}
+
+static size_t parse_worker_count(size_t jobs)
+{
+	const char *env = getenv("IGT_RESULTGEN_THREADS");
+	long count;
+
+	count = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+	if (count < 1)
+		count = 1;
+
+	return count < jobs ? count : jobs;
+}
+
+static void parse_jobs(struct parse_pool *pool)
+{
+	size_t count = parse_worker_count(pool->job_list->size);
+	pthread_t *threads;
+	size_t i, started = 0;
+
+	threads = calloc(count, sizeof(*threads));
+	for (i = 1; i < count; i++) {
+		if (pthread_create(&threads[started], NULL, parse_worker, pool))
+			break;
+		started++;
+	}
+
+	/* The caller works too, alone if no thread could be started */
+	parse_worker(pool);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+static bool tests_overlap(struct json_object *tests, struct json_object *from)
+{
+	json_object_object_foreach(from, key, val) {
+		if (json_object_object_get_ex(tests, key, NULL))
+			return true;
+	}
+
+	return false;
+}
+
+static void merge_tests(struct json_object *tests, struct json_object *from)
+{
+	json_object_object_foreach(from, key, val)
+		json_object_object_add(tests, key, json_object_get(val));
+}
+
+static void merge_totals(struct json_object *totals, struct json_object *from)
+{
+	json_object_object_foreach(from, key, val) {
+		struct json_object *obj = get_totals_object(totals, key);
+
+		json_object_object_foreach(val, result, countobj) {
+			int count = json_object_get_int(countobj);
+			struct json_object *old;
+
+			if (!count)
+				continue;
+
+			if (!json_object_object_get_ex(obj, result, &old)) {
+				fprintf(stderr, "Warning: Totals object without count for %s\n", result);
+				continue;
+			}
+
+			json_object_object_add(obj, result,
+					       json_object_new_int(json_object_get_int(old) + count));
+		}
+	}
+}
+
+static void merge_runtimes(struct json_object *runtimes, struct json_object *from)
+{
+	json_object_object_foreach(from, key, val) {
+		struct json_object *timeobj, *end;
+
+		if (json_object_object_get_ex(val, "time", &timeobj) &&
+		    json_object_object_get_ex(timeobj, "end", &end))
+			add_runtime(get_or_create_json_object(runtimes, key),
+				    json_object_get_double(end));
+	}
+}
+
+static void merge_results(struct results *results, struct results *from)
+{
+	merge_tests(results->tests, from->tests);
+	merge_totals(results->totals, from->totals);
+	merge_runtimes(results->runtimes, from->runtimes);
+}
+
 struct json_object *generate_results_json(int dirfd)
 {
 	struct settings settings;
 	struct job_list job_list;
 	struct json_object *obj, *elapsed;
 	struct results results;
-	int testdirfd, fd;
+	struct parse_pool pool = {};
+	bool ok = true;
+	int fd;
 	size_t i;
 
 	init_settings(&settings);
@@ -1605,20 +2004,47 @@ struct json_object *generate_results_json(int dirfd)
 	 * - options
 	 */
 
-	for (i = 0; i < job_list.size; i++) {
-		char name[16];
+	/* Compiled once, matching is safe from several threads */
+	pool.filter = dmesg_filter_new(settings.piglit_style_dmesg);
+	if (!pool.filter) {
+		json_object_put(obj);
+		return NULL;
+	}
+
+	pool.dirfd = dirfd;
+	pool.job_list = &job_list;
+	pool.settings = &settings;
+	pool.jobs = calloc(job_list.size, sizeof(*pool.jobs));
+	if (!pool.jobs && job_list.size) {
+		fprintf(stderr, "resultgen: Cannot allocate the parsed jobs\n");
+		dmesg_filter_free(pool.filter);
+		json_object_put(obj);
+		return NULL;
+	}
+
+	parse_jobs(&pool);
 
-		snprintf(name, 16, "%zd", i);
-		if ((testdirfd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0) {
-			try_add_notrun_results(&job_list.entries[i], &settings, &results);
+	for (i = 0; i < job_list.size; i++) {
+		if (!pool.jobs[i].root)
 			continue;
-		}
 
-		if (!parse_test_directory(testdirfd, &job_list.entries[i], &settings, &results)) {
-			close(testdirfd);
-			return NULL;
+		if (!ok || !pool.jobs[i].ok) {
+			ok = false;
+		} else if (tests_overlap(results.tests, pool.jobs[i].results.tests)) {
+			/* A test of an earlier job, see struct parsed_job */
+			ok = parse_job_into(&pool, i, &results);
+		} else {
+			merge_results(&results, &pool.jobs[i].results);
 		}
-		close(testdirfd);
+
+		json_object_put(pool.jobs[i].root);
+	}
+	free(pool.jobs);
+	dmesg_filter_free(pool.filter);
+
+	if (!ok) {
+		json_object_put(obj);
+		return NULL;
 	}
 
 	if ((fd = openat(dirfd, "aborted.txt", O_RDONLY)) >= 0) {
@@ -2,10 +2,18 @@
 #define RUNNER_RESULTGEN_H
 
 #include <stdbool.h>
+#include <glib.h>
 
 bool generate_results(int dirfd);
 bool generate_results_path(char *resultspath);
 
 struct json_object *generate_results_json(int dirfd);
 
+struct dmesg_filter;
+
+struct dmesg_filter *dmesg_filter_new(bool piglit_style);
+bool dmesg_filter_match(const struct dmesg_filter *filter, const char *message);
+GRegex *dmesg_filter_regex(const struct dmesg_filter *filter);
+void dmesg_filter_free(struct dmesg_filter *filter);
+
 #endif
@@ -0,0 +1,297 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <json.h>
+
+#include "resultgen.h"
+
+#define REPS 3
+
+static const char *files[] = {
+	"journal.txt", "out.txt", "err.txt", "dmesg.txt",
+};
+
+static double elapsed(const struct timespec *start, const struct timespec *end)
+{
+	return (end->tv_sec - start->tv_sec) + (end->tv_nsec - start->tv_nsec) * 1e-9;
+}
+
+static bool write_file(int dirfd, const char *name, const char *text)
+{
+	int fd = openat(dirfd, name, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+	size_t len = strlen(text);
+	bool ok;
+
+	if (fd < 0)
+		return false;
+
+	ok = write(fd, text, len) == len;
+	close(fd);
+
+	return ok;
+}
+
+/*
+ * One job per subtest, as without --multiple-mode, with a kernel log of
+ * dmesg_lines records of which one in eight is a warning.
+ */
+static bool write_job(int dirfd, size_t i, size_t dmesg_lines)
+{
+	unsigned long long ts = 1000000ull * (i + 1);
+	char name[16], buf[256];
+	FILE *f;
+	int fd;
+
+	snprintf(name, sizeof(name), "%zd", i);
+	mkdirat(dirfd, name, 0777);
+	if ((fd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) < 0)
+		return false;
+
+	snprintf(buf, sizeof(buf), "subtest-%zd\nexit:0 (0.%03zds)\n", i, i % 1000);
+	if (!write_file(fd, "journal.txt", buf))
+		goto err;
+
+	snprintf(buf, sizeof(buf),
+		 "IGT-Version: 1.26-synthetic (x86_64) (Linux: 5.15.0 x86_64)\n"
+		 "Starting subtest: subtest-%zd\n"
+		 "Subtest subtest-%zd: %s (0.%03zds)\n",
+		 i, i, i % 16 ? "SUCCESS" : "SKIP", i % 1000);
+	if (!write_file(fd, "out.txt", buf))
+		goto err;
+
+	snprintf(buf, sizeof(buf),
+		 "Starting subtest: subtest-%zd\n"
+		 "Subtest subtest-%zd: %s (0.%03zds)\n",
+		 i, i, i % 16 ? "SUCCESS" : "SKIP", i % 1000);
+	if (!write_file(fd, "err.txt", buf))
+		goto err;
+
+	f = fdopen(openat(fd, "dmesg.txt", O_CREAT | O_TRUNC | O_WRONLY, 0666), "w");
+	if (!f)
+		goto err;
+
+	fprintf(f, "14,%zd,%llu,-;[IGT] synthetic: executing\n", 3 * i, ts);
+	fprintf(f, "14,%zd,%llu,-;[IGT] synthetic: starting subtest subtest-%zd\n",
+		3 * i + 1, ts + 10, i);
+	for (size_t k = 0; k < dmesg_lines; k++) {
+		if (k % 8 == 7)
+			fprintf(f, "4,%zd,%llu,-;i915 0000:00:02.0: [drm] GPU HANG: ecode 12:1:%08zx\n",
+				3 * i + 2, ts + 20 + k, k);
+		else
+			fprintf(f, "6,%zd,%llu,-;i915 0000:00:02.0: [drm] synthetic line %zd\\x0a\n",
+				3 * i + 2, ts + 20 + k, k);
+	}
+	fprintf(f, "14,%zd,%llu,-;[IGT] synthetic: exiting, ret=0\n",
+		3 * i + 2, ts + 30 + dmesg_lines);
+	fclose(f);
+
+	close(fd);
+	return true;
+
+err:
+	close(fd);
+	return false;
+}
+
+static bool write_results(int dirfd, size_t jobs, size_t dmesg_lines)
+{
+	FILE *f;
+	size_t i;
+
+	if (!write_file(dirfd, "metadata.txt",
+			"name : synthetic\n"
+			"multiple_mode : 0\n"
+			"piglit_style_dmesg : 0\n"
+			"dmesg_warn_level : 4\n"
+			"test_root : /path/does/not/exist\n"
+			"results_path : /path/does/not/exist\n"))
+		return false;
+
+	f = fdopen(openat(dirfd, "joblist.txt", O_CREAT | O_TRUNC | O_WRONLY, 0666), "w");
+	if (!f)
+		return false;
+	for (i = 0; i < jobs; i++)
+		fprintf(f, "synthetic subtest-%zd\n", i);
+	fclose(f);
+
+	for (i = 0; i < jobs; i++)
+		if (!write_job(dirfd, i, dmesg_lines))
+			return false;
+
+	return true;
+}
+
+static void remove_results(int dirfd, size_t jobs)
+{
+	char name[16];
+	size_t i, k;
+	int fd;
+
+	for (i = 0; i < jobs; i++) {
+		snprintf(name, sizeof(name), "%zd", i);
+		if ((fd = openat(dirfd, name, O_DIRECTORY | O_RDONLY)) >= 0) {
+			for (k = 0; k < sizeof(files) / sizeof(files[0]); k++)
+				unlinkat(fd, files[k], 0);
+			close(fd);
+		}
+		unlinkat(dirfd, name, AT_REMOVEDIR);
+	}
+
+	unlinkat(dirfd, "metadata.txt", 0);
+	unlinkat(dirfd, "joblist.txt", 0);
+}
+
+static char *time_results(int dirfd, const char *threads, double *time)
+{
+	struct timespec start, end;
+	struct json_object *obj;
+	char *json = NULL;
+	int i;
+
+	setenv("IGT_RESULTGEN_THREADS", threads, 1);
+
+	*time = 0;
+	for (i = 0; i < REPS; i++) {
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		obj = generate_results_json(dirfd);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (!obj) {
+			free(json);
+			return NULL;
+		}
+
+		*time += elapsed(&start, &end);
+
+		if (!json)
+			json = strdup(json_object_to_json_string_ext(obj, JSON_C_TO_STRING_PRETTY));
+		json_object_put(obj);
+	}
+
+	return json;
+}
+
+/*
+ * Matches kernel log messages like the synthetic ones against the dmesg
+ * regexp alone and through the anchor prefilter, checking both agree.
+ */
+static bool time_dmesg_filter(bool piglit_style, size_t lines)
+{
+	static const char *messages[] = {
+		"i915 0000:00:02.0: [drm] synthetic line 42\\x0a",
+		"i915 0000:00:02.0: [drm] GPU HANG: ecode 12:1:00000007",
+		"[IGT] synthetic: starting subtest subtest-42",
+		"usb usb3: root hub lost power or was reset",
+		"Setting dangerous option enable_guc - tainting kernel",
+		"perf: interrupt took too long (2503 > 2500), lowering kernel.perf_event_max_sample_rate to 79750",
+	};
+	const size_t count = sizeof(messages) / sizeof(messages[0]);
+	struct dmesg_filter *filter = dmesg_filter_new(piglit_style);
+	struct timespec start, end;
+	double tregex, tfilter;
+	size_t i, matches = 0;
+	bool ok = true;
+
+	if (!filter)
+		return false;
+
+	for (i = 0; i < count; i++)
+		if (dmesg_filter_match(filter, messages[i]) !=
+		    g_regex_match(dmesg_filter_regex(filter), messages[i], 0, NULL))
+			ok = false;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < lines; i++)
+		matches += g_regex_match(dmesg_filter_regex(filter),
+					 messages[i % count], 0, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	tregex = elapsed(&start, &end);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < lines; i++)
+		matches -= dmesg_filter_match(filter, messages[i % count]);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	tfilter = elapsed(&start, &end);
+
+	dmesg_filter_free(filter);
+
+	printf("%s dmesg %s: regexp %.1fns, prefiltered %.1fns per line\n",
+	       piglit_style ? "piglit style" : "default",
+	       piglit_style ? "blacklist" : "whitelist",
+	       tregex * 1e9 / lines, tfilter * 1e9 / lines);
+
+	if (!ok || matches) {
+		fprintf(stderr, "The dmesg prefilter disagrees with the regexp\n");
+		return false;
+	}
+
+	return true;
+}
+
+/*
+ * Usage: resultgen_benchmark [jobs] [dmesg lines per job]
+ *
+ * Writes a synthetic results directory and reports the time taken to
+ * generate its results with a single thread and with one per CPU,
+ * checking that both give the same results, then the time taken to
+ * match that many kernel log lines against the dmesg regexp.
+ */
+int main(int argc, char **argv)
+{
+	size_t jobs = argc > 1 ? strtoul(argv[1], NULL, 0) : 5000;
+	size_t dmesg_lines = argc > 2 ? strtoul(argv[2], NULL, 0) : 64;
+	char path[] = "/tmp/igt-resultgen.XXXXXX";
+	char *serial = NULL, *parallel = NULL, cpus[16];
+	double tserial, tparallel;
+	int dirfd, ret = 1;
+
+	if (!mkdtemp(path)) {
+		fprintf(stderr, "Cannot create a temporary results directory\n");
+		return 1;
+	}
+
+	dirfd = open(path, O_DIRECTORY | O_RDONLY);
+	if (dirfd < 0 || !write_results(dirfd, jobs, dmesg_lines)) {
+		fprintf(stderr, "Cannot write the synthetic results\n");
+		goto out;
+	}
+
+	snprintf(cpus, sizeof(cpus), "%ld", sysconf(_SC_NPROCESSORS_ONLN));
+	serial = time_results(dirfd, "1", &tserial);
+	parallel = time_results(dirfd, cpus, &tparallel);
+	if (!serial || !parallel) {
+		fprintf(stderr, "Generating the results failed\n");
+		goto out_free;
+	}
+
+	printf("%zu jobs, %zu dmesg lines each\n", jobs, dmesg_lines);
+	printf("1 thread: %.3fms\n", tserial * 1e3 / REPS);
+	printf("%s threads: %.3fms\n", cpus, tparallel * 1e3 / REPS);
+
+	if (strcmp(serial, parallel)) {
+		fprintf(stderr, "Results differ between 1 and %s threads\n", cpus);
+		goto out_free;
+	}
+
+	if (!time_dmesg_filter(false, jobs * dmesg_lines) ||
+	    !time_dmesg_filter(true, jobs * dmesg_lines))
+		goto out_free;
+
+	ret = 0;
+
+out_free:
+	free(serial);
+	free(parallel);
+out:
+	if (dirfd >= 0) {
+		remove_results(dirfd, jobs);
+		close(dirfd);
+	}
+	rmdir(path);
+
+	return ret;
+}
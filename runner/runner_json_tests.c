@@ -166,6 +166,8 @@ static const char *dirnames[] = {
 	"dynamic-subtest-name-in-multiple-subtests",
 	"unprintable-characters",
 	"empty-result-files",
+	"repeated-job",
+	"repeated-subtest-without-result",
 };
 
 igt_main
@@ -177,6 +179,11 @@ igt_main
 
 	for (i = 0; i < ARRAY_SIZE(dirnames); i++) {
 		igt_subtest(dirnames[i]) {
+			/* All jobs in one thread, then each in its own */
+			setenv("IGT_RESULTGEN_THREADS", "1", 1);
+			run_results_and_compare(dirfd, dirnames[i]);
+
+			setenv("IGT_RESULTGEN_THREADS", "64", 1);
 			run_results_and_compare(dirfd, dirnames[i]);
 		}
 	}
@@ -219,6 +219,26 @@ static void assert_job_list_equal(struct job_list *one, struct job_list *two)
 	}
 }
 
+static void assert_cached_subtest(struct job_list *list, const char *binary,
+				  const char *subtest)
+{
+	size_t i, k;
+
+	for (i = 0; i < list->size; i++) {
+		struct job_list_entry *entry = &list->entries[i];
+
+		if (strcmp(entry->binary, binary))
+			continue;
+
+		for (k = 0; k < entry->subtest_count; k++) {
+			if (!strcmp(entry->subtests[k], subtest))
+				return;
+		}
+	}
+
+	igt_assert_f(false, "%s@%s not in the job list\n", binary, subtest);
+}
+
 static void assert_execution_created(int dirfd, const char *name)
 {
 	int fd;
@@ -720,6 +740,84 @@ igt_main
 	job_list_filter_test("piglit-names", "-t", "igt@successtest", 2, 1);
 	job_list_filter_test("piglit-names-subtest", "-t", "igt@successtest@first", 1, 1);
 
+	igt_subtest_group {
+		char dirname[] = "tmpdirXXXXXX";
+		char cachename[64];
+		struct job_list *cold = malloc(sizeof(*cold));
+		struct job_list *warm = malloc(sizeof(*warm));
+
+		igt_fixture {
+			igt_require(mkdtemp(dirname) != NULL);
+			snprintf(cachename, sizeof(cachename), "%s/cache.txt", dirname);
+			setenv("IGT_RUNNER_SUBTEST_CACHE", cachename, 1);
+			init_job_list(cold);
+			init_job_list(warm);
+		}
+
+		igt_subtest("job-list-subtest-cache") {
+			const char *argv[] = { "runner",
+					       "-x", "second-subtest",
+					       testdatadir,
+					       "path-to-results",
+			};
+			struct stat st, warm_st;
+			char buf[4096], *s;
+			ssize_t len;
+			int fd;
+
+			igt_assert(parse_options(ARRAY_SIZE(argv), (char**)argv, settings));
+
+			igt_assert(create_job_list(cold, settings));
+			igt_assert_eq(cold->size, NUM_TESTDATA_SUBTESTS - 1);
+			igt_assert_eq(stat(cachename, &st), 0);
+			igt_assert_lt(0, st.st_size);
+
+			/* Cache hits give the same job list */
+			igt_assert(create_job_list(warm, settings));
+			assert_job_list_equal(cold, warm);
+
+			/* Nothing was relisted, so the cache wasn't rewritten */
+			igt_assert_eq(stat(cachename, &warm_st), 0);
+			igt_assert_eq(warm_st.st_ino, st.st_ino);
+			igt_assert(warm_st.st_mtim.tv_sec == st.st_mtim.tv_sec &&
+				   warm_st.st_mtim.tv_nsec == st.st_mtim.tv_nsec);
+
+			/* and the subtests come from the cache, not the binary */
+			igt_assert((fd = open(cachename, O_RDONLY)) >= 0);
+			len = read(fd, buf, sizeof(buf) - 1);
+			close(fd);
+			igt_assert_lt(0, len);
+			buf[len] = '\0';
+			igt_assert((s = strstr(buf, "\nfirst-subtest\n")));
+			memcpy(s + 1, "cache", 5);
+
+			igt_assert((fd = open(cachename, O_WRONLY | O_TRUNC)) >= 0);
+			igt_assert_eq(write(fd, buf, len), len);
+			close(fd);
+
+			igt_assert(create_job_list(warm, settings));
+			assert_cached_subtest(warm, "successtest", "cache-subtest");
+
+			/* A garbled cache is ignored and relisted */
+			igt_assert((fd = open(cachename, O_WRONLY | O_TRUNC)) >= 0);
+			igt_assert_eq(write(fd, "garbage\n", 8), 8);
+			close(fd);
+
+			igt_assert(create_job_list(warm, settings));
+			assert_job_list_equal(cold, warm);
+		}
+
+		igt_fixture {
+			unsetenv("IGT_RUNNER_SUBTEST_CACHE");
+			unlink(cachename);
+			rmdir(dirname);
+			free_job_list(cold);
+			free_job_list(warm);
+			free(cold);
+			free(warm);
+		}
+	}
+
 	igt_subtest_group {
 		char filename[] = "tmplistXXXXXX";
 		const char testlisttext[] = "igt@successtest@first-subtest\n"
@@ -241,6 +241,11 @@ static const char *usage_str =
 	"  [test_root]           Directory that contains the IGT tests. The environment\n"
 	"                        variable IGT_TEST_ROOT will be used if set, overriding\n"
 	"                        this option if given.\n"
+	"\n"
+	"Subtest lists of the test binaries are cached in $XDG_CACHE_HOME/igt-gpu-tools\n"
+	"(~/.cache/igt-gpu-tools if unset), or in results-path if that is not writable.\n"
+	"The environment variable IGT_RUNNER_SUBTEST_CACHE overrides the cache file;\n"
+	"setting it to an empty string disables the cache.\n"
 	;
 
 static void usage(const char *extra_message, FILE *f)
@@ -0,0 +1,617 @@
+#include <elf.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "igt_core.h"
+#include "subtest_cache.h"
+
+#define CACHE_MAGIC "igt-subtest-cache 1"
+#define MAX_BUILD_ID 64
+
+struct binary_id {
+	int64_t size;
+	int64_t mtime_ns;
+	/* Hex encoded NT_GNU_BUILD_ID, or "-" if the binary has none */
+	char build_id[2 * MAX_BUILD_ID + 1];
+};
+
+struct cache_entry {
+	char *binary;
+	struct binary_id id;
+	int exitcode;
+	char **subtests;
+	size_t size;
+};
+
+struct subtest_cache {
+	char *path;
+	struct cache_entry *entries;
+	size_t size;
+	bool dirty;
+};
+
+static const char *note_build_id(const char *notes, size_t len, size_t align,
+				 size_t *id_len)
+{
+	const char *p = notes;
+
+	while (p + sizeof(Elf64_Nhdr) <= notes + len) {
+		/* Elf32_Nhdr and Elf64_Nhdr have the same layout */
+		const Elf64_Nhdr *nhdr = (const Elf64_Nhdr *)p;
+		size_t name = (nhdr->n_namesz + align - 1) & ~(align - 1);
+		size_t desc = (nhdr->n_descsz + align - 1) & ~(align - 1);
+		const char *n = p + sizeof(*nhdr);
+
+		if (n + name + desc > notes + len)
+			break;
+
+		if (nhdr->n_type == NT_GNU_BUILD_ID &&
+		    nhdr->n_namesz == sizeof(ELF_NOTE_GNU) &&
+		    !memcmp(n, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU))) {
+			*id_len = nhdr->n_descsz;
+			return n + name;
+		}
+
+		p = n + name + desc;
+	}
+
+	return NULL;
+}
+
+static void read_build_id(int fd, size_t size, char *out)
+{
+	const unsigned char *elf;
+	const char *id = NULL;
+	size_t id_len = 0;
+	int i;
+
+	strcpy(out, "-");
+
+	if (size < sizeof(Elf64_Ehdr))
+		return;
+
+	elf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (elf == MAP_FAILED)
+		return;
+
+	if (memcmp(elf, ELFMAG, SELFMAG))
+		goto out;
+
+	if (elf[EI_CLASS] == ELFCLASS64) {
+		const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)elf;
+
+		for (i = 0; !id && i < ehdr->e_phnum; i++) {
+			const Elf64_Phdr *phdr;
+			size_t off = ehdr->e_phoff + i * ehdr->e_phentsize;
+
+			if (off + sizeof(*phdr) > size)
+				break;
+
+			phdr = (const Elf64_Phdr *)(elf + off);
+			if (phdr->p_type != PT_NOTE ||
+			    phdr->p_offset + phdr->p_filesz > size)
+				continue;
+
+			id = note_build_id((const char *)elf + phdr->p_offset,
+					   phdr->p_filesz,
+					   phdr->p_align == 8 ? 8 : 4,
+					   &id_len);
+		}
+	} else if (elf[EI_CLASS] == ELFCLASS32) {
+		const Elf32_Ehdr *ehdr = (const Elf32_Ehdr *)elf;
+
+		for (i = 0; !id && i < ehdr->e_phnum; i++) {
+			const Elf32_Phdr *phdr;
+			size_t off = ehdr->e_phoff + i * ehdr->e_phentsize;
+
+			if (off + sizeof(*phdr) > size)
+				break;
+
+			phdr = (const Elf32_Phdr *)(elf + off);
+			if (phdr->p_type != PT_NOTE ||
+			    phdr->p_offset + phdr->p_filesz > size)
+				continue;
+
+			id = note_build_id((const char *)elf + phdr->p_offset,
+					   phdr->p_filesz, 4, &id_len);
+		}
+	}
+
+	if (id && id_len && id_len <= MAX_BUILD_ID) {
+		for (i = 0; i < id_len; i++)
+			sprintf(out + 2 * i, "%02x", (unsigned char)id[i]);
+	}
+
+out:
+	munmap((void *)elf, size);
+}
+
+static bool identify_binary(const char *test_root, const char *binary,
+			    struct binary_id *id)
+{
+	char path[PATH_MAX];
+	struct stat st;
+	int fd;
+
+	if (snprintf(path, sizeof(path), "%s/%s", test_root, binary) >= sizeof(path))
+		return false;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &st) || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	id->size = st.st_size;
+	id->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	read_build_id(fd, st.st_size, id->build_id);
+	close(fd);
+
+	return true;
+}
+
+static bool same_binary(const struct binary_id *one, const struct binary_id *two)
+{
+	return one->size == two->size &&
+		one->mtime_ns == two->mtime_ns &&
+		!strcmp(one->build_id, two->build_id);
+}
+
+/* mkdir -p */
+static bool make_dirs(char *path)
+{
+	char *s;
+
+	for (s = path + 1; (s = strchr(s, '/')); s++) {
+		*s = '\0';
+		if (mkdir(path, 0755) && errno != EEXIST) {
+			*s = '/';
+			return false;
+		}
+		*s = '/';
+	}
+
+	return !mkdir(path, 0755) || errno == EEXIST;
+}
+
+static uint64_t hash_string(const char *str)
+{
+	uint64_t hash = 0xcbf29ce484222325ull; /* FNV-1a */
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+static char *cache_path(struct settings *settings)
+{
+	const char *env = getenv("IGT_RUNNER_SUBTEST_CACHE");
+	const char *xdg = getenv("XDG_CACHE_HOME");
+	const char *home = getenv("HOME");
+	char *dir = NULL, *path = NULL;
+
+	if (env)
+		return *env ? strdup(env) : NULL;
+
+	if (xdg && *xdg)
+		asprintf(&dir, "%s/igt-gpu-tools", xdg);
+	else if (home && *home)
+		asprintf(&dir, "%s/.cache/igt-gpu-tools", home);
+
+	/*
+	 * One file per test root, so that alternating between test
+	 * roots doesn't keep throwing the whole cache away.
+	 */
+	if (dir && make_dirs(dir) && !access(dir, W_OK)) {
+		asprintf(&path, "%s/subtest-cache-%016" PRIx64 ".txt",
+			 dir, hash_string(settings->test_root));
+		free(dir);
+		return path;
+	}
+	free(dir);
+
+	/*
+	 * Don't create the results directory here, that is left to
+	 * serialize_job_list() and friends.
+	 */
+	if (settings->results_path && !access(settings->results_path, W_OK)) {
+		asprintf(&path, "%s/%s", settings->results_path, SUBTEST_CACHE_FILENAME);
+		return path;
+	}
+
+	return NULL;
+}
+
+static void free_cache_entry(struct cache_entry *entry)
+{
+	size_t i;
+
+	for (i = 0; i < entry->size; i++)
+		free(entry->subtests[i]);
+	free(entry->subtests);
+	free(entry->binary);
+}
+
+static void free_cache(struct subtest_cache *cache)
+{
+	size_t i;
+
+	for (i = 0; i < cache->size; i++)
+		free_cache_entry(&cache->entries[i]);
+	free(cache->entries);
+	free(cache->path);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static struct cache_entry *find_entry(struct subtest_cache *cache,
+				      const char *binary)
+{
+	size_t i;
+
+	for (i = 0; i < cache->size; i++) {
+		if (!strcmp(cache->entries[i].binary, binary))
+			return &cache->entries[i];
+	}
+
+	return NULL;
+}
+
+static struct cache_entry *new_entry(struct subtest_cache *cache,
+				     const char *binary)
+{
+	struct cache_entry *entry = find_entry(cache, binary);
+
+	if (entry) {
+		free_cache_entry(entry);
+	} else {
+		cache->size++;
+		cache->entries = realloc(cache->entries,
+					 cache->size * sizeof(*cache->entries));
+		entry = &cache->entries[cache->size - 1];
+	}
+
+	memset(entry, 0, sizeof(*entry));
+	entry->binary = strdup(binary);
+
+	return entry;
+}
+
+static void read_cache(struct subtest_cache *cache, const char *test_root)
+{
+	char *line = NULL;
+	size_t line_len = 0;
+	ssize_t len;
+	FILE *f;
+
+	f = fopen(cache->path, "r");
+	if (!f)
+		return;
+
+	if (getline(&line, &line_len, f) < 0 ||
+	    strcmp(line, CACHE_MAGIC "\n"))
+		goto out;
+
+	/* A cache file written for another test root is ignored entirely */
+	if ((len = getline(&line, &line_len, f)) <= 0)
+		goto out;
+	line[len - 1] = '\0';
+	if (strcmp(line, test_root))
+		goto out;
+
+	while (getline(&line, &line_len, f) > 0) {
+		struct cache_entry *entry;
+		char binary[PATH_MAX], build_id[2 * MAX_BUILD_ID + 1];
+		struct binary_id id;
+		int exitcode;
+		size_t i, size;
+
+		if (sscanf(line, "%4095s %" SCNd64 " %" SCNd64 " %128s %d %zu",
+			   binary, &id.size, &id.mtime_ns, build_id,
+			   &exitcode, &size) != 6)
+			break;
+
+		strcpy(id.build_id, build_id);
+		entry = new_entry(cache, binary);
+		entry->id = id;
+		entry->exitcode = exitcode;
+		entry->subtests = calloc(size, sizeof(*entry->subtests));
+
+		for (i = 0; i < size; i++) {
+			if ((len = getline(&line, &line_len, f)) <= 0)
+				break;
+			line[len - 1] = '\0';
+			entry->subtests[entry->size++] = strdup(line);
+		}
+
+		if (entry->size != size) {
+			/* Truncated entry, let the binary be relisted */
+			free_cache_entry(entry);
+			*entry = cache->entries[--cache->size];
+			break;
+		}
+	}
+
+out:
+	free(line);
+	fclose(f);
+}
+
+static void write_cache(struct subtest_cache *cache, const char *test_root)
+{
+	char *tmp = NULL;
+	size_t i, k;
+	FILE *f;
+	int fd;
+
+	if (asprintf(&tmp, "%s.XXXXXX", cache->path) < 0)
+		return;
+
+	fd = mkstemp(tmp);
+	if (fd < 0 || !(f = fdopen(fd, "w"))) {
+		if (fd >= 0) {
+			close(fd);
+			unlink(tmp);
+		}
+		free(tmp);
+		return;
+	}
+
+	fprintf(f, "%s\n%s\n", CACHE_MAGIC, test_root);
+	for (i = 0; i < cache->size; i++) {
+		struct cache_entry *entry = &cache->entries[i];
+
+		fprintf(f, "%s %" PRId64 " %" PRId64 " %s %d %zu\n",
+			entry->binary, entry->id.size, entry->id.mtime_ns,
+			entry->id.build_id, entry->exitcode, entry->size);
+		for (k = 0; k < entry->size; k++)
+			fprintf(f, "%s\n", entry->subtests[k]);
+	}
+
+	fchmod(fd, 0644);
+	if (fclose(f) || rename(tmp, cache->path))
+		unlink(tmp);
+
+	free(tmp);
+}
+
+struct listing {
+	struct subtest_list *list;
+	pid_t pid;
+	int fd;
+};
+
+static bool spawn_listing(struct settings *settings, struct listing *listing)
+{
+	char path[PATH_MAX];
+	int pipefd[2];
+
+	listing->pid = -1;
+	listing->fd = -1;
+
+	if (snprintf(path, sizeof(path), "%s/%s",
+		     settings->test_root, listing->list->binary) >= sizeof(path)) {
+		fprintf(stderr, "Path to binary too long, ignoring: %s/%s\n",
+			settings->test_root, listing->list->binary);
+		return false;
+	}
+
+	/*
+	 * Close-on-exec so that the other listings running in
+	 * parallel don't hold our write end open.
+	 */
+	if (pipe2(pipefd, O_CLOEXEC)) {
+		fprintf(stderr, "pipe failed when executing %s: %s\n",
+			path, strerror(errno));
+		return false;
+	}
+
+	fflush(stdout);
+	fflush(stderr);
+
+	listing->pid = fork();
+	if (listing->pid < 0) {
+		fprintf(stderr, "fork failed when executing %s: %s\n",
+			path, strerror(errno));
+		close(pipefd[0]);
+		close(pipefd[1]);
+		return false;
+	} else if (listing->pid == 0) {
+		dup2(pipefd[1], STDOUT_FILENO);
+		execl(path, path, "--list-subtests", (char *)NULL);
+		fprintf(stderr, "Cannot execute %s: %s\n", path, strerror(errno));
+		_exit(127);
+	}
+
+	close(pipefd[1]);
+	listing->fd = pipefd[0];
+
+	return true;
+}
+
+static void finish_listing(struct listing *listing)
+{
+	struct subtest_list *list = listing->list;
+	char *subtestname;
+	FILE *f;
+	int status;
+
+	list->exitcode = -1;
+
+	if (listing->pid < 0)
+		return;
+
+	f = fdopen(listing->fd, "r");
+	while (fscanf(f, "%ms", &subtestname) == 1) {
+		list->size++;
+		list->subtests = realloc(list->subtests,
+					 list->size * sizeof(*list->subtests));
+		list->subtests[list->size - 1] = subtestname;
+	}
+	fclose(f);
+
+	while (waitpid(listing->pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			fprintf(stderr, "waitpid error when executing %s: %s\n",
+				list->binary, strerror(errno));
+			return;
+		}
+	}
+
+	if (WIFEXITED(status))
+		list->exitcode = WEXITSTATUS(status);
+	else
+		fprintf(stderr, "Test binary %s died unexpectedly\n", list->binary);
+}
+
+static void run_listings(struct settings *settings, struct subtest_list **lists,
+			 const size_t *indices, size_t count)
+{
+	struct listing *listings;
+	long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t started = 0, window, i;
+
+	if (!count)
+		return;
+
+	listings = calloc(count, sizeof(*listings));
+
+	/*
+	 * Most of a listing is spent in the dynamic loader and
+	 * igt_core setup waiting on the filesystem, so run a couple
+	 * per cpu ahead of the one we are reading from. Output is
+	 * collected in order; a listing whose pipe fills up just
+	 * waits for its turn.
+	 */
+	window = ncpus > 2 ? 2 * ncpus : 4;
+	for (i = 0; i < count; i++) {
+		while (started < count && started < i + window) {
+			listings[started].list = lists[indices[started]];
+			spawn_listing(settings, &listings[started]);
+			started++;
+		}
+
+		finish_listing(&listings[i]);
+	}
+
+	free(listings);
+}
+
+static void copy_entry(struct subtest_list *list, const struct cache_entry *entry)
+{
+	size_t i;
+
+	list->exitcode = entry->exitcode;
+	list->size = entry->size;
+	list->subtests = calloc(entry->size, sizeof(*list->subtests));
+	for (i = 0; i < entry->size; i++)
+		list->subtests[i] = strdup(entry->subtests[i]);
+}
+
+static void update_entry(struct subtest_cache *cache,
+			 const struct subtest_list *list,
+			 const struct binary_id *id)
+{
+	struct cache_entry *entry;
+	size_t i;
+
+	/* Failures might be transient, don't remember them */
+	if (list->exitcode != 0 && list->exitcode != IGT_EXIT_INVALID)
+		return;
+
+	entry = new_entry(cache, list->binary);
+	entry->id = *id;
+	entry->exitcode = list->exitcode;
+	entry->size = list->size;
+	entry->subtests = calloc(list->size, sizeof(*entry->subtests));
+	for (i = 0; i < list->size; i++)
+		entry->subtests[i] = strdup(list->subtests[i]);
+
+	cache->dirty = true;
+}
+
+void fill_subtest_lists(struct settings *settings,
+			struct subtest_list **lists, size_t count)
+{
+	struct subtest_cache cache = {};
+	struct binary_id *ids;
+	size_t *misses;
+	bool *identified;
+	size_t nmisses = 0, i;
+
+	if (!count)
+		return;
+
+	misses = calloc(count, sizeof(*misses));
+	ids = calloc(count, sizeof(*ids));
+	identified = calloc(count, sizeof(*identified));
+
+	cache.path = cache_path(settings);
+	if (cache.path)
+		read_cache(&cache, settings->test_root);
+
+	for (i = 0; i < count; i++) {
+		struct cache_entry *entry;
+
+		identified[i] = identify_binary(settings->test_root,
+						lists[i]->binary, &ids[i]);
+
+		entry = find_entry(&cache, lists[i]->binary);
+		if (identified[i] && entry && same_binary(&entry->id, &ids[i]))
+			copy_entry(lists[i], entry);
+		else
+			misses[nmisses++] = i;
+	}
+
+	run_listings(settings, lists, misses, nmisses);
+
+	for (i = 0; cache.path && i < nmisses; i++) {
+		size_t idx = misses[i];
+		struct binary_id id;
+
+		/*
+		 * Only remember the listing if the binary didn't
+		 * change while it was running.
+		 */
+		if (identified[idx] &&
+		    identify_binary(settings->test_root, lists[idx]->binary, &id) &&
+		    same_binary(&id, &ids[idx]))
+			update_entry(&cache, lists[idx], &ids[idx]);
+	}
+
+	if (cache.dirty)
+		write_cache(&cache, settings->test_root);
+
+	free_cache(&cache);
+	free(identified);
+	free(ids);
+	free(misses);
+}
+
+void free_subtest_lists(struct subtest_list *lists, size_t count)
+{
+	size_t i, k;
+
+	for (i = 0; i < count; i++) {
+		for (k = 0; k < lists[i].size; k++)
+			free(lists[i].subtests[k]);
+		free(lists[i].subtests);
+		free(lists[i].binary);
+	}
+}
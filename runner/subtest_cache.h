@@ -0,0 +1,57 @@
+#ifndef RUNNER_SUBTEST_CACHE_H
+#define RUNNER_SUBTEST_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "settings.h"
+
+#define SUBTEST_CACHE_FILENAME ".igt-subtest-cache.txt"
+
+struct subtest_list {
+	char *binary;
+	/*
+	 * Exit code of '<binary> --list-subtests'. 0 if the binary
+	 * listed its subtests, IGT_EXIT_INVALID if it has none, or -1
+	 * if the binary could not be executed or died.
+	 */
+	int exitcode;
+	char **subtests;
+	size_t size;
+};
+
+/**
+ * fill_subtest_lists:
+ *
+ * Fills each list with the subtests of the binary named in its
+ * binary field, relative to settings->test_root. Results are taken
+ * from the subtest cache when the binary's size, mtime and build id
+ * still match what was recorded. The remaining binaries are executed
+ * with --list-subtests in parallel and the cache is updated with
+ * their output.
+ *
+ * The cache is stored in $XDG_CACHE_HOME/igt-gpu-tools (~/.cache if
+ * unset), one file per test root, and as SUBTEST_CACHE_FILENAME in an
+ * existing results directory if that isn't writable. The environment
+ * variable IGT_RUNNER_SUBTEST_CACHE overrides the cache location;
+ * setting it to an empty string disables caching.
+ *
+ * @settings: Settings providing test_root and results_path.
+ * @lists: Array of pointers to lists with binary set and the rest
+ * zeroed.
+ * @count: Number of elements in @lists.
+ */
+void fill_subtest_lists(struct settings *settings,
+			struct subtest_list **lists, size_t count);
+
+/**
+ * free_subtest_lists:
+ *
+ * Releases the subtest names and binary names of all lists.
+ *
+ * @lists: Array of lists filled with #fill_subtest_lists.
+ * @count: Number of elements in @lists.
+ */
+void free_subtest_lists(struct subtest_list *lists, size_t count);
+
+#endif
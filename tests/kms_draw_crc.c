@@ -253,6 +253,40 @@ static void fill_fb_subtest(void)
 	igt_remove_fb(drm_fd, &fb);
 }
 
+static void fb_pool_disable_subtest(void)
+{
+	struct igt_fb fb;
+	igt_crc_t base_crc, crc;
+	cairo_t *cr;
+	int rc;
+
+	get_fill_crc(LOCAL_DRM_FORMAT_MOD_NONE, &base_crc);
+
+	/* Map the framebuffer while its storage belongs to the pool */
+	igt_fb_pool_enable(drm_fd, 0);
+	igt_create_fb(drm_fd, ms.mode->hdisplay, ms.mode->vdisplay,
+		      DRM_FORMAT_XRGB8888, LOCAL_DRM_FORMAT_MOD_NONE, &fb);
+	cr = igt_get_cairo_ctx(drm_fd, &fb);
+	igt_paint_color(cr, 0, 0, fb.width, fb.height, 1.0, 0.0, 0.0);
+	igt_put_cairo_ctx(cr);
+
+	igt_fb_pool_disable(drm_fd);
+
+	/* The framebuffer and its mapping must outlive the pool */
+	cr = igt_get_cairo_ctx(drm_fd, &fb);
+	igt_paint_color(cr, 0, 0, fb.width, fb.height, 0.0, 0.0, 1.0);
+	igt_put_cairo_ctx(cr);
+
+	rc = drmModeSetCrtc(drm_fd, ms.crtc_id, fb.fb_id, 0, 0,
+			    &ms.connector_id, 1, ms.mode);
+	igt_assert_eq(rc, 0);
+
+	igt_pipe_crc_collect_crc(pipe_crc, &crc);
+	igt_assert_crc_equal(&crc, &base_crc);
+
+	igt_remove_fb(drm_fd, &fb);
+}
+
 static void setup_environment(void)
 {
 	int i;
@@ -342,6 +376,9 @@ igt_main
 	igt_subtest("fill-fb")
 		fill_fb_subtest();
 
+	igt_subtest("fb-pool-disable")
+		fb_pool_disable_subtest();
+
 	igt_fixture
 		teardown_environment();
 }
@@ -30,6 +30,7 @@
 #include "igt.h"
 #include "igt_core.h"
 #include "igt_fb.h"
+#include "igt_wb_capture.h"
 #include "sw_sync.h"
 
 IGT_TEST_DESCRIPTION(
@@ -337,6 +338,54 @@ static void writeback_check_output(igt_output_t *output, igt_plane_t *plane,
 	igt_remove_fb(output_fb->fd, &second_out_fb);
 }
 
+static void writeback_capture_stream(igt_output_t *output, igt_plane_t *plane,
+				     drmModeModeInfo *mode, int n_frames)
+{
+	uint32_t colors[2] = { 0xffff0000, 0xff0000ff };
+	igt_fb_t in_fbs[2];
+	igt_crc_t expected[2], *crcs;
+	igt_wb_capture_t *wb;
+	int i, n;
+
+	for (i = 0; i < ARRAY_SIZE(in_fbs); i++) {
+		igt_create_fb(output->display->drm_fd,
+			      mode->hdisplay, mode->vdisplay,
+			      DRM_FORMAT_XRGB8888, DRM_FORMAT_MOD_LINEAR,
+			      &in_fbs[i]);
+		fill_fb(&in_fbs[i], colors[i]);
+		igt_fb_get_fnv1a_crc(&in_fbs[i], &expected[i]);
+	}
+	igt_assert(!igt_check_crc_equal(&expected[0], &expected[1]));
+
+	wb = igt_wb_capture_new(output, mode->hdisplay, mode->vdisplay,
+				DRM_FORMAT_XRGB8888, 4);
+
+	/*
+	 * Alternate between two input framebuffers rather than refilling
+	 * one, as earlier frames may still be in flight.
+	 */
+	for (i = 0; i < n_frames; i++) {
+		igt_plane_set_fb(plane, &in_fbs[i % 2]);
+		igt_wb_capture_queue(wb);
+		igt_display_commit_atomic(output->display,
+					  DRM_MODE_ATOMIC_ALLOW_MODESET, NULL);
+		igt_wb_capture_submit(wb);
+	}
+
+	n = igt_wb_capture_get_crcs(wb, n_frames, &crcs);
+	for (i = 0; i < n; i++) {
+		igt_assert_eq(crcs[i].frame, i);
+		igt_assert_crc_equal(&crcs[i], &expected[i % 2]);
+	}
+	free(crcs);
+
+	igt_wb_capture_free(wb);
+
+	igt_plane_set_fb(plane, NULL);
+	for (i = 0; i < ARRAY_SIZE(in_fbs); i++)
+		igt_remove_fb(output->display->drm_fd, &in_fbs[i]);
+}
+
 igt_main
 {
 	igt_display_t display;
@@ -443,6 +492,13 @@ igt_main
 		igt_remove_fb(display.drm_fd, &output_fb);
 	}
 
+	igt_describe("Stream frames through a ring of writeback buffers and "
+		     "check each one with a software CRC");
+	igt_subtest("writeback-capture-stream") {
+		writeback_capture_stream(output, plane, &mode, 64);
+		igt_plane_set_fb(plane, &input_fb);
+	}
+
 	igt_fixture {
 		igt_remove_fb(display.drm_fd, &input_fb);
 		igt_display_fini(&display);
@@ -22,6 +22,7 @@
  */
 #include "config.h"
 #include "igt.h"
+#include "i915/perf_data.h"
 #include <stdio.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -29,6 +30,9 @@
 #include <libgen.h>
 #include <unistd.h>
 #include <linux/limits.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #define TOOLS "../tools/"
 
@@ -53,6 +57,43 @@ static bool check_cmd_output(const char *line, void *data)
 	return false;
 }
 
+struct metric_check {
+	const char *name;
+	double value;
+};
+
+/* Prometheus sample of metric_check::name, its value is the line's tail. */
+static bool check_metric_output(const char *line, void *data)
+{
+	struct metric_check *check = data;
+	size_t len = strlen(check->name);
+
+	if (!strncmp(line, check->name, len) && line[len] == ' ')
+		check->value = strtod(line + len + 1, NULL);
+
+	return false;
+}
+
+/* The value following the first occurrence of key in buf. */
+static double value_after(const char *buf, const char *key)
+{
+	const char *s = strstr(buf, key);
+
+	igt_assert_f(s, "%s missing\n", key);
+
+	return strtod(s + strlen(key), NULL);
+}
+
+/*
+ * The fake amdgpu reports 42% in gpu_busy_percent. The busy time derived
+ * from it is rounded to whole nanoseconds, so only close to that.
+ */
+static void assert_gpu_busy(const char *what, double value)
+{
+	igt_assert_f(fabs(value - 42.0) < 0.01,
+		     "%s gpu busy %f, expected 42\n", what, value);
+}
+
 static void assert_cmd_success(int exec_return)
 {
 	igt_skip_on_f(exec_return == IGT_EXIT_SKIP,
@@ -92,6 +133,235 @@ static bool chdir_to_tools_dir(void)
 	return chdir(TOOLS) == 0 || chdir("../../bin") == 0;
 }
 
+/* An amdgpu device with one DRM client, as seen through sysfs and procfs. */
+static void make_fake_amdgpu(const char *root)
+{
+	const char *dev = "sys/bus/pci/devices/0000:03:00.0";
+
+	igt_make_symlink("../../../../bus/pci/drivers/amdgpu",
+			 "%s/%s/driver", root, dev);
+	igt_write_file("42\n", "%s/%s/gpu_busy_percent", root, dev);
+	igt_write_file("15000000\n", "%s/%s/hwmon/hwmon0/power1_average",
+		       root, dev);
+	igt_write_file("1200000000\n", "%s/%s/hwmon/hwmon0/freq1_input",
+		       root, dev);
+
+	igt_make_symlink("/dev/dri/renderD128", "%s/proc/1234/fd/3", root);
+	igt_write_file("pos:\t0\n"
+		       "drm-driver:\tamdgpu\n"
+		       "drm-pdev:\t0000:03:00.0\n"
+		       "drm-client-id:\t5\n"
+		       "drm-engine-gfx:\t123456 ns\n"
+		       "drm-engine-vpe:\t0 ns\n",
+		       "%s/proc/1234/fdinfo/3", root);
+}
+
+struct idle_snapshot {
+	uint64_t time_ns;
+	uint64_t tsc;
+	uint64_t pc6;
+	uint64_t cc6;
+	uint64_t rc6_ms;
+	uint64_t energy_uj;
+};
+
+/*
+ * One sample of intel_idle_residency -R: a single CPU with its MSRs, 8 bytes
+ * per MSR address in a regular file, and its cpuidle states, GPU RC6 and a
+ * RAPL package zone.
+ */
+static void make_idle_snapshot(const char *dir, int i,
+			       const struct idle_snapshot *snap)
+{
+	const struct {
+		uint32_t addr;
+		uint64_t value;
+	} msrs[] = {
+		{ 0x10, snap->tsc },
+		{ 0x3f9, snap->pc6 },
+		{ 0x3fd, snap->cc6 },
+	};
+	const char *cpu = "sys/devices/system/cpu/cpu0";
+	const char *rapl = "sys/class/powercap/intel-rapl:0";
+	char root[PATH_MAX], path[PATH_MAX], buf[32];
+	int fd;
+
+	snprintf(root, sizeof(root), "%s/%d", dir, i);
+	igt_make_dirs("%s/dev/cpu/0", root);
+	igt_make_dirs("%s/%s/cpuidle/state0", root, cpu);
+	igt_make_dirs("%s/%s/cpuidle/state1", root, cpu);
+
+	snprintf(buf, sizeof(buf), "%"PRIu64"\n", snap->time_ns);
+	igt_write_file(buf, "%s/time_ns", root);
+
+	snprintf(path, sizeof(path), "%s/dev/cpu/0/msr", root);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	igt_assert(fd >= 0);
+	for (int j = 0; j < ARRAY_SIZE(msrs); j++)
+		igt_assert_eq(pwrite(fd, &msrs[j].value, sizeof(msrs[j].value),
+				     msrs[j].addr * sizeof(msrs[j].value)),
+			      sizeof(msrs[j].value));
+	close(fd);
+
+	igt_write_file("POLL\n", "%s/%s/cpuidle/state0/name", root, cpu);
+	igt_write_file("0\n", "%s/%s/cpuidle/state0/time", root, cpu);
+	igt_write_file("C6\n", "%s/%s/cpuidle/state1/name", root, cpu);
+	snprintf(buf, sizeof(buf), "%"PRIu64"\n", snap->cc6 / 1000);
+	igt_write_file(buf, "%s/%s/cpuidle/state1/time", root, cpu);
+
+	snprintf(buf, sizeof(buf), "%"PRIu64"\n", snap->rc6_ms);
+	igt_write_file(buf, "%s/sys/class/drm/card0/gt/gt0/rc6_residency_ms",
+		       root);
+
+	igt_write_file("package-0\n", "%s/%s/name", root, rapl);
+	snprintf(buf, sizeof(buf), "%"PRIu64"\n", snap->energy_uj);
+	igt_write_file(buf, "%s/%s/energy_uj", root, rapl);
+	igt_write_file("262143328850\n", "%s/%s/max_energy_range_uj",
+		       root, rapl);
+}
+
+static void write_record(int fd, uint32_t type, const void *data, size_t size)
+{
+	struct drm_i915_perf_record_header header = {
+		.type = type,
+		.size = sizeof(header) + size,
+	};
+
+	igt_assert_eq(write(fd, &header, sizeof(header)), sizeof(header));
+	igt_assert_eq(write(fd, data, size), size);
+}
+
+/*
+ * An i915-perf-recorder file of RenderBasic on a Tigerlake GT2 with 96 EUs,
+ * one report every 10ms for a second. The counters advance at a constant
+ * rate: EUs 50% active and 10% stalled, sampler 30% busy, 1GiB/s GTI reads
+ * and 256MiB/s writes.
+ */
+static void make_oa_recording(const char *path)
+{
+	const uint64_t freq = 19200000, ticks = freq / 100;
+	const uint32_t clocks = 15000000, eus = 96;
+	struct intel_perf_record_version version = {
+		.version = INTEL_PERF_RECORD_VERSION,
+	};
+	struct intel_perf_record_device_info info = {
+		.timestamp_frequency = freq,
+		.device_id = 0x9a49,
+		.gt_min_frequency = 300,
+		.gt_max_frequency = 1300,
+		.oa_format = I915_OA_FORMAT_A32u40_A4u32_B8_C8,
+		.metric_set_name = "RenderBasic",
+		.metric_set_uuid = "0fc397c0-4833-492c-9ccd-4929d574d5b8",
+	};
+	struct {
+		struct drm_i915_query_topology_info topology;
+		uint8_t data[16];
+	} topology = {
+		.topology = {
+			.max_slices = 1,
+			.max_subslices = 6,
+			.max_eus_per_subslice = 16,
+			.subslice_offset = 1,
+			.subslice_stride = 1,
+			.eu_offset = 2,
+			.eu_stride = 2,
+		},
+		.data = { 0x1, 0x3f,
+			  0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+			  0xff, 0xff, 0xff, 0xff, 0xff, 0xff },
+	};
+	struct intel_perf_record_timestamp_correlation corr = {
+		.cpu_timestamp = 1000000000ull,
+		.gpu_timestamp = 1ull << 32,
+	};
+	uint64_t a_counters[32] = {};
+	uint32_t report[64] = {};
+	int fd, i;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	igt_assert(fd >= 0);
+
+	write_record(fd, INTEL_PERF_RECORD_TYPE_VERSION,
+		     &version, sizeof(version));
+	write_record(fd, INTEL_PERF_RECORD_TYPE_DEVICE_INFO,
+		     &info, sizeof(info));
+	write_record(fd, INTEL_PERF_RECORD_TYPE_DEVICE_TOPOLOGY,
+		     &topology, sizeof(topology));
+	write_record(fd, INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+		     &corr, sizeof(corr));
+	corr.cpu_timestamp += 1000000000ull;
+	corr.gpu_timestamp += 100 * ticks;
+	write_record(fd, INTEL_PERF_RECORD_TYPE_TIMESTAMP_CORRELATION,
+		     &corr, sizeof(corr));
+
+	report[0] = 1 << 19;
+	report[2] = 0x10;
+	for (i = 0; i <= 100; i++) {
+		/* A0-A31 are 40 bits, the high bytes follow A35. */
+		for (int a = 0; a < 32; a++) {
+			report[4 + a] = a_counters[a];
+			((uint8_t *)(report + 40))[a] = a_counters[a] >> 32;
+		}
+		write_record(fd, DRM_I915_PERF_RECORD_SAMPLE,
+			     report, sizeof(report));
+
+		report[1] += ticks;
+		report[3] += clocks;
+		/* A7-A10 count active EU cycles, A11-A14 stalled ones. */
+		for (int a = 7; a <= 10; a++)
+			a_counters[a] += (uint64_t)eus * clocks / 2 / 4;
+		for (int a = 11; a <= 14; a++)
+			a_counters[a] += (uint64_t)eus * clocks / 10 / 4;
+		/* B0 is sampler busy, C0-C1 GTI writes, C2-C5 reads, in 64B. */
+		report[48] += clocks * 3 / 10;
+		report[56] += (256 << 20) / 100 / 64 / 2;
+		report[57] += (256 << 20) / 100 / 64 / 2;
+		for (int c = 2; c <= 5; c++)
+			report[56 + c] += (1 << 30) / 100 / 64 / 4;
+	}
+
+	close(fd);
+}
+
+static int bind_unix(const char *root, const char *name, int type)
+{
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+	int fd;
+
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/%s", root, name);
+
+	fd = socket(AF_UNIX, type | SOCK_NONBLOCK, 0);
+	igt_assert(fd >= 0);
+	igt_assert_eq(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+	if (type == SOCK_STREAM)
+		igt_assert_eq(listen(fd, 1), 0);
+
+	return fd;
+}
+
+/* Returns the number of packets, the payload of all is in buf. */
+static int recv_all(int fd, char *buf, size_t size, int *max_lines)
+{
+	size_t len = 0;
+	int packets = 0;
+	ssize_t ret;
+
+	*max_lines = 0;
+	while ((ret = recv(fd, buf + len, size - len - 1, 0)) > 0) {
+		int lines = 0;
+
+		for (ssize_t i = 0; i < ret; i++)
+			lines += buf[len + i] == '\n';
+		*max_lines = max(*max_lines, lines);
+
+		len += ret;
+		packets++;
+	}
+	buf[len] = '\0';
+
+	return packets;
+}
+
 igt_main
 {
 	igt_fixture {
@@ -160,6 +430,200 @@ igt_main
 		igt_assert_eq(line.found, 1);
 	}
 
+	igt_subtest("intel_gpu_top_fdinfo") {
+		char root[] = "/tmp/igt_gpu_top.XXXXXX";
+		const char *metrics[] = {
+			"intel_gpu_top_gfx_busy",
+			"intel_gpu_top_vpe_busy",
+			"intel_gpu_top_gpu_busy",
+			"intel_gpu_top_power_gpu",
+			"intel_gpu_top_frequency_actual",
+		};
+		struct metric_check busy = {
+			.name = "intel_gpu_top_gpu_busy",
+			.value = -1,
+		};
+		int exec_return;
+
+		igt_require(access("intel_gpu_top", X_OK) == 0);
+		igt_assert(mkdtemp(root));
+		make_fake_amdgpu(root);
+
+		igt_system_cmd(exec_return,
+			       "./intel_gpu_top -r %s -d 0000:03:00.0 -p -s 100",
+			       root);
+		igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
+
+		for (int i = 0; i < ARRAY_SIZE(metrics); i++) {
+			struct line_check line = { .substr = metrics[i] };
+
+			igt_log_buffer_inspect(check_cmd_output, &line);
+			igt_assert_f(line.found, "%s missing\n", metrics[i]);
+		}
+
+		igt_log_buffer_inspect(check_metric_output, &busy);
+		assert_gpu_busy("prometheus", busy.value);
+
+		igt_system_cmd(exec_return, "rm -rf %s", root);
+	}
+
+	igt_subtest("intel_gpu_top_oa_replay") {
+		char root[] = "/tmp/igt_gpu_top.XXXXXX";
+		struct metric_check metrics[] = {
+			{ "intel_gpu_top_eu_active", 50.0 },
+			{ "intel_gpu_top_eu_stall", 10.0 },
+			{ "intel_gpu_top_sampler_busy", 30.0 },
+			{ "intel_gpu_top_gti_bandwidth_reads", 1024.0 },
+			{ "intel_gpu_top_gti_bandwidth_writes", 256.0 },
+		};
+		char path[PATH_MAX];
+		int exec_return;
+
+		igt_require(access("intel_gpu_top", X_OK) == 0);
+		igt_assert(mkdtemp(root));
+		make_fake_amdgpu(root);
+		snprintf(path, sizeof(path), "%s/oa.data", root);
+		make_oa_recording(path);
+
+		igt_system_cmd(exec_return,
+			       "./intel_gpu_top -r %s -d 0000:03:00.0 -R %s -p -s 100",
+			       root, path);
+		igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
+
+		for (int i = 0; i < ARRAY_SIZE(metrics); i++) {
+			struct metric_check check = { .name = metrics[i].name,
+						      .value = -1 };
+
+			igt_log_buffer_inspect(check_metric_output, &check);
+			igt_assert_f(fabs(check.value - metrics[i].value) < 0.1,
+				     "%s %f, expected %f\n", metrics[i].name,
+				     check.value, metrics[i].value);
+		}
+
+		igt_system_cmd(exec_return, "rm -rf %s", root);
+	}
+
+	igt_subtest("intel_gpu_top_push") {
+		char root[] = "/tmp/igt_gpu_top.XXXXXX";
+		struct sockaddr_in addr = {
+			.sin_family = AF_INET,
+			.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+		};
+		socklen_t addrlen = sizeof(addr);
+		int udp, unixgram, stream, conn;
+		int exec_return, lines;
+		static char buf[256 << 10];
+		char *path;
+		FILE *f;
+
+		igt_require(access("intel_gpu_top", X_OK) == 0);
+		igt_assert(mkdtemp(root));
+		make_fake_amdgpu(root);
+
+		udp = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+		igt_assert(udp >= 0);
+		igt_assert_eq(bind(udp, (struct sockaddr *)&addr, addrlen), 0);
+		igt_assert_eq(getsockname(udp, (struct sockaddr *)&addr,
+					  &addrlen), 0);
+		unixgram = bind_unix(root, "statsd.sock", SOCK_DGRAM);
+		stream = bind_unix(root, "influx.sock", SOCK_STREAM);
+
+		/* Samples past the first flush are coalesced into one packet. */
+		igt_system_cmd(exec_return,
+			       "./intel_gpu_top -r %s -d 0000:03:00.0 -s 10 -n 5 "
+			       "-P statsd:udp://127.0.0.1:%d "
+			       "-P statsd:unixgram://%s/statsd.sock "
+			       "-P influx:unix://%s/influx.sock "
+			       "-P textfile:%s/gpu.prom",
+			       root, ntohs(addr.sin_port), root, root, root);
+		igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
+
+		igt_assert(recv_all(udp, buf, sizeof(buf), &lines) > 0);
+		assert_gpu_busy("statsd udp",
+				value_after(buf, "intel_gpu_top.gpu.busy:"));
+		igt_assert(strstr(buf, "intel_gpu_top.vpe.busy:"));
+		igt_assert(lines > 10);
+
+		igt_assert(recv_all(unixgram, buf, sizeof(buf), &lines) > 0);
+		assert_gpu_busy("statsd unixgram",
+				value_after(buf, "intel_gpu_top.gpu.busy:"));
+		igt_assert(lines > 10);
+
+		conn = accept(stream, NULL, NULL);
+		igt_assert(conn >= 0);
+		recv_all(conn, buf, sizeof(buf), &lines);
+		assert_gpu_busy("influx",
+				value_after(buf, "intel_gpu_top,device=0000:03:00.0,group=gpu busy="));
+		close(conn);
+
+		igt_assert(asprintf(&path, "%s/gpu.prom", root) > 0);
+		f = fopen(path, "r");
+		igt_assert(f);
+		buf[fread(buf, 1, sizeof(buf) - 1, f)] = '\0';
+		fclose(f);
+		free(path);
+		assert_gpu_busy("textfile",
+				value_after(buf, "intel_gpu_top_gpu_busy{device=\"0000:03:00.0\"} "));
+
+		close(udp);
+		close(unixgram);
+		close(stream);
+		igt_system_cmd(exec_return, "rm -rf %s", root);
+	}
+
+	igt_subtest("intel_idle_residency_replay") {
+		/*
+		 * Over one second the package spends 20% in PC6, the core 40%
+		 * in CC6 and the GPU 70% in RC6, so between 50% and 70% of the
+		 * time the GPU is in RC6 while the package is not deep.
+		 */
+		const struct idle_snapshot snap[] = {
+			{ 1000000000, 1000000000, 0, 0, 100, 1000000 },
+			{ 2000000000, 2000000000, 200000000, 400000000, 800, 6000000 },
+		};
+		const char *msr_lines[] = {
+			"Package deep: 20.0%",
+			"GPU RC6: 70.0%",
+			"GPU RC6 while package not deep: 50.0% - 70.0%, 56.0% if uncorrelated",
+			"Power package-0: 5.00W",
+		};
+		const char *cpuidle_lines[] = {
+			"Package deep: 40.0% (estimated from the CPUs)",
+			"GPU RC6 while package not deep: 30.0% - 60.0%, 42.0% if uncorrelated",
+		};
+		char dir[] = "/tmp/igt_idle_residency.XXXXXX";
+		int exec_return;
+
+		igt_require(access("intel_idle_residency", X_OK) == 0);
+		igt_assert(mkdtemp(dir));
+		for (int i = 0; i < ARRAY_SIZE(snap); i++)
+			make_idle_snapshot(dir, i, &snap[i]);
+
+		igt_system_cmd(exec_return, "./intel_idle_residency -R %s -q", dir);
+		igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
+
+		for (int i = 0; i < ARRAY_SIZE(msr_lines); i++) {
+			struct line_check line = { .substr = msr_lines[i] };
+
+			igt_log_buffer_inspect(check_cmd_output, &line);
+			igt_assert_f(line.found, "%s missing\n", msr_lines[i]);
+		}
+
+		/* Without the MSRs the package is only as deep as its CPUs. */
+		igt_system_cmd(exec_return, "./intel_idle_residency -R %s -q -C",
+			       dir);
+		igt_assert_eq(exec_return, IGT_EXIT_SUCCESS);
+
+		for (int i = 0; i < ARRAY_SIZE(cpuidle_lines); i++) {
+			struct line_check line = { .substr = cpuidle_lines[i] };
+
+			igt_log_buffer_inspect(check_cmd_output, &line);
+			igt_assert_f(line.found, "%s missing\n", cpuidle_lines[i]);
+		}
+
+		igt_system_cmd(exec_return, "rm -rf %s", dir);
+	}
+
 	igt_subtest("tools_test") {
 		igt_require(access("intel_reg", X_OK) == 0);
 
@@ -35,6 +35,9 @@
 #include <unistd.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <time.h>
+
+#include "igt_dpcd.h"
 
 #define MAX_DP_OFFSET	0xfffff
 #define DRM_AUX_MINORS	256
@@ -56,8 +59,14 @@ struct dpcd_data {
 		DUMP,
 		READ,
 		WRITE,
+		SNAPSHOT,
+		DIFF,
+		WATCH,
 	} cmd;
 	uint8_t val;
+	const char *files[2];
+	int num_files;
+	long interval;
 };
 
 static const struct dpcd_block dump_list[] = {
@@ -90,12 +99,17 @@ static void print_usage(void)
 	printf("Usage: dpcd_reg [OPTION ...] COMMAND\n\n");
 	printf("COMMAND is one of:\n");
 	printf("  read:		Read [count] bytes dpcd reg at an offset\n");
-	printf("  write:	Write a dpcd reg at an offset\n\n");
+	printf("  write:	Write a dpcd reg at an offset\n");
+	printf("  snapshot:	Read and decode all the standard registers\n");
+	printf("  diff:		Compare a saved snapshot with the registers, or two saved snapshots\n");
+	printf("  watch:	Show the changes of the link status and IRQ registers\n\n");
 	printf("Options for the above COMMANDS are\n");
 	printf(" --device=DEVID		Aux device id, as listed in /dev/drm_dp_aux_dev[n]. Defaults to 0. Upper limit - 256\n");
 	printf(" --offset=REG_ADDR	DPCD register offset in hex. Defaults to 0x0. Upper limit - 0xfffff\n");
 	printf(" --count=BYTES		For reads, specify number of bytes to be read from the offset. Defaults to 1\n");
-	printf(" --value		For writes, specify a hex value to be written. Upper limit - 0xff\n\n");
+	printf(" --value		For writes, specify a hex value to be written. Upper limit - 0xff\n");
+	printf(" --file=PATH		For snapshots, save to a file. For diffs, the saved snapshot, twice for two\n");
+	printf(" --interval=MS		For watch, milliseconds between reads. Defaults to 100\n\n");
 
 	printf(" --help: print the usage\n");
 }
@@ -118,13 +132,15 @@ static int parse_opts(struct dpcd_data *dpcd, int argc, char **argv)
 	struct option longopts[] = {
 		{ "count",	required_argument,	NULL,		'c' },
 		{ "device",	required_argument,	NULL,		'd' },
+		{ "file",	required_argument,	NULL,		'f' },
+		{ "interval",	required_argument,	NULL,		'i' },
 		{ "help",	no_argument,		NULL,		'h' },
 		{ "offset",	required_argument,	NULL,		'o' },
 		{ "value",	required_argument,	NULL,		'v' },
 		{ 0 }
 	};
 
-	while ((ret = getopt_long(argc, argv, "-:c:d:ho:v:", longopts, NULL)) != -1) {
+	while ((ret = getopt_long(argc, argv, "-:c:d:f:hi:o:v:", longopts, NULL)) != -1) {
 		switch (ret) {
 		case 'c':
 			temp = strtol(optarg, &endptr, 10);
@@ -147,6 +163,24 @@ static int parse_opts(struct dpcd_data *dpcd, int argc, char **argv)
 			}
 			dpcd->devid = temp;
 			break;
+		case 'f':
+			if (dpcd->num_files == 2) {
+				fprintf(stderr, "Too many --file arguments\n");
+				print_usage();
+				return EXIT_FAILURE;
+			}
+			dpcd->files[dpcd->num_files++] = optarg;
+			break;
+		case 'i':
+			temp = strtol(optarg, &endptr, 10);
+			if (strtol_err_util(endptr, &temp) || !temp) {
+				fprintf(stderr,
+					"--interval argument is invalid/negative/out-of-range\n");
+				print_usage();
+				return ERANGE;
+			}
+			dpcd->interval = temp;
+			break;
 		case 'h':
 			printf("DPCD register read and write tool\n\n");
 			printf("This tool requires CONFIG_DRM_DP_AUX_CHARDEV\n"
@@ -182,6 +216,12 @@ static int parse_opts(struct dpcd_data *dpcd, int argc, char **argv)
 			} else if (strcmp(optarg, "write") == 0) {
 				dpcd->cmd = WRITE;
 				dpcd->file_op = O_WRONLY;
+			} else if (strcmp(optarg, "snapshot") == 0) {
+				dpcd->cmd = SNAPSHOT;
+			} else if (strcmp(optarg, "diff") == 0) {
+				dpcd->cmd = DIFF;
+			} else if (strcmp(optarg, "watch") == 0) {
+				dpcd->cmd = WATCH;
 			} else if (strcmp(optarg, "dump") != 0) {
 				fprintf(stderr, "Unrecognized command\n");
 				print_usage();
@@ -211,6 +251,12 @@ static int parse_opts(struct dpcd_data *dpcd, int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	if ((dpcd->cmd == DIFF) && !dpcd->num_files) {
+		fprintf(stderr, "Snapshot to compare with is missing\n");
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
 	return EXIT_SUCCESS;
 }
 
@@ -280,6 +326,169 @@ static int dpcd_dump(int fd)
 	return ret;
 }
 
+static void print_snapshot(const struct igt_dpcd_snapshot *snap)
+{
+	char buf[512];
+	int i, j;
+
+	for (i = 0; i < snap->num_chunks; i++) {
+		const struct igt_dpcd_chunk *chunk = &snap->chunks[i];
+
+		if (!chunk->valid) {
+			printf("0x%04x: unreadable\n", chunk->offset);
+			continue;
+		}
+
+		printf("0x%04x: ", chunk->offset);
+		for (j = 0; j < chunk->len; j++)
+			printf(" %02x", chunk->data[j]);
+		printf("\n");
+
+		for (j = 0; j < chunk->len; j++) {
+			if (!igt_dpcd_reg_lookup(chunk->offset + j))
+				continue;
+
+			igt_dpcd_decode(chunk->offset + j, chunk->data[j],
+					buf, sizeof(buf));
+			printf("  %s\n", buf);
+		}
+	}
+}
+
+static void print_changes(const struct igt_dpcd_snapshot *old,
+			  const struct igt_dpcd_snapshot *new)
+{
+	struct igt_dpcd_change *changes;
+	char from[512], to[512];
+	unsigned int i, n;
+
+	n = igt_dpcd_snapshot_diff(old, new, &changes);
+	for (i = 0; i < n; i++) {
+		const struct igt_dpcd_change *c = &changes[i];
+
+		if (c->old_valid)
+			igt_dpcd_decode(c->offset, c->old, from, sizeof(from));
+		else
+			strcpy(from, "unreadable");
+		if (c->new_valid)
+			igt_dpcd_decode(c->offset, c->new, to, sizeof(to));
+		else
+			strcpy(to, "unreadable");
+
+		printf("0x%04x: %s -> %s\n", c->offset, from, to);
+	}
+	free(changes);
+}
+
+static int dpcd_snapshot(int fd, const char *file)
+{
+	struct igt_dpcd_snapshot snap;
+	int ret;
+
+	igt_dpcd_snapshot_init(&snap);
+	ret = igt_dpcd_snapshot_read(&snap, fd);
+	if (ret) {
+		fprintf(stderr, "Failed to read - %s\n", strerror(-ret));
+		goto out;
+	}
+
+	if (file) {
+		ret = igt_dpcd_snapshot_save(&snap, file);
+		if (ret)
+			fprintf(stderr, "Failed to save %s - %s\n",
+				file, strerror(-ret));
+	} else {
+		print_snapshot(&snap);
+	}
+
+out:
+	igt_dpcd_snapshot_fini(&snap);
+	return -ret;
+}
+
+static int load_snapshot(struct igt_dpcd_snapshot *snap, const char *file)
+{
+	int ret = igt_dpcd_snapshot_load(snap, file);
+
+	if (ret)
+		fprintf(stderr, "Failed to load %s - %s\n",
+			file, strerror(-ret));
+
+	return -ret;
+}
+
+static int dpcd_diff(int fd, const struct dpcd_data *dpcd)
+{
+	struct igt_dpcd_snapshot old, new;
+	int ret;
+
+	ret = load_snapshot(&old, dpcd->files[0]);
+	if (ret)
+		return ret;
+
+	if (dpcd->num_files == 2) {
+		ret = load_snapshot(&new, dpcd->files[1]);
+	} else {
+		igt_dpcd_snapshot_init(&new);
+		ret = -igt_dpcd_snapshot_read(&new, fd);
+		if (ret)
+			fprintf(stderr, "Failed to read - %s\n", strerror(ret));
+	}
+
+	if (!ret)
+		print_changes(&old, &new);
+
+	igt_dpcd_snapshot_fini(&new);
+	igt_dpcd_snapshot_fini(&old);
+	return ret;
+}
+
+/* Only the volatile registers are read again, until interrupted */
+static int dpcd_watch(int fd, long interval)
+{
+	struct igt_dpcd_snapshot snap, last;
+	struct timespec ts = {
+		.tv_sec = interval / 1000,
+		.tv_nsec = interval % 1000 * 1000000,
+	};
+	int ret;
+
+	igt_dpcd_snapshot_init(&snap);
+	ret = igt_dpcd_snapshot_read(&snap, fd);
+	if (ret) {
+		fprintf(stderr, "Failed to read - %s\n", strerror(-ret));
+		igt_dpcd_snapshot_fini(&snap);
+		return -ret;
+	}
+
+	igt_dpcd_snapshot_copy(&last, &snap);
+	for (;;) {
+		struct timespec now;
+
+		nanosleep(&ts, NULL);
+
+		ret = igt_dpcd_snapshot_refresh(&snap, fd);
+		if (ret < 0) {
+			fprintf(stderr, "Failed to read - %s\n", strerror(-ret));
+			break;
+		}
+		if (!ret)
+			continue;
+
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		printf("[%ld.%06ld]\n", (long)now.tv_sec, now.tv_nsec / 1000);
+		print_changes(&last, &snap);
+		fflush(stdout);
+
+		igt_dpcd_snapshot_fini(&last);
+		igt_dpcd_snapshot_copy(&last, &snap);
+	}
+
+	igt_dpcd_snapshot_fini(&last);
+	igt_dpcd_snapshot_fini(&snap);
+	return -ret;
+}
+
 int main(int argc, char **argv)
 {
 	char dev_name[20];
@@ -291,12 +500,17 @@ int main(int argc, char **argv)
 		.rw.offset = 0x0,
 		.rw.count = 1,
 		.cmd = DUMP,
+		.interval = 100,
 	};
 
 	ret = parse_opts(&dpcd, argc, argv);
 	if (ret != EXIT_SUCCESS)
 		return ret;
 
+	/* Two saved snapshots need no device */
+	if (dpcd.cmd == DIFF && dpcd.num_files == 2)
+		return dpcd_diff(-1, &dpcd);
+
 	snprintf(dev_name, strlen(aux_dev) + 4, "%s%d", aux_dev, dpcd.devid);
 
 	fd = open(dev_name, dpcd.file_op);
@@ -314,6 +528,15 @@ int main(int argc, char **argv)
 	case WRITE:
 		ret = dpcd_write(fd, dpcd.rw.offset, dpcd.val);
 		break;
+	case SNAPSHOT:
+		ret = dpcd_snapshot(fd, dpcd.files[0]);
+		break;
+	case DIFF:
+		ret = dpcd_diff(fd, &dpcd);
+		break;
+	case WATCH:
+		ret = dpcd_watch(fd, dpcd.interval);
+		break;
 	case DUMP:
 	default:
 		ret = dpcd_dump(fd);
@@ -53,7 +53,297 @@ usage(void)
 	       "     --help,    -h             Print this screen\n"
 	       "     --counters, -c c1,c2,...  List of counters to display values for.\n"
 	       "                               Use 'all' to display all counters.\n"
-	       "                               Use 'list' to list available counters.\n");
+	       "                               Use 'list' to list available counters.\n"
+	       "     --events,   -e            Print OA reports, PMU samples and requests\n"
+	       "                               as a single time ordered stream.\n"
+	       "     --contexts, -x            Print counters accumulated per context.\n"
+	       "     --bucket,   -b <ms>       With --contexts, also print the counters of\n"
+	       "                               each context over buckets of <ms>.\n"
+	       "     --downsample, -d <n>      Print the timeline of the counters as <n>\n"
+	       "                               buckets with min/max/mean/last values.\n"
+	       "     --range,    -r <s>,<e>    With --downsample, only cover <s>ms to <e>ms\n"
+	       "                               from the first report.\n"
+	       "     --cache,    -C            With --downsample, keep the timelines in\n"
+	       "                               <file>.<counter>.series next to the recording\n"
+	       "                               and reuse them on later runs.\n");
+}
+
+static void
+print_counters(struct intel_perf_data_reader *reader,
+	       struct intel_perf_logical_counter **counters,
+	       int32_t n_counters, uint64_t *deltas)
+{
+	for (uint32_t c = 0; c < n_counters; c++) {
+		struct intel_perf_logical_counter *counter = counters[c];
+
+		switch (counter->storage) {
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
+			fprintf(stdout, "   %s: %" PRIu64 "\n",
+				counter->symbol_name, counter->read_uint64(reader->perf,
+									   reader->metric_set,
+									   deltas));
+			break;
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
+		case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
+			fprintf(stdout, "   %s: %f\n",
+				counter->symbol_name, counter->read_float(reader->perf,
+									  reader->metric_set,
+									  deltas));
+			break;
+		}
+	}
+}
+
+static void
+print_context_stats(struct intel_perf_data_reader *reader,
+		    struct intel_perf_logical_counter **counters,
+		    int32_t n_counters, uint64_t bucket_ns)
+{
+	struct intel_perf_context_stats stats;
+
+	if (!intel_perf_data_reader_context_stats(reader, bucket_ns, &stats)) {
+		fprintf(stderr, "Unable to compute context stats: %s.\n",
+			reader->error_msg);
+		return;
+	}
+
+	fprintf(stdout, "Contexts: %u\n", stats.n_contexts);
+	for (uint32_t i = 0; i < stats.n_contexts; i++) {
+		struct intel_perf_context_totals *ctx = &stats.contexts[i];
+
+		fprintf(stdout, "hw_id=0x%x %sgpu_time=%.3fms (%.1f%%) reports=%u\n",
+			ctx->hw_id, ctx->hw_id == 0xffffffff ? "(idle) " : "",
+			ctx->gpu_time_ns / 1e6,
+			stats.gpu_time_ns ? 100.0 * ctx->gpu_time_ns / stats.gpu_time_ns : 0.0,
+			ctx->n_deltas);
+		print_counters(reader, counters, n_counters, ctx->totals.deltas);
+
+		for (uint32_t b = 0; b < ctx->n_buckets && b < stats.n_buckets; b++) {
+			uint64_t gpu_ticks =
+				ctx->buckets[b].deltas[reader->metric_set->gpu_time_offset];
+
+			/* Nothing ran for this context in the bucket. */
+			if (!gpu_ticks)
+				continue;
+
+			fprintf(stdout, "  bucket=%u start=%.3fms gpu_time=%.3fms\n",
+				b, b * bucket_ns / 1e6,
+				gpu_ticks * 1e3 / reader->devinfo.timestamp_frequency);
+			print_counters(reader, counters, n_counters, ctx->buckets[b].deltas);
+		}
+	}
+
+	intel_perf_context_stats_fini(&stats);
+}
+
+/* Written aside and renamed over, a concurrent reader never sees it partial. */
+static void
+save_series(const struct intel_perf_series *series, const char *cache_path)
+{
+	char *tmp;
+	bool saved;
+	int fd;
+
+	if (asprintf(&tmp, "%s.XXXXXX", cache_path) < 0)
+		return;
+
+	fd = mkstemp(tmp);
+	saved = fd >= 0 && !fchmod(fd, 0644) &&
+		intel_perf_series_save(series, fd);
+	if (fd >= 0 && close(fd))
+		saved = false;
+	if (!saved || rename(tmp, cache_path)) {
+		fprintf(stderr, "Unable to write '%s'.\n", cache_path);
+		if (fd >= 0)
+			unlink(tmp);
+	}
+
+	free(tmp);
+}
+
+static bool
+load_series(struct intel_perf_data_reader *reader,
+	    const struct intel_perf_logical_counter *counter,
+	    const char *cache_path, struct intel_perf_series *series)
+{
+	int fd;
+
+	if (cache_path) {
+		fd = open(cache_path, O_RDONLY);
+		if (fd >= 0) {
+			bool loaded = intel_perf_series_load(series, fd);
+
+			close(fd);
+			if (loaded &&
+			    series->source_id == intel_perf_data_reader_source_id(reader))
+				return true;
+			if (loaded)
+				intel_perf_series_fini(series);
+		}
+	}
+
+	if (!intel_perf_data_reader_counter_series(reader, counter, series))
+		return false;
+
+	if (cache_path)
+		save_series(series, cache_path);
+
+	return true;
+}
+
+static void
+print_series(struct intel_perf_data_reader *reader,
+	     struct intel_perf_logical_counter **counters,
+	     int32_t n_counters, uint32_t n_buckets,
+	     uint64_t start_ns, uint64_t end_ns,
+	     const char *recording, bool cache)
+{
+	struct intel_perf_series_bucket *buckets =
+		calloc(n_buckets, sizeof(*buckets));
+
+	for (uint32_t c = 0; c < n_counters; c++) {
+		struct intel_perf_logical_counter *counter = counters[c];
+		struct intel_perf_series series;
+		char *cache_path = NULL;
+		uint64_t end = end_ns, width;
+		uint32_t n;
+
+		if (cache && asprintf(&cache_path, "%s.%s.series",
+				      recording, counter->symbol_name) < 0)
+			cache_path = NULL;
+
+		if (!load_series(reader, counter, cache_path, &series)) {
+			fprintf(stderr, "Unable to compute the timeline of %s: %s.\n",
+				counter->symbol_name, reader->error_msg);
+			free(cache_path);
+			break;
+		}
+		free(cache_path);
+
+		if (!end && series.n_samples)
+			end = series.ts[series.n_samples - 1] + 1;
+
+		fprintf(stdout, "Timeline of %s: samples=%" PRIu64
+			" range=%.3fms-%.3fms\n",
+			counter->symbol_name, series.n_samples,
+			start_ns / 1e6, end / 1e6);
+
+		/* Keep n_buckets as requested for the next counters. */
+		n = intel_perf_series_query(&series, start_ns, end,
+					    n_buckets, buckets);
+		width = n ? (end - start_ns + n - 1) / n : 0;
+		for (uint32_t b = 0; b < n; b++) {
+			const struct intel_perf_series_bucket *bucket = &buckets[b];
+
+			if (!bucket->n)
+				continue;
+
+			fprintf(stdout, "   %.3fms: n=%" PRIu64
+				" min=%f max=%f mean=%f last=%f\n",
+				(start_ns + b * width) / 1e6, bucket->n,
+				bucket->min, bucket->max,
+				bucket->sum / bucket->n, bucket->last);
+		}
+
+		intel_perf_series_fini(&series);
+	}
+
+	free(buckets);
+}
+
+static const char *
+request_event_name(uint16_t event)
+{
+	static const char *names[] = {
+		[INTEL_PERF_REQUEST_ADD]        = "add",
+		[INTEL_PERF_REQUEST_SUBMIT]     = "submit",
+		[INTEL_PERF_REQUEST_EXECUTE]    = "execute",
+		[INTEL_PERF_REQUEST_IN]         = "in",
+		[INTEL_PERF_REQUEST_OUT]        = "out",
+		[INTEL_PERF_REQUEST_RETIRE]     = "retire",
+		[INTEL_PERF_REQUEST_WAIT_BEGIN] = "wait_begin",
+		[INTEL_PERF_REQUEST_WAIT_END]   = "wait_end",
+	};
+
+	if (event >= sizeof(names) / sizeof(names[0]) || !names[event])
+		return "unknown";
+
+	return names[event];
+}
+
+static void
+print_pmu_sample(const struct intel_perf_record_pmu_config *config,
+		 const struct intel_perf_record_pmu_sample *prev,
+		 const struct intel_perf_record_pmu_sample *sample)
+{
+	double dt;
+
+	fprintf(stdout, "pmu");
+
+	/* Rates need the previous sample. */
+	if (!config || !prev || sample->time_enabled <= prev->time_enabled ||
+	    sample->n_values != config->n_counters ||
+	    prev->n_values != config->n_counters) {
+		fprintf(stdout, "\n");
+		return;
+	}
+
+	dt = sample->time_enabled - prev->time_enabled;
+	for (uint32_t i = 0; i < config->n_counters; i++) {
+		const char *name = config->counters[i].name;
+		double delta = sample->values[i] - prev->values[i];
+
+		/* Frequencies accumulate MHz over seconds, the rest is time. */
+		if (strstr(name, "frequency"))
+			fprintf(stdout, " %s=%.0fMHz", name, delta * 1e9 / dt);
+		else
+			fprintf(stdout, " %s=%.1f%%", name, delta * 100.0 / dt);
+	}
+	fprintf(stdout, "\n");
+}
+
+static void
+print_events(struct intel_perf_data_reader *reader)
+{
+	const struct intel_perf_record_pmu_sample *prev_sample = NULL;
+
+	for (uint32_t i = 0; i < reader->n_events; i++) {
+		const struct intel_perf_event *event = &reader->events[i];
+
+		fprintf(stdout, "%" PRIu64 ".%09" PRIu64 " ",
+			event->cpu_ts / 1000000000, event->cpu_ts % 1000000000);
+
+		switch (event->type) {
+		case INTEL_PERF_EVENT_OA_REPORT: {
+			const uint32_t *report =
+				(const uint32_t *) (reader->records[event->record] + 1);
+
+			fprintf(stdout, "oa gpu_ts=0x%08x ctx_id=0x%x\n",
+				report[1], report[2]);
+			break;
+		}
+
+		case INTEL_PERF_EVENT_PMU_SAMPLE:
+			print_pmu_sample(reader->pmu_config, prev_sample,
+					 event->pmu_sample);
+			prev_sample = event->pmu_sample;
+			break;
+
+		case INTEL_PERF_EVENT_REQUEST: {
+			const struct intel_perf_record_request *request = event->request;
+
+			fprintf(stdout, "request %s engine=%u:%u ctx=%" PRIu64
+				" seqno=%u arg=%u cpu=%u\n",
+				request_event_name(request->event),
+				request->engine_class, request->engine_instance,
+				(uint64_t) request->ctx, request->seqno,
+				request->arg, request->cpu);
+			break;
+		}
+		}
+	}
 }
 
 static struct intel_perf_logical_counter *
@@ -171,16 +461,26 @@ main(int argc, char *argv[])
 	const struct option long_options[] = {
 		{"help",             no_argument, 0, 'h'},
 		{"counters",   required_argument, 0, 'c'},
+		{"events",           no_argument, 0, 'e'},
+		{"contexts",         no_argument, 0, 'x'},
+		{"bucket",     required_argument, 0, 'b'},
+		{"downsample", required_argument, 0, 'd'},
+		{"range",      required_argument, 0, 'r'},
+		{"cache",            no_argument, 0, 'C'},
 		{0, 0, 0, 0}
 	};
 	struct intel_perf_data_reader reader;
 	struct intel_perf_logical_counter **counters;
 	const struct intel_device_info *devinfo;
 	const char *counter_names = NULL;
+	uint32_t n_pmu_samples = 0, n_requests = 0;
 	int32_t n_counters;
+	bool events = false, contexts = false, cache = false;
+	uint64_t bucket_ns = 0, range_start_ns = 0, range_end_ns = 0;
+	uint32_t downsample = 0;
 	int fd, opt;
 
-	while ((opt = getopt_long(argc, argv, "hc:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:exb:d:r:C", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage();
@@ -188,6 +488,34 @@ main(int argc, char *argv[])
 		case 'c':
 			counter_names = optarg;
 			break;
+		case 'e':
+			events = true;
+			break;
+		case 'x':
+			contexts = true;
+			break;
+		case 'b':
+			bucket_ns = atof(optarg) * 1000000.0;
+			contexts = true;
+			break;
+		case 'd':
+			downsample = atoi(optarg);
+			break;
+		case 'r': {
+			double start, end;
+
+			if (sscanf(optarg, "%lf,%lf", &start, &end) != 2 ||
+			    start < 0 || end <= start) {
+				fprintf(stderr, "Invalid range '%s'.\n", optarg);
+				return EXIT_FAILURE;
+			}
+			range_start_ns = start * 1000000.0;
+			range_end_ns = end * 1000000.0;
+			break;
+		}
+		case 'C':
+			cache = true;
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -229,6 +557,16 @@ main(int argc, char *argv[])
 	fprintf(stdout, "Context switches: %u\n", reader.n_timelines);
 	fprintf(stdout, "Timestamp correlation points: %u\n", reader.n_correlations);
 
+	for (uint32_t i = 0; i < reader.n_events; i++) {
+		if (reader.events[i].type == INTEL_PERF_EVENT_PMU_SAMPLE)
+			n_pmu_samples++;
+		else if (reader.events[i].type == INTEL_PERF_EVENT_REQUEST)
+			n_requests++;
+	}
+	fprintf(stdout, "PMU samples: %u (%u counters)\n", n_pmu_samples,
+		reader.pmu_config ? reader.pmu_config->n_counters : 0);
+	fprintf(stdout, "Request events: %u\n", n_requests);
+
 	if (strcmp(reader.metric_set_uuid, reader.metric_set->hw_config_guid)) {
 		fprintf(stdout,
 			"WARNING: Recording used a different HW configuration.\n"
@@ -253,29 +591,19 @@ main(int argc, char *argv[])
 		intel_perf_accumulate_reports(&accu, reader.metric_set->perf_oa_format,
 					      i915_report0, i915_report1);
 
-		for (uint32_t c = 0; c < n_counters; c++) {
-			struct intel_perf_logical_counter *counter = counters[c];
-
-			switch (counter->storage) {
-			case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT64:
-			case INTEL_PERF_LOGICAL_COUNTER_STORAGE_UINT32:
-			case INTEL_PERF_LOGICAL_COUNTER_STORAGE_BOOL32:
-				fprintf(stdout, "   %s: %" PRIu64 "\n",
-					counter->symbol_name, counter->read_uint64(reader.perf,
-										   reader.metric_set,
-										   accu.deltas));
-				break;
-			case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
-			case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
-				fprintf(stdout, "   %s: %f\n",
-					counter->symbol_name, counter->read_float(reader.perf,
-										  reader.metric_set,
-										  accu.deltas));
-				break;
-			}
-		}
+		print_counters(&reader, counters, n_counters, accu.deltas);
 	}
 
+	if (contexts)
+		print_context_stats(&reader, counters, n_counters, bucket_ns);
+
+	if (events)
+		print_events(&reader);
+
+	if (downsample)
+		print_series(&reader, counters, n_counters, downsample,
+			     range_start_ns, range_end_ns, argv[optind], cache);
+
  exit:
 	intel_perf_data_reader_fini(&reader);
 	close(fd);
@@ -26,6 +26,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
 #include <stdbool.h>
@@ -34,7 +35,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/sysinfo.h>
 #include <sys/sysmacros.h>
 #include <sys/time.h>
 #include <sys/types.h>
@@ -44,6 +47,7 @@
 #include <i915_drm.h>
 
 #include "igt_core.h"
+#include "igt_perf.h"
 #include "intel_chipset.h"
 #include "i915/perf.h"
 #include "i915/perf_data.h"
@@ -331,6 +335,18 @@ get_device_timestamp_frequency(const struct intel_device_info *devinfo, int drm_
 	return 12000000;
 }
 
+struct pmu_counter {
+	uint64_t config;
+	char name[48];
+	int fd;
+};
+
+/* Per CPU ring buffer shared by all the request tracepoints. */
+struct trace_cpu {
+	int fds[8];
+	void *map;
+};
+
 struct recording_context {
 	int drm_fd;
 	int perf_fd;
@@ -355,6 +371,14 @@ struct recording_context {
 	int command_fifo_fd;
 
 	uint64_t poll_period;
+
+	struct pmu_counter *pmu_counters;
+	uint32_t n_pmu_counters;
+	uint64_t *pmu_values;
+
+	struct trace_cpu *trace_cpus;
+	int n_trace_cpus;
+	uint64_t trace_lost;
 };
 
 static int
@@ -608,6 +632,503 @@ write_correlation_timestamps(FILE *output, int drm_fd)
 	return write_saved_correlation_timestamps(output, &corr);
 }
 
+static uint64_t
+timespec_ns(const struct timespec *ts)
+{
+	return ts->tv_sec * 1000000000ull + ts->tv_nsec;
+}
+
+static bool
+pmu_event_wanted(const char *name)
+{
+	size_t len = strlen(name);
+
+	if (len > 5 && !strcmp(name + len - 5, "-busy"))
+		return true;
+
+	return !strcmp(name, "actual-frequency") ||
+		!strcmp(name, "requested-frequency") ||
+		!strcmp(name, "rc6-residency");
+}
+
+static bool
+pmu_open(struct recording_context *ctx)
+{
+	char device[80], path[PATH_MAX];
+	struct dirent *entry;
+	uint32_t n = 0;
+	DIR *dir;
+
+	snprintf(path, sizeof(path), "/sys/bus/event_source/devices/%s/events",
+		 i915_perf_device(ctx->drm_fd, device, sizeof(device)));
+	dir = opendir(path);
+	if (!dir) {
+		fprintf(stderr, "Unable to list i915 PMU events in '%s': %s\n",
+			path, strerror(errno));
+		return false;
+	}
+
+	while ((entry = readdir(dir))) {
+		struct pmu_counter *counter;
+		char file[PATH_MAX + 256], config[64];
+		uint64_t value;
+		ssize_t ret;
+		int fd;
+
+		if (!pmu_event_wanted(entry->d_name))
+			continue;
+
+		snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+		fd = open(file, O_RDONLY);
+		if (fd < 0)
+			continue;
+		ret = read(fd, config, sizeof(config) - 1);
+		close(fd);
+		if (ret <= 0)
+			continue;
+		config[ret] = '\0';
+
+		if (sscanf(config, "config=%"SCNx64, &value) != 1)
+			continue;
+
+		ctx->pmu_counters = realloc(ctx->pmu_counters,
+					    (n + 1) * sizeof(*ctx->pmu_counters));
+		assert(ctx->pmu_counters);
+
+		counter = &ctx->pmu_counters[n++];
+		counter->config = value;
+		counter->fd = -1;
+		snprintf(counter->name, sizeof(counter->name), "%s", entry->d_name);
+	}
+	closedir(dir);
+
+	/* Group members are read back in the order they were added, drop
+	 * the ones the kernel refuses so that the record matches.
+	 */
+	for (uint32_t i = 0; i < n; i++) {
+		struct pmu_counter *counter = &ctx->pmu_counters[ctx->n_pmu_counters];
+
+		*counter = ctx->pmu_counters[i];
+		counter->fd = perf_i915_open_group(ctx->drm_fd, counter->config,
+						   ctx->n_pmu_counters ?
+						   ctx->pmu_counters[0].fd : -1);
+		if (counter->fd < 0) {
+			fprintf(stderr, "Unable to open i915 PMU counter '%s': %s\n",
+				counter->name, strerror(errno));
+			continue;
+		}
+
+		ctx->n_pmu_counters++;
+	}
+
+	if (!ctx->n_pmu_counters) {
+		fprintf(stderr, "No i915 PMU counters available.\n");
+		return false;
+	}
+
+	ctx->pmu_values = calloc(2 + ctx->n_pmu_counters, sizeof(*ctx->pmu_values));
+	assert(ctx->pmu_values);
+
+	return true;
+}
+
+static bool
+write_pmu_config(FILE *output, struct recording_context *ctx)
+{
+	struct intel_perf_record_pmu_config config = {
+		.n_counters = ctx->n_pmu_counters,
+	};
+	struct drm_i915_perf_record_header header = {
+		.type = INTEL_PERF_RECORD_TYPE_PMU_CONFIG,
+		.size = sizeof(header) + sizeof(config) +
+			ctx->n_pmu_counters * sizeof(config.counters[0]),
+	};
+
+	if (!ctx->n_pmu_counters)
+		return true;
+
+	if (fwrite(&header, sizeof(header), 1, output) != 1)
+		return false;
+
+	if (fwrite(&config, sizeof(config), 1, output) != 1)
+		return false;
+
+	for (uint32_t i = 0; i < ctx->n_pmu_counters; i++) {
+		struct intel_perf_record_pmu_counter counter = {
+			.config = ctx->pmu_counters[i].config,
+		};
+
+		memcpy(counter.name, ctx->pmu_counters[i].name, sizeof(counter.name));
+		if (fwrite(&counter, sizeof(counter), 1, output) != 1)
+			return false;
+	}
+
+	return true;
+}
+
+static bool
+write_pmu_sample(FILE *output, struct recording_context *ctx)
+{
+	struct intel_perf_record_pmu_sample sample = {
+		.n_values = ctx->n_pmu_counters,
+	};
+	struct drm_i915_perf_record_header header = {
+		.type = INTEL_PERF_RECORD_TYPE_PMU_SAMPLE,
+		.size = sizeof(header) + sizeof(sample) +
+			ctx->n_pmu_counters * sizeof(sample.values[0]),
+	};
+	size_t len = (2 + ctx->n_pmu_counters) * sizeof(*ctx->pmu_values);
+	struct timespec begin, end;
+	ssize_t ret;
+
+	/* Like for the GPU timestamp, place the read in the middle of the
+	 * syscall on the correlation clock.
+	 */
+	clock_gettime(correlation_clock_id, &begin);
+	ret = read(ctx->pmu_counters[0].fd, ctx->pmu_values, len);
+	clock_gettime(correlation_clock_id, &end);
+	if (ret != (ssize_t) len)
+		return false;
+
+	assert(ctx->pmu_values[0] == ctx->n_pmu_counters);
+	sample.cpu_timestamp = timespec_ns(&begin) + timespec_diff(&begin, &end) / 2;
+	sample.time_enabled = ctx->pmu_values[1];
+
+	if (fwrite(&header, sizeof(header), 1, output) != 1)
+		return false;
+
+	if (fwrite(&sample, sizeof(sample), 1, output) != 1)
+		return false;
+
+	if (fwrite(&ctx->pmu_values[2], sizeof(*ctx->pmu_values),
+		   ctx->n_pmu_counters, output) != ctx->n_pmu_counters)
+		return false;
+
+	return true;
+}
+
+struct tp_field {
+	int offset;
+	int size;
+};
+
+static struct request_tracepoint {
+	const char *name;
+	enum intel_perf_request_event event;
+	/* Event specific field stored into intel_perf_record_request.arg */
+	const char *arg_name;
+
+	uint32_t id;
+	struct tp_field class, instance, ctx, seqno, arg;
+} request_tracepoints[] = {
+	{ "i915_request_add",        INTEL_PERF_REQUEST_ADD },
+	{ "i915_request_submit",     INTEL_PERF_REQUEST_SUBMIT },
+	{ "i915_request_execute",    INTEL_PERF_REQUEST_EXECUTE },
+	{ "i915_request_in",         INTEL_PERF_REQUEST_IN, "port" },
+	{ "i915_request_out",        INTEL_PERF_REQUEST_OUT, "completed" },
+	{ "i915_request_retire",     INTEL_PERF_REQUEST_RETIRE },
+	{ "i915_request_wait_begin", INTEL_PERF_REQUEST_WAIT_BEGIN, "flags" },
+	{ "i915_request_wait_end",   INTEL_PERF_REQUEST_WAIT_END },
+};
+
+#define TRACE_BUFFER_PAGES 64
+#define TRACE_DRAIN_PERIOD_NS (10 * 1000 * 1000)
+
+static ssize_t
+read_tracefs_file(const char *tracepoint, const char *file,
+		  char *buf, size_t len)
+{
+	static const char *roots[] = {
+		"/sys/kernel/tracing",
+		"/sys/kernel/debug/tracing",
+	};
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(roots); i++) {
+		char path[PATH_MAX];
+		ssize_t ret, total = 0;
+		int fd;
+
+		snprintf(path, sizeof(path), "%s/events/i915/%s/%s",
+			 roots[i], tracepoint, file);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			continue;
+
+		/* tracefs files report a size of 0, read until EOF. */
+		while (total < (ssize_t) len - 1 &&
+		       (ret = read(fd, buf + total, len - 1 - total)) > 0)
+			total += ret;
+		close(fd);
+
+		buf[total] = '\0';
+		return total;
+	}
+
+	return -1;
+}
+
+static void
+parse_tp_field(const char *format, const char *name, struct tp_field *field)
+{
+	const char *line = format;
+
+	field->offset = -1;
+	field->size = 0;
+
+	/* Lines look like "\tfield:u32 seqno;\toffset:24;\tsize:4;\tsigned:0;" */
+	while ((line = strstr(line, "field:"))) {
+		const char *end = strchr(line, ';'), *start, *offset, *size;
+
+		if (!end)
+			return;
+
+		for (start = end; start > line && start[-1] != ' '; start--)
+			;
+
+		offset = strstr(end, "offset:");
+		size = strstr(end, "size:");
+		if (offset && size &&
+		    end - start == strlen(name) && !strncmp(start, name, end - start)) {
+			field->offset = atoi(offset + strlen("offset:"));
+			field->size = atoi(size + strlen("size:"));
+			return;
+		}
+
+		line = end;
+	}
+}
+
+static uint64_t
+read_tp_field(const uint8_t *raw, uint32_t raw_size, const struct tp_field *field)
+{
+	if (field->offset < 0 || field->offset + field->size > raw_size)
+		return 0;
+
+	switch (field->size) {
+	case 1: return *(const uint8_t *) (raw + field->offset);
+	case 2: return *(const uint16_t *) (raw + field->offset);
+	case 4: return *(const uint32_t *) (raw + field->offset);
+	case 8: return *(const uint64_t *) (raw + field->offset);
+	default: return 0;
+	}
+}
+
+static bool
+trace_open(struct recording_context *ctx)
+{
+	size_t map_size = (1 + TRACE_BUFFER_PAGES) * sysconf(_SC_PAGESIZE);
+	uint32_t n_found = 0;
+	char buf[8192];
+
+	_Static_assert(ARRAY_SIZE(request_tracepoints) <=
+		       ARRAY_SIZE(((struct trace_cpu *) 0)->fds),
+		       "not enough tracepoint fds per cpu");
+
+	for (uint32_t i = 0; i < ARRAY_SIZE(request_tracepoints); i++) {
+		struct request_tracepoint *tp = &request_tracepoints[i];
+
+		/* Some are only there with CONFIG_DRM_I915_LOW_LEVEL_TRACEPOINTS. */
+		if (read_tracefs_file(tp->name, "id", buf, sizeof(buf)) <= 0)
+			continue;
+		tp->id = strtoul(buf, NULL, 0);
+
+		if (read_tracefs_file(tp->name, "format", buf, sizeof(buf)) <= 0) {
+			tp->id = 0;
+			continue;
+		}
+
+		parse_tp_field(buf, "class", &tp->class);
+		parse_tp_field(buf, "instance", &tp->instance);
+		parse_tp_field(buf, "ctx", &tp->ctx);
+		parse_tp_field(buf, "seqno", &tp->seqno);
+		if (tp->arg_name)
+			parse_tp_field(buf, tp->arg_name, &tp->arg);
+		else
+			tp->arg.offset = -1;
+
+		n_found++;
+	}
+
+	if (!n_found) {
+		fprintf(stderr,
+			"No i915 request tracepoints found, is tracefs mounted and readable?\n");
+		return false;
+	}
+
+	ctx->n_trace_cpus = get_nprocs_conf();
+	ctx->trace_cpus = calloc(ctx->n_trace_cpus, sizeof(*ctx->trace_cpus));
+	assert(ctx->trace_cpus);
+
+	for (int cpu = 0; cpu < ctx->n_trace_cpus; cpu++) {
+		struct trace_cpu *tc = &ctx->trace_cpus[cpu];
+
+		for (uint32_t i = 0; i < ARRAY_SIZE(tc->fds); i++)
+			tc->fds[i] = -1;
+	}
+
+	for (int cpu = 0; cpu < ctx->n_trace_cpus; cpu++) {
+		struct trace_cpu *tc = &ctx->trace_cpus[cpu];
+		int leader = -1;
+
+		for (uint32_t i = 0; i < ARRAY_SIZE(request_tracepoints); i++) {
+			struct perf_event_attr attr = {
+				.type = PERF_TYPE_TRACEPOINT,
+				.config = request_tracepoints[i].id,
+				.sample_period = 1,
+				.sample_type = PERF_SAMPLE_TIME | PERF_SAMPLE_CPU | PERF_SAMPLE_RAW,
+				.use_clockid = 1,
+				.clockid = correlation_clock_id,
+			};
+
+			if (!request_tracepoints[i].id)
+				continue;
+
+			tc->fds[i] = perf_event_open(&attr, -1, cpu, -1,
+						     PERF_FLAG_FD_CLOEXEC);
+			if (tc->fds[i] < 0) {
+				/* Offline cpu */
+				if (errno == ENODEV)
+					break;
+
+				fprintf(stderr, "Unable to open tracepoint '%s': %s\n"
+					"Consider running:\n"
+					"   sysctl kernel.perf_event_paranoid=-1\n",
+					request_tracepoints[i].name, strerror(errno));
+				return false;
+			}
+
+			/* All tracepoints of a cpu share one ring buffer. */
+			if (leader >= 0) {
+				if (ioctl(tc->fds[i], PERF_EVENT_IOC_SET_OUTPUT, leader) < 0) {
+					fprintf(stderr, "Unable to redirect tracepoint '%s': %s\n",
+						request_tracepoints[i].name, strerror(errno));
+					return false;
+				}
+				continue;
+			}
+
+			leader = tc->fds[i];
+			tc->map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+				       MAP_SHARED, leader, 0);
+			if (tc->map == MAP_FAILED) {
+				tc->map = NULL;
+				fprintf(stderr, "Unable to map tracepoint buffer: %s\n",
+					strerror(errno));
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+static bool
+write_request(FILE *output, struct recording_context *ctx,
+	      const struct perf_event_header *event)
+{
+	/* Layout for PERF_SAMPLE_TIME | PERF_SAMPLE_CPU | PERF_SAMPLE_RAW */
+	const struct {
+		struct perf_event_header header;
+		uint64_t time;
+		uint32_t cpu, res;
+		uint32_t raw_size;
+		uint8_t raw[];
+	} __attribute__((packed)) *sample = (const void *) event;
+	struct intel_perf_record_request request = {};
+	struct drm_i915_perf_record_header header = {
+		.type = INTEL_PERF_RECORD_TYPE_REQUEST,
+		.size = sizeof(header) + sizeof(request),
+	};
+	const struct request_tracepoint *tp = NULL;
+	uint16_t common_type;
+
+	if (sample->raw_size < sizeof(common_type))
+		return true;
+
+	/* The first common field of all tracepoints is their id. */
+	memcpy(&common_type, sample->raw, sizeof(common_type));
+	for (uint32_t i = 0; i < ARRAY_SIZE(request_tracepoints); i++) {
+		if (request_tracepoints[i].id == common_type) {
+			tp = &request_tracepoints[i];
+			break;
+		}
+	}
+	if (!tp)
+		return true;
+
+	request.cpu_timestamp = sample->time;
+	request.ctx = read_tp_field(sample->raw, sample->raw_size, &tp->ctx);
+	request.seqno = read_tp_field(sample->raw, sample->raw_size, &tp->seqno);
+	request.event = tp->event;
+	request.engine_class = read_tp_field(sample->raw, sample->raw_size, &tp->class);
+	request.engine_instance = read_tp_field(sample->raw, sample->raw_size, &tp->instance);
+	request.arg = read_tp_field(sample->raw, sample->raw_size, &tp->arg);
+	request.cpu = sample->cpu;
+
+	if (fwrite(&header, sizeof(header), 1, output) != 1)
+		return false;
+
+	if (fwrite(&request, sizeof(request), 1, output) != 1)
+		return false;
+
+	return true;
+}
+
+static bool
+trace_drain(FILE *output, struct recording_context *ctx)
+{
+	static uint8_t wrapped[UINT16_MAX + 1];
+	size_t page_size = sysconf(_SC_PAGESIZE);
+
+	for (int cpu = 0; cpu < ctx->n_trace_cpus; cpu++) {
+		struct perf_event_mmap_page *pc = ctx->trace_cpus[cpu].map;
+		const uint8_t *data;
+		uint64_t head, tail, size;
+
+		if (!pc)
+			continue;
+
+		data = (const uint8_t *) pc + page_size;
+		size = TRACE_BUFFER_PAGES * page_size;
+		head = __atomic_load_n(&pc->data_head, __ATOMIC_ACQUIRE);
+		tail = pc->data_tail;
+
+		while (tail < head) {
+			const struct perf_event_header *event =
+				(const void *) (data + tail % size);
+			uint64_t offset = tail % size;
+
+			/* Headers are 8 bytes aligned and never wrap, the
+			 * payload might.
+			 */
+			if (offset + event->size > size) {
+				memcpy(wrapped, data + offset, size - offset);
+				memcpy(wrapped + size - offset, data,
+				       event->size - (size - offset));
+				event = (const void *) wrapped;
+			}
+
+			switch (event->type) {
+			case PERF_RECORD_SAMPLE:
+				if (!write_request(output, ctx, event)) {
+					__atomic_store_n(&pc->data_tail, tail, __ATOMIC_RELEASE);
+					return false;
+				}
+				break;
+			case PERF_RECORD_LOST:
+				ctx->trace_lost += ((const uint64_t *) (event + 1))[1];
+				break;
+			}
+
+			tail += event->size;
+		}
+
+		__atomic_store_n(&pc->data_tail, tail, __ATOMIC_RELEASE);
+	}
+
+	return true;
+}
+
 static void
 read_command_file(struct recording_context *ctx)
 {
@@ -644,6 +1165,7 @@ read_command_file(struct recording_context *ctx)
 			if (!write_version(file, ctx) ||
 			    !write_header(file, ctx) ||
 			    !write_topology(file, ctx) ||
+			    !write_pmu_config(file, ctx) ||
 			    fwrite(chunks[0].data, chunks[0].len, 1, file) != 1 ||
 			    (chunks[1].len > 0 &&
 			     fwrite(chunks[1].data, chunks[1].len, 1, file) != 1) ||
@@ -738,7 +1260,11 @@ usage(const char *name)
 		"                                       Values: boot, mono, mono_raw (default = mono)\n"
 		"     --poll-period         -P <value>  Polling interval in microseconds used by a timer in the driver to query\n"
 		"                                       for OA reports periodically\n"
-		"                                       (default = 5000), Minimum = 100.\n",
+		"                                       (default = 5000), Minimum = 100.\n"
+		"     --pmu-period,         -u <value>  Also sample the i915 PMU engine busyness, frequency and\n"
+		"                                       RC6 counters with this period in seconds\n"
+		"     --trace,              -t          Also record the i915 request tracepoints\n"
+		"                                       (requires kernel.perf_event_paranoid=-1 or root)\n",
 		name);
 }
 
@@ -761,6 +1287,23 @@ teardown_recording_context(struct recording_context *ctx)
 
 	free(ctx->circular_buffer.data);
 
+	for (int cpu = 0; cpu < ctx->n_trace_cpus; cpu++) {
+		struct trace_cpu *tc = &ctx->trace_cpus[cpu];
+
+		if (tc->map)
+			munmap(tc->map, (1 + TRACE_BUFFER_PAGES) * sysconf(_SC_PAGESIZE));
+		for (uint32_t i = 0; i < ARRAY_SIZE(tc->fds); i++) {
+			if (tc->fds[i] != -1)
+				close(tc->fds[i]);
+		}
+	}
+	free(ctx->trace_cpus);
+
+	for (uint32_t i = 0; i < ctx->n_pmu_counters; i++)
+		close(ctx->pmu_counters[i].fd);
+	free(ctx->pmu_counters);
+	free(ctx->pmu_values);
+
 	if (ctx->perf_fd != -1)
 		close(ctx->perf_fd);
 	if (ctx->drm_fd != -1)
@@ -781,6 +1324,8 @@ main(int argc, char *argv[])
 		{"command-fifo",         required_argument, 0, 'f'},
 		{"cpu-clock",            required_argument, 0, 'k'},
 		{"poll-period",          required_argument, 0, 'P'},
+		{"pmu-period",           required_argument, 0, 'u'},
+		{"trace",                      no_argument, 0, 't'},
 		{0, 0, 0, 0}
 	};
 	const struct {
@@ -791,15 +1336,15 @@ main(int argc, char *argv[])
 		{ CLOCK_MONOTONIC,     "mono" },
 		{ CLOCK_MONOTONIC_RAW, "mono_raw" },
 	};
-	double corr_period = 1.0, perf_period = 0.001;
+	double corr_period = 1.0, perf_period = 0.001, pmu_period = 0.0;
 	const char *metric_name = NULL, *output_file = "i915_perf.record";
 	struct intel_perf_metric_set *metric_set;
 	struct intel_perf_record_timestamp_correlation initial_correlation;
 	struct timespec now;
-	uint64_t corr_period_ns, poll_time_ns;
+	uint64_t corr_period_ns, pmu_period_ns, next_corr_ns, next_pmu_ns, next_trace_ns;
 	uint32_t circular_size = 0;
 	int opt;
-	bool list_counters = false;
+	bool list_counters = false, trace = false;
 	FILE *output = NULL;
 	struct recording_context ctx = {
 		.drm_fd = -1,
@@ -812,7 +1357,7 @@ main(int argc, char *argv[])
 		.poll_period = 5 * 1000 * 1000,
 	};
 
-	while ((opt = getopt_long(argc, argv, "hc:p:m:Co:s:f:k:P:", long_options, NULL)) != -1) {
+	while ((opt = getopt_long(argc, argv, "hc:p:m:Co:s:f:k:P:u:t", long_options, NULL)) != -1) {
 		switch (opt) {
 		case 'h':
 			usage(argv[0]);
@@ -857,6 +1402,12 @@ main(int argc, char *argv[])
 		case 'P':
 			ctx.poll_period = MAX(100, atol(optarg)) * 1000;
 			break;
+		case 'u':
+			pmu_period = atof(optarg);
+			break;
+		case 't':
+			trace = true;
+			break;
 		default:
 			fprintf(stderr, "Internal error: "
 				"unexpected getopt value: %d\n", opt);
@@ -930,6 +1481,15 @@ main(int argc, char *argv[])
 
 	ctx.timestamp_frequency = get_device_timestamp_frequency(ctx.devinfo, ctx.drm_fd);
 
+	/* Open the extra sources before writing the headers, they describe
+	 * the PMU counters.
+	 */
+	if (pmu_period > 0.0 && !pmu_open(&ctx))
+		goto fail;
+
+	if (trace && !trace_open(&ctx))
+		goto fail;
+
 	signal(SIGINT, sigint_handler);
 
 	if (ctx.command_fifo) {
@@ -983,6 +1543,7 @@ main(int argc, char *argv[])
 		if (!write_version(output, &ctx) ||
 		    !write_header(output, &ctx) ||
 		    !write_topology(output, &ctx) ||
+		    !write_pmu_config(output, &ctx) ||
 		    !write_correlation_timestamps(output, ctx.drm_fd)) {
 			fprintf(stderr, "Unable to write header in file '%s'\n",
 				output_file);
@@ -1012,18 +1573,31 @@ main(int argc, char *argv[])
 	}
 
 	corr_period_ns = corr_period * 1000000000ul;
-	poll_time_ns = corr_period_ns;
+	pmu_period_ns = pmu_period * 1000000000ul;
+
+	igt_gettime(&now);
+	next_corr_ns = timespec_ns(&now) + corr_period_ns;
+	next_pmu_ns = timespec_ns(&now) + pmu_period_ns;
+	next_trace_ns = timespec_ns(&now) + TRACE_DRAIN_PERIOD_NS;
 
 	while (!quit) {
 		struct pollfd pollfd[2] = {
 			{         ctx.perf_fd, POLLIN, 0 },
 			{ ctx.command_fifo_fd, POLLIN, 0 },
 		};
-		uint64_t elapsed_ns;
+		uint64_t now_ns, deadline_ns = next_corr_ns;
 		int ret;
 
+		if (ctx.n_pmu_counters)
+			deadline_ns = MIN(deadline_ns, next_pmu_ns);
+		if (ctx.trace_cpus)
+			deadline_ns = MIN(deadline_ns, next_trace_ns);
+
 		igt_gettime(&now);
-		ret = poll(pollfd, ctx.command_fifo_fd != -1 ? 2 : 1, poll_time_ns / 1000000);
+		now_ns = timespec_ns(&now);
+		ret = poll(pollfd, ctx.command_fifo_fd != -1 ? 2 : 1,
+			   deadline_ns > now_ns ?
+			   (deadline_ns - now_ns + 999999) / 1000000 : 0);
 		if (ret < 0 && errno != EINTR) {
 			fprintf(stderr, "Failed to poll i915-perf stream: %s\n",
 				strerror(errno));
@@ -1044,22 +1618,47 @@ main(int argc, char *argv[])
 			}
 		}
 
-		elapsed_ns = igt_nsec_elapsed(&now);
-		if (elapsed_ns > poll_time_ns) {
-			poll_time_ns = corr_period_ns;
+		igt_gettime(&now);
+		now_ns = timespec_ns(&now);
+
+		if (ctx.n_pmu_counters && now_ns >= next_pmu_ns) {
+			next_pmu_ns = MAX(next_pmu_ns + pmu_period_ns, now_ns);
+			if (!write_pmu_sample(ctx.output_stream, &ctx)) {
+				fprintf(stderr, "Failed to write i915 PMU data: %s\n",
+					strerror(errno));
+				break;
+			}
+		}
+
+		if (ctx.trace_cpus && now_ns >= next_trace_ns) {
+			next_trace_ns = now_ns + TRACE_DRAIN_PERIOD_NS;
+			if (!trace_drain(ctx.output_stream, &ctx)) {
+				fprintf(stderr, "Failed to write i915 request data: %s\n",
+					strerror(errno));
+				break;
+			}
+		}
+
+		if (now_ns >= next_corr_ns) {
+			next_corr_ns = now_ns + corr_period_ns;
 			if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
 				fprintf(stderr,
 					"Failed to write i915 timestamp correlation data: %s\n",
 					strerror(errno));
 				break;
 			}
-		} else {
-			poll_time_ns -= elapsed_ns;
 		}
 	}
 
 	fprintf(stdout, "Exiting...\n");
 
+	if (ctx.trace_cpus) {
+		trace_drain(ctx.output_stream, &ctx);
+		if (ctx.trace_lost)
+			fprintf(stderr, "Lost %"PRIu64" i915 request events\n",
+				ctx.trace_lost);
+	}
+
 	if (!write_correlation_timestamps(ctx.output_stream, ctx.drm_fd)) {
 		fprintf(stderr,
 			"Failed to write final i915 timestamp correlation data: %s\n",
@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Records benchmark results per commit and reports the commits where they
+ * changed, e.g. after each run of a benchmark:
+ *
+ *   gem_exec_nop ... | igt_bench_history -f history add exec-nop $(git rev-parse HEAD)
+ *   igt_bench_history -f history -l analyse
+ *
+ * analyse exits with 2 when it finds a regression.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "igt_bench_history.h"
+
+#define MAX_CHANGES 64
+
+static void usage(const char *appname)
+{
+	printf("igt_bench_history - benchmark regressions across commits\n"
+	       "\n"
+	       "Usage: %s -f <file> [parameters] add <benchmark> <commit> [values...]\n"
+	       "       %s -f <file> [parameters] list\n"
+	       "       %s -f <file> [parameters] analyse\n"
+	       "\n"
+	       "add reads the values from stdin when none are given.\n"
+	       "\n"
+	       "\t[-h]            Show this help text.\n"
+	       "\t[-f <file>]     The history file.\n"
+	       "\t[-b <name>]     Only this benchmark.\n"
+	       "\t[-l]            Lower values are better.\n"
+	       "\t[-a <alpha>]    Significance level (default 0.05).\n"
+	       "\t[-m <percent>]  Smallest regression reported (default 1%%).\n"
+	       "\t[-c <commits>]  Fewest commits on either side of a change (default 2).\n"
+	       "\t[-p <count>]    Permutations per change point (default 199).\n"
+	       "\t[-r <count>]    Bootstrap resamples (default 1000).\n"
+	       "\t[-s <seed>]     Seed of the permutations and resamples.\n",
+	       appname, appname, appname);
+}
+
+static int add(const char *file, int argc, char **argv)
+{
+	unsigned int n = 0, capacity = 64;
+	double *values;
+	int ret;
+
+	if (argc < 2) {
+		fprintf(stderr, "add needs a benchmark and a commit\n");
+		return EXIT_FAILURE;
+	}
+
+	values = malloc(capacity * sizeof(*values));
+	if (argc > 2) {
+		for (int i = 2; i < argc; i++) {
+			char *end;
+
+			if (n == capacity)
+				values = realloc(values,
+						 (capacity *= 2) * sizeof(*values));
+			values[n++] = strtod(argv[i], &end);
+			if (*end) {
+				fprintf(stderr, "Invalid value %s\n", argv[i]);
+				free(values);
+				return EXIT_FAILURE;
+			}
+		}
+	} else {
+		double v;
+
+		while (scanf("%lf", &v) == 1) {
+			if (n == capacity)
+				values = realloc(values,
+						 (capacity *= 2) * sizeof(*values));
+			values[n++] = v;
+		}
+	}
+
+	if (!n) {
+		fprintf(stderr, "No values for %s\n", argv[0]);
+		free(values);
+		return EXIT_FAILURE;
+	}
+
+	ret = igt_bench_history_append(file, argv[0], argv[1], values, n);
+	free(values);
+	if (ret) {
+		fprintf(stderr, "Unable to append to %s: %s\n",
+			file, strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+static void list(const struct igt_bench_series *s)
+{
+	printf("%s:\n", s->name);
+	for (unsigned int i = 0; i < s->n_commits; i++) {
+		const struct igt_bench_commit *c = &s->commits[i];
+		double sum = 0;
+
+		for (unsigned int j = 0; j < c->n_samples; j++)
+			sum += c->samples[j];
+
+		printf("  %4u %-16s %4u samples, mean %g\n",
+		       i, c->id, c->n_samples, sum / c->n_samples);
+	}
+}
+
+static bool analyse(const struct igt_bench_series *s,
+		    const struct igt_bench_analysis *opts)
+{
+	struct igt_bench_change changes[MAX_CHANGES];
+	bool regressed = false;
+	unsigned int n;
+
+	n = igt_bench_series_analyse(s, opts, changes, MAX_CHANGES);
+
+	printf("%s: %u commits, %u change%s\n",
+	       s->name, s->n_commits, n, n == 1 ? "" : "s");
+	for (unsigned int i = 0; i < n; i++) {
+		const struct igt_bench_change *c = &changes[i];
+
+		printf("  %s %s: %g -> %g, %+.2f%% [%+.2f%%, %+.2f%%], p %.3f\n",
+		       c->regression ? "REGRESSION at" : "change at",
+		       s->commits[c->commit].id, c->before, c->after,
+		       100 * c->change, 100 * c->change_lo,
+		       100 * c->change_hi, c->p_value);
+
+		if (c->bisect_first == c->bisect_last)
+			printf("    first bad commit %s, last good %s\n",
+			       s->commits[c->bisect_first].id,
+			       s->commits[c->bisect_first - 1].id);
+		else
+			printf("    bisect %s..%s (%u commits)\n",
+			       s->commits[c->bisect_first - 1].id,
+			       s->commits[c->bisect_last].id,
+			       c->bisect_last - c->bisect_first + 1);
+
+		regressed |= c->regression;
+	}
+
+	return regressed;
+}
+
+int main(int argc, char **argv)
+{
+	const char *file = NULL, *bench = NULL, *cmd;
+	struct igt_bench_analysis opts;
+	struct igt_bench_history history;
+	bool found = false, regressed = false;
+	int ret, c;
+
+	igt_bench_analysis_init(&opts);
+
+	while ((c = getopt(argc, argv, "+hf:b:la:m:c:p:r:s:")) != -1) {
+		switch (c) {
+		case 'f':
+			file = optarg;
+			break;
+		case 'b':
+			bench = optarg;
+			break;
+		case 'l':
+			opts.lower_is_better = true;
+			break;
+		case 'a':
+			opts.alpha = strtod(optarg, NULL);
+			break;
+		case 'm':
+			opts.min_change = strtod(optarg, NULL) / 100;
+			break;
+		case 'c':
+			opts.min_commits = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			opts.permutations = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			opts.resamples = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			opts.seed = strtoull(optarg, NULL, 0);
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			fprintf(stderr, "Invalid option %c!\n", (char)optopt);
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!file || optind >= argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	cmd = argv[optind++];
+	if (!strcmp(cmd, "add"))
+		return add(file, argc - optind, argv + optind);
+
+	if (strcmp(cmd, "list") && strcmp(cmd, "analyse")) {
+		fprintf(stderr, "Unknown command %s\n", cmd);
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	igt_bench_history_init(&history);
+	ret = igt_bench_history_load(&history, file);
+	if (ret) {
+		fprintf(stderr, "Unable to load %s: %s\n", file, strerror(-ret));
+		igt_bench_history_fini(&history);
+		return EXIT_FAILURE;
+	}
+
+	for (unsigned int i = 0; i < history.n_series; i++) {
+		const struct igt_bench_series *s = &history.series[i];
+
+		if (bench && strcmp(bench, s->name))
+			continue;
+
+		found = true;
+		if (!strcmp(cmd, "list"))
+			list(s);
+		else
+			regressed |= analyse(s, &opts);
+	}
+
+	igt_bench_history_fini(&history);
+
+	if (!found) {
+		fprintf(stderr, "No results for %s in %s\n",
+			bench ?: "any benchmark", file);
+		return EXIT_FAILURE;
+	}
+
+	return regressed ? 2 : EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/* Convert frames dumped with IGT_FRAME_DUMP_ASYNC into PNG files */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <cairo.h>
+
+#include "igt_dump.h"
+
+static char *png_filename(const char *path)
+{
+	size_t len = strlen(path);
+	char *name;
+
+	if (len > 8 && !strcmp(path + len - 8, ".igtdump"))
+		len -= 8;
+
+	if (asprintf(&name, "%.*s.png", (int)len, path) < 0)
+		return NULL;
+
+	return name;
+}
+
+static int convert(const char *path, const char *output, bool remove_input)
+{
+	struct igt_dump_header hdr;
+	cairo_surface_t *surface;
+	cairo_status_t status;
+	cairo_format_t format;
+	char *name = NULL;
+	void *data;
+	int err;
+
+	err = igt_dump_read(path, &hdr, &data);
+	if (err) {
+		fprintf(stderr, "%s: %s\n", path, strerror(-err));
+		return 1;
+	}
+
+	format = igt_dump_drm_to_cairo_format(hdr.format);
+	if (format == CAIRO_FORMAT_INVALID) {
+		fprintf(stderr, "%s: unsupported format 0x%08x\n",
+			path, hdr.format);
+		free(data);
+		return 1;
+	}
+
+	if (!output)
+		output = name = png_filename(path);
+
+	surface = cairo_image_surface_create_for_data(data, format,
+						      hdr.width, hdr.height,
+						      hdr.stride);
+	status = cairo_surface_write_to_png(surface, output);
+	cairo_surface_destroy(surface);
+	free(data);
+
+	if (status != CAIRO_STATUS_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", output,
+			cairo_status_to_string(status));
+		free(name);
+		return 1;
+	}
+
+	if (remove_input)
+		unlink(path);
+
+	free(name);
+	return 0;
+}
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage: %s [-r] [-o output.png] file.igtdump...\n"
+		"\n"
+		"Converts frame dumps to PNG, next to the input unless -o is given.\n"
+		"  -r, --remove  delete the .igtdump files once converted\n"
+		"  -o, --output  output file, only with a single input\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	static const struct option longopts[] = {
+		{ "remove", no_argument, NULL, 'r' },
+		{ "output", required_argument, NULL, 'o' },
+		{ "help", no_argument, NULL, 'h' },
+		{ }
+	};
+	const char *output = NULL;
+	bool remove_input = false;
+	int ret = 0, c;
+
+	while ((c = getopt_long(argc, argv, "ro:h", longopts, NULL)) != -1) {
+		switch (c) {
+		case 'r':
+			remove_input = true;
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (optind == argc || (output && argc - optind > 1)) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	for (int i = optind; i < argc; i++)
+		ret |= convert(argv[i], output, remove_input);
+
+	return ret;
+}
@@ -0,0 +1,349 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+
+/*
+ * Per process and per cgroup GPU memory, from the DRM fdinfo memory keys, in
+ * the Prometheus text format. With -o the file is replaced atomically so it
+ * can be picked up by the node_exporter textfile collector.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "igt_drm_fdinfo.h"
+
+/* Processes summed by cgroup, or by command name. */
+struct group_mem {
+	const char *name;
+	unsigned int num_regions;
+	struct drm_fdinfo_memory region[DRM_FDINFO_MAX_REGIONS];
+};
+
+static bool stop;
+
+static void sigint_handler(int sig)
+{
+	stop = true;
+}
+
+static void usage(const char *appname)
+{
+	printf("intel_gpu_mem - Per process and cgroup GPU memory usage\n"
+	       "\n"
+	       "Usage: %s [parameters]\n"
+	       "\n"
+	       "\t[-h]            Show this help text.\n"
+	       "\t[-o <file>]     Write to <file>, replacing it atomically.\n"
+	       "\t[-s <ms>]       Update period in milliseconds (default 1000ms).\n"
+	       "\t[-n <samples>]  Exit after this many updates (default 1, 0 runs forever).\n"
+	       "\t[-D <driver>]   Only account clients of this DRM driver.\n"
+	       "\t[-r <dir>]      Read procfs and debugfs under <dir>.\n"
+	       "\t[-v]            Report the work done by each update on stderr.\n",
+	       appname);
+}
+
+/* Label values may not contain raw quotes, backslashes or newlines. */
+static void print_label(FILE *f, const char *name, const char *value)
+{
+	fprintf(f, "%s=\"", name);
+	for (; *value; value++) {
+		if (*value == '"' || *value == '\\')
+			fputc('\\', f);
+		if (*value == '\n')
+			fputs("\\n", f);
+		else
+			fputc(*value, f);
+	}
+	fputc('"', f);
+}
+
+static void print_regions(FILE *f, const char *metric, const char *label,
+			  const char *value, const struct drm_fdinfo_memory *r,
+			  unsigned int num_regions, pid_t pid)
+{
+	static const struct {
+		const char *type;
+		size_t offset;
+	} types[] = {
+		{ "total", offsetof(struct drm_fdinfo_memory, total) },
+		{ "shared", offsetof(struct drm_fdinfo_memory, shared) },
+		{ "resident", offsetof(struct drm_fdinfo_memory, resident) },
+	};
+	unsigned int i, j;
+
+	for (i = 0; i < num_regions; i++) {
+		for (j = 0; j < sizeof(types) / sizeof(types[0]); j++) {
+			fprintf(f, "%s{", metric);
+			if (pid)
+				fprintf(f, "pid=\"%d\",", pid);
+			print_label(f, label, value);
+			fputc(',', f);
+			print_label(f, "region", r[i].region);
+			fprintf(f, ",type=\"%s\"} %"PRIu64"\n", types[j].type,
+				*(const uint64_t *)((const char *)&r[i] +
+						    types[j].offset));
+		}
+	}
+}
+
+static void add_group(struct group_mem **groups, unsigned int *count,
+		      const char *name, const struct igt_drm_mem_process *p)
+{
+	struct group_mem *cg = NULL;
+	unsigned int i, j;
+
+	for (i = 0; i < *count; i++) {
+		if (!strcmp((*groups)[i].name, name)) {
+			cg = &(*groups)[i];
+			break;
+		}
+	}
+
+	if (!cg) {
+		*groups = realloc(*groups, (*count + 1) * sizeof(**groups));
+		if (!*groups)
+			exit(1);
+		cg = &(*groups)[(*count)++];
+		memset(cg, 0, sizeof(*cg));
+		cg->name = name;
+	}
+
+	for (i = 0; i < p->num_regions; i++) {
+		for (j = 0; j < cg->num_regions; j++) {
+			if (!strcmp(cg->region[j].region, p->region[i].region))
+				break;
+		}
+		if (j == cg->num_regions) {
+			if (j == DRM_FDINFO_MAX_REGIONS)
+				continue;
+			memset(&cg->region[j], 0, sizeof(cg->region[j]));
+			strcpy(cg->region[j].region, p->region[i].region);
+			cg->num_regions++;
+		}
+
+		cg->region[j].total += p->region[i].total;
+		cg->region[j].shared += p->region[i].shared;
+		cg->region[j].resident += p->region[i].resident;
+	}
+}
+
+static void print_mem(FILE *f, const struct igt_drm_mem *mem)
+{
+	struct group_mem *groups = NULL;
+	unsigned int num_groups = 0;
+	unsigned int i;
+
+	if (mem->debugfs) {
+		/*
+		 * No pids there, only the command names, and several clients
+		 * may share one. Sum them for a single series per command.
+		 */
+		for (i = 0; i < mem->num_processes; i++)
+			add_group(&groups, &num_groups,
+				  mem->processes[i].comm, &mem->processes[i]);
+
+		fprintf(f, "# HELP gpu_memory_comm_bytes GPU memory per command, from debugfs.\n"
+			"# TYPE gpu_memory_comm_bytes gauge\n");
+		for (i = 0; i < num_groups; i++)
+			print_regions(f, "gpu_memory_comm_bytes", "comm",
+				      groups[i].name, groups[i].region,
+				      groups[i].num_regions, 0);
+
+		free(groups);
+		return;
+	}
+
+	fprintf(f, "# HELP gpu_memory_process_bytes GPU memory of the DRM clients of a process.\n"
+		"# TYPE gpu_memory_process_bytes gauge\n");
+	for (i = 0; i < mem->num_processes; i++) {
+		const struct igt_drm_mem_process *p = &mem->processes[i];
+
+		print_regions(f, "gpu_memory_process_bytes", "comm", p->comm,
+			      p->region, p->num_regions, p->pid);
+
+		if (p->cgroup)
+			add_group(&groups, &num_groups, p->cgroup, p);
+	}
+
+	fprintf(f, "# HELP gpu_memory_cgroup_bytes GPU memory of the processes in a cgroup.\n"
+		"# TYPE gpu_memory_cgroup_bytes gauge\n");
+	for (i = 0; i < num_groups; i++)
+		print_regions(f, "gpu_memory_cgroup_bytes", "cgroup",
+			      groups[i].name, groups[i].region,
+			      groups[i].num_regions, 0);
+
+	free(groups);
+}
+
+static int write_file(const char *path, const struct igt_drm_mem *mem)
+{
+	char *tmp;
+	FILE *f;
+	int ret = 0;
+
+	if (asprintf(&tmp, "%s.%d.tmp", path, getpid()) < 0)
+		return -ENOMEM;
+
+	f = fopen(tmp, "w");
+	if (!f) {
+		ret = -errno;
+		goto out;
+	}
+
+	print_mem(f, mem);
+
+	/* Readers see either the old or the new file, never a partial one. */
+	if (fclose(f) || rename(tmp, path)) {
+		ret = -errno;
+		unlink(tmp);
+	}
+
+out:
+	free(tmp);
+	return ret;
+}
+
+/* A non-negative decimal number, or -1 for anything else. */
+static long parse_count(const char *str)
+{
+	char *end;
+	long val;
+
+	errno = 0;
+	val = strtol(str, &end, 10);
+	if (errno || end == str || *end || val < 0)
+		return -1;
+
+	return val;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int period_ms = 1000;
+	const char *output_path = NULL;
+	const char *driver = NULL;
+	const char *root = "";
+	bool verbose = false;
+	long samples = 1;
+	struct igt_drm_mem mem;
+	int ch, ret = 0;
+	long val;
+
+	while ((ch = getopt(argc, argv, "o:s:n:D:r:vh")) != -1) {
+		switch (ch) {
+		case 'o':
+			output_path = optarg;
+			break;
+		case 's':
+			val = parse_count(optarg);
+			if (val <= 0 || val > UINT_MAX / 1000) {
+				fprintf(stderr, "Invalid update period '%s'!\n",
+					optarg);
+				exit(1);
+			}
+			period_ms = val;
+			break;
+		case 'n':
+			samples = parse_count(optarg);
+			if (samples < 0) {
+				fprintf(stderr, "Invalid sample count '%s'!\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		case 'D':
+			driver = optarg;
+			break;
+		case 'r':
+			root = optarg;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			exit(0);
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	signal(SIGINT, sigint_handler);
+	signal(SIGTERM, sigint_handler);
+
+	igt_drm_mem_init(&mem, root, driver);
+
+	while (!stop) {
+		struct timespec start, end;
+
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		ret = igt_drm_mem_update(&mem);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		if (ret) {
+			fprintf(stderr, "Failed to scan %s/proc! (%s)\n",
+				root, strerror(-ret));
+			break;
+		}
+
+		if (verbose)
+			fprintf(stderr,
+				"%u processes, %lu fds resolved, %lu fdinfo reads in %.3fms\n",
+				mem.num_processes, mem.fds_resolved,
+				mem.fdinfo_reads,
+				(end.tv_sec - start.tv_sec) * 1e3 +
+				(end.tv_nsec - start.tv_nsec) / 1e6);
+
+		if (output_path) {
+			ret = write_file(output_path, &mem);
+			if (ret) {
+				fprintf(stderr, "Failed to write %s! (%s)\n",
+					output_path, strerror(-ret));
+				break;
+			}
+		} else {
+			print_mem(stdout, &mem);
+			fflush(stdout);
+		}
+
+		if (samples && !--samples)
+			break;
+
+		usleep(period_ms * 1000);
+	}
+
+	igt_drm_mem_fini(&mem);
+
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -32,19 +32,28 @@
 #include <limits.h>
 #include <locale.h>
 #include <math.h>
+#include <netdb.h>
 #include <poll.h>
 #include <signal.h>
+#include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 #include <termios.h>
 
+#include "i915_drm.h"
+#include "igt_drm_fdinfo.h"
 #include "igt_perf.h"
+#include "i915/perf.h"
+#include "i915/perf_data_reader.h"
 
 struct pmu_pair {
 	uint64_t cur;
@@ -82,6 +91,45 @@ struct engine_class {
 	unsigned int num_engines;
 };
 
+struct engines;
+
+/*
+ * Source of the counters behind struct engines. The i915 one uses the PMU,
+ * others get engine busyness from the DRM fdinfo of the clients and the
+ * rest from sysfs, all behind the same counter model so the output paths
+ * don't care which one is in use.
+ */
+struct backend {
+	const char *name;
+	int (*init)(struct engines *engines);
+	void (*sample)(struct engines *engines);
+};
+
+struct fdinfo_client;
+
+/*
+ * Uncore PMUs can't be grouped with each other, so every memory controller
+ * is opened as its own group, once for each socket it counts on.
+ */
+struct imc_group {
+	int fd;
+	unsigned int num;
+	unsigned int socket;
+	double reads_bytes;
+	double writes_bytes;
+	struct pmu_counter reads;
+	struct pmu_counter writes;
+};
+
+struct imc_socket {
+	int id;
+	char *name;
+	double read_bytes;
+	double write_bytes;
+	struct pmu_counter reads;
+	struct pmu_counter writes;
+};
+
 struct engines {
 	unsigned int num_engines;
 	unsigned int num_classes;
@@ -95,10 +143,12 @@ struct engines {
 	struct pmu_counter r_gpu, r_pkg;
 	unsigned int num_rapl;
 
-	int imc_fd;
+	struct imc_group *imc;
+	unsigned int num_imc;
+	struct imc_socket *imc_sockets;
+	unsigned int num_imc_sockets;
 	struct pmu_counter imc_reads;
 	struct pmu_counter imc_writes;
-	unsigned int num_imc;
 
 	struct pmu_counter freq_req;
 	struct pmu_counter freq_act;
@@ -108,6 +158,25 @@ struct engines {
 	bool discrete;
 	char *device;
 
+	const struct backend *backend;
+
+	/* Engine class names when not i915, indexed by engine->class. */
+	const char **class_names;
+
+	/* DRM fdinfo backend. */
+	char *driver;
+	char *pdev;
+	struct fdinfo_client *clients;
+	unsigned int num_clients;
+	unsigned int generation;
+	uint64_t *engine_ns;
+	unsigned int *engine_capacity;
+	char *gpu_busy_path;
+	char *hwmon_path;
+	double gpu_busy_ns;
+	double energy_uj;
+	double freq_mhz_s;
+
 	/* Do not edit below this line.
 	 * This structure is reallocated every time a new engine is
 	 * found and size is increased by sizeof (engine).
@@ -264,6 +333,8 @@ get_pmu_config(int dirfd, const char *name, const char *counter)
 
 #define engine_ptr(engines, n) (&engines->engine + (n))
 
+#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+
 static const char *class_display_name(unsigned int class)
 {
 	switch (class) {
@@ -439,40 +510,93 @@ static struct engines *discover_engines(char *device)
 	fd__; \
 })
 
-static int imc_parse(struct pmu_counter *pmu, const char *str)
+/* Prefix of all the sysfs and procfs paths read outside of the i915 PMU. */
+static const char *sys_root = "";
+
+static unsigned int imc_socket(struct engines *engines, int id)
 {
-	return pmu_parse(pmu, "/sys/devices/uncore_imc", str);
+	struct imc_socket *socket;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < engines->num_imc_sockets; i++) {
+		if (engines->imc_sockets[i].id == id)
+			return i;
+	}
+
+	engines->imc_sockets = realloc(engines->imc_sockets,
+				       (i + 1) * sizeof(*engines->imc_sockets));
+	assert(engines->imc_sockets);
+
+	socket = &engines->imc_sockets[i];
+	memset(socket, 0, sizeof(*socket));
+	socket->id = id;
+	ret = asprintf(&socket->name, "imc-socket%d", id);
+	assert(ret > 0);
+
+	socket->reads.present = true;
+	socket->reads.scale = 1.0 / (1024 * 1024);
+	socket->reads.units = "MiB";
+	socket->writes = socket->reads;
+
+	return engines->num_imc_sockets++;
 }
 
-static void
-imc_open(struct pmu_counter *pmu,
-	 const char *domain,
-	 struct engines *engines)
+/*
+ * Open the data read and write counters of every uncore memory controller on
+ * every socket. Counts are converted to bytes with the scale and unit of each
+ * event and summed per socket and in total, reported in MiB.
+ */
+static void imc_open(struct engines *engines)
 {
-	int fd;
+	struct igt_perf_imc *imc;
+	int n, i;
 
-	if (imc_parse(pmu, domain) < 0)
+	n = igt_perf_imc_discover(sys_root, &imc);
+	if (n <= 0)
 		return;
 
-	fd = igt_perf_open_group(pmu->type, pmu->config, engines->imc_fd);
-	if (fd < 0)
-		return;
+	engines->imc = calloc(n, sizeof(*engines->imc));
+	assert(engines->imc);
 
-	if (engines->imc_fd == -1)
-		engines->imc_fd = fd;
+	for (i = 0; i < n; i++) {
+		struct imc_group *group = &engines->imc[engines->num_imc];
+		int fd;
 
-	pmu->idx = engines->num_imc++;
-	pmu->present = true;
-}
+		group->reads_bytes = imc[i].reads.scale *
+				     igt_perf_unit_bytes(imc[i].reads.unit);
+		group->writes_bytes = imc[i].writes.scale *
+				      igt_perf_unit_bytes(imc[i].writes.unit);
+		if (!group->reads_bytes || !group->writes_bytes)
+			continue;
 
-static void imc_writes_open(struct pmu_counter *pmu, struct engines *engines)
-{
-	imc_open(pmu, "data_writes", engines);
-}
+		group->fd = igt_perf_event_open_cpu(&imc[i].reads, imc[i].cpu,
+						    -1);
+		if (group->fd < 0)
+			continue;
+		group->reads.idx = group->num++;
+		group->reads.present = true;
+
+		fd = igt_perf_event_open_cpu(&imc[i].writes, imc[i].cpu,
+					     group->fd);
+		if (fd >= 0) {
+			group->writes.idx = group->num++;
+			group->writes.present = true;
+		}
 
-static void imc_reads_open(struct pmu_counter *pmu, struct engines *engines)
-{
-	imc_open(pmu, "data_reads", engines);
+		group->socket = imc_socket(engines, imc[i].socket);
+		engines->num_imc++;
+	}
+
+	free(imc);
+
+	if (!engines->num_imc)
+		return;
+
+	engines->imc_reads.present = true;
+	engines->imc_reads.scale = 1.0 / (1024 * 1024);
+	engines->imc_reads.units = "MiB";
+	engines->imc_writes = engines->imc_reads;
 }
 
 static int pmu_init(struct engines *engines)
@@ -529,9 +653,7 @@ static int pmu_init(struct engines *engines)
 		pkg_power_open(&engines->r_pkg, engines);
 	}
 
-	engines->imc_fd = -1;
-	imc_reads_open(&engines->imc_reads, engines);
-	imc_writes_open(&engines->imc_writes, engines);
+	imc_open(engines);
 
 	return 0;
 }
@@ -590,6 +712,42 @@ static void update_sample(struct pmu_counter *counter, uint64_t *val)
 		__update_sample(counter, val[counter->idx]);
 }
 
+static void imc_sample(struct engines *engines)
+{
+	double reads = 0, writes = 0;
+	uint64_t val[2];
+	unsigned int i;
+
+	for (i = 0; i < engines->num_imc; i++) {
+		struct imc_group *group = &engines->imc[i];
+		struct imc_socket *socket = &engines->imc_sockets[group->socket];
+
+		pmu_read_multi(group->fd, group->num, val);
+		update_sample(&group->reads, val);
+		update_sample(&group->writes, val);
+
+		socket->read_bytes += (group->reads.val.cur -
+				       group->reads.val.prev) *
+				      group->reads_bytes;
+		if (group->writes.present)
+			socket->write_bytes += (group->writes.val.cur -
+						group->writes.val.prev) *
+					       group->writes_bytes;
+	}
+
+	for (i = 0; i < engines->num_imc_sockets; i++) {
+		struct imc_socket *socket = &engines->imc_sockets[i];
+
+		__update_sample(&socket->reads, socket->read_bytes);
+		__update_sample(&socket->writes, socket->write_bytes);
+		reads += socket->read_bytes;
+		writes += socket->write_bytes;
+	}
+
+	__update_sample(&engines->imc_reads, reads);
+	__update_sample(&engines->imc_writes, writes);
+}
+
 static void pmu_sample(struct engines *engines)
 {
 	const int num_val = engines->num_counters;
@@ -618,234 +776,1065 @@ static void pmu_sample(struct engines *engines)
 		update_sample(&engines->r_pkg, val);
 	}
 
-	if (engines->num_imc) {
-		pmu_read_multi(engines->imc_fd, engines->num_imc, val);
-		update_sample(&engines->imc_reads, val);
-		update_sample(&engines->imc_writes, val);
-	}
+	imc_sample(engines);
 }
 
-static const char *bars[] = { " ", "▏", "▎", "▍", "▌", "▋", "▊", "▉", "█" };
+static const struct backend i915_backend = {
+	.name = "i915",
+	.init = pmu_init,
+	.sample = pmu_sample,
+};
 
-static void
-print_percentage_bar(double percent, int max_len)
+__attribute__((format(printf,1,2)))
+static char *root_path(const char *fmt, ...)
 {
-	int bar_len = percent * (8 * (max_len - 2)) / 100.0;
-	int i;
-
-	putchar('|');
+	char *path, *full;
+	va_list ap;
+	int ret;
 
-	for (i = bar_len; i >= 8; i -= 8)
-		printf("%s", bars[8]);
-	if (i)
-		printf("%s", bars[i]);
+	va_start(ap, fmt);
+	ret = vasprintf(&path, fmt, ap);
+	va_end(ap);
+	assert(ret >= 0);
 
-	for (i = 0; i < (max_len - 2 - (bar_len + 7) / 8); i++)
-		putchar(' ');
+	ret = asprintf(&full, "%s%s", sys_root, path);
+	assert(ret >= 0);
+	free(path);
 
-	putchar('|');
+	return full;
 }
 
-#define DEFAULT_PERIOD_MS (1000)
-
-static void
-usage(const char *appname)
+static int read_u64(const char *path, uint64_t *val)
 {
-	printf("intel_gpu_top - Display a top-like summary of Intel GPU usage\n"
-		"\n"
-		"Usage: %s [parameters]\n"
-		"\n"
-		"\tThe following parameters are optional:\n\n"
-		"\t[-h]            Show this help text.\n"
-		"\t[-J]            Output JSON formatted data.\n"
-		"\t[-l]            List plain text data.\n"
-		"\t[-p]            Print in format of Prometheus metrics.\n"
-		"\t[-o <file|->]   Output to specified file or '-' for standard out.\n"
-		"\t[-s <ms>]       Refresh period in milliseconds (default %ums).\n"
-		"\t[-L]            List all cards.\n"
-		"\t[-d <device>]   Device filter, please check manual page for more details.\n"
-		"\n",
-		appname, DEFAULT_PERIOD_MS);
-	igt_device_print_filter_types();
-}
+	char buf[64];
+	ssize_t ret;
+	int fd;
 
-static enum {
-	INTERACTIVE,
-	STDOUT,
-	JSON,
-	PROMETHEUS
-} output_mode;
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
 
-struct cnt_item {
-	struct pmu_counter *pmu;
-	unsigned int fmt_width;
-	unsigned int fmt_precision;
-	double d;
-	double t;
-	double s;
-	const char *name;
-	const char *unit;
+	ret = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (ret <= 0)
+		return -EINVAL;
+	buf[ret] = '\0';
 
-	/* Internal fields. */
-	char buf[16];
-};
+	*val = strtoull(buf, NULL, 0);
 
-struct cnt_group {
-	const char *name;
-	const char *display_name;
-	struct cnt_item *items;
-};
+	return 0;
+}
 
-static unsigned int json_indent_level;
+/* Name of the kernel driver bound to a PCI device. */
+static char *pci_driver(const char *pci_slot_name)
+{
+	char *path, buf[PATH_MAX], *name;
+	ssize_t ret;
 
-static const char *json_indent[] = {
-	"",
-	"\t",
-	"\t\t",
-	"\t\t\t",
-	"\t\t\t\t",
-	"\t\t\t\t\t",
-};
+	path = root_path("/sys/bus/pci/devices/%s/driver", pci_slot_name);
+	ret = readlink(path, buf, sizeof(buf) - 1);
+	free(path);
+	if (ret <= 0)
+		return NULL;
+	buf[ret] = '\0';
 
-#define ARRAY_SIZE(arr) (sizeof(arr)/sizeof(arr[0]))
+	name = strrchr(buf, '/');
 
-static unsigned int json_prev_struct_members;
-static unsigned int json_struct_members;
+	return strdup(name ? name + 1 : buf);
+}
 
-FILE *out;
+#define MAX_FDINFO_ENGINES DRM_FDINFO_MAX_ENGINES
+
+struct fdinfo_client {
+	uint64_t id;
+	unsigned int generation;
+	uint64_t engine_ns[MAX_FDINFO_ENGINES];
+};
 
+/*
+ * Walk all the DRM file descriptors of all processes, calling fn for each
+ * one belonging to a client of our device.
+ */
 static void
-json_open_struct(const char *name)
+scan_drm_clients(struct engines *engines,
+		 void (*fn)(struct engines *engines,
+			    const struct drm_client_fdinfo *info))
 {
-	assert(json_indent_level < ARRAY_SIZE(json_indent));
+	struct igt_drm_clients_iter it;
+	struct drm_client_fdinfo info;
 
-	json_prev_struct_members = json_struct_members;
-	json_struct_members = 0;
+	if (igt_drm_clients_iter_init(&it, sys_root))
+		return;
 
-	if (name)
-		fprintf(out, "%s%s\"%s\": {\n",
-			json_prev_struct_members ? ",\n" : "",
-			json_indent[json_indent_level],
-			name);
-	else
-		fprintf(out, "%s\n%s{\n",
-			json_prev_struct_members ? "," : "",
-			json_indent[json_indent_level]);
+	while (igt_drm_clients_next_process(&it)) {
+		while (igt_drm_clients_next_fd(&it)) {
+			if (!igt_drm_clients_fd_is_drm(&it) ||
+			    !igt_drm_clients_fd_parse(&it, &info))
+				continue;
 
-	json_indent_level++;
+			if (strcmp(info.driver, engines->driver) ||
+			    (engines->pdev && strcmp(info.pdev, engines->pdev)))
+				continue;
+
+			fn(engines, &info);
+		}
+	}
+
+	igt_drm_clients_iter_fini(&it);
 }
 
-static void
-json_close_struct(void)
+static int fdinfo_engine_idx(struct engines *engines, const char *name)
 {
-	assert(json_indent_level > 0);
-
-	fprintf(out, "\n%s}", json_indent[--json_indent_level]);
+	for (unsigned int i = 0; i < engines->num_engines; i++) {
+		if (!strcmp(engine_ptr(engines, i)->name, name))
+			return i;
+	}
 
-	if (json_indent_level == 0)
-		fflush(stdout);
+	return -1;
 }
 
-static unsigned int
-json_add_member(const struct cnt_group *parent, struct cnt_item *item,
-		unsigned int headers)
+static struct engines *
+fdinfo_add_engine(struct engines *engines, const char *name)
 {
-	assert(json_indent_level < ARRAY_SIZE(json_indent));
+	struct engine *engine;
+	unsigned int i;
 
-	fprintf(out, "%s%s\"%s\": ",
-		json_struct_members ? ",\n" : "",
-		json_indent[json_indent_level], item->name);
+	if (fdinfo_engine_idx(engines, name) >= 0)
+		return engines;
 
-	json_struct_members++;
+	if (engines->num_engines == MAX_FDINFO_ENGINES)
+		return engines;
 
-	if (!strcmp(item->name, "unit"))
-		fprintf(out, "\"%s\"", item->unit);
-	else
-		fprintf(out, "%f",
-			pmu_calc(&item->pmu->val, item->d, item->t, item->s));
+	engines = realloc(engines, sizeof(struct engines) +
+			  (engines->num_engines + 1) * sizeof(struct engine));
+	assert(engines);
 
-	return 1;
-}
+	i = engines->num_engines++;
+	engine = engine_ptr(engines, i);
+	memset(engine, 0, sizeof(*engine));
 
-static unsigned int stdout_level;
+	engine->name = strdup(name);
+	engine->display_name = strdup(name);
+	engine->short_name = strdup(name);
+	assert(engine->name && engine->display_name && engine->short_name);
+	for (char *c = engine->short_name; *c; c++)
+		*c = toupper(*c);
 
-#define STDOUT_HEADER_REPEAT 20
-static unsigned int stdout_lines = STDOUT_HEADER_REPEAT;
+	/* Clients report one value per class, make each its own class. */
+	engine->class = i;
+	engine->instance = 0;
 
-static void
-stdout_open_struct(const char *name)
-{
-	stdout_level++;
-	assert(stdout_level > 0);
+	engines->class_names = realloc(engines->class_names,
+				       engines->num_engines *
+				       sizeof(*engines->class_names));
+	assert(engines->class_names);
+	engines->class_names[i] = engine->name;
+
+	return engines;
 }
 
+static struct engines *discovered;
+
 static void
-stdout_close_struct(void)
+fdinfo_discover_client(struct engines *engines,
+		       const struct drm_client_fdinfo *info)
 {
-	assert(stdout_level > 0);
-	if (--stdout_level == 0) {
-		stdout_lines++;
-		fputs("\n", out);
-		fflush(out);
-	}
+	for (unsigned int i = 0; i < info->num_engines; i++)
+		discovered = fdinfo_add_engine(discovered, info->engine[i].name);
 }
 
-static unsigned int
-stdout_add_member(const struct cnt_group *parent, struct cnt_item *item,
-		  unsigned int headers)
+static int fdinfo_init(struct engines *engines)
 {
-	unsigned int fmt_tot = item->fmt_width + (item->fmt_precision ? 1 : 0);
-	char buf[fmt_tot + 1];
-	double val;
-	int len;
+	engines->engine_ns = calloc(engines->num_engines,
+				    sizeof(*engines->engine_ns));
+	engines->engine_capacity = calloc(engines->num_engines,
+					  sizeof(*engines->engine_capacity));
+	assert(engines->engine_ns && engines->engine_capacity);
 
-	if (!item->pmu)
-		return 0;
-	else if (!item->pmu->present)
-		return 0;
+	for (unsigned int i = 0; i < engines->num_engines; i++) {
+		struct engine *engine = engine_ptr(engines, i);
 
-	if (headers == 1) {
-		unsigned int grp_tot = 0;
-		struct cnt_item *it;
+		engines->engine_capacity[i] = 1;
 
-		if (item != parent->items)
-			return 0;
+		engine->busy.present = true;
+		engine->busy.idx = i;
+		engine->num_counters = 1;
+	}
 
-		for (it = parent->items; it->pmu; it++) {
-			if (!it->pmu->present)
-				continue;
+	if (engines->hwmon_path) {
+		char *path;
+		uint64_t val;
 
-			grp_tot += 1 + it->fmt_width +
-				   (it->fmt_precision ? 1 : 0);
+		path = root_path("%s/power1_average", engines->hwmon_path);
+		if (read_u64(path, &val)) {
+			free(path);
+			path = root_path("%s/power1_input", engines->hwmon_path);
+		}
+		if (!read_u64(path, &val)) {
+			engines->r_gpu.present = true;
+			engines->r_gpu.scale = 1e-6; /* uJ */
+			engines->r_gpu.units = "Joules";
 		}
+		free(path);
 
-		fprintf(out, "%*s ", grp_tot - 1, parent->display_name);
-		return 0;
-	} else if (headers == 2) {
-		fprintf(out, "%*s ", fmt_tot, item->unit ?: item->name);
-		return 0;
+		path = root_path("%s/freq1_input", engines->hwmon_path);
+		engines->freq_act.present = !read_u64(path, &val);
+		free(path);
 	}
 
-	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
-
-	len = snprintf(buf, sizeof(buf), "%*.*f",
-		       fmt_tot, item->fmt_precision, val);
-	if (len < 0 || len == sizeof(buf))
-		fill_str(buf, sizeof(buf), 'X', fmt_tot);
-
-	len = fprintf(out, "%s ", buf);
+	imc_open(engines);
 
-	return len > 0 ? len : 0;
+	return 0;
 }
 
 static void
-term_open_struct(const char *name)
+fdinfo_sample_client(struct engines *engines,
+		     const struct drm_client_fdinfo *info)
 {
-}
+	struct fdinfo_client *client = NULL;
+	bool new_client = false;
 
-static void
-term_close_struct(void)
-{
+	for (unsigned int i = 0; i < engines->num_clients; i++) {
+		if (engines->clients[i].id == info->id) {
+			client = &engines->clients[i];
+			break;
+		}
+	}
+
+	/* Several fds may share one client. */
+	if (client && client->generation == engines->generation)
+		return;
+
+	if (!client) {
+		engines->clients = realloc(engines->clients,
+					   (engines->num_clients + 1) *
+					   sizeof(*engines->clients));
+		assert(engines->clients);
+
+		client = &engines->clients[engines->num_clients++];
+		memset(client, 0, sizeof(*client));
+		client->id = info->id;
+		new_client = true;
+	}
+
+	client->generation = engines->generation;
+
+	for (unsigned int i = 0; i < info->num_engines; i++) {
+		int idx = fdinfo_engine_idx(engines, info->engine[i].name);
+		uint64_t ns = info->engine[i].busy_ns;
+
+		if (idx < 0)
+			continue;
+
+		engines->engine_capacity[idx] = info->engine[i].capacity;
+
+		/*
+		 * Clients existing at startup only provide a baseline, those
+		 * which appeared since did all their work in this period.
+		 */
+		if ((!new_client || engines->ts.prev) && ns > client->engine_ns[idx])
+			engines->engine_ns[idx] +=
+				(ns - client->engine_ns[idx]) /
+				engines->engine_capacity[idx];
+		client->engine_ns[idx] = ns;
+	}
+}
+
+static void fdinfo_sample(struct engines *engines)
+{
+	struct timespec ts;
+	unsigned int i, j;
+	double dt;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	engines->ts.prev = engines->ts.cur;
+	engines->ts.cur = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	dt = engines->ts.prev ? (engines->ts.cur - engines->ts.prev) : 0;
+
+	engines->generation++;
+	scan_drm_clients(engines, fdinfo_sample_client);
+
+	/* Forget about clients which went away. */
+	for (i = 0, j = 0; i < engines->num_clients; i++) {
+		if (engines->clients[i].generation == engines->generation)
+			engines->clients[j++] = engines->clients[i];
+	}
+	engines->num_clients = j;
+
+	/*
+	 * The sysfs attributes are instant values, integrate them over the
+	 * period to fit the accumulating counter model.
+	 */
+	if (engines->gpu_busy_path) {
+		int idx = fdinfo_engine_idx(engines, "gpu");
+		uint64_t val;
+
+		if (idx >= 0 && !read_u64(engines->gpu_busy_path, &val))
+			engines->gpu_busy_ns += val * dt / 100;
+		if (idx >= 0)
+			engines->engine_ns[idx] = llround(engines->gpu_busy_ns);
+	}
+
+	if (engines->r_gpu.present) {
+		char *path;
+		uint64_t val;
+
+		path = root_path("%s/power1_average", engines->hwmon_path);
+		if (read_u64(path, &val)) {
+			free(path);
+			path = root_path("%s/power1_input", engines->hwmon_path);
+		}
+		if (!read_u64(path, &val))
+			engines->energy_uj += val * dt / 1e9;
+		free(path);
+
+		__update_sample(&engines->r_gpu, engines->energy_uj);
+	}
+
+	if (engines->freq_act.present) {
+		char *path;
+		uint64_t val;
+
+		path = root_path("%s/freq1_input", engines->hwmon_path);
+		if (!read_u64(path, &val))
+			engines->freq_mhz_s += val / 1e6 * dt / 1e9;
+		free(path);
+
+		__update_sample(&engines->freq_act, llround(engines->freq_mhz_s));
+	}
+
+	for (i = 0; i < engines->num_engines; i++)
+		__update_sample(&engine_ptr(engines, i)->busy,
+				engines->engine_ns[i]);
+
+	imc_sample(engines);
+}
+
+static const struct backend fdinfo_backend = {
+	.name = "drm-fdinfo",
+	.init = fdinfo_init,
+	.sample = fdinfo_sample,
+};
+
+/* Engines amdgpu reports in fdinfo, listed even when idle. */
+static const char *amdgpu_engines[] = {
+	"gfx", "compute", "dma", "dec", "enc", "enc_1", "jpeg",
+};
+
+static char *find_hwmon(const char *device_path)
+{
+	struct dirent *dent;
+	char *path, *hwmon = NULL;
+	DIR *d;
+
+	path = root_path("%s/hwmon", device_path);
+	d = opendir(path);
+	free(path);
+	if (!d)
+		return NULL;
+
+	while ((dent = readdir(d))) {
+		if (!strncmp(dent->d_name, "hwmon", 5)) {
+			int ret = asprintf(&hwmon, "%s/hwmon/%s",
+					   device_path, dent->d_name);
+
+			assert(ret >= 0);
+			break;
+		}
+	}
+	closedir(d);
+
+	return hwmon;
+}
+
+static struct engines *
+discover_fdinfo_engines(const char *driver, const char *pci_slot_name)
+{
+	struct engines *engines;
+	char *device_path;
+
+	engines = calloc(1, sizeof(struct engines));
+	if (!engines)
+		return NULL;
+
+	engines->backend = &fdinfo_backend;
+	engines->driver = strdup(driver);
+	engines->pdev = strdup(pci_slot_name);
+	engines->discrete = true;
+	engines->fd = -1;
+	engines->rapl_fd = -1;
+
+	if (!strcmp(driver, "amdgpu")) {
+		char *path;
+		uint64_t val;
+
+		for (unsigned int i = 0; i < ARRAY_SIZE(amdgpu_engines); i++)
+			engines = fdinfo_add_engine(engines, amdgpu_engines[i]);
+
+		if (asprintf(&device_path, "/sys/bus/pci/devices/%s",
+			     pci_slot_name) < 0)
+			device_path = NULL;
+		assert(device_path);
+
+		path = root_path("%s/gpu_busy_percent", device_path);
+		if (!read_u64(path, &val)) {
+			engines->gpu_busy_path = path;
+			engines = fdinfo_add_engine(engines, "gpu");
+		} else {
+			free(path);
+		}
+
+		engines->hwmon_path = find_hwmon(device_path);
+		free(device_path);
+	}
+
+	/* Plus whatever the current clients report. */
+	discovered = engines;
+	scan_drm_clients(engines, fdinfo_discover_client);
+	engines = discovered;
+	discovered = NULL;
+
+	if (!engines->num_engines) {
+		free(engines);
+		errno = ENOENT;
+		return NULL;
+	}
+
+	return engines;
+}
+
+/*
+ * EU, sampler and GTI metrics from the OA unit through i915 perf. The
+ * stream is opened with a period short enough that none of the 32 bit
+ * counters can wrap between two reports and each report is accumulated
+ * against the previous one as it is read, so a sample only costs the
+ * reports which arrived since the last one. With -R the reports come
+ * from an i915-perf-recorder file instead, replayed one refresh period
+ * of GPU time per sample.
+ */
+#define OA_PERIOD_NS (10 * 1000 * 1000)
+
+enum oa_metric {
+	OA_EU_ACTIVE,
+	OA_EU_STALL,
+	OA_SAMPLER_BUSY,
+	OA_GTI_READ,
+	OA_GTI_WRITE,
+	OA_NUM_METRICS,
+};
+
+static const struct {
+	const char *symbol_name;
+	bool bytes;
+} oa_metrics[OA_NUM_METRICS] = {
+	[OA_EU_ACTIVE] = { "EuActive" },
+	[OA_EU_STALL] = { "EuStall" },
+	[OA_SAMPLER_BUSY] = { "SamplersBusy" },
+	[OA_GTI_READ] = { "GtiReadThroughput", true },
+	[OA_GTI_WRITE] = { "GtiWriteThroughput", true },
+};
+
+struct oa_stream {
+	struct intel_perf *perf;
+	struct intel_perf_metric_set *metric_set;
+	struct intel_perf_logical_counter *counters[OA_NUM_METRICS];
+
+	int drm_fd;
+	int fd;
+	uint8_t *buf;
+	size_t buf_size;
+
+	/* Replay of a recording. */
+	struct intel_perf_data_reader *reader;
+	uint32_t next_record;
+	uint64_t period_ticks;
+
+	/* Copy of the last report, the base for the next delta. */
+	struct drm_i915_perf_record_header *last;
+	bool have_last;
+
+	/* Deltas since the previous sample. */
+	struct intel_perf_accumulator acc;
+
+	struct pmu_counter metrics[OA_NUM_METRICS];
+	double value[OA_NUM_METRICS];
+};
+
+static int
+oa_exponent_for_period(uint64_t timestamp_frequency, uint64_t period_ns)
+{
+	unsigned int i;
+
+	for (i = 0; i < 32; i++) {
+		uint64_t ns = 1000000000ull * (2ull << i) / timestamp_frequency;
+
+		if (ns > period_ns)
+			return i ? i - 1 : 0;
+	}
+
+	return -1;
+}
+
+static struct intel_perf_metric_set *
+oa_find_metric_set(struct intel_perf *perf, const char *name)
+{
+	struct intel_perf_metric_set *metric_set;
+
+	igt_list_for_each_entry(metric_set, &perf->metric_sets, link) {
+		if (!strcasecmp(metric_set->symbol_name, name))
+			return metric_set;
+	}
+
+	return NULL;
+}
+
+static struct oa_stream *oa_alloc(struct intel_perf *perf,
+				  struct intel_perf_metric_set *metric_set)
+{
+	struct oa_stream *oa;
+	unsigned int i;
+	int c;
+
+	oa = calloc(1, sizeof(*oa));
+	assert(oa);
+
+	oa->perf = perf;
+	oa->metric_set = metric_set;
+	oa->drm_fd = -1;
+	oa->fd = -1;
+
+	oa->last = calloc(1, sizeof(*oa->last) + metric_set->perf_raw_size);
+	assert(oa->last);
+
+	for (i = 0; i < OA_NUM_METRICS; i++) {
+		for (c = 0; c < metric_set->n_counters; c++) {
+			struct intel_perf_logical_counter *counter =
+				&metric_set->counters[c];
+
+			if (!strcmp(counter->symbol_name,
+				    oa_metrics[i].symbol_name)) {
+				oa->counters[i] = counter;
+				break;
+			}
+		}
+
+		/* Constant pair, the value is the scale of the item. */
+		oa->metrics[i].present = oa->counters[i];
+		oa->metrics[i].val.cur = 1;
+	}
+
+	return oa;
+}
+
+static void oa_free(struct oa_stream *oa)
+{
+	if (!oa)
+		return;
+
+	if (oa->reader) {
+		intel_perf_data_reader_fini(oa->reader);
+		free(oa->reader);
+	} else {
+		intel_perf_free(oa->perf);
+	}
+
+	if (oa->fd >= 0)
+		close(oa->fd);
+	if (oa->drm_fd >= 0)
+		close(oa->drm_fd);
+
+	free(oa->buf);
+	free(oa->last);
+	free(oa);
+}
+
+static struct oa_stream *oa_open(const char *device, const char *name)
+{
+	struct intel_perf_metric_set *metric_set;
+	struct drm_i915_perf_open_param param;
+	uint64_t properties[8];
+	struct intel_perf *perf;
+	struct oa_stream *oa;
+	int drm_fd, exponent;
+
+	drm_fd = open(device, O_RDWR | O_CLOEXEC);
+	if (drm_fd < 0) {
+		fprintf(stderr, "Failed to open %s! (%s)\n",
+			device, strerror(errno));
+		return NULL;
+	}
+
+	perf = intel_perf_for_fd(drm_fd);
+	if (!perf) {
+		fprintf(stderr, "No OA metrics for this device!\n");
+		close(drm_fd);
+		return NULL;
+	}
+	intel_perf_load_perf_configs(perf, drm_fd);
+
+	metric_set = oa_find_metric_set(perf, name);
+	if (!metric_set || !metric_set->perf_oa_metrics_set) {
+		fprintf(stderr, "Metric set '%s' is not available!\n", name);
+		intel_perf_free(perf);
+		close(drm_fd);
+		return NULL;
+	}
+
+	exponent = oa_exponent_for_period(perf->devinfo.timestamp_frequency,
+					  OA_PERIOD_NS);
+	assert(exponent >= 0);
+
+	properties[0] = DRM_I915_PERF_PROP_SAMPLE_OA;
+	properties[1] = true;
+	properties[2] = DRM_I915_PERF_PROP_OA_METRICS_SET;
+	properties[3] = metric_set->perf_oa_metrics_set;
+	properties[4] = DRM_I915_PERF_PROP_OA_FORMAT;
+	properties[5] = metric_set->perf_oa_format;
+	properties[6] = DRM_I915_PERF_PROP_OA_EXPONENT;
+	properties[7] = exponent;
+
+	memset(&param, 0, sizeof(param));
+	param.flags = I915_PERF_FLAG_FD_CLOEXEC | I915_PERF_FLAG_FD_NONBLOCK;
+	param.properties_ptr = (uintptr_t)properties;
+	param.num_properties = ARRAY_SIZE(properties) / 2;
+
+	oa = oa_alloc(perf, metric_set);
+	oa->drm_fd = drm_fd;
+
+	oa->fd = ioctl(drm_fd, DRM_IOCTL_I915_PERF_OPEN, &param);
+	if (oa->fd < 0) {
+		fprintf(stderr, "Failed to open the OA stream! (%s)\n",
+			strerror(errno));
+		oa_free(oa);
+		return NULL;
+	}
+
+	/* Room for a bit over a second of reports. */
+	oa->buf_size = (sizeof(struct drm_i915_perf_record_header) +
+			metric_set->perf_raw_size) *
+		       (2 * 1000000000ull / OA_PERIOD_NS);
+	oa->buf = malloc(oa->buf_size);
+	assert(oa->buf);
+
+	return oa;
+}
+
+static struct oa_stream *oa_replay(const char *path, unsigned int period_us)
+{
+	struct intel_perf_data_reader *reader;
+	struct oa_stream *oa;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to open %s! (%s)\n",
+			path, strerror(errno));
+		return NULL;
+	}
+
+	reader = calloc(1, sizeof(*reader));
+	assert(reader);
+
+	if (!intel_perf_data_reader_init(reader, fd)) {
+		fprintf(stderr, "Failed to read %s! (%s)\n",
+			path, reader->error_msg);
+		close(fd);
+		free(reader);
+		return NULL;
+	}
+	close(fd);
+
+	if (!reader->metric_set) {
+		fprintf(stderr, "Unknown metric set '%s' in %s!\n",
+			reader->metric_set_name, path);
+		intel_perf_data_reader_fini(reader);
+		free(reader);
+		return NULL;
+	}
+
+	oa = oa_alloc(reader->perf, reader->metric_set);
+	oa->reader = reader;
+	oa->period_ticks = (uint64_t)period_us *
+			   reader->devinfo.timestamp_frequency / 1000000;
+
+	return oa;
+}
+
+static uint32_t oa_report_timestamp(const struct drm_i915_perf_record_header *header)
+{
+	return ((const uint32_t *)(header + 1))[1];
+}
+
+static void oa_record(struct oa_stream *oa,
+		      const struct drm_i915_perf_record_header *header)
+{
+	struct intel_perf_accumulator delta;
+	unsigned int i;
+
+	switch (header->type) {
+	case DRM_I915_PERF_RECORD_SAMPLE:
+		if (oa->have_last) {
+			intel_perf_accumulate_reports(&delta,
+						      oa->metric_set->perf_oa_format,
+						      oa->last, header);
+			for (i = 0; i < ARRAY_SIZE(delta.deltas); i++)
+				oa->acc.deltas[i] += delta.deltas[i];
+		}
+
+		memcpy(oa->last, header, header->size);
+		oa->have_last = true;
+		break;
+	case DRM_I915_PERF_RECORD_OA_REPORT_LOST:
+	case DRM_I915_PERF_RECORD_OA_BUFFER_LOST:
+		/* Nothing to compute a delta against across the gap. */
+		oa->have_last = false;
+		break;
+	}
+}
+
+static void oa_read_stream(struct oa_stream *oa)
+{
+	for (;;) {
+		ssize_t len = read(oa->fd, oa->buf, oa->buf_size);
+		ssize_t offset = 0;
+
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			break;
+
+		while (offset < len) {
+			const struct drm_i915_perf_record_header *header =
+				(const void *)(oa->buf + offset);
+
+			oa_record(oa, header);
+			offset += header->size;
+		}
+	}
+}
+
+/*
+ * Feeds the next refresh period worth of GPU time from the recording,
+ * returns false once it has all been replayed.
+ */
+static bool oa_read_replay(struct oa_stream *oa)
+{
+	struct intel_perf_data_reader *reader = oa->reader;
+	bool started = oa->have_last;
+	uint64_t ticks = 0;
+
+	if (oa->next_record >= reader->n_records)
+		return false;
+
+	while (oa->next_record < reader->n_records) {
+		const struct drm_i915_perf_record_header *header =
+			reader->records[oa->next_record];
+
+		if (header->type == DRM_I915_PERF_RECORD_SAMPLE) {
+			/* The first sample only establishes the base. */
+			if (!started && oa->have_last)
+				break;
+
+			if (oa->have_last) {
+				uint64_t prev = ticks;
+
+				ticks += (uint32_t)(oa_report_timestamp(header) -
+						    oa_report_timestamp(oa->last));
+				if (prev && ticks > oa->period_ticks)
+					break;
+			}
+		}
+
+		oa_record(oa, header);
+		oa->next_record++;
+	}
+
+	return true;
+}
+
+static double oa_counter_read(struct oa_stream *oa,
+			      const struct intel_perf_logical_counter *counter)
+{
+	switch (counter->storage) {
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_DOUBLE:
+	case INTEL_PERF_LOGICAL_COUNTER_STORAGE_FLOAT:
+		return counter->read_float(oa->perf, oa->metric_set,
+					   oa->acc.deltas);
+	default:
+		return counter->read_uint64(oa->perf, oa->metric_set,
+					    oa->acc.deltas);
+	}
+}
+
+/*
+ * Turns the deltas accumulated since the previous call into the metric
+ * values, returns false when a replay has run out of reports.
+ */
+static bool oa_sample(struct oa_stream *oa)
+{
+	double gpu_time;
+	unsigned int i;
+
+	if (oa->reader) {
+		if (!oa_read_replay(oa))
+			return false;
+	} else {
+		oa_read_stream(oa);
+	}
+
+	gpu_time = (double)oa->acc.deltas[oa->metric_set->gpu_time_offset] /
+		   oa->perf->devinfo.timestamp_frequency;
+
+	for (i = 0; i < OA_NUM_METRICS; i++) {
+		double v;
+
+		if (!oa->counters[i] || gpu_time == 0.0) {
+			oa->value[i] = 0.0;
+			continue;
+		}
+
+		v = oa_counter_read(oa, oa->counters[i]);
+		if (oa_metrics[i].bytes)
+			v /= gpu_time;
+
+		oa->value[i] = v;
+	}
+
+	memset(&oa->acc, 0, sizeof(oa->acc));
+
+	return true;
+}
+
+static const char *bars[] = { " ", "▏", "▎", "▍", "▌", "▋", "▊", "▉", "█" };
+
+static void
+print_percentage_bar(double percent, int max_len)
+{
+	int bar_len = percent * (8 * (max_len - 2)) / 100.0;
+	int i;
+
+	putchar('|');
+
+	for (i = bar_len; i >= 8; i -= 8)
+		printf("%s", bars[8]);
+	if (i)
+		printf("%s", bars[i]);
+
+	for (i = 0; i < (max_len - 2 - (bar_len + 7) / 8); i++)
+		putchar(' ');
+
+	putchar('|');
+}
+
+#define DEFAULT_PERIOD_MS (1000)
+
+static void
+usage(const char *appname)
+{
+	printf("intel_gpu_top - Display a top-like summary of Intel GPU usage\n"
+		"\n"
+		"Usage: %s [parameters]\n"
+		"\n"
+		"\tThe following parameters are optional:\n\n"
+		"\t[-h]            Show this help text.\n"
+		"\t[-J]            Output JSON formatted data.\n"
+		"\t[-l]            List plain text data.\n"
+		"\t[-p]            Print in format of Prometheus metrics.\n"
+		"\t[-P <sink>]     Push metrics to a sink, can be repeated. One of\n"
+		"\t                statsd:<uri>, influx:<uri> or textfile:<path>,\n"
+		"\t                with <uri> udp://host:port, unix://path or\n"
+		"\t                unixgram://path.\n"
+		"\t[-n <samples>]  Exit after this many samples.\n"
+		"\t[-o <file|->]   Output to specified file or '-' for standard out.\n"
+		"\t[-s <ms>]       Refresh period in milliseconds (default %ums).\n"
+		"\t[-L]            List all cards.\n"
+		"\t[-d <device>]   Device filter, please check manual page for more details.\n"
+		"\t[-r <dir>]      Read sysfs and procfs under <dir>, selecting the device\n"
+		"\t                by PCI slot name with -d (non-i915 devices only).\n"
+		"\t[-O <set>]      Show EU, sampler and GTI metrics from the OA unit using\n"
+		"\t                this metric set, e.g. RenderBasic (i915 only).\n"
+		"\t[-R <file>]     Replay the OA metrics from an i915-perf-recorder file.\n"
+		"\n",
+		appname, DEFAULT_PERIOD_MS);
+	igt_device_print_filter_types();
+}
+
+static enum {
+	INTERACTIVE,
+	STDOUT,
+	JSON,
+	PROMETHEUS,
+	PUSH
+} output_mode;
+
+struct cnt_item {
+	struct pmu_counter *pmu;
+	unsigned int fmt_width;
+	unsigned int fmt_precision;
+	double d;
+	double t;
+	double s;
+	const char *name;
+	const char *unit;
+
+	/* Internal fields. */
+	char buf[16];
+};
+
+struct cnt_group {
+	const char *name;
+	const char *display_name;
+	struct cnt_item *items;
+};
+
+static unsigned int json_indent_level;
+
+static const char *json_indent[] = {
+	"",
+	"\t",
+	"\t\t",
+	"\t\t\t",
+	"\t\t\t\t",
+	"\t\t\t\t\t",
+};
+
+static unsigned int json_prev_struct_members;
+static unsigned int json_struct_members;
+
+FILE *out;
+
+static void
+json_open_struct(const char *name)
+{
+	assert(json_indent_level < ARRAY_SIZE(json_indent));
+
+	json_prev_struct_members = json_struct_members;
+	json_struct_members = 0;
+
+	if (name)
+		fprintf(out, "%s%s\"%s\": {\n",
+			json_prev_struct_members ? ",\n" : "",
+			json_indent[json_indent_level],
+			name);
+	else
+		fprintf(out, "%s\n%s{\n",
+			json_prev_struct_members ? "," : "",
+			json_indent[json_indent_level]);
+
+	json_indent_level++;
+}
+
+static void
+json_close_struct(void)
+{
+	assert(json_indent_level > 0);
+
+	fprintf(out, "\n%s}", json_indent[--json_indent_level]);
+
+	if (json_indent_level == 0)
+		fflush(stdout);
+}
+
+static unsigned int
+json_add_member(const struct cnt_group *parent, struct cnt_item *item,
+		unsigned int headers)
+{
+	assert(json_indent_level < ARRAY_SIZE(json_indent));
+
+	fprintf(out, "%s%s\"%s\": ",
+		json_struct_members ? ",\n" : "",
+		json_indent[json_indent_level], item->name);
+
+	json_struct_members++;
+
+	if (!strcmp(item->name, "unit"))
+		fprintf(out, "\"%s\"", item->unit);
+	else
+		fprintf(out, "%f",
+			pmu_calc(&item->pmu->val, item->d, item->t, item->s));
+
+	return 1;
+}
+
+static unsigned int stdout_level;
+
+#define STDOUT_HEADER_REPEAT 20
+static unsigned int stdout_lines = STDOUT_HEADER_REPEAT;
+
+static void
+stdout_open_struct(const char *name)
+{
+	stdout_level++;
+	assert(stdout_level > 0);
+}
+
+static void
+stdout_close_struct(void)
+{
+	assert(stdout_level > 0);
+	if (--stdout_level == 0) {
+		stdout_lines++;
+		fputs("\n", out);
+		fflush(out);
+	}
+}
+
+static unsigned int
+stdout_add_member(const struct cnt_group *parent, struct cnt_item *item,
+		  unsigned int headers)
+{
+	unsigned int fmt_tot = item->fmt_width + (item->fmt_precision ? 1 : 0);
+	char buf[fmt_tot + 1];
+	double val;
+	int len;
+
+	if (!item->pmu)
+		return 0;
+	else if (!item->pmu->present)
+		return 0;
+
+	if (headers == 1) {
+		unsigned int grp_tot = 0;
+		struct cnt_item *it;
+
+		if (item != parent->items)
+			return 0;
+
+		for (it = parent->items; it->pmu; it++) {
+			if (!it->pmu->present)
+				continue;
+
+			grp_tot += 1 + it->fmt_width +
+				   (it->fmt_precision ? 1 : 0);
+		}
+
+		fprintf(out, "%*s ", grp_tot - 1, parent->display_name);
+		return 0;
+	} else if (headers == 2) {
+		fprintf(out, "%*s ", fmt_tot, item->unit ?: item->name);
+		return 0;
+	}
+
+	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+
+	len = snprintf(buf, sizeof(buf), "%*.*f",
+		       fmt_tot, item->fmt_precision, val);
+	if (len < 0 || len == sizeof(buf))
+		fill_str(buf, sizeof(buf), 'X', fmt_tot);
+
+	len = fprintf(out, "%s ", buf);
+
+	return len > 0 ? len : 0;
+}
+
+static void
+term_open_struct(const char *name)
+{
+}
+
+static void
+term_close_struct(void)
+{
 }
 
 static void
@@ -860,177 +1849,633 @@ prometheus_close_struct(void)
 
 
 
-static unsigned int
-prometheus_add_member(const struct cnt_group *parent, struct cnt_item *item,
-		  unsigned int headers)
+static unsigned int
+prometheus_add_member(const struct cnt_group *parent, struct cnt_item *item,
+		  unsigned int headers)
+{
+	double val;
+	int len;
+	char parent_name_key[20];
+	char item_name_key[20];
+
+	if (!item->pmu)
+		return 0;
+	else if (!item->pmu->present)
+		return 0;
+	snprintf(parent_name_key, sizeof(parent_name_key), "%s", parent->name);
+	for (int i = 0; parent_name_key[i]; i++) {
+		parent_name_key[i] = tolower(parent_name_key[i]);
+		if (!(
+			(parent_name_key[i] >= '0' && parent_name_key[i] <= '9') ||
+			(parent_name_key[i] >= 'a' && parent_name_key[i] <= 'z')
+		)) {
+			parent_name_key[i] = '_';
+		}
+	}
+	snprintf(item_name_key, sizeof(item_name_key), "%s", item->name);
+	for (int i = 0; parent_name_key[i]; i++) {
+		item_name_key[i] = tolower(item_name_key[i]);
+	}
+
+	fprintf(out, "# HELP intel_gpu_top_%s_%s %s %s", parent_name_key, item_name_key, parent->display_name, item->name);
+	if (item->unit) {
+		fprintf(out, " (%s)", item->unit);
+	}
+	fprintf(out, "\n");
+	fprintf(out, "# TYPE intel_gpu_top_%s_%s gauge\n", parent_name_key, item_name_key);
+
+	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+
+	len = fprintf(out, "intel_gpu_top_%s_%s %f\n", parent_name_key, item_name_key, val);
+
+	return len > 0 ? len : 0;
+}
+
+static unsigned int
+term_add_member(const struct cnt_group *parent, struct cnt_item *item,
+		unsigned int headers)
+{
+	unsigned int fmt_tot = item->fmt_width + (item->fmt_precision ? 1 : 0);
+	double val;
+	int len;
+
+	if (!item->pmu)
+		return 0;
+
+	assert(fmt_tot <= sizeof(item->buf));
+
+	if (!item->pmu->present) {
+		fill_str(item->buf, sizeof(item->buf), '-', fmt_tot);
+		return 1;
+	}
+
+	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+	len = snprintf(item->buf, sizeof(item->buf),
+		       "%*.*f",
+		       fmt_tot, item->fmt_precision, val);
+
+	if (len < 0 || len == sizeof(item->buf))
+		fill_str(item->buf, sizeof(item->buf), 'X', fmt_tot);
+
+	return 1;
+}
+
+struct print_operations {
+	void (*open_struct)(const char *name);
+	void (*close_struct)(void);
+	unsigned int (*add_member)(const struct cnt_group *parent,
+				   struct cnt_item *item,
+				   unsigned int headers);
+	bool (*print_group)(struct cnt_group *group, unsigned int headers);
+};
+
+static const struct print_operations *pops;
+
+static unsigned int
+present_in_group(const struct cnt_group *grp)
+{
+	unsigned int present = 0;
+	struct cnt_item *item;
+
+	for (item = grp->items; item->name; item++) {
+		if (item->pmu && item->pmu->present)
+			present++;
+	}
+
+	return present;
+}
+
+static bool
+print_group(struct cnt_group *grp, unsigned int headers)
+{
+	unsigned int consumed = 0;
+	struct cnt_item *item;
+
+	if (!present_in_group(grp))
+		return false;
+
+	pops->open_struct(grp->name);
+
+	for (item = grp->items; item->name; item++)
+		consumed += pops->add_member(grp, item, headers);
+
+	pops->close_struct();
+
+	return consumed;
+}
+
+static bool
+prometheus_print_group(struct cnt_group *grp, unsigned int headers)
+{
+	unsigned int consumed = 0;
+	struct cnt_item *item;
+
+	if (!present_in_group(grp))
+		return false;
+
+	pops->open_struct(grp->name);
+
+	for (item = grp->items; item->name; item++)
+		consumed += pops->add_member(grp, item, headers);
+
+	pops->close_struct();
+
+	return consumed;
+}
+
+static bool
+term_print_group(struct cnt_group *grp, unsigned int headers)
+{
+	unsigned int consumed = 0;
+	struct cnt_item *item;
+
+	pops->open_struct(grp->name);
+
+	for (item = grp->items; item->name; item++)
+		consumed += pops->add_member(grp, item, headers);
+
+	pops->close_struct();
+
+	return consumed;
+}
+
+static const struct print_operations json_pops = {
+	.open_struct = json_open_struct,
+	.close_struct = json_close_struct,
+	.add_member = json_add_member,
+	.print_group = print_group,
+};
+
+static const struct print_operations stdout_pops = {
+	.open_struct = stdout_open_struct,
+	.close_struct = stdout_close_struct,
+	.add_member = stdout_add_member,
+	.print_group = print_group,
+};
+
+static const struct print_operations prometheus_pops = {
+	.open_struct = prometheus_open_struct,
+	.close_struct = prometheus_close_struct,
+	.add_member = prometheus_add_member,
+	.print_group = prometheus_print_group,
+};
+
+/*
+ * Push sinks. Every sample is rendered into the buffer of each sink, which
+ * coalesces them and sends whole packets, either when the next line would
+ * not fit or when the flush interval expires. Sockets are non-blocking and a
+ * batch which can't be sent right away is dropped and counted rather than
+ * stalling the sampling loop.
+ */
+enum sink_format {
+	SINK_STATSD,
+	SINK_INFLUX,
+	SINK_TEXTFILE,
+};
+
+#define PUSH_UDP_PAYLOAD (1432)
+#define PUSH_UNIXGRAM_PAYLOAD (8192)
+#define PUSH_STREAM_BUFFER (64 * 1024)
+#define PUSH_FLUSH_MS (1000)
+#define MAX_PUSH_SINKS (8)
+
+struct push_sink {
+	enum sink_format format;
+	const char *spec;
+
+	/* Socket sinks. */
+	int fd;
+	int socktype;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+
+	/* Textfile sink. */
+	char *path;
+	char *tmp_path;
+
+	/* Payload limit of one packet, 0 for streams. */
+	size_t mtu;
+
+	/* Unsent data starts at off, everything before was already sent. */
+	char *buf;
+	size_t size;
+	size_t len;
+	size_t off;
+
+	unsigned long dropped;
+};
+
+static struct push_sink push_sinks[MAX_PUSH_SINKS];
+static unsigned int num_push_sinks;
+
+struct push_value {
+	char group[32];
+	char item[32];
+	double val;
+};
+
+static struct push_value *push_values;
+static unsigned int num_push_values, max_push_values;
+static const char *push_device;
+
+static int push_parse_addr(struct push_sink *sink, const char *uri)
+{
+	if (!strncmp(uri, "udp://", 6)) {
+		struct addrinfo hints = {
+			.ai_family = AF_UNSPEC,
+			.ai_socktype = SOCK_DGRAM,
+		};
+		struct addrinfo *res;
+		char host[256], *port;
+
+		snprintf(host, sizeof(host), "%s", uri + 6);
+		port = strrchr(host, ':');
+		if (!port)
+			return -EINVAL;
+		*port++ = '\0';
+
+		/* [::1]:8125 */
+		if (host[0] == '[' && port[-2] == ']') {
+			port[-2] = '\0';
+			memmove(host, host + 1, strlen(host));
+		}
+
+		if (getaddrinfo(host, port, &hints, &res))
+			return -EINVAL;
+
+		memcpy(&sink->addr, res->ai_addr, res->ai_addrlen);
+		sink->addrlen = res->ai_addrlen;
+		freeaddrinfo(res);
+
+		sink->socktype = SOCK_DGRAM;
+		sink->mtu = PUSH_UDP_PAYLOAD;
+	} else if (!strncmp(uri, "unix://", 7) ||
+		   !strncmp(uri, "unixgram://", 11)) {
+		struct sockaddr_un *sun = (struct sockaddr_un *)&sink->addr;
+		const char *path = strstr(uri, "://") + 3;
+
+		if (strlen(path) >= sizeof(sun->sun_path))
+			return -ENAMETOOLONG;
+
+		sun->sun_family = AF_UNIX;
+		strcpy(sun->sun_path, path);
+		sink->addrlen = sizeof(*sun);
+
+		if (uri[4] == 'g') {
+			sink->socktype = SOCK_DGRAM;
+			sink->mtu = PUSH_UNIXGRAM_PAYLOAD;
+		} else {
+			sink->socktype = SOCK_STREAM;
+			sink->mtu = 0;
+		}
+	} else {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * statsd:<uri>, influx:<uri> or textfile:<path>, with <uri> one of
+ * udp://host:port, unix://path or unixgram://path.
+ */
+static int push_add_sink(const char *spec)
+{
+	struct push_sink *sink;
+	const char *uri;
+	int ret;
+
+	if (num_push_sinks == MAX_PUSH_SINKS)
+		return -ENOSPC;
+
+	sink = &push_sinks[num_push_sinks];
+	memset(sink, 0, sizeof(*sink));
+	sink->spec = spec;
+	sink->fd = -1;
+
+	uri = strchr(spec, ':');
+	if (!uri)
+		return -EINVAL;
+	uri++;
+
+	if (!strncmp(spec, "statsd:", 7)) {
+		sink->format = SINK_STATSD;
+	} else if (!strncmp(spec, "influx:", 7)) {
+		sink->format = SINK_INFLUX;
+	} else if (!strncmp(spec, "textfile:", 9)) {
+		sink->format = SINK_TEXTFILE;
+		sink->path = strdup(uri);
+		ret = asprintf(&sink->tmp_path, "%s.%d.tmp", uri, getpid());
+		assert(ret > 0);
+	} else {
+		return -EINVAL;
+	}
+
+	if (sink->format != SINK_TEXTFILE) {
+		ret = push_parse_addr(sink, uri);
+		if (ret)
+			return ret;
+	}
+
+	sink->size = sink->mtu ?: PUSH_STREAM_BUFFER;
+	sink->buf = malloc(sink->size);
+	assert(sink->buf);
+
+	num_push_sinks++;
+
+	return 0;
+}
+
+static bool push_connect(struct push_sink *sink)
+{
+	if (sink->fd >= 0)
+		return true;
+
+	sink->fd = socket(sink->addr.ss_family,
+			  sink->socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (sink->fd < 0)
+		return false;
+
+	if (connect(sink->fd, (struct sockaddr *)&sink->addr,
+		    sink->addrlen)) {
+		close(sink->fd);
+		sink->fd = -1;
+		return false;
+	}
+
+	return true;
+}
+
+static void push_disconnect(struct push_sink *sink)
+{
+	close(sink->fd);
+	sink->fd = -1;
+}
+
+static void push_write_textfile(struct push_sink *sink)
+{
+	int fd;
+
+	fd = open(sink->tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		  0644);
+	if (fd < 0) {
+		sink->dropped++;
+		return;
+	}
+
+	/* Readers see either the old or the new file, never a partial one. */
+	if (write(fd, sink->buf, sink->len) != (ssize_t)sink->len ||
+	    close(fd) || rename(sink->tmp_path, sink->path)) {
+		unlink(sink->tmp_path);
+		sink->dropped++;
+	}
+}
+
+static void push_send(struct push_sink *sink)
 {
-	double val;
-	int len;
-	char parent_name_key[20];
-	char item_name_key[20];
+	ssize_t ret;
 
-	if (!item->pmu)
-		return 0;
-	else if (!item->pmu->present)
-		return 0;
-	snprintf(parent_name_key, sizeof(parent_name_key), "%s", parent->name);
-	for (int i = 0; parent_name_key[i]; i++) {
-		parent_name_key[i] = tolower(parent_name_key[i]);
-		if (!(
-			(parent_name_key[i] >= '0' && parent_name_key[i] <= '9') ||
-			(parent_name_key[i] >= 'a' && parent_name_key[i] <= 'z')
-		)) {
-			parent_name_key[i] = '_';
-		}
+	if (sink->format == SINK_TEXTFILE) {
+		if (sink->len)
+			push_write_textfile(sink);
+		return;
 	}
-	snprintf(item_name_key, sizeof(item_name_key), "%s", item->name);
-	for (int i = 0; parent_name_key[i]; i++) {
-		item_name_key[i] = tolower(item_name_key[i]);
+
+	if (sink->len == sink->off)
+		return;
+
+	if (!push_connect(sink)) {
+		sink->dropped++;
+		sink->len = sink->off = 0;
+		return;
 	}
 
-	fprintf(out, "# HELP intel_gpu_top_%s_%s %s %s", parent_name_key, item_name_key, parent->display_name, item->name);
-	if (item->unit) {
-		fprintf(out, " (%s)", item->unit);
+	ret = send(sink->fd, sink->buf + sink->off, sink->len - sink->off,
+		   MSG_DONTWAIT | MSG_NOSIGNAL);
+	if (ret < 0) {
+		/* Streams keep the data for the next flush until full. */
+		if ((errno == EAGAIN || errno == ENOBUFS || errno == EINTR) &&
+		    sink->socktype == SOCK_STREAM)
+			return;
+
+		/* Receiver gone, try to reconnect on the next flush. */
+		if (errno != EAGAIN && errno != ENOBUFS && errno != EINTR)
+			push_disconnect(sink);
+
+		sink->dropped++;
+		sink->len = sink->off = 0;
+		return;
 	}
-	fprintf(out, "\n");
-	fprintf(out, "# TYPE intel_gpu_top_%s_%s gauge\n", parent_name_key, item_name_key);
 
-	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+	sink->off += ret;
+	if (sink->off < sink->len)
+		return;
 
-	len = fprintf(out, "intel_gpu_top_%s_%s %f\n", parent_name_key, item_name_key, val);
+	sink->len = sink->off = 0;
+}
 
-	return len > 0 ? len : 0;
+static void push_append(struct push_sink *sink, const char *line, size_t len)
+{
+	/* Datagrams carry whole lines, send what fits and start a new one. */
+	if (sink->mtu && sink->len + len > sink->mtu)
+		push_send(sink);
+
+	if (sink->off && sink->len + len > sink->size) {
+		memmove(sink->buf, sink->buf + sink->off, sink->len - sink->off);
+		sink->len -= sink->off;
+		sink->off = 0;
+	}
+
+	if (sink->len + len > sink->size) {
+		sink->dropped++;
+		return;
+	}
+
+	memcpy(sink->buf + sink->len, line, len);
+	sink->len += len;
 }
 
-static unsigned int
-term_add_member(const struct cnt_group *parent, struct cnt_item *item,
-		unsigned int headers)
+__attribute__((format(printf, 2, 3)))
+static void push_printf(struct push_sink *sink, const char *fmt, ...)
 {
-	unsigned int fmt_tot = item->fmt_width + (item->fmt_precision ? 1 : 0);
-	double val;
+	char line[512];
+	va_list ap;
 	int len;
 
-	if (!item->pmu)
-		return 0;
-
-	assert(fmt_tot <= sizeof(item->buf));
+	va_start(ap, fmt);
+	len = vsnprintf(line, sizeof(line), fmt, ap);
+	va_end(ap);
 
-	if (!item->pmu->present) {
-		fill_str(item->buf, sizeof(item->buf), '-', fmt_tot);
-		return 1;
+	if (len < 0 || len >= (int)sizeof(line)) {
+		sink->dropped++;
+		return;
 	}
 
-	val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
-	len = snprintf(item->buf, sizeof(item->buf),
-		       "%*.*f",
-		       fmt_tot, item->fmt_precision, val);
+	push_append(sink, line, len);
+}
 
-	if (len < 0 || len == sizeof(item->buf))
-		fill_str(item->buf, sizeof(item->buf), 'X', fmt_tot);
+static void push_key(char *dst, size_t size, const char *src)
+{
+	size_t i;
 
-	return 1;
+	for (i = 0; src[i] && i < size - 1; i++)
+		dst[i] = isalnum(src[i]) ? tolower(src[i]) : '_';
+	dst[i] = '\0';
 }
 
-struct print_operations {
-	void (*open_struct)(const char *name);
-	void (*close_struct)(void);
-	unsigned int (*add_member)(const struct cnt_group *parent,
-				   struct cnt_item *item,
-				   unsigned int headers);
-	bool (*print_group)(struct cnt_group *group, unsigned int headers);
-};
+static void push_open_struct(const char *name)
+{
+}
 
-static const struct print_operations *pops;
+static void push_close_struct(void)
+{
+}
 
 static unsigned int
-present_in_group(const struct cnt_group *grp)
+push_add_member(const struct cnt_group *parent, struct cnt_item *item,
+		unsigned int headers)
 {
-	unsigned int present = 0;
-	struct cnt_item *item;
+	struct push_value *value;
 
-	for (item = grp->items; item->name; item++) {
-		if (item->pmu && item->pmu->present)
-			present++;
+	if (!item->pmu || !item->pmu->present)
+		return 0;
+
+	if (num_push_values == max_push_values) {
+		max_push_values = max_push_values * 2 ?: 32;
+		push_values = realloc(push_values,
+				      max_push_values * sizeof(*push_values));
+		assert(push_values);
 	}
 
-	return present;
+	value = &push_values[num_push_values++];
+	push_key(value->group, sizeof(value->group), parent->name);
+	push_key(value->item, sizeof(value->item), item->name);
+	value->val = pmu_calc(&item->pmu->val, item->d, item->t, item->s);
+
+	return 1;
 }
 
-static bool
-print_group(struct cnt_group *grp, unsigned int headers)
+static void push_render(struct push_sink *sink, uint64_t ts)
 {
-	unsigned int consumed = 0;
-	struct cnt_item *item;
+	unsigned int i, j;
 
-	if (!present_in_group(grp))
-		return false;
+	switch (sink->format) {
+	case SINK_STATSD:
+		for (i = 0; i < num_push_values; i++)
+			push_printf(sink, "intel_gpu_top.%s.%s:%g|g\n",
+				    push_values[i].group, push_values[i].item,
+				    push_values[i].val);
+		break;
 
-	pops->open_struct(grp->name);
+	case SINK_INFLUX:
+		/* One line per group, the items as its fields. */
+		for (i = 0; i < num_push_values; i = j) {
+			char line[512];
+			int len;
+
+			len = snprintf(line, sizeof(line),
+				       "intel_gpu_top,device=%s,group=%s ",
+				       push_device, push_values[i].group);
+
+			for (j = i; j < num_push_values &&
+			     !strcmp(push_values[j].group,
+				     push_values[i].group); j++)
+				len += snprintf(line + len,
+						len < (int)sizeof(line) ?
+						sizeof(line) - len : 0,
+						"%s%s=%g", j == i ? "" : ",",
+						push_values[j].item,
+						push_values[j].val);
+
+			len += snprintf(line + len,
+					len < (int)sizeof(line) ?
+					sizeof(line) - len : 0,
+					" %"PRIu64"\n", ts);
+
+			if (len < (int)sizeof(line))
+				push_append(sink, line, len);
+			else
+				sink->dropped++;
+		}
+		break;
 
-	for (item = grp->items; item->name; item++)
-		consumed += pops->add_member(grp, item, headers);
+	case SINK_TEXTFILE:
+		/* A snapshot of the latest sample only. */
+		sink->len = 0;
+		for (i = 0; i < num_push_values; i++)
+			push_printf(sink,
+				    "# TYPE intel_gpu_top_%s_%s gauge\n"
+				    "intel_gpu_top_%s_%s{device=\"%s\"} %f\n",
+				    push_values[i].group, push_values[i].item,
+				    push_values[i].group, push_values[i].item,
+				    push_device, push_values[i].val);
+		break;
+	}
+}
 
-	pops->close_struct();
+static void push_flush(void)
+{
+	unsigned int i;
 
-	return consumed;
+	for (i = 0; i < num_push_sinks; i++)
+		push_send(&push_sinks[i]);
 }
 
-static bool
-prometheus_print_group(struct cnt_group *grp, unsigned int headers)
+/* Hand the values collected by push_add_member() over to the sinks. */
+static void push_sample(unsigned int period_us)
 {
-	unsigned int consumed = 0;
-	struct cnt_item *item;
-
-	if (!present_in_group(grp))
-		return false;
+	static struct timespec last_flush;
+	unsigned int interval_ms = period_us / 1000;
+	struct timespec now;
+	unsigned int i;
 
-	pops->open_struct(grp->name);
+	if (interval_ms < PUSH_FLUSH_MS)
+		interval_ms = PUSH_FLUSH_MS;
 
-	for (item = grp->items; item->name; item++)
-		consumed += pops->add_member(grp, item, headers);
+	clock_gettime(CLOCK_REALTIME, &now);
 
-	pops->close_struct();
+	for (i = 0; i < num_push_sinks; i++)
+		push_render(&push_sinks[i],
+			    now.tv_sec * 1000000000ull + now.tv_nsec);
+	num_push_values = 0;
 
-	return consumed;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	if ((now.tv_sec - last_flush.tv_sec) * 1000 +
+	    (now.tv_nsec - last_flush.tv_nsec) / 1000000 >= interval_ms) {
+		push_flush();
+		last_flush = now;
+	}
 }
 
-static bool
-term_print_group(struct cnt_group *grp, unsigned int headers)
+static void push_fini(void)
 {
-	unsigned int consumed = 0;
-	struct cnt_item *item;
+	unsigned int i;
 
-	pops->open_struct(grp->name);
+	push_flush();
 
-	for (item = grp->items; item->name; item++)
-		consumed += pops->add_member(grp, item, headers);
+	for (i = 0; i < num_push_sinks; i++) {
+		struct push_sink *sink = &push_sinks[i];
 
-	pops->close_struct();
+		if (sink->dropped)
+			fprintf(stderr, "%s: %lu batches dropped\n",
+				sink->spec, sink->dropped);
+		if (sink->fd >= 0)
+			close(sink->fd);
+		free(sink->buf);
+		free(sink->path);
+		free(sink->tmp_path);
+	}
 
-	return consumed;
+	free(push_values);
 }
 
-static const struct print_operations json_pops = {
-	.open_struct = json_open_struct,
-	.close_struct = json_close_struct,
-	.add_member = json_add_member,
-	.print_group = print_group,
-};
-
-static const struct print_operations stdout_pops = {
-	.open_struct = stdout_open_struct,
-	.close_struct = stdout_close_struct,
-	.add_member = stdout_add_member,
+static const struct print_operations push_pops = {
+	.open_struct = push_open_struct,
+	.close_struct = push_close_struct,
+	.add_member = push_add_member,
 	.print_group = print_group,
 };
 
-static const struct print_operations prometheus_pops = {
-	.open_struct = prometheus_open_struct,
-	.close_struct = prometheus_close_struct,
-	.add_member = prometheus_add_member,
-	.print_group = prometheus_print_group,
-};
-
 static const struct print_operations term_pops = {
 	.open_struct = term_open_struct,
 	.close_struct = term_close_struct,
@@ -1170,10 +2615,11 @@ print_imc(struct engines *engines, double t, int lines, int con_w, int con_h)
 		.name = "imc-bandwidth",
 		.items = imc_items,
 	};
-	struct cnt_group *groups[] = {
-		&imc_group,
-		NULL
-	};
+	unsigned int num_sockets = engines->num_imc_sockets;
+	struct cnt_group *groups[num_sockets + 2];
+	struct cnt_group socket_groups[num_sockets + 1];
+	struct cnt_item socket_items[num_sockets + 1][4];
+	unsigned int i;
 	int ret;
 
 	if (!engines->num_imc)
@@ -1187,6 +2633,37 @@ print_imc(struct engines *engines, double t, int lines, int con_w, int con_h)
 			engines->imc_reads.units);
 	assert(ret >= 0);
 
+	groups[0] = &imc_group;
+
+	/* Break it down per socket only when there is more than one. */
+	if (num_sockets < 2)
+		num_sockets = 0;
+
+	for (i = 0; i < num_sockets; i++) {
+		struct imc_socket *socket = &engines->imc_sockets[i];
+		struct cnt_item items[] = {
+			{ &socket->reads, 6, 0, 1.0, t, socket->reads.scale,
+			  "reads", "rd" },
+			{ &socket->writes, 6, 0, 1.0, t, socket->writes.scale,
+			  "writes", "wr" },
+			{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", imc_items[2].unit },
+			{ },
+		};
+
+		memcpy(socket_items[i], items, sizeof(items));
+		socket_groups[i] = (struct cnt_group) {
+			.name = socket->name,
+			.items = socket_items[i],
+		};
+		ret = asprintf((char **)&socket_groups[i].display_name,
+			       "IMC%d %s/s", socket->id,
+			       engines->imc_reads.units);
+		assert(ret >= 0);
+
+		groups[i + 1] = &socket_groups[i];
+	}
+	groups[num_sockets + 1] = NULL;
+
 	print_groups(groups);
 
 	free((void *)imc_group.display_name);
@@ -1201,6 +2678,86 @@ print_imc(struct engines *engines, double t, int lines, int con_w, int con_h)
 			printf("     IMC writes:   %s %s/s\n",
 			       imc_items[1].buf, engines->imc_writes.units);
 
+		for (i = 0; i < num_sockets; i++) {
+			if (lines++ < con_h)
+				printf("   IMC socket %d:   %s rd, %s wr %s/s\n",
+				       engines->imc_sockets[i].id,
+				       socket_items[i][0].buf,
+				       socket_items[i][1].buf,
+				       engines->imc_reads.units);
+		}
+
+		if (lines++ < con_h)
+			printf("\n");
+	}
+
+	for (i = 0; i < num_sockets; i++)
+		free((void *)socket_groups[i].display_name);
+
+	return lines;
+}
+
+static int
+print_oa(struct oa_stream *oa, int lines, int con_w, int con_h)
+{
+	struct cnt_item eu_items[] = {
+		{ &oa->metrics[OA_EU_ACTIVE], 3, 0, 1.0, 1.0,
+		  oa->value[OA_EU_ACTIVE], "active", "act" },
+		{ &oa->metrics[OA_EU_STALL], 3, 0, 1.0, 1.0,
+		  oa->value[OA_EU_STALL], "stall", "stl" },
+		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "%" },
+		{ },
+	};
+	struct cnt_group eu_group = {
+		.name = "eu",
+		.display_name = "EU %",
+		.items = eu_items,
+	};
+	struct cnt_item sampler_items[] = {
+		{ &oa->metrics[OA_SAMPLER_BUSY], 3, 0, 1.0, 1.0,
+		  oa->value[OA_SAMPLER_BUSY], "busy", "%" },
+		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "%" },
+		{ },
+	};
+	struct cnt_group sampler_group = {
+		.name = "sampler",
+		.display_name = "SMP",
+		.items = sampler_items,
+	};
+	struct cnt_item gti_items[] = {
+		{ &oa->metrics[OA_GTI_READ], 6, 0, 1.0, 1.0,
+		  oa->value[OA_GTI_READ] / (1024 * 1024), "reads", "rd" },
+		{ &oa->metrics[OA_GTI_WRITE], 6, 0, 1.0, 1.0,
+		  oa->value[OA_GTI_WRITE] / (1024 * 1024), "writes", "wr" },
+		{ NULL, 0, 0, 0.0, 0.0, 0.0, "unit", "MiB/s" },
+		{ },
+	};
+	struct cnt_group gti_group = {
+		.name = "gti-bandwidth",
+		.display_name = "GTI MiB/s",
+		.items = gti_items,
+	};
+	struct cnt_group *groups[] = {
+		&eu_group,
+		&sampler_group,
+		&gti_group,
+		NULL
+	};
+
+	print_groups(groups);
+
+	if (output_mode == INTERACTIVE) {
+		if (lines++ < con_h)
+			printf("      EU active:   %s%%, stall %s%%, sampler busy %s%%\n",
+			       eu_items[0].buf, eu_items[1].buf,
+			       sampler_items[0].buf);
+
+		if (lines++ < con_h)
+			printf("      GTI reads:   %s MiB/s\n", gti_items[0].buf);
+
+		if (lines++ < con_h)
+			printf("     GTI writes:   %s MiB/s\n", gti_items[1].buf);
+
 		if (lines++ < con_h)
 			printf("\n");
 	}
@@ -1311,6 +2868,24 @@ print_engines_footer(struct engines *engines, double t,
 	return lines;
 }
 
+static const char *
+engines_class_display_name(const struct engines *engines, unsigned int class)
+{
+	if (engines->class_names)
+		return engines->class_names[class];
+
+	return class_display_name(class);
+}
+
+static const char *
+engines_class_short_name(const struct engines *engines, unsigned int class)
+{
+	if (engines->class_names)
+		return engines->class_names[class];
+
+	return class_short_name(class);
+}
+
 static int class_cmp(const void *_a, const void *_b)
 {
 	const struct engine_class *a = _a;
@@ -1346,7 +2921,7 @@ static void init_engine_classes(struct engines *engines)
 
 	for (i = 0; i < num; i++) {
 		classes[i].class = i;
-		classes[i].name = class_display_name(i);
+		classes[i].name = engines_class_display_name(engines, i);
 	}
 
 	qsort(classes, num, sizeof(*classes), class_cmp);
@@ -1402,9 +2977,9 @@ static struct engines *init_class_engines(struct engines *engines)
 		engine->class = i;
 		engine->instance = -1;
 
-		engine->display_name = strdup(class_display_name(i));
+		engine->display_name = strdup(engines_class_display_name(engines, i));
 		assert(engine->display_name);
-		engine->short_name = strdup(class_short_name(i));
+		engine->short_name = strdup(engines_class_short_name(engines, i));
 		assert(engine->short_name);
 
 		/*
@@ -1579,12 +3154,16 @@ int main(int argc, char **argv)
 	struct engines *engines;
 	int ret = 0, ch;
 	bool list_device = false;
-	char *pmu_device, *opt_device = NULL;
+	char *pmu_device = NULL, *opt_device = NULL;
 	struct igt_device_card card;
 	char *codename = NULL;
+	char *driver = NULL;
+	long samples = -1;
+	char *oa_metric_set = NULL, *oa_recording = NULL;
+	struct oa_stream *oa = NULL;
 
 	/* Parse options */
-	while ((ch = getopt(argc, argv, "o:s:d:JLlph")) != -1) {
+	while ((ch = getopt(argc, argv, "o:s:d:r:n:P:O:R:JLlph")) != -1) {
 		switch (ch) {
 		case 'o':
 			output_path = optarg;
@@ -1595,6 +3174,9 @@ int main(int argc, char **argv)
 		case 'd':
 			opt_device = strdup(optarg);
 			break;
+		case 'r':
+			sys_root = optarg;
+			break;
 		case 'J':
 			output_mode = JSON;
 			break;
@@ -1607,6 +3189,32 @@ int main(int argc, char **argv)
 		case 'p':
 			output_mode = PROMETHEUS;
 			break;
+		case 'P':
+			if (push_add_sink(optarg)) {
+				fprintf(stderr, "Invalid push sink '%s'!\n",
+					optarg);
+				exit(1);
+			}
+			output_mode = PUSH;
+			break;
+		case 'n': {
+			char *end;
+
+			errno = 0;
+			samples = strtol(optarg, &end, 10);
+			if (errno || end == optarg || *end || samples < 0) {
+				fprintf(stderr, "Invalid sample count '%s'!\n",
+					optarg);
+				exit(1);
+			}
+			break;
+		}
+		case 'O':
+			oa_metric_set = optarg;
+			break;
+		case 'R':
+			oa_recording = optarg;
+			break;
 		case 'h':
 			usage(argv[0]);
 			exit(0);
@@ -1651,6 +3259,9 @@ int main(int argc, char **argv)
 	case PROMETHEUS:
 		pops = &prometheus_pops;
 		break;
+	case PUSH:
+		pops = &push_pops;
+		break;
 	case JSON:
 		pops = &json_pops;
 		break;
@@ -1659,6 +3270,22 @@ int main(int argc, char **argv)
 		break;
 	};
 
+	if (sys_root[0]) {
+		/* Fake tree, no udev to scan it. */
+		if (!opt_device) {
+			fprintf(stderr, "A PCI slot name is required with -r!\n");
+			ret = EXIT_FAILURE;
+			goto exit;
+		}
+
+		memset(&card, 0, sizeof(card));
+		snprintf(card.pci_slot_name, sizeof(card.pci_slot_name),
+			 "%s", opt_device);
+		snprintf(card.card, sizeof(card.card), "%s", opt_device);
+		free(opt_device);
+		goto open_device;
+	}
+
 	igt_devices_scan(false);
 
 	if (list_device) {
@@ -1681,7 +3308,9 @@ int main(int argc, char **argv)
 		if (!ret)
 			ret = igt_device_find_integrated_card(&card);
 		if (!ret)
-			fprintf(stderr, "No device filter specified and no discrete/integrated i915 devices found\n");
+			ret = igt_device_card_match_pci("pci:vendor=amd", &card);
+		if (!ret)
+			fprintf(stderr, "No device filter specified and no i915 or amdgpu devices found\n");
 	}
 
 	if (!ret) {
@@ -1689,34 +3318,80 @@ int main(int argc, char **argv)
 		goto exit;
 	}
 
-	if (card.pci_slot_name[0] && !is_igpu_pci(card.pci_slot_name))
-		pmu_device = tr_pmu_name(&card);
-	else
-		pmu_device = strdup("i915");
+open_device:
+	/* Non-PCI devices can only be i915 ones. */
+	if (card.pci_slot_name[0])
+		driver = pci_driver(card.pci_slot_name);
+	if (!driver && !sys_root[0])
+		driver = strdup("i915");
+	if (!driver) {
+		fprintf(stderr, "No driver bound to %s!\n", card.pci_slot_name);
+		ret = EXIT_FAILURE;
+		goto exit;
+	}
+
+	if (!strcmp(driver, "i915")) {
+		if (card.pci_slot_name[0] && !is_igpu_pci(card.pci_slot_name))
+			pmu_device = tr_pmu_name(&card);
+		else
+			pmu_device = strdup("i915");
+
+		engines = discover_engines(pmu_device);
+		if (!engines) {
+			fprintf(stderr,
+				"Failed to detect engines! (%s)\n(Kernel 4.16 or newer is required for i915 PMU support.)\n",
+				strerror(errno));
+			ret = EXIT_FAILURE;
+			goto err;
+		}
+		engines->backend = &i915_backend;
+	} else {
+		engines = discover_fdinfo_engines(driver, card.pci_slot_name);
+		if (!engines) {
+			fprintf(stderr,
+				"Failed to detect %s engines! (%s)\n(Engine utilisation requires DRM fdinfo support from the driver.)\n",
+				driver, strerror(errno));
+			ret = EXIT_FAILURE;
+			goto err;
+		}
+	}
 
-	engines = discover_engines(pmu_device);
-	if (!engines) {
+	ret = engines->backend->init(engines);
+	if (ret) {
 		fprintf(stderr,
-			"Failed to detect engines! (%s)\n(Kernel 4.16 or newer is required for i915 PMU support.)\n",
-			strerror(errno));
+			"Failed to initialize %s counters! (%s)\n",
+			engines->backend->name, strerror(errno));
 		ret = EXIT_FAILURE;
 		goto err;
 	}
 
-	ret = pmu_init(engines);
-	if (ret) {
-		fprintf(stderr,
-			"Failed to initialize PMU! (%s)\n", strerror(errno));
+	if (oa_recording) {
+		oa = oa_replay(oa_recording, period_us);
+	} else if (oa_metric_set) {
+		if (strcmp(driver, "i915") || sys_root[0])
+			fprintf(stderr, "OA metrics are only available on i915!\n");
+		else
+			oa = oa_open(card.render[0] ? card.render : card.card,
+				     oa_metric_set);
+	}
+	if ((oa_recording || oa_metric_set) && !oa) {
 		ret = EXIT_FAILURE;
 		goto err;
 	}
 
 	ret = EXIT_SUCCESS;
 
-	pmu_sample(engines);
-	codename = igt_device_get_pretty_name(&card, false);
+	engines->backend->sample(engines);
+	if (oa)
+		oa_sample(oa);
+	if (sys_root[0])
+		codename = strdup(driver);
+	else
+		codename = igt_device_get_pretty_name(&card, false);
+
+	push_device = card.pci_slot_name[0] ? card.pci_slot_name : driver;
 
-	while (!stop_top) {
+	while (!stop_top && samples--) {
 		bool consumed = false;
 		int lines = 0;
 		struct winsize ws;
@@ -1739,9 +3414,13 @@ int main(int argc, char **argv)
 		if (output_mode == PROMETHEUS)
 			usleep(period_us);
 
-		pmu_sample(engines);
+		engines->backend->sample(engines);
 		t = (double)(engines->ts.cur - engines->ts.prev) / 1e9;
 
+		/* Stop once a replayed recording has been shown in full. */
+		if (oa && !oa_sample(oa))
+			break;
+
 		if (stop_top)
 			break;
 
@@ -1752,6 +3431,9 @@ int main(int argc, char **argv)
 
 			lines = print_imc(engines, t, lines, con_w, con_h);
 
+			if (oa)
+				lines = print_oa(oa, lines, con_w, con_h);
+
 			lines = print_engines(engines, t, lines, con_w, con_h);
 		}
 
@@ -1763,16 +3445,24 @@ int main(int argc, char **argv)
 			break;
 		}
 
+		if (output_mode == PUSH)
+			push_sample(period_us);
+
 		if (output_mode == INTERACTIVE)
 			process_stdin(period_us);
 		else
 			usleep(period_us);
 	}
 
+	if (output_mode == PUSH)
+		push_fini();
+
 	free(codename);
 err:
+	oa_free(oa);
 	free(engines);
 	free(pmu_device);
+	free(driver);
 exit:
 	igt_devices_free();
 	return ret;
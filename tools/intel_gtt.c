@@ -34,6 +34,7 @@
 #include <pciaccess.h>
 #include <unistd.h>
 
+#include "igt_ggtt.h"
 #include "intel_io.h"
 #include "intel_chipset.h"
 
@@ -55,47 +56,6 @@ static gen8_gtt_pte_t gen8_gtt_pte(const unsigned i)
 	return *((volatile gen8_gtt_pte_t *)(gtt) + i);
 }
 
-static uint64_t ingtt(const unsigned offset)
-{
-	if (intel_gen(devid) < 8)
-		return gen6_gtt_pte(offset/KB(4));
-
-	return gen8_gtt_pte(offset/KB(4));
-}
-
-static uint64_t get_phys(uint32_t pt_offset)
-{
-	uint64_t pae = 0;
-	uint64_t phys = ingtt(pt_offset);
-
-	if (intel_gen(devid) < 4 && !IS_G33(devid))
-		return phys & ~0xfff;
-
-	switch (intel_gen(devid)) {
-		case 3:
-		case 4:
-		case 5:
-			pae = (phys & 0xf0) << 28;
-			break;
-		case 6:
-		case 7:
-			if (IS_HASWELL(devid))
-				pae = (phys & 0x7f0) << 28;
-			else
-				pae = (phys & 0xff0) << 28;
-			break;
-		case 8:
-		case 9:
-			phys = phys & 0x7ffffff000;
-			break;
-		default:
-			fprintf(stderr, "Unsupported platform\n");
-			exit(-1);
-	}
-
-	return (phys | pae) & ~0xfff;
-}
-
 static void pte_dump(int size, uint32_t offset) {
 	int pte_size;
 	int entries;
@@ -136,24 +96,29 @@ static void pte_dump(int size, uint32_t offset) {
 	}
 }
 
-int main(int argc, char **argv)
+static void usage(const char *appname)
+{
+	printf("intel_gtt - GGTT layout and fragmentation\n"
+	       "\n"
+	       "Usage: %s [parameters]\n"
+	       "\n"
+	       "\t[-h]          Show this help text.\n"
+	       "\t[-d]          Dump the raw PTEs.\n"
+	       "\t[-e]          List the extents.\n"
+	       "\t[-s <file>]   Save a snapshot of the GGTT to file.\n"
+	       "\t[-l <file>]   Analyse a saved snapshot instead of the live GGTT.\n"
+	       "\t[-x <file>]   Show what changed since a saved snapshot.\n",
+	       appname);
+}
+
+static void map_gtt(struct pci_device *pci_dev)
 {
-	struct pci_device *pci_dev;
-	unsigned int start, gtt_size;
 	int flag[] = {
 		PCI_DEV_MAP_FLAG_WRITE_COMBINE,
 		PCI_DEV_MAP_FLAG_WRITABLE,
 		0
 	}, f;
 
-	pci_dev = intel_get_pci_device();
-	devid = pci_dev->device_id;
-
-	if (IS_GEN2(devid)) {
-		printf("Unsupported chipset for gtt dumper\n");
-		exit(1);
-	}
-
 	for (f = 0; flag[f] != 0; f++) {
 		if (IS_GEN3(devid)) {
 			/* 915/945 chips has GTT range in bar 3 */
@@ -183,53 +148,225 @@ int main(int argc, char **argv)
 		printf("Failed to map gtt\n");
 		exit(1);
 	}
+}
+
+/* Reads the PTEs one at a time, as the GSM may not be safe to memcpy */
+static void snapshot_live(struct igt_ggtt_snapshot *snap, unsigned int gtt_size)
+{
+	unsigned int pte_size = intel_gen(devid) < 8 ? 4 : 8;
+	unsigned int entries = gtt_size / pte_size;
+	void *ptes = malloc(gtt_size);
+	unsigned int i;
+
+	if (!ptes) {
+		fprintf(stderr, "Out of memory\n");
+		exit(1);
+	}
 
-	gtt_size = pci_dev->regions[0].size / 2;
-	if (argc > 1 && !strncmp("-d", argv[1], 2)) {
-		pte_dump(gtt_size, 0);
-		return 0;
+	for (i = 0; i < entries; i++) {
+		if (pte_size == 4)
+			((gen6_gtt_pte_t *)ptes)[i] = gen6_gtt_pte(i);
+		else
+			((gen8_gtt_pte_t *)ptes)[i] = gen8_gtt_pte(i);
 	}
 
-	for (start = 0; start < gtt_size; start += KB(4)) {
-		uint64_t start_phys = get_phys(start);
-		uint32_t end;
-		int constant_length = 0;
-		int linear_length = 0;
-
-		/* Check if it's a linear sequence */
-		for (end = start + KB(4); end < gtt_size; end += KB(4)) {
-			uint64_t end_phys = get_phys(end);
-			if (end_phys == start_phys + (end - start))
-				linear_length++;
-			else
-				break;
-		}
-		if (linear_length > 0) {
-			printf("0x%08x - 0x%08x: linear from "
-			       "0x%" PRIx64 " to 0x%" PRIx64 "\n",
-			       start, end - KB(4),
-			       start_phys, start_phys + (end - start) - KB(4));
-			start = end - KB(4);
+	igt_ggtt_snapshot_init(snap, devid, ptes, entries);
+	free(ptes);
+}
+
+static void print_size(uint64_t size)
+{
+	if (size >= MB(1))
+		printf("%" PRIu64 "MiB", size >> 20);
+	else
+		printf("%" PRIu64 "KiB", size >> 10);
+}
+
+static void list_extents(const struct igt_ggtt_analysis *a)
+{
+	for (uint64_t i = 0; i < a->num_extents; i++) {
+		const struct igt_ggtt_extent *e = &a->extents[i];
+
+		printf("0x%08" PRIx64 " - 0x%08" PRIx64 ": %-7s",
+		       e->offset, e->offset + e->size - KB(4),
+		       igt_ggtt_kind_name(e->kind));
+		if (e->kind != IGT_GGTT_INVALID)
+			printf(" from 0x%" PRIx64, e->phys);
+		if (e->kind == IGT_GGTT_MAPPED)
+			printf(", flags 0x%03x, %" PRIu64 " chunk%s",
+			       e->flags, e->chunks, e->chunks == 1 ? "" : "s");
+		printf("\n");
+	}
+}
+
+static void summary(const struct igt_ggtt_snapshot *snap,
+		    const struct igt_ggtt_analysis *a)
+{
+	uint64_t mapped = a->pages[IGT_GGTT_MAPPED];
+	int o;
+
+	printf("GGTT: ");
+	print_size(snap->num_entries * KB(4));
+	printf(", %" PRIu64 " PTEs of %u bytes\n",
+	       snap->num_entries, snap->pte_size);
+	if (snap->scratch != IGT_GGTT_NO_SCRATCH)
+		printf("Scratch page: 0x%" PRIx64 "\n", snap->scratch);
+	else
+		printf("Scratch page: not found\n");
+
+	for (o = 0; o < IGT_GGTT_NUM_KINDS; o++)
+		printf("%-7s %8" PRIu64 " pages (%5.1f%%)\n",
+		       igt_ggtt_kind_name(o), a->pages[o],
+		       snap->num_entries ?
+		       100. * a->pages[o] / snap->num_entries : 0.);
+	printf("%" PRIu64 " extents, %" PRIu64 " physically contiguous chunks",
+	       a->num_extents, a->chunks);
+	if (a->chunks)
+		printf(", %.1f pages per chunk", (double)mapped / a->chunks);
+	printf("\n");
+
+	printf("\n%" PRIu64 " holes:\n", a->num_holes);
+	for (o = 0; o < IGT_GGTT_ORDERS; o++) {
+		if (!a->hole_histogram[o])
 			continue;
+
+		printf("  ");
+		print_size(KB(4) << o);
+		printf(": %" PRIu64 "\n", a->hole_histogram[o]);
+	}
+
+	printf("\nLargest free range by alignment:\n");
+	for (o = 0; o < IGT_GGTT_ORDERS; o++) {
+		if (!a->largest[o])
+			break;
+
+		printf("  ");
+		print_size(KB(4) << o);
+		printf(": ");
+		print_size(a->largest[o]);
+		printf("\n");
+	}
+}
+
+static int diff(const struct igt_ggtt_snapshot *snap, const char *file)
+{
+	struct igt_ggtt_snapshot old;
+	struct igt_ggtt_diff *diffs;
+	uint64_t n;
+	int ret;
+
+	ret = igt_ggtt_snapshot_load(&old, file);
+	if (ret) {
+		fprintf(stderr, "Unable to load %s: %s\n", file, strerror(-ret));
+		return 1;
+	}
+
+	if (old.devid != snap->devid || old.num_entries != snap->num_entries) {
+		fprintf(stderr, "%s is from a different device\n", file);
+		igt_ggtt_snapshot_fini(&old);
+		return 1;
+	}
+
+	n = igt_ggtt_snapshot_diff(&old, snap, &diffs);
+	for (uint64_t i = 0; i < n; i++)
+		printf("0x%08" PRIx64 " - 0x%08" PRIx64 ": %s\n",
+		       diffs[i].offset, diffs[i].offset + diffs[i].size - KB(4),
+		       igt_ggtt_change_name(diffs[i].change));
+	printf("%" PRIu64 " change%s\n", n, n == 1 ? "" : "s");
+
+	free(diffs);
+	igt_ggtt_snapshot_fini(&old);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *save = NULL, *load = NULL, *since = NULL;
+	struct igt_ggtt_snapshot snap;
+	struct igt_ggtt_analysis a;
+	bool dump = false, extents = false;
+	unsigned int gtt_size;
+	int ret = 0, c;
+
+	while ((c = getopt(argc, argv, "hdes:l:x:")) != -1) {
+		switch (c) {
+		case 'd':
+			dump = true;
+			break;
+		case 'e':
+			extents = true;
+			break;
+		case 's':
+			save = optarg;
+			break;
+		case 'l':
+			load = optarg;
+			break;
+		case 'x':
+			since = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return 0;
+		default:
+			usage(argv[0]);
+			return 1;
 		}
+	}
 
-		/* Check if it's a constant sequence */
-		for (end = start + KB(4); end < gtt_size; end += KB(4)) {
-			uint64_t end_phys = get_phys(end);
-			if (end_phys == start_phys)
-				constant_length++;
-			else
-				break;
+	if (load) {
+		ret = igt_ggtt_snapshot_load(&snap, load);
+		if (ret) {
+			fprintf(stderr, "Unable to load %s: %s\n",
+				load, strerror(-ret));
+			return 1;
 		}
-		if (constant_length > 0) {
-			printf("0x%08x - 0x%08x: constant 0x%" PRIx64 "\n",
-			       start, end - KB(4), start_phys);
-			start = end - KB(4);
-			continue;
+		devid = snap.devid;
+	} else {
+		struct pci_device *pci_dev;
+
+		pci_dev = intel_get_pci_device();
+		devid = pci_dev->device_id;
+
+		if (IS_GEN2(devid)) {
+			printf("Unsupported chipset for gtt dumper\n");
+			exit(1);
+		}
+
+		map_gtt(pci_dev);
+
+		gtt_size = pci_dev->regions[0].size / 2;
+		if (dump) {
+			pte_dump(gtt_size, 0);
+			return 0;
 		}
 
-		printf("0x%08x: 0x%" PRIx64 "\n", start, start_phys);
+		snapshot_live(&snap, gtt_size);
 	}
 
-	return 0;
+	if (save) {
+		ret = igt_ggtt_snapshot_save(&snap, save);
+		if (ret) {
+			fprintf(stderr, "Unable to save %s: %s\n",
+				save, strerror(-ret));
+			igt_ggtt_snapshot_fini(&snap);
+			return 1;
+		}
+	}
+
+	if (since) {
+		ret = diff(&snap, since);
+	} else {
+		igt_ggtt_analyse(&snap, &a);
+		if (extents)
+			list_extents(&a);
+		else
+			summary(&snap, &a);
+		igt_ggtt_analysis_fini(&a);
+	}
+
+	igt_ggtt_snapshot_fini(&snap);
+
+	return ret;
 }
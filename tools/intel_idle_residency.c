@@ -0,0 +1,979 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * CPU package and core C-state residency sampled together with GPU RC6 and
+ * RAPL energy, to see how the two sides of the chip idle with respect to
+ * each other.
+ *
+ * C-state residency comes from the MSRs through /dev/cpu/N/msr, relative to
+ * the TSC, or from the cpuidle sysfs when the MSRs are not readable. In the
+ * latter case there is no package residency, only the time each CPU spent in
+ * deep idle states, and the package is assumed to be no deeper than its
+ * shallowest CPU. RC6 comes from the i915 PMU, or from sysfs under a fake
+ * root. Energy comes from the powercap sysfs.
+ *
+ * All sources are read back to back each period and stamped with the
+ * midpoint of CLOCK_MONOTONIC around the reads, so each interval covers the
+ * same time for all of them. Within an interval only the residency fractions
+ * are known, not when the idle periods happened, so the time the GPU spent in
+ * RC6 while the package was not in a deep C-state is reported as a range
+ * [max(0, rc6 - deep), min(rc6, 1 - deep)] which narrows with the period.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "i915_drm.h"
+#include "igt_perf.h"
+
+#define IA32_TIME_STAMP_COUNTER		0x10
+
+#define MSR_PKG_C2_RESIDENCY		0x60D
+#define MSR_PKG_C3_RESIDENCY		0x3F8
+#define MSR_PKG_C6_RESIDENCY		0x3F9
+#define MSR_PKG_C7_RESIDENCY		0x3FA
+#define MSR_PKG_C8_RESIDENCY		0x630
+#define MSR_PKG_C9_RESIDENCY		0x631
+#define MSR_PKG_C10_RESIDENCY		0x632
+
+#define MSR_CORE_C3_RESIDENCY		0x3FC
+#define MSR_CORE_C6_RESIDENCY		0x3FD
+#define MSR_CORE_C7_RESIDENCY		0x3FE
+
+#define MAX_CPUS 1024
+#define MAX_IDLE_STATES 16
+#define MAX_RAPL 8
+
+struct cstate_msr {
+	const char *name;
+	uint32_t addr;
+	int level;
+};
+
+/* The residency counters are exclusive, each counts its own state only. */
+static const struct cstate_msr pkg_msrs[] = {
+	{ "PC2", MSR_PKG_C2_RESIDENCY, 2 },
+	{ "PC3", MSR_PKG_C3_RESIDENCY, 3 },
+	{ "PC6", MSR_PKG_C6_RESIDENCY, 6 },
+	{ "PC7", MSR_PKG_C7_RESIDENCY, 7 },
+	{ "PC8", MSR_PKG_C8_RESIDENCY, 8 },
+	{ "PC9", MSR_PKG_C9_RESIDENCY, 9 },
+	{ "PC10", MSR_PKG_C10_RESIDENCY, 10 },
+};
+
+static const struct cstate_msr core_msrs[] = {
+	{ "CC3", MSR_CORE_C3_RESIDENCY, 3 },
+	{ "CC6", MSR_CORE_C6_RESIDENCY, 6 },
+	{ "CC7", MSR_CORE_C7_RESIDENCY, 7 },
+};
+
+#define ARRAY_SIZE(arr) (sizeof(arr) / sizeof(arr[0]))
+
+enum cpu_source {
+	CPU_NONE,
+	CPU_MSR,
+	CPU_CPUIDLE,
+};
+
+enum rc6_source {
+	RC6_NONE,
+	RC6_PMU,
+	RC6_SYSFS,
+};
+
+struct cpu {
+	int id;
+	int package;
+	bool first_in_package;
+	int msr_fd;
+	/* 8 for a regular file standing in for the msr device */
+	unsigned int msr_stride;
+
+	/* cpuidle states at or above the deep level */
+	unsigned int num_idle;
+	unsigned int idle_state[MAX_IDLE_STATES];
+};
+
+struct rapl_zone {
+	char name[32];
+	char dir[NAME_MAX + 1];
+	uint64_t max_uj;
+};
+
+struct sources {
+	const char *root;
+	int deep;
+
+	enum cpu_source cpu_source;
+	unsigned int num_cpus;
+	unsigned int num_packages;
+	struct cpu cpus[MAX_CPUS];
+	/* Which of pkg_msrs / core_msrs could be read, as a mask */
+	unsigned int pkg_mask;
+	unsigned int core_mask;
+
+	enum rc6_source rc6_source;
+	const char *card;
+	char rc6_path[PATH_MAX];
+	int rc6_fd;
+
+	unsigned int num_rapl;
+	struct rapl_zone rapl[MAX_RAPL];
+};
+
+struct cpu_sample {
+	uint64_t tsc;
+	uint64_t pkg_deep; /* only on the first CPU of each package */
+	uint64_t core_deep; /* TSC ticks, or us from cpuidle */
+};
+
+struct sample {
+	uint64_t t_ns;
+	uint64_t skew_ns;
+	uint64_t rc6_ns;
+	uint64_t energy_uj[MAX_RAPL];
+	struct cpu_sample *cpu;
+};
+
+/* One interval between two samples, as fractions of its duration. */
+struct interval {
+	double dt;
+	double pkg_deep;
+	double core_deep;
+	double rc6;
+	double power[MAX_RAPL];
+};
+
+struct stats {
+	unsigned int count;
+	uint64_t max_skew_ns;
+	double time;
+	double pkg_deep;
+	double core_deep;
+	double rc6;
+	double rc6_not_deep_min;
+	double rc6_not_deep_max;
+	double rc6_not_deep_indep;
+	double energy[MAX_RAPL];
+};
+
+static bool stop;
+
+static void sigint_handler(int sig)
+{
+	stop = true;
+}
+
+static void usage(const char *appname)
+{
+	printf("intel_idle_residency - CPU C-state residency against GPU RC6\n"
+	       "\n"
+	       "Usage: %s [parameters]\n"
+	       "\n"
+	       "\t[-h]            Show this help text.\n"
+	       "\t[-s <ms>]       Sampling period in milliseconds (default 1000ms).\n"
+	       "\t[-n <samples>]  Exit after this many intervals (default 0, runs until interrupted).\n"
+	       "\t[-c <level>]    Shallowest C-state counted as deep (default 6).\n"
+	       "\t[-d <card>]     DRM card for RC6 from sysfs (default card0).\n"
+	       "\t[-C]            Ignore the MSRs, use cpuidle sysfs.\n"
+	       "\t[-J]            Output the summary as JSON.\n"
+	       "\t[-q]            Only print the summary.\n"
+	       "\t[-r <dir>]      Read devices, sysfs and powercap under <dir>, a regular\n"
+	       "\t                file as dev/cpu/N/msr holds each MSR at 8 * its address.\n"
+	       "\t[-R <dir>]      Replay the fake roots <dir>/0, <dir>/1, ...,\n"
+	       "\t                each with its timestamp in a time_ns file.\n",
+	       appname);
+}
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static bool read_u64_file(const char *root, const char *path, uint64_t *val)
+{
+	char full[PATH_MAX], buf[32];
+	ssize_t len;
+	int fd;
+
+	snprintf(full, sizeof(full), "%s%s", root, path);
+	fd = open(full, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0)
+		return false;
+	buf[len] = '\0';
+
+	*val = strtoull(buf, NULL, 10);
+	return true;
+}
+
+static bool read_str_file(const char *root, const char *path,
+			  char *buf, size_t size)
+{
+	char full[PATH_MAX];
+	ssize_t len;
+	int fd;
+
+	snprintf(full, sizeof(full), "%s%s", root, path);
+	fd = open(full, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	len = read(fd, buf, size - 1);
+	close(fd);
+	if (len <= 0)
+		return false;
+
+	buf[len] = '\0';
+	buf[strcspn(buf, "\n")] = '\0';
+	return true;
+}
+
+static bool msr_read(const struct cpu *cpu, uint32_t addr, uint64_t *val)
+{
+	return pread(cpu->msr_fd, val, sizeof(*val),
+		     (off_t)addr * cpu->msr_stride) == sizeof(*val);
+}
+
+/* "C6", "C6S", "C1E", "C3_ACPI"... the level is the number after the C. */
+static int idle_state_level(const char *name)
+{
+	if (name[0] != 'C' || name[1] < '0' || name[1] > '9')
+		return 0;
+
+	return atoi(name + 1);
+}
+
+static int cmp_int(const void *a, const void *b)
+{
+	return *(const int *)a - *(const int *)b;
+}
+
+/* CPU numbers of the cpuN / N entries of a directory, sorted. */
+static unsigned int list_cpus(const char *root, const char *dir,
+			      const char *prefix, int *ids)
+{
+	char path[PATH_MAX];
+	struct dirent *de;
+	unsigned int n = 0;
+	size_t len = strlen(prefix);
+	DIR *d;
+
+	snprintf(path, sizeof(path), "%s%s", root, dir);
+	d = opendir(path);
+	if (!d)
+		return 0;
+
+	while ((de = readdir(d)) && n < MAX_CPUS) {
+		char *end;
+		long id;
+
+		if (strncmp(de->d_name, prefix, len) ||
+		    de->d_name[len] < '0' || de->d_name[len] > '9')
+			continue;
+
+		id = strtol(de->d_name + len, &end, 10);
+		if (*end)
+			continue;
+
+		ids[n++] = id;
+	}
+	closedir(d);
+
+	qsort(ids, n, sizeof(*ids), cmp_int);
+	return n;
+}
+
+static void add_cpu(struct sources *s, int id)
+{
+	struct cpu *cpu = &s->cpus[s->num_cpus++];
+	char path[PATH_MAX];
+	uint64_t package;
+
+	memset(cpu, 0, sizeof(*cpu));
+	cpu->id = id;
+	cpu->msr_fd = -1;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/topology/physical_package_id",
+		 id);
+	if (read_u64_file(s->root, path, &package))
+		cpu->package = package;
+
+	cpu->first_in_package = true;
+	for (unsigned int i = 0; i < s->num_cpus - 1; i++) {
+		if (s->cpus[i].package == cpu->package) {
+			cpu->first_in_package = false;
+			break;
+		}
+	}
+	if (cpu->first_in_package)
+		s->num_packages++;
+}
+
+static bool open_msr(struct sources *s)
+{
+	int ids[MAX_CPUS];
+	unsigned int n;
+
+	n = list_cpus(s->root, "/dev/cpu", "", ids);
+	for (unsigned int i = 0; i < n; i++) {
+		char path[PATH_MAX];
+		struct cpu probe = {};
+		struct stat st;
+		uint64_t val;
+
+		snprintf(path, sizeof(path), "%s/dev/cpu/%d/msr", s->root, ids[i]);
+		probe.msr_fd = open(path, O_RDONLY);
+		if (probe.msr_fd < 0)
+			continue;
+
+		/*
+		 * The device reads the MSR at the file offset, adjacent MSRs
+		 * overlap in a regular file so there each takes 8 bytes.
+		 */
+		fstat(probe.msr_fd, &st);
+		probe.msr_stride = S_ISCHR(st.st_mode) ? 1 : sizeof(val);
+
+		if (!msr_read(&probe, IA32_TIME_STAMP_COUNTER, &val)) {
+			close(probe.msr_fd);
+			continue;
+		}
+
+		add_cpu(s, ids[i]);
+		s->cpus[s->num_cpus - 1].msr_fd = probe.msr_fd;
+		s->cpus[s->num_cpus - 1].msr_stride = probe.msr_stride;
+	}
+
+	if (!s->num_cpus)
+		return false;
+
+	/* Not all models have all the counters, those that fail to read don't. */
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkg_msrs); i++) {
+		uint64_t val;
+
+		if (pkg_msrs[i].level >= s->deep &&
+		    msr_read(&s->cpus[0], pkg_msrs[i].addr, &val))
+			s->pkg_mask |= 1 << i;
+	}
+	for (unsigned int i = 0; i < ARRAY_SIZE(core_msrs); i++) {
+		uint64_t val;
+
+		if (core_msrs[i].level >= s->deep &&
+		    msr_read(&s->cpus[0], core_msrs[i].addr, &val))
+			s->core_mask |= 1 << i;
+	}
+
+	s->cpu_source = CPU_MSR;
+	return true;
+}
+
+
+static bool open_cpuidle(struct sources *s)
+{
+	int ids[MAX_CPUS];
+	unsigned int n;
+
+	n = list_cpus(s->root, "/sys/devices/system/cpu", "cpu", ids);
+	for (unsigned int i = 0; i < n; i++) {
+		char path[PATH_MAX], name[32];
+		struct cpu *cpu;
+
+		snprintf(path, sizeof(path),
+			 "/sys/devices/system/cpu/cpu%d/cpuidle/state0/name",
+			 ids[i]);
+		if (!read_str_file(s->root, path, name, sizeof(name)))
+			continue;
+
+		add_cpu(s, ids[i]);
+		cpu = &s->cpus[s->num_cpus - 1];
+
+		for (unsigned int state = 0; state < MAX_IDLE_STATES; state++) {
+			snprintf(path, sizeof(path),
+				 "/sys/devices/system/cpu/cpu%d/cpuidle/state%u/name",
+				 cpu->id, state);
+			if (!read_str_file(s->root, path, name, sizeof(name)))
+				break;
+
+			if (idle_state_level(name) >= s->deep)
+				cpu->idle_state[cpu->num_idle++] = state;
+		}
+	}
+
+	if (!s->num_cpus)
+		return false;
+
+	s->cpu_source = CPU_CPUIDLE;
+	return true;
+}
+
+static void open_rc6(struct sources *s)
+{
+	static const char *paths[] = {
+		"gt/gt0/rc6_residency_ms",
+		"power/rc6_residency_ms",
+	};
+
+	if (!s->root[0]) {
+		s->rc6_fd = perf_igfx_open(I915_PMU_RC6_RESIDENCY);
+		if (s->rc6_fd >= 0) {
+			s->rc6_source = RC6_PMU;
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(paths); i++) {
+		uint64_t val;
+
+		snprintf(s->rc6_path, sizeof(s->rc6_path),
+			 "/sys/class/drm/%s/%s", s->card, paths[i]);
+		if (read_u64_file(s->root, s->rc6_path, &val)) {
+			s->rc6_source = RC6_SYSFS;
+			return;
+		}
+	}
+}
+
+static int rapl_filter(const struct dirent *de)
+{
+	return !strncmp(de->d_name, "intel-rapl:", 11);
+}
+
+static void open_rapl(struct sources *s)
+{
+	struct dirent **names;
+	char path[PATH_MAX];
+	int n;
+
+	snprintf(path, sizeof(path), "%s/sys/class/powercap", s->root);
+	n = scandir(path, &names, rapl_filter, alphasort);
+	if (n < 0)
+		return;
+
+	for (int i = 0; i < n; i++) {
+		struct rapl_zone *z = &s->rapl[s->num_rapl];
+		uint64_t val;
+
+		if (s->num_rapl == MAX_RAPL)
+			goto next;
+
+		snprintf(z->dir, sizeof(z->dir), "%s", names[i]->d_name);
+
+		snprintf(path, sizeof(path), "/sys/class/powercap/%s/name",
+			 z->dir);
+		if (!read_str_file(s->root, path, z->name, sizeof(z->name)))
+			goto next;
+
+		snprintf(path, sizeof(path),
+			 "/sys/class/powercap/%s/max_energy_range_uj", z->dir);
+		if (!read_u64_file(s->root, path, &z->max_uj))
+			z->max_uj = 0;
+
+		/* energy_uj is only readable by root on recent kernels. */
+		snprintf(path, sizeof(path), "/sys/class/powercap/%s/energy_uj",
+			 z->dir);
+		if (read_u64_file(s->root, path, &val))
+			s->num_rapl++;
+next:
+		free(names[i]);
+	}
+	free(names);
+}
+
+static bool sources_open(struct sources *s, const char *root, bool msr)
+{
+	s->root = root;
+	s->num_cpus = 0;
+	s->num_packages = 0;
+	s->pkg_mask = 0;
+	s->core_mask = 0;
+	s->cpu_source = CPU_NONE;
+	s->rc6_source = RC6_NONE;
+	s->rc6_fd = -1;
+	s->num_rapl = 0;
+
+	if (!(msr && open_msr(s)))
+		open_cpuidle(s);
+	open_rc6(s);
+	open_rapl(s);
+
+	return s->cpu_source != CPU_NONE && s->rc6_source != RC6_NONE;
+}
+
+static void sources_close(struct sources *s)
+{
+	for (unsigned int i = 0; i < s->num_cpus; i++) {
+		if (s->cpus[i].msr_fd >= 0)
+			close(s->cpus[i].msr_fd);
+	}
+	s->num_cpus = 0;
+
+	if (s->rc6_fd >= 0)
+		close(s->rc6_fd);
+	s->rc6_fd = -1;
+}
+
+static void read_cpu(const struct sources *s, const struct cpu *cpu,
+		     struct cpu_sample *cs)
+{
+	uint64_t val;
+
+	memset(cs, 0, sizeof(*cs));
+
+	if (s->cpu_source == CPU_CPUIDLE) {
+		for (unsigned int i = 0; i < cpu->num_idle; i++) {
+			char path[PATH_MAX];
+
+			snprintf(path, sizeof(path),
+				 "/sys/devices/system/cpu/cpu%d/cpuidle/state%u/time",
+				 cpu->id, cpu->idle_state[i]);
+			if (read_u64_file(s->root, path, &val))
+				cs->core_deep += val;
+		}
+		return;
+	}
+
+	msr_read(cpu, IA32_TIME_STAMP_COUNTER, &cs->tsc);
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(core_msrs); i++) {
+		if (s->core_mask & (1 << i) &&
+		    msr_read(cpu, core_msrs[i].addr, &val))
+			cs->core_deep += val;
+	}
+
+	if (!cpu->first_in_package)
+		return;
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkg_msrs); i++) {
+		if (s->pkg_mask & (1 << i) &&
+		    msr_read(cpu, pkg_msrs[i].addr, &val))
+			cs->pkg_deep += val;
+	}
+}
+
+static void read_sample(const struct sources *s, struct sample *smp)
+{
+	uint64_t start, end, val;
+
+	start = now_ns();
+
+	for (unsigned int i = 0; i < s->num_cpus; i++)
+		read_cpu(s, &s->cpus[i], &smp->cpu[i]);
+
+	smp->rc6_ns = 0;
+	if (s->rc6_source == RC6_PMU) {
+		uint64_t buf[2];
+
+		if (read(s->rc6_fd, buf, sizeof(buf)) == sizeof(buf))
+			smp->rc6_ns = buf[0];
+	} else if (read_u64_file(s->root, s->rc6_path, &val)) {
+		smp->rc6_ns = val * 1000000;
+	}
+
+	for (unsigned int i = 0; i < s->num_rapl; i++) {
+		char path[PATH_MAX];
+
+		snprintf(path, sizeof(path), "/sys/class/powercap/%s/energy_uj",
+			 s->rapl[i].dir);
+		smp->energy_uj[i] = 0;
+		read_u64_file(s->root, path, &smp->energy_uj[i]);
+	}
+
+	end = now_ns();
+
+	smp->t_ns = start + (end - start) / 2;
+	smp->skew_ns = end - start;
+}
+
+static double clamp(double v)
+{
+	return v < 0 ? 0 : v > 1 ? 1 : v;
+}
+
+static double ratio(uint64_t a, uint64_t b, uint64_t da, uint64_t db)
+{
+	return db > b ? clamp((double)(da - a) / (db - b)) : 0;
+}
+
+/*
+ * Package residency from the package MSRs when there are any, otherwise the
+ * package can be no deeper than its shallowest CPU.
+ */
+static bool package_estimated(const struct sources *s)
+{
+	return s->cpu_source == CPU_CPUIDLE || !s->pkg_mask;
+}
+
+static void compute_interval(const struct sources *s,
+			     const struct sample *a, const struct sample *b,
+			     struct interval *iv)
+{
+	uint64_t dt_ns = b->t_ns > a->t_ns ? b->t_ns - a->t_ns : 1;
+	double pkg_min[MAX_CPUS];
+
+	memset(iv, 0, sizeof(*iv));
+	iv->dt = dt_ns * 1e-9;
+
+	for (unsigned int i = 0; i < s->num_cpus; i++) {
+		const struct cpu_sample *ca = &a->cpu[i], *cb = &b->cpu[i];
+		const struct cpu *cpu = &s->cpus[i];
+		double core;
+
+		if (s->cpu_source == CPU_CPUIDLE)
+			core = clamp((cb->core_deep - ca->core_deep) * 1e3 /
+				     dt_ns);
+		else
+			core = ratio(ca->core_deep, ca->tsc,
+				     cb->core_deep, cb->tsc);
+		iv->core_deep += core / s->num_cpus;
+
+		if (cpu->first_in_package)
+			pkg_min[cpu->package % MAX_CPUS] = 1;
+		if (core < pkg_min[cpu->package % MAX_CPUS])
+			pkg_min[cpu->package % MAX_CPUS] = core;
+
+		if (cpu->first_in_package && !package_estimated(s))
+			iv->pkg_deep += ratio(ca->pkg_deep, ca->tsc,
+					      cb->pkg_deep, cb->tsc) /
+					s->num_packages;
+	}
+
+	if (package_estimated(s)) {
+		for (unsigned int i = 0; i < s->num_cpus; i++) {
+			if (s->cpus[i].first_in_package)
+				iv->pkg_deep += pkg_min[s->cpus[i].package % MAX_CPUS] /
+						s->num_packages;
+		}
+	}
+
+	iv->rc6 = clamp((double)(b->rc6_ns - a->rc6_ns) / dt_ns);
+
+	for (unsigned int i = 0; i < s->num_rapl; i++) {
+		uint64_t de = b->energy_uj[i] - a->energy_uj[i];
+
+		if (b->energy_uj[i] < a->energy_uj[i])
+			de += s->rapl[i].max_uj;
+
+		iv->power[i] = de * 1e-6 / iv->dt;
+	}
+}
+
+static void accumulate(struct stats *st, const struct sources *s,
+		       const struct interval *iv, uint64_t skew_ns)
+{
+	double g = iv->rc6, d = iv->pkg_deep;
+
+	st->count++;
+	if (skew_ns > st->max_skew_ns)
+		st->max_skew_ns = skew_ns;
+
+	st->time += iv->dt;
+	st->pkg_deep += d * iv->dt;
+	st->core_deep += iv->core_deep * iv->dt;
+	st->rc6 += g * iv->dt;
+
+	/* Bounds of the overlap of two fractions of the same interval. */
+	st->rc6_not_deep_min += (g > d ? g - d : 0) * iv->dt;
+	st->rc6_not_deep_max += (g < 1 - d ? g : 1 - d) * iv->dt;
+	st->rc6_not_deep_indep += g * (1 - d) * iv->dt;
+
+	for (unsigned int i = 0; i < s->num_rapl; i++)
+		st->energy[i] += iv->power[i] * iv->dt;
+}
+
+static void print_header(const struct sources *s)
+{
+	printf("%9s %9s %9s %9s %15s", "time", "pkg-deep", "core-deep",
+	       "rc6", "rc6&!pkg-deep");
+	for (unsigned int i = 0; i < s->num_rapl; i++)
+		printf(" %11s", s->rapl[i].name);
+	printf("\n");
+}
+
+static void print_interval(const struct sources *s, double t,
+			   const struct interval *iv)
+{
+	double g = iv->rc6, d = iv->pkg_deep;
+
+	printf("%9.3f %8.1f%% %8.1f%% %8.1f%% %6.1f%%-%6.1f%%",
+	       t, 100 * d, 100 * iv->core_deep, 100 * g,
+	       100 * (g > d ? g - d : 0), 100 * (g < 1 - d ? g : 1 - d));
+	for (unsigned int i = 0; i < s->num_rapl; i++)
+		printf(" %10.2fW", iv->power[i]);
+	printf("\n");
+}
+
+static const char *cpu_source_name(const struct sources *s)
+{
+	return s->cpu_source == CPU_MSR ? "msr" : "cpuidle";
+}
+
+static void print_summary(const struct sources *s, const struct stats *st)
+{
+	double t = st->time > 0 ? st->time : 1;
+
+	printf("Sampled %u intervals over %.3fs, max skew %"PRIu64"us\n",
+	       st->count, st->time, st->max_skew_ns / 1000);
+	printf("C-states from %s, C%d and deeper are deep:",
+	       cpu_source_name(s), s->deep);
+	for (unsigned int i = 0; i < ARRAY_SIZE(pkg_msrs); i++) {
+		if (s->pkg_mask & (1 << i))
+			printf(" %s", pkg_msrs[i].name);
+	}
+	for (unsigned int i = 0; i < ARRAY_SIZE(core_msrs); i++) {
+		if (s->core_mask & (1 << i))
+			printf(" %s", core_msrs[i].name);
+	}
+	if (s->cpu_source == CPU_CPUIDLE)
+		printf(" %u CPUs", s->num_cpus);
+	printf("\n");
+	printf("Package deep: %.1f%%%s\n", 100 * st->pkg_deep / t,
+	       package_estimated(s) ? " (estimated from the CPUs)" : "");
+	printf("Core deep: %.1f%%\n", 100 * st->core_deep / t);
+	printf("GPU RC6: %.1f%%\n", 100 * st->rc6 / t);
+	printf("GPU RC6 while package not deep: %.1f%% - %.1f%%, %.1f%% if uncorrelated\n",
+	       100 * st->rc6_not_deep_min / t, 100 * st->rc6_not_deep_max / t,
+	       100 * st->rc6_not_deep_indep / t);
+	for (unsigned int i = 0; i < s->num_rapl; i++)
+		printf("Power %s: %.2fW\n", s->rapl[i].name, st->energy[i] / t);
+}
+
+static void print_summary_json(const struct sources *s, const struct stats *st)
+{
+	double t = st->time > 0 ? st->time : 1;
+
+	printf("{\n");
+	printf("\t\"intervals\": %u,\n", st->count);
+	printf("\t\"time\": %.6f,\n", st->time);
+	printf("\t\"max-skew-us\": %"PRIu64",\n", st->max_skew_ns / 1000);
+	printf("\t\"cpu-source\": \"%s\",\n", cpu_source_name(s));
+	printf("\t\"deep-level\": %d,\n", s->deep);
+	printf("\t\"package-estimated\": %s,\n",
+	       package_estimated(s) ? "true" : "false");
+	printf("\t\"package-deep\": %.3f,\n", 100 * st->pkg_deep / t);
+	printf("\t\"core-deep\": %.3f,\n", 100 * st->core_deep / t);
+	printf("\t\"rc6\": %.3f,\n", 100 * st->rc6 / t);
+	printf("\t\"rc6-not-package-deep\": {\n");
+	printf("\t\t\"min\": %.3f,\n", 100 * st->rc6_not_deep_min / t);
+	printf("\t\t\"max\": %.3f,\n", 100 * st->rc6_not_deep_max / t);
+	printf("\t\t\"uncorrelated\": %.3f\n", 100 * st->rc6_not_deep_indep / t);
+	printf("\t},\n");
+	printf("\t\"power\": {");
+	for (unsigned int i = 0; i < s->num_rapl; i++)
+		printf("%s\n\t\t\"%s\": %.3f", i ? "," : "", s->rapl[i].name,
+		       st->energy[i] / t);
+	printf("%s}\n", s->num_rapl ? "\n\t" : "");
+	printf("}\n");
+}
+
+static bool snapshot_exists(const char *dir, unsigned int i)
+{
+	char path[PATH_MAX];
+
+	snprintf(path, sizeof(path), "%s/%u", dir, i);
+	return access(path, F_OK) == 0;
+}
+
+/* Reads one fake root of a replay, timestamped by its time_ns file. */
+static bool replay_sample(struct sources *s, const char *dir, unsigned int i,
+			  bool msr, struct sample *smp)
+{
+	unsigned int num_cpus = s->num_cpus;
+	enum cpu_source cpu_source = s->cpu_source;
+	static char root[PATH_MAX]; /* s->root until the next snapshot */
+	bool ret;
+
+	snprintf(root, sizeof(root), "%s/%u", dir, i);
+
+	sources_close(s);
+	ret = sources_open(s, root, msr);
+	if (!ret)
+		fprintf(stderr, "No %s in %s\n",
+			s->cpu_source == CPU_NONE ? "C-state residency" : "GPU RC6",
+			root);
+	else if (i && (s->num_cpus != num_cpus ||
+			 s->cpu_source != cpu_source)) {
+		fprintf(stderr, "%s does not match the previous snapshots\n",
+			root);
+		ret = false;
+	}
+
+	if (ret) {
+		read_sample(s, smp);
+		smp->skew_ns = 0;
+		if (!read_u64_file(root, "/time_ns", &smp->t_ns)) {
+			fprintf(stderr, "No timestamp in %s\n", root);
+			ret = false;
+		}
+	}
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int period_ms = 1000, samples = 0;
+	const char *replay = NULL, *root = "";
+	bool json = false, quiet = false, msr = true;
+	struct sample smp[2] = {};
+	struct interval iv;
+	struct stats st = {};
+	uint64_t start_ns;
+	struct sources *s;
+	unsigned int i;
+	int c, ret = EXIT_FAILURE;
+
+	s = calloc(1, sizeof(*s));
+	if (!s)
+		return EXIT_FAILURE;
+	s->card = "card0";
+	s->deep = 6;
+	s->rc6_fd = -1;
+
+	while ((c = getopt(argc, argv, "hs:n:c:d:CJqr:R:")) != -1) {
+		switch (c) {
+		case 's':
+			period_ms = atoi(optarg);
+			if (!period_ms)
+				period_ms = 1;
+			break;
+		case 'n':
+			samples = atoi(optarg);
+			break;
+		case 'c':
+			s->deep = atoi(optarg);
+			break;
+		case 'd':
+			s->card = optarg;
+			break;
+		case 'C':
+			msr = false;
+			break;
+		case 'J':
+			json = true;
+			break;
+		case 'q':
+			quiet = true;
+			break;
+		case 'r':
+			root = optarg;
+			break;
+		case 'R':
+			replay = optarg;
+			break;
+		case 'h':
+			usage(argv[0]);
+			free(s);
+			return EXIT_SUCCESS;
+		default:
+			fprintf(stderr, "Invalid option %c!\n", (char)optopt);
+			usage(argv[0]);
+			free(s);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (replay) {
+		if (!snapshot_exists(replay, 0) || !snapshot_exists(replay, 1)) {
+			fprintf(stderr, "%s needs snapshots 0 and 1\n", replay);
+			goto out;
+		}
+	} else if (!sources_open(s, root, msr)) {
+		fprintf(stderr, "%s\n", s->cpu_source == CPU_NONE ?
+			"No C-state residency, is the msr module loaded?" :
+			"No GPU RC6 residency");
+		goto out;
+	}
+
+	for (i = 0; i < 2; i++) {
+		smp[i].cpu = calloc(MAX_CPUS, sizeof(*smp[i].cpu));
+		if (!smp[i].cpu)
+			goto out;
+	}
+
+	if (replay) {
+		if (!replay_sample(s, replay, 0, msr, &smp[0]))
+			goto out;
+	} else {
+		signal(SIGINT, sigint_handler);
+		read_sample(s, &smp[0]);
+	}
+	start_ns = smp[0].t_ns;
+
+	if (!quiet && !json)
+		print_header(s);
+
+	for (i = 1; !stop && (!samples || i <= samples); i++) {
+		struct sample *prev = &smp[(i - 1) & 1], *cur = &smp[i & 1];
+
+		if (replay) {
+			if (!snapshot_exists(replay, i))
+				break;
+			if (!replay_sample(s, replay, i, msr, cur))
+				goto out;
+		} else {
+			usleep(period_ms * 1000);
+			read_sample(s, cur);
+		}
+
+		compute_interval(s, prev, cur, &iv);
+		accumulate(&st, s, &iv, cur->skew_ns);
+
+		if (!quiet && !json)
+			print_interval(s, (cur->t_ns - start_ns) * 1e-9, &iv);
+	}
+
+	if (json)
+		print_summary_json(s, &st);
+	else
+		print_summary(s, &st);
+
+	ret = EXIT_SUCCESS;
+out:
+	sources_close(s);
+	free(smp[0].cpu);
+	free(smp[1].cpu);
+	free(s);
+	return ret;
+}
@@ -0,0 +1,150 @@
+/*
+ * Copyright © 2021 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ */
+
+/*
+ * Traces the PSR state of the source and the sink from debugfs, and reports
+ * the residency of each state, how long entering and leaving self refresh
+ * takes and how often it is left soon after being entered.
+ */
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "igt_psr.h"
+
+static void usage(const char *appname)
+{
+	printf("intel_psr_trace - PSR state transitions and residency\n"
+	       "\n"
+	       "Usage: %s [parameters]\n"
+	       "\n"
+	       "\t[-h]            Show this help text.\n"
+	       "\t[-d <dir>]      The debugfs directory of the device (default /sys/kernel/debug/dri/0).\n"
+	       "\t[-t <s>]        Trace for this long (default 10s).\n"
+	       "\t[-p <us>]       Sampling period in microseconds (default 1000us, 0 back to back).\n"
+	       "\t[-f <ms>]       Self refresh shorter than this is a flap (default 100ms).\n"
+	       "\t[-v]            Print each transition.\n",
+	       appname);
+}
+
+static void print_latency(const char *name, const struct igt_psr_latency *l)
+{
+	if (!l->count) {
+		printf("%s latency: -\n", name);
+		return;
+	}
+
+	printf("%s latency: min %.3fms, avg %.3fms, max %.3fms over %u\n",
+	       name, l->min_ns * 1e-6, l->total_ns * 1e-6 / l->count,
+	       l->max_ns * 1e-6, l->count);
+}
+
+int main(int argc, char **argv)
+{
+	const char *debugfs = "/sys/kernel/debug/dri/0";
+	uint64_t duration_ns = 10ull * NSEC_PER_SEC, period_ns = 1000000;
+	uint64_t flap_ns = 100000000;
+	struct igt_psr_trace_stats stats;
+	struct igt_psr_trace trace;
+	bool verbose = false;
+	int dir, c;
+
+	while ((c = getopt(argc, argv, "hd:t:p:f:v")) != -1) {
+		switch (c) {
+		case 'd':
+			debugfs = optarg;
+			break;
+		case 't':
+			duration_ns = strtod(optarg, NULL) * NSEC_PER_SEC;
+			break;
+		case 'p':
+			period_ns = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case 'f':
+			flap_ns = strtod(optarg, NULL) * 1000000;
+			break;
+		case 'v':
+			verbose = true;
+			break;
+		case 'h':
+			usage(argv[0]);
+			return EXIT_SUCCESS;
+		default:
+			fprintf(stderr, "Invalid option %c!\n", (char)optopt);
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	dir = open(debugfs, O_RDONLY | O_DIRECTORY);
+	if (dir < 0 || !igt_psr_trace_open(&trace, dir)) {
+		fprintf(stderr, "No PSR status under %s\n", debugfs);
+		return EXIT_FAILURE;
+	}
+	close(dir);
+
+	if (!igt_psr_trace_run(&trace, duration_ns, period_ns)) {
+		fprintf(stderr, "Failed to read the PSR status\n");
+		igt_psr_trace_fini(&trace);
+		return EXIT_FAILURE;
+	}
+
+	if (verbose) {
+		for (unsigned int i = 0; i < trace.num_transitions; i++) {
+			const struct igt_psr_transition *t =
+				&trace.transitions[i];
+
+			printf("%12.6f %-10s -> %-10s sink %d, %u SU blocks\n",
+			       (t->ts_ns - trace.first_ns) * 1e-9,
+			       igt_psr_state_name(t->from),
+			       igt_psr_state_name(t->to),
+			       t->sink_state, t->su_blocks);
+		}
+	}
+
+	igt_psr_trace_stats(&trace, flap_ns, &stats);
+
+	printf("%"PRIu64" samples over %.3fs, %u transitions\n",
+	       trace.num_samples, stats.duration_ns * 1e-9,
+	       trace.num_transitions);
+	for (int i = 0; i < IGT_PSR_NUM_STATES; i++) {
+		if (stats.residency_ns[i])
+			printf("%-10s %6.2f%%\n", igt_psr_state_name(i),
+			       100.0 * stats.residency_ns[i] /
+			       (stats.duration_ns ?: 1));
+	}
+	printf("Self refresh: %.2f%%, %u entries, %u exits, %u flaps\n",
+	       100.0 * stats.active_ns / (stats.duration_ns ?: 1),
+	       stats.entries, stats.exits, stats.flaps);
+	print_latency("Entry", &stats.entry);
+	print_latency("Exit", &stats.exit);
+	printf("Max SU blocks: %u\n", trace.su_blocks_max);
+
+	igt_psr_trace_fini(&trace);
+
+	return EXIT_SUCCESS;
+}